@@ -0,0 +1,109 @@
+#pragma once
+
+#include "http/HttpParser.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace hsmm {
+namespace http {
+
+/**
+ * @brief 响应体的内容编码
+ */
+enum class ContentEncoding : std::uint8_t {
+    identity,
+    gzip,
+    deflate,
+    br
+};
+
+/**
+ * @brief 响应压缩配置
+ */
+struct CompressionOptions {
+    // 是否启用响应压缩
+    bool enabled = true;
+    // 小于该大小的响应体不压缩，收益不足以抵消CPU开销和额外的头部
+    size_t min_size = 1024;
+    // 动态响应每次请求都要压缩，使用较快的级别
+    int gzip_level = 6;
+    int brotli_quality = 5;
+    // 静态文件只在加载时压缩一次，使用较高的级别
+    int static_gzip_level = 9;
+    int static_brotli_quality = 9;
+    // 压缩动态响应的线程数，压缩不在IO线程上执行
+    size_t threads = 2;
+};
+
+/**
+ * @brief 获取编码在Content-Encoding中的名称
+ * @param encoding 内容编码
+ * @return 编码名称
+ */
+std::string_view encoding_token(ContentEncoding encoding) noexcept;
+
+/**
+ * @brief 获取当前构建支持的压缩编码，按服务器优先顺序排列
+ * @return 压缩编码列表，不包含identity
+ */
+std::span<const ContentEncoding> supported_encodings() noexcept;
+
+/**
+ * @brief 按Accept-Encoding选择编码
+ *
+ * 选择q值最高的编码，q值相同时按available中的顺序，q=0表示拒绝该编码
+ * @param accept_encoding 请求的Accept-Encoding头
+ * @param available 可选的压缩编码
+ * @return 选中的编码，没有可接受的压缩编码时返回identity
+ */
+ContentEncoding negotiate_encoding(std::string_view accept_encoding,
+                                   std::span<const ContentEncoding> available) noexcept;
+
+/**
+ * @brief 判断内容类型是否值得压缩
+ *
+ * 文本、JSON、JavaScript、XML、SVG和WebAssembly可以压缩，图片、视频和已压缩格式不再压缩
+ * @param content_type Content-Type头
+ * @return 是否值得压缩
+ */
+bool is_compressible_type(std::string_view content_type) noexcept;
+
+/**
+ * @brief 压缩数据
+ * @param encoding 压缩编码，不能是identity
+ * @param input 输入数据
+ * @param output 输出缓冲区，压缩结果覆盖原有内容
+ * @param level 压缩级别（gzip/deflate为1-9，br为0-11）
+ * @return 是否压缩成功
+ */
+bool compress(ContentEncoding encoding, std::string_view input, std::string& output, int level);
+
+/**
+ * @brief 为处理函数生成的响应协商编码
+ *
+ * 响应适合压缩时添加Vary: Accept-Encoding，不论最终是否压缩，缓存才能区分不同的表示。
+ * 预先生成的响应、文件响应体、分块响应体和已经设置了Content-Encoding的响应不处理。
+ * @param request HTTP请求
+ * @param response HTTP响应
+ * @param options 压缩配置
+ * @return 应使用的编码，不需要压缩时返回identity
+ */
+ContentEncoding negotiate_response_encoding(const HttpRequest& request, HttpResponse& response,
+                                            const CompressionOptions& options);
+
+/**
+ * @brief 压缩响应体并设置Content-Encoding
+ *
+ * 压缩结果由响应持有，原来的响应体持有者同时保留。压缩后没有变小时响应保持不变。
+ * @param response HTTP响应
+ * @param encoding negotiate_response_encoding选中的编码
+ * @param options 压缩配置
+ * @return 是否压缩了响应体
+ */
+bool compress_response(HttpResponse& response, ContentEncoding encoding, const CompressionOptions& options);
+
+} // namespace http
+} // namespace hsmm
@@ -0,0 +1,304 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory_resource>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace hsmm {
+namespace http {
+
+/**
+ * @brief 常用的请求头，解析时直接解析为槽位编号
+ */
+enum class Header : std::uint8_t {
+    accept,
+    accept_encoding,
+    accept_language,
+    authorization,
+    cache_control,
+    connection,
+    content_length,
+    content_type,
+    cookie,
+    expect,
+    forwarded,
+    host,
+    http2_settings,
+    if_match,
+    if_modified_since,
+    if_none_match,
+    if_range,
+    if_unmodified_since,
+    keep_alive,
+    origin,
+    pragma,
+    proxy_connection,
+    range,
+    referer,
+    sec_websocket_extensions,
+    sec_websocket_key,
+    sec_websocket_protocol,
+    sec_websocket_version,
+    te,
+    trailer,
+    transfer_encoding,
+    upgrade,
+    user_agent,
+    via,
+    x_forwarded_for,
+    x_forwarded_host,
+    x_forwarded_proto,
+    x_real_ip,
+    x_request_id,
+    count
+};
+
+namespace detail {
+
+// 常用请求头的规范写法，顺序与Header一致
+inline constexpr std::array<std::string_view, static_cast<size_t>(Header::count)> header_names{
+    "Accept", "Accept-Encoding", "Accept-Language", "Authorization", "Cache-Control", "Connection",
+    "Content-Length", "Content-Type", "Cookie", "Expect", "Forwarded", "Host", "HTTP2-Settings",
+    "If-Match", "If-Modified-Since", "If-None-Match", "If-Range", "If-Unmodified-Since", "Keep-Alive",
+    "Origin", "Pragma", "Proxy-Connection", "Range", "Referer", "Sec-WebSocket-Extensions",
+    "Sec-WebSocket-Key", "Sec-WebSocket-Protocol", "Sec-WebSocket-Version", "TE", "Trailer",
+    "Transfer-Encoding", "Upgrade", "User-Agent", "Via", "X-Forwarded-For", "X-Forwarded-Host",
+    "X-Forwarded-Proto", "X-Real-IP", "X-Request-Id"
+};
+
+inline constexpr size_t header_table_bits = 7;
+inline constexpr std::uint8_t no_header = 0xff;
+
+constexpr char to_lower(char c) noexcept {
+    return c >= 'A' && c <= 'Z' ? static_cast<char>(c + ('a' - 'A')) : c;
+}
+
+// 只取长度和首、中、尾三个字符（不区分大小写），哈希本身不需要遍历字段名
+constexpr size_t header_hash(std::string_view name, std::uint32_t seed) noexcept {
+    std::uint32_t h = static_cast<std::uint32_t>(name.size()) * seed;
+    h = (h ^ static_cast<std::uint8_t>(to_lower(name.front()))) * seed;
+    h = (h ^ static_cast<std::uint8_t>(to_lower(name[name.size() / 2]))) * seed;
+    h = (h ^ static_cast<std::uint8_t>(to_lower(name.back()))) * seed;
+    return h >> (32 - header_table_bits);
+}
+
+// 编译期寻找使所有常用请求头落在不同槽位的种子，即完美哈希
+constexpr std::uint32_t find_header_seed() noexcept {
+    for (std::uint32_t seed = 0x9e3779b1; ; seed += 2) {
+        std::array<bool, size_t{1} << header_table_bits> used{};
+        bool collision = false;
+        for (const auto name : header_names) {
+            auto& slot = used[header_hash(name, seed)];
+            collision = collision || slot;
+            slot = true;
+        }
+        if (!collision) {
+            return seed;
+        }
+    }
+}
+
+inline constexpr std::uint32_t header_seed = find_header_seed();
+
+constexpr std::array<std::uint8_t, size_t{1} << header_table_bits> make_header_table() noexcept {
+    std::array<std::uint8_t, size_t{1} << header_table_bits> table{};
+    for (auto& entry : table) {
+        entry = no_header;
+    }
+    for (size_t i = 0; i < header_names.size(); ++i) {
+        table[header_hash(header_names[i], header_seed)] = static_cast<std::uint8_t>(i);
+    }
+    return table;
+}
+
+inline constexpr auto header_table = make_header_table();
+
+inline constexpr size_t max_header_name = [] {
+    size_t longest = 0;
+    for (const auto name : header_names) {
+        longest = std::max(longest, name.size());
+    }
+    return longest;
+}();
+
+} // namespace detail
+
+/**
+ * @brief 请求头表
+ *
+ * 常用请求头（Header）在解析时通过完美哈希解析为槽位编号，存放在按编号索引的数组中，
+ * get(Header)直接读取槽位，不计算哈希也不比较字符串。
+ * 其他请求头按收到的顺序存放在溢出列表中，find()按字段名不区分大小写地逐个比较。
+ * 同一个常用请求头出现多次时只保留第一个，溢出列表中的重复字段全部保留，查找返回第一个。
+ * 字段名和值都是视图，引用的数据由调用者保证有效（通常在读缓冲区或请求内存池中）。
+ */
+class HeaderMap {
+public:
+    using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+    using value_type = std::pair<std::string_view, std::string_view>;
+
+    static constexpr size_t known_count = static_cast<size_t>(Header::count);
+    static_assert(known_count <= 64, "present_按位记录常用请求头");
+
+    /**
+     * @brief 按字段名查找常用请求头，不区分大小写
+     * @param name 字段名
+     * @return 槽位编号，不是常用请求头时返回std::nullopt
+     */
+    static std::optional<Header> lookup(std::string_view name) noexcept {
+        if (name.empty() || name.size() > detail::max_header_name) {
+            return std::nullopt;
+        }
+        const auto index = detail::header_table[detail::header_hash(name, detail::header_seed)];
+        if (index == detail::no_header || !iequals(detail::header_names[index], name)) {
+            return std::nullopt;
+        }
+        return static_cast<Header>(index);
+    }
+
+    /**
+     * @brief 常用请求头的规范写法
+     */
+    static constexpr std::string_view name(Header header) noexcept {
+        return detail::header_names[static_cast<size_t>(header)];
+    }
+
+    /**
+     * @brief 不区分大小写比较ASCII字段名
+     */
+    static bool iequals(std::string_view a, std::string_view b) noexcept {
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+            return detail::to_lower(x) == detail::to_lower(y);
+        });
+    }
+
+    /**
+     * @brief 遍历所有请求头：先是常用请求头（使用规范写法），然后是溢出列表
+     */
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = HeaderMap::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = value_type;
+
+        const_iterator() = default;
+        const_iterator(const HeaderMap* map, size_t index) noexcept : map_(map), index_(index) { skip_absent(); }
+
+        value_type operator*() const noexcept {
+            if (index_ < known_count) {
+                return {detail::header_names[index_], map_->known_[index_]};
+            }
+            return map_->other_[index_ - known_count];
+        }
+        const_iterator& operator++() noexcept { ++index_; skip_absent(); return *this; }
+        const_iterator operator++(int) noexcept { auto it = *this; ++*this; return it; }
+        bool operator==(const const_iterator& other) const noexcept { return index_ == other.index_; }
+
+    private:
+        // 跳到下一个出现的常用请求头，没有时跳到溢出列表
+        void skip_absent() noexcept {
+            if (index_ < known_count) {
+                const auto rest = map_->present_ >> index_;
+                index_ = rest == 0 ? known_count : index_ + static_cast<size_t>(std::countr_zero(rest));
+            }
+        }
+
+        const HeaderMap* map_{nullptr};
+        size_t index_{0};
+    };
+
+    explicit HeaderMap(allocator_type alloc = {}) : other_(alloc) {}
+
+    /**
+     * @brief 添加请求头，先解析是否是常用请求头
+     * @param name 字段名
+     * @param value 字段值
+     * @return 常用请求头的槽位编号，其他请求头返回std::nullopt
+     */
+    std::optional<Header> add(std::string_view name, std::string_view value) {
+        const auto header = lookup(name);
+        if (header) {
+            add(*header, value);
+        } else {
+            other_.emplace_back(name, value);
+        }
+        return header;
+    }
+
+    /**
+     * @brief 添加常用请求头，已经存在时保留原来的值
+     */
+    void add(Header header, std::string_view value) noexcept {
+        const auto index = static_cast<size_t>(header);
+        if (!(present_ >> index & 1)) {
+            present_ |= std::uint64_t{1} << index;
+            known_[index] = value;
+        }
+    }
+
+    /**
+     * @brief 设置常用请求头，替换原来的值
+     */
+    void set(Header header, std::string_view value) noexcept {
+        const auto index = static_cast<size_t>(header);
+        present_ |= std::uint64_t{1} << index;
+        known_[index] = value;
+    }
+
+    /**
+     * @brief 读取常用请求头，O(1)
+     * @return 字段值，不存在时返回std::nullopt
+     */
+    std::optional<std::string_view> get(Header header) const noexcept {
+        const auto index = static_cast<size_t>(header);
+        if (!(present_ >> index & 1)) {
+            return std::nullopt;
+        }
+        return known_[index];
+    }
+
+    bool contains(Header header) const noexcept { return present_ >> static_cast<size_t>(header) & 1; }
+
+    /**
+     * @brief 按字段名查找请求头，不区分大小写；常用请求头直接读取槽位，其他的在溢出列表中查找
+     * @return 第一个匹配的字段值，不存在时返回std::nullopt
+     */
+    std::optional<std::string_view> find(std::string_view name) const noexcept {
+        if (const auto header = lookup(name)) {
+            return get(*header);
+        }
+        for (const auto& [key, value] : other_) {
+            if (iequals(key, name)) {
+                return value;
+            }
+        }
+        return std::nullopt;
+    }
+
+    bool contains(std::string_view name) const noexcept { return find(name).has_value(); }
+
+    size_t size() const noexcept { return static_cast<size_t>(std::popcount(present_)) + other_.size(); }
+    bool empty() const noexcept { return size() == 0; }
+
+    const_iterator begin() const noexcept { return const_iterator(this, 0); }
+    const_iterator end() const noexcept { return const_iterator(this, known_count + other_.size()); }
+
+private:
+    // 第i位表示第i个常用请求头存在
+    std::uint64_t present_{0};
+    std::array<std::string_view, known_count> known_{};
+    std::pmr::vector<value_type> other_;
+};
+
+} // namespace http
+} // namespace hsmm
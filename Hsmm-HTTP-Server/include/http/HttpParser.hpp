@@ -1,9 +1,17 @@
 #pragma once
 
+#include "http/Headers.hpp"
+#include <algorithm>
+#include <string>
 #include <string_view>
 #include <span>
+#include <functional>
 #include <optional>
-#include <unordered_map>
+#include <vector>
+#include <utility>
+#include <memory>
+#include <memory_resource>
+#include <cstdint>
 
 namespace hsmm {
 namespace http {
@@ -12,11 +20,49 @@ namespace http {
  * @brief HTTP请求解析结果
  */
 struct HttpRequest {
+    using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+    /**
+     * @brief 构造函数
+     * @param alloc 头部表使用的分配器，通常指向连接的请求内存池
+     */
+    explicit HttpRequest(allocator_type alloc = {})
+        : headers(alloc) {}
+
     std::string_view method;
     std::string_view uri;
     std::string_view version;
-    std::unordered_map<std::string_view, std::string_view> headers;
+    // 常用请求头用headers.get(Header::...)读取，其他的用headers.find(字段名)，都不区分大小写
+    HeaderMap headers;
+    // 与请求头在同一次读取中收到的请求体，流式接收的请求体不在这里
     std::string_view body;
+
+    // Content-Length，没有该头部时为std::nullopt
+    std::optional<std::uint64_t> content_length;
+    // 是否使用分块传输编码（Transfer-Encoding: chunked）
+    bool chunked{false};
+    // 客户端是否在发送请求体前等待"100 Continue"
+    bool expect_continue{false};
+    // Connection头部中是否有close或keep-alive选项
+    bool connection_close{false};
+    bool connection_keep_alive{false};
+
+    // 调用异步处理函数的连接设置：把任务投递回该连接（strand）执行，可以在任意线程调用；其他情况下为nullptr
+    const std::function<void(std::function<void()>)>* post{nullptr};
+
+    /**
+     * @brief 判断请求是否带有请求体
+     * @return 是否需要读取请求体
+     */
+    bool has_body() const noexcept { return chunked || content_length.value_or(0) > 0; }
+
+    /**
+     * @brief 判断响应后能否继续在连接上读取下一个请求
+     * @return HTTP/1.1默认为长连接，HTTP/1.0需要Connection: keep-alive；Connection: close总是关闭
+     */
+    bool keep_alive() const noexcept {
+        return !connection_close && (version != "HTTP/1.0" || connection_keep_alive);
+    }
 };
 
 /**
@@ -24,6 +70,13 @@ struct HttpRequest {
  */
 class HttpResponse {
 public:
+    /**
+     * @brief 构造函数
+     * @param resource 头部列表使用的内存资源
+     */
+    explicit HttpResponse(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : headers_(resource) {}
+
     /**
      * @brief 设置状态码和状态消息
      * @param code HTTP状态码
@@ -44,17 +97,231 @@ public:
      */
     void set_body(std::string_view body);
 
+    /**
+     * @brief 设置由其他对象持有的响应体
+     * @param body 响应体内容
+     * @param owner 保证body在发送完成前有效的对象
+     */
+    void set_body(std::string_view body, std::shared_ptr<const void> owner);
+
+    /**
+     * @brief 获取状态码
+     * @return HTTP状态码
+     */
+    int status_code() const noexcept { return status_code_; }
+
+    /**
+     * @brief 获取响应体
+     * @return 响应体内容
+     */
+    std::string_view body() const noexcept { return body_; }
+
+    /**
+     * @brief 获取状态消息
+     * @return 状态消息
+     */
+    std::string_view status_message() const noexcept { return status_message_; }
+
+    /**
+     * @brief 获取响应头列表（不包括自动生成的Content-Length）
+     * @return 按添加顺序排列的头部字段
+     */
+    std::span<const std::pair<std::string_view, std::string_view>> headers() const noexcept { return headers_; }
+
+    /**
+     * @brief 计算Content-Length
+     * @return 响应体长度，分块发送时为std::nullopt
+     */
+    std::optional<std::uint64_t> content_length() const noexcept;
+
+    /**
+     * @brief 查找响应头，字段名不区分大小写
+     * @param name 头部字段名
+     * @return 第一个匹配的字段值，不存在时返回std::nullopt
+     */
+    std::optional<std::string_view> header(std::string_view name) const noexcept;
+
+    /**
+     * @brief 文件响应体，由连接通过sendfile直接从文件发送
+     */
+    struct FileBody {
+        int fd;
+        std::uint64_t offset;
+        std::uint64_t length;
+    };
+
+    /**
+     * @brief 使用预先生成的响应数据，发送时不再序列化
+     *
+     * 设置了文件响应体时，这里只包含响应头部
+     * @param data 预先生成的响应数据
+     * @param owner 保证data在发送完成前有效的对象
+     */
+    void set_prebuilt(std::string_view data, std::shared_ptr<const void> owner);
+
+    /**
+     * @brief 设置文件响应体
+     * @param fd 文件描述符，发送期间必须保持打开
+     * @param offset 文件起始偏移
+     * @param length 发送的字节数
+     * @param owner 持有fd的对象，保证发送完成前fd有效
+     */
+    void set_file_body(int fd, std::uint64_t offset, std::uint64_t length, std::shared_ptr<const void> owner);
+
+    /**
+     * @brief 分块响应体的数据源
+     *
+     * 每次调用向缓冲区写入下一段数据并返回写入的字节数，返回0表示响应体结束。
+     * 上一段数据发送完成后才会请求下一段，发送速度受客户端接收速度限制。
+     */
+    using ChunkSource = std::function<std::size_t(std::span<char>)>;
+
+    /**
+     * @brief 设置长度未知的响应体，使用分块传输编码发送
+     * @param source 数据源
+     */
+    void set_chunked_body(ChunkSource source);
+
+    /**
+     * @brief 获取预先生成的响应数据
+     * @return 响应数据，未设置时为空
+     */
+    std::string_view prebuilt() const noexcept { return prebuilt_; }
+
+    /**
+     * @brief 获取文件响应体
+     * @return 文件响应体，未设置时为std::nullopt
+     */
+    const std::optional<FileBody>& file_body() const noexcept { return file_body_; }
+
+    /**
+     * @brief 获取分块响应体的数据源
+     * @return 数据源，未设置时为空
+     */
+    const ChunkSource& chunked_body() const noexcept { return chunked_body_; }
+
+    /**
+     * @brief 获取响应数据的持有者
+     * @return 持有prebuilt数据和文件描述符的对象
+     */
+    const std::shared_ptr<const void>& owner() const noexcept { return owner_; }
+
+    /**
+     * @brief 获取响应使用的内存资源
+     * @return 构造时传入的内存资源
+     */
+    std::pmr::memory_resource* resource() const noexcept { return headers_.get_allocator().resource(); }
+
     /**
      * @brief 生成完整的HTTP响应
      * @return 格式化后的HTTP响应字符串
      */
     std::string to_string() const;
 
+    /**
+     * @brief 将完整的HTTP响应追加到输出缓冲区
+     *
+     * 不经过临时字符串，输出缓冲区可以分配在请求内存池上
+     * @param out 输出缓冲区
+     */
+    void serialize(std::pmr::string& out) const;
+
+    /**
+     * @brief 只将状态行和头部追加到输出缓冲区，响应体由调用者直接从body()发送
+     * @param out 输出缓冲区
+     */
+    void serialize_head(std::pmr::string& out) const;
+
+    /**
+     * @brief 将预先生成的响应的头部追加到输出缓冲区，并在头部末尾加上一个字段
+     *
+     * 预先生成的响应不受add_header()影响，发送前需要额外的头部（例如Connection: close）时使用
+     * @param out 输出缓冲区
+     * @param name 追加的头部字段名
+     * @param value 追加的头部字段值
+     * @return prebuilt()中头部之后的响应体，由调用者接着发送
+     */
+    std::string_view serialize_prebuilt_head(std::pmr::string& out, std::string_view name, std::string_view value) const;
+
 private:
     int status_code_{200};
     std::string_view status_message_{"OK"};
-    std::unordered_map<std::string_view, std::string_view> headers_;
+    std::pmr::vector<std::pair<std::string_view, std::string_view>> headers_;
     std::string_view body_;
+    std::string_view prebuilt_;
+    std::optional<FileBody> file_body_;
+    ChunkSource chunked_body_;
+    std::shared_ptr<const void> owner_;
+};
+
+/**
+ * @brief 分块传输编码的增量解码器
+ *
+ * 输入可以在任意位置被切分，数据块以输入的子区间交给回调，不复制数据
+ */
+class ChunkedDecoder {
+public:
+    enum class Status {
+        need_more,  // 输入已全部消耗，需要更多数据
+        done,       // 请求体（包括trailer）已结束
+        error       // 编码格式错误
+    };
+
+    /**
+     * @brief 解码一段输入
+     * @param input 输入数据
+     * @param consumed 输出实际消耗的字节数，结束时其后的数据属于下一个请求
+     * @param on_data 数据回调，参数为std::span<const char>
+     * @return 解码状态
+     */
+    template<typename F>
+    Status decode(std::span<const char> input, std::size_t& consumed, F&& on_data) {
+        std::size_t pos = 0;
+        while (pos < input.size() && state_ != State::done) {
+            if (state_ == State::data) {
+                const auto n = static_cast<std::size_t>(std::min<std::uint64_t>(remaining_, input.size() - pos));
+                on_data(input.subspan(pos, n));
+                pos += n;
+                remaining_ -= n;
+                if (remaining_ == 0) {
+                    state_ = State::data_cr;
+                }
+                continue;
+            }
+            if (!step(input[pos++])) {
+                consumed = pos;
+                return Status::error;
+            }
+        }
+        consumed = pos;
+        return state_ == State::done ? Status::done : Status::need_more;
+    }
+
+    /**
+     * @brief 重置为初始状态，用于下一个请求
+     */
+    void reset() noexcept {
+        state_ = State::size;
+        remaining_ = 0;
+        digits_ = 0;
+    }
+
+private:
+    /**
+     * @brief 处理一个控制字节（分块大小、扩展、分隔符和trailer）
+     * @param c 输入字节
+     * @return 格式是否正确
+     */
+    bool step(char c) noexcept;
+
+    enum class State {
+        size, extension, size_lf, data, data_cr, data_lf,
+        trailer_start, trailer_line, trailer_lf, final_lf, done
+    };
+
+    State state_{State::size};
+    std::uint64_t remaining_{0};
+    unsigned digits_{0};
 };
 
 /**
@@ -65,9 +332,18 @@ public:
     /**
      * @brief 解析HTTP请求
      * @param data 请求数据
+     * @param resource 解析结果使用的内存资源
      * @return 解析结果，如果解析失败返回std::nullopt
      */
-    static std::optional<HttpRequest> parse(std::span<const char> data);
+    static std::optional<HttpRequest> parse(std::span<const char> data,
+                                            std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    /**
+     * @brief 查找请求头的结束位置
+     * @param data 已收到的数据
+     * @return 请求头（包括结尾的空行）的长度，请求头还不完整时返回0
+     */
+    static std::size_t header_size(std::span<const char> data) noexcept;
 
 private:
     /**
@@ -82,7 +358,8 @@ private:
      * @brief 解析头部字段
      * @param line 头部字段行
      * @param request 解析结果存储对象
-     * @return 是否解析成功
+     * @return 是否解析成功，续行（obs-fold）、字段名与冒号之间有空白、
+     *         Content-Length或Transfer-Encoding无效时返回false
      */
     static bool parse_header(std::string_view line, HttpRequest& request);
 };
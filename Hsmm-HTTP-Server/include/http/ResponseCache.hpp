@@ -0,0 +1,143 @@
+#pragma once
+
+#include "http/Compression.hpp"
+#include "http/HttpParser.hpp"
+#include "http/Router.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace hsmm {
+namespace http {
+
+/**
+ * @brief 响应缓存配置
+ */
+struct CacheOptions {
+    // 缓存的总字节数上限（包括各编码的变体），为0时不启用缓存
+    size_t max_bytes = 64 * 1024 * 1024;
+    // 单个响应体的大小上限，更大的响应不缓存
+    size_t max_entry_size = 1024 * 1024;
+    // 响应没有Cache-Control: max-age/s-maxage时的缓存时间，为0时不缓存这样的响应
+    std::chrono::seconds default_ttl{0};
+    // 响应没有stale-while-revalidate指令时，过期后仍可先返回旧响应、同时在后台刷新的时间
+    std::chrono::seconds stale_while_revalidate{0};
+    // 除方法和URI外参与缓存键的请求头；响应的Vary只能包含这些头和Accept-Encoding，否则不缓存
+    std::vector<std::string> key_headers;
+    // 响应不能缓存后，同一个键的请求在这段时间内不再等待进行中的调用，直接调用处理函数（hit-for-pass）
+    std::chrono::seconds hit_for_pass{5};
+};
+
+/**
+ * @brief 进程内的HTTP响应缓存
+ *
+ * 包装处理函数，缓存键为方法、URI和CacheOptions::key_headers的值。只缓存GET/HEAD请求的、
+ * 由Cache-Control（s-maxage优先于max-age）或default_ttl给出有效期的响应；no-store、private、
+ * no-cache、带Set-Cookie的响应不缓存，带Authorization或Cache-Control: no-cache/no-store的请求不经过缓存。
+ *
+ * 响应在存入时序列化为完整的HTTP/1.1响应，可压缩的响应同时按每种支持的编码压缩一次，
+ * 命中时直接作为预先生成的响应发送，不再序列化或压缩。
+ * 同一个键的并发未命中合并为一次处理函数调用，其余请求等待其结果；结果不能缓存时，
+ * 等待的请求各自回到所在的连接上调用处理函数，之后hit_for_pass期间同一个键的请求不再等待。
+ * 过期但仍在stale-while-revalidate期限内的条目先返回旧响应，同时在后台调用一次处理函数刷新。
+ *
+ * 缓存分为多个分片，每个分片一把锁，按字节数限制容量。淘汰按LRU顺序，新条目的准入使用
+ * TinyLFU：只有估计访问频率高于被淘汰条目的新条目才会挤掉它，一次性的访问不会冲掉热点条目。
+ */
+class ResponseCache : public std::enable_shared_from_this<ResponseCache> {
+public:
+    /**
+     * @brief 把后台刷新投递到工作线程执行，可以在任意线程调用
+     */
+    using Post = std::function<void(std::function<void()>)>;
+
+    /**
+     * @brief 构造函数
+     * @param options 缓存配置
+     * @param compression 压缩配置，用于生成缓存条目的压缩变体
+     * @param post 投递后台刷新的函数，为空时在触发刷新的线程上直接调用处理函数
+     */
+    ResponseCache(CacheOptions options, CompressionOptions compression, Post post = {});
+    ~ResponseCache();
+
+    ResponseCache(const ResponseCache&) = delete;
+    ResponseCache& operator=(const ResponseCache&) = delete;
+
+    /**
+     * @brief 包装同步处理函数
+     * @param handler 处理函数
+     * @return 带缓存的异步处理函数，命中时在调用线程上直接完成
+     */
+    Router::AsyncHandler wrap(Router::Handler handler);
+
+    /**
+     * @brief 包装异步处理函数
+     * @param handler 异步处理函数
+     * @return 带缓存的异步处理函数
+     */
+    Router::AsyncHandler wrap(Router::AsyncHandler handler);
+
+    /**
+     * @brief 当前缓存的字节数
+     */
+    size_t size_bytes() const;
+
+private:
+    struct Stored;
+    struct Fill;
+    struct Shard;
+
+    using SharedHandler = std::shared_ptr<const Router::AsyncHandler>;
+
+    void handle(const SharedHandler& handler, const HttpRequest& request, HttpResponse& response,
+                Router::Completion done);
+
+    /**
+     * @brief 一次处理函数调用结束，存入结果并唤醒等待同一个键的请求
+     * @param stored 新的缓存条目，响应不能缓存或处理函数失败时为nullptr，此时记录hit-for-pass，
+     *               等待的请求各自投递回所在的连接（HttpRequest::post）调用处理函数
+     */
+    void complete(const SharedHandler& handler, Shard& shard, const std::string& key, std::uint64_t hash,
+                  std::shared_ptr<const Stored> stored);
+
+    /**
+     * @brief 在后台用请求的副本调用处理函数刷新条目
+     */
+    void revalidate(const SharedHandler& handler, Shard& shard, std::string key, std::uint64_t hash,
+                    const HttpRequest& request);
+
+    /**
+     * @brief 把处理函数生成的响应转换为缓存条目，不能缓存时返回nullptr
+     */
+    std::shared_ptr<const Stored> make_stored(const HttpResponse& response) const;
+
+    /**
+     * @brief 用缓存条目中适合该请求的编码变体填写响应
+     */
+    static void apply(const std::shared_ptr<const Stored>& stored, const HttpRequest& request, HttpResponse& response);
+
+    /**
+     * @brief 生成缓存键
+     * @return 请求能否使用缓存
+     */
+    bool make_key(const HttpRequest& request, std::string& key) const;
+
+    /**
+     * @brief 存入条目（调用者持有分片的锁），新条目需要通过TinyLFU准入，分片超出容量时按LRU淘汰
+     */
+    void insert(Shard& shard, const std::string& key, std::uint64_t hash, std::shared_ptr<const Stored> stored);
+
+    Shard& shard_for(std::uint64_t hash) noexcept;
+
+    const CacheOptions options_;
+    const CompressionOptions compression_;
+    const Post post_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+} // namespace http
+} // namespace hsmm
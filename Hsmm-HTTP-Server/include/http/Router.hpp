@@ -0,0 +1,193 @@
+#pragma once
+
+#include "http/HttpParser.hpp"
+#include "websocket/WebSocket.hpp"
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace hsmm {
+namespace http {
+
+/**
+ * @brief 流式请求体的接收者
+ *
+ * 由流式路由的处理函数为每个请求创建。请求体不在内存中缓存，按收到的顺序分段交给on_data()；
+ * 连接在on_data()返回之前不会继续读取，接收窗口填满后TCP流量控制会让客户端暂停发送。
+ * BodyReader在响应发送完成后才销毁，响应体可以引用它的成员。
+ */
+class BodyReader {
+public:
+    virtual ~BodyReader() = default;
+
+    /**
+     * @brief 收到一段请求体（已去除分块编码）
+     * @param data 数据，仅在调用期间有效
+     */
+    virtual void on_data(std::span<const char> data) = 0;
+
+    /**
+     * @brief 请求体接收完毕，填写响应
+     * @param response 响应
+     */
+    virtual void on_complete(HttpResponse& response) = 0;
+};
+
+/**
+ * @brief 请求路由表
+ *
+ * 按URI路径（不含查询字符串）查找处理函数：先精确匹配，再按最长前缀匹配，最后使用默认处理函数。
+ * 路由必须在服务器启动前注册，运行期间只读，可被多个IO线程并发访问。
+ */
+class Router {
+public:
+    /**
+     * @brief 请求处理函数，可能被多个线程并发调用
+     */
+    using Handler = std::function<void(const HttpRequest&, HttpResponse&)>;
+
+    /**
+     * @brief 流式请求处理函数，在收到请求头后调用
+     *
+     * 返回接收请求体的BodyReader；返回nullptr表示拒绝请求，此时应已填写响应，连接在发送响应后关闭。
+     * request中的数据仅在调用期间有效。
+     */
+    using StreamHandler = std::function<std::unique_ptr<BodyReader>(const HttpRequest&, HttpResponse&)>;
+
+    /**
+     * @brief 异步处理函数的完成通知，可以在任意线程调用，只能调用一次
+     */
+    using Completion = std::function<void()>;
+
+    /**
+     * @brief 异步请求处理函数，在完整收到请求（请求体按max_body_size缓存）后调用
+     *
+     * 处理函数返回后可以继续在其他线程上填写响应，填写完成后调用done。
+     * 调用done之前request和response保持有效，连接不会读取下一个请求。
+     * 处理函数抛出异常时生成500响应，此时不能再调用done。
+     */
+    using AsyncHandler = std::function<void(const HttpRequest&, HttpResponse&, Completion done)>;
+
+    /**
+     * @brief 路由表项，四种处理函数只设置其中一种
+     */
+    struct Route {
+        Handler handler;
+        StreamHandler stream_handler;
+        AsyncHandler async_handler;
+        std::shared_ptr<const websocket::Handler> websocket;
+    };
+
+    /**
+     * @brief 注册精确匹配的路由
+     * @param path 请求路径
+     * @param handler 处理函数
+     */
+    void add_route(std::string path, Handler handler);
+
+    /**
+     * @brief 注册前缀匹配的路由
+     * @param prefix 路径前缀
+     * @param handler 处理函数
+     */
+    void add_prefix_route(std::string prefix, Handler handler);
+
+    /**
+     * @brief 注册精确匹配的流式路由，请求体不受ServerOptions::max_body_size限制
+     * @param path 请求路径
+     * @param handler 流式处理函数
+     */
+    void add_stream_route(std::string path, StreamHandler handler);
+
+    /**
+     * @brief 注册精确匹配的异步路由
+     * @param path 请求路径
+     * @param handler 异步处理函数
+     */
+    void add_async_route(std::string path, AsyncHandler handler);
+
+    /**
+     * @brief 注册前缀匹配的异步路由
+     * @param prefix 路径前缀
+     * @param handler 异步处理函数
+     */
+    void add_async_prefix_route(std::string prefix, AsyncHandler handler);
+
+    /**
+     * @brief 注册精确匹配的WebSocket路由，只接受HTTP/1.1的升级请求，其他请求返回426
+     * @param path 请求路径
+     * @param handler WebSocket回调
+     */
+    void add_websocket_route(std::string path, websocket::Handler handler);
+
+    /**
+     * @brief 设置没有路由匹配时使用的处理函数
+     * @param handler 处理函数
+     */
+    void set_default(Handler handler);
+
+    /**
+     * @brief 查找请求对应的路由
+     * @param uri 请求URI
+     * @return 匹配的路由表项
+     */
+    const Route& find(std::string_view uri) const;
+
+    /**
+     * @brief 使用已经完整收到的请求调用路由的处理函数
+     *
+     * 流式路由会一次收到整个request.body。处理函数抛出异常时生成500响应。
+     * 异步路由需要调用者支持（Connection和http2::Session），这里生成501响应；
+     * WebSocket路由需要Connection处理升级，这里生成426响应
+     * @param route 路由表项
+     * @param request 请求
+     * @param response 响应
+     * @return 流式路由创建的BodyReader，调用者必须在响应发送完成前保持其有效
+     */
+    static std::unique_ptr<BodyReader> handle(const Route& route, const HttpRequest& request, HttpResponse& response);
+
+    /**
+     * @brief 解析一个完整的HTTP请求并调用匹配的处理函数
+     *
+     * 请求格式错误时生成400响应，请求体不在data中时生成411/413响应，处理函数抛出异常时生成500响应
+     * @param data 请求数据
+     * @param response 响应，应使用与resource相同的内存资源构造
+     * @param resource 解析结果使用的内存资源
+     * @return 同handle()
+     */
+    std::unique_ptr<BodyReader> dispatch(std::span<const char> data, HttpResponse& response, std::pmr::memory_resource* resource) const;
+
+private:
+    struct StringHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view str) const noexcept {
+            return std::hash<std::string_view>{}(str);
+        }
+    };
+
+    std::unordered_map<std::string, Route, StringHash, std::equal_to<>> exact_routes_;
+    // 按前缀长度降序排列，保证最长前缀优先匹配
+    std::vector<std::pair<std::string, Route>> prefix_routes_;
+    Route default_route_;
+};
+
+/**
+ * @brief 生成纯文本的错误响应，覆盖响应中已有的内容
+ * @param response 响应
+ * @param code HTTP状态码
+ * @param reason 状态消息，同时作为响应体
+ */
+void set_error_response(HttpResponse& response, int code, std::string_view reason);
+
+/**
+ * @brief 去掉URI中的查询字符串和片段
+ * @param uri 请求URI
+ * @return 路径部分
+ */
+std::string_view uri_path(std::string_view uri) noexcept;
+
+} // namespace http
+} // namespace hsmm
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "http/Compression.hpp"
+#include "http/HttpParser.hpp"
+#include <boost/asio.hpp>
+#include <array>
+#include <filesystem>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace hsmm {
+namespace http {
+
+/**
+ * @brief 静态文件处理器
+ *
+ * 小文件连同预先生成的响应头（ETag、Last-Modified、Content-Length）整体缓存在内存中，
+ * 命中时直接发送缓存的完整响应；大文件只缓存响应头和打开的文件描述符，响应体由连接通过sendfile发送。
+ * 可压缩的小文件在加载时按每种支持的编码压缩一次，与原文件一起缓存，请求时按Accept-Encoding选择。
+ * Linux下通过inotify监听缓存文件所在目录，文件变化时立即使缓存失效；其他平台在命中时比较文件的修改时间。
+ */
+class StaticFileHandler {
+public:
+    /**
+     * @brief 缓存配置
+     */
+    struct Options {
+        // 不超过该大小的文件整体缓存在内存中，更大的文件使用sendfile发送
+        size_t max_cached_file_size = 64 * 1024;
+        // 内存缓存的总字节数上限
+        size_t cache_capacity = 64 * 1024 * 1024;
+        // 缓存条目数上限（大文件条目会占用一个文件描述符）
+        size_t max_entries = 4096;
+        // 预压缩配置，enabled为false时不压缩
+        CompressionOptions compression;
+    };
+
+    /**
+     * @brief 构造函数
+     * @param io_context 用于监听文件变化的io_context
+     * @param root 静态文件根目录
+     * @param url_prefix 挂载的URL前缀，例如"/static/"
+     * @param options 缓存配置
+     * @throws std::runtime_error 如果根目录不存在
+     */
+    StaticFileHandler(boost::asio::io_context& io_context, std::filesystem::path root,
+                      std::string url_prefix, Options options);
+    StaticFileHandler(boost::asio::io_context& io_context, std::filesystem::path root,
+                      std::string url_prefix)
+        : StaticFileHandler(io_context, std::move(root), std::move(url_prefix), Options{}) {}
+    ~StaticFileHandler();
+
+    StaticFileHandler(const StaticFileHandler&) = delete;
+    StaticFileHandler& operator=(const StaticFileHandler&) = delete;
+
+    /**
+     * @brief 处理静态文件请求
+     * @param request HTTP请求
+     * @param response HTTP响应
+     */
+    void handle(const HttpRequest& request, HttpResponse& response);
+
+private:
+    struct Entry;
+
+    struct StringHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view str) const noexcept {
+            return std::hash<std::string_view>{}(str);
+        }
+    };
+
+    /**
+     * @brief 查找缓存条目，未命中时从磁盘加载
+     * @param key 相对于根目录的路径
+     * @return 缓存条目，文件不存在时返回nullptr
+     */
+    std::shared_ptr<const Entry> lookup(std::string_view key);
+
+    /**
+     * @brief 从磁盘加载文件并生成缓存条目
+     * @param key 相对于根目录的路径
+     * @return 缓存条目，文件不存在或不可读时返回nullptr
+     */
+    std::shared_ptr<const Entry> load(const std::string& key);
+
+    /**
+     * @brief 生成可压缩文件的各个压缩版本
+     * @param entry 缓存条目，etag已经设置
+     * @param type Content-Type头
+     * @param body 文件内容
+     * @param last_modified Last-Modified头
+     */
+    void load_variants(Entry& entry, std::string_view type, std::string_view body,
+                       std::string_view last_modified) const;
+
+    /**
+     * @brief 使缓存条目失效
+     * @param key 相对于根目录的路径
+     * @param recursive 是否同时使该路径下的所有条目失效
+     */
+    void invalidate(std::string_view key, bool recursive);
+
+    /**
+     * @brief 监听缓存文件所在目录
+     * @param dir_key 目录相对于根目录的路径
+     */
+    void watch_directory(const std::string& dir_key);
+
+    /**
+     * @brief 异步读取inotify事件
+     */
+    void do_watch();
+
+private:
+    std::filesystem::path root_;
+    std::string url_prefix_;
+    Options options_;
+
+    std::shared_mutex mutex_;
+    std::unordered_map<std::string, std::shared_ptr<const Entry>, StringHash, std::equal_to<>> cache_;
+    size_t cached_bytes_{0};
+
+#ifdef __linux__
+    boost::asio::posix::stream_descriptor inotify_;
+    // inotify watch描述符到目录相对路径的映射
+    std::unordered_map<int, std::string> watches_;
+    std::unordered_map<std::string, int> watched_dirs_;
+    std::array<char, 4096> event_buffer_;
+#endif
+};
+
+} // namespace http
+} // namespace hsmm
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace hsmm {
+namespace http2 {
+
+// 客户端连接前言（RFC 9113 3.4）
+inline constexpr std::string_view client_preface = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+inline constexpr std::size_t frame_header_size = 9;
+inline constexpr std::uint32_t default_window_size = 65535;
+inline constexpr std::uint32_t default_max_frame_size = 16384;
+inline constexpr std::uint32_t max_window_size = 0x7fffffff;
+
+/**
+ * @brief 帧类型
+ */
+enum class FrameType : std::uint8_t {
+    data = 0x0,
+    headers = 0x1,
+    priority = 0x2,
+    rst_stream = 0x3,
+    settings = 0x4,
+    push_promise = 0x5,
+    ping = 0x6,
+    goaway = 0x7,
+    window_update = 0x8,
+    continuation = 0x9
+};
+
+/**
+ * @brief 帧标志位
+ */
+namespace flags {
+    inline constexpr std::uint8_t end_stream = 0x1;
+    inline constexpr std::uint8_t ack = 0x1;
+    inline constexpr std::uint8_t end_headers = 0x4;
+    inline constexpr std::uint8_t padded = 0x8;
+    inline constexpr std::uint8_t priority = 0x20;
+}
+
+/**
+ * @brief 错误码
+ */
+enum class ErrorCode : std::uint32_t {
+    no_error = 0x0,
+    protocol_error = 0x1,
+    internal_error = 0x2,
+    flow_control_error = 0x3,
+    settings_timeout = 0x4,
+    stream_closed = 0x5,
+    frame_size_error = 0x6,
+    refused_stream = 0x7,
+    cancel = 0x8,
+    compression_error = 0x9,
+    connect_error = 0xa,
+    enhance_your_calm = 0xb,
+    inadequate_security = 0xc,
+    http_1_1_required = 0xd
+};
+
+/**
+ * @brief SETTINGS参数
+ */
+enum class SettingId : std::uint16_t {
+    header_table_size = 0x1,
+    enable_push = 0x2,
+    max_concurrent_streams = 0x3,
+    initial_window_size = 0x4,
+    max_frame_size = 0x5,
+    max_header_list_size = 0x6
+};
+
+/**
+ * @brief 帧头
+ */
+struct FrameHeader {
+    std::uint32_t length;
+    FrameType type;
+    std::uint8_t flags;
+    std::uint32_t stream_id;
+};
+
+inline std::uint32_t read_u32(const std::uint8_t* p) noexcept {
+    return (static_cast<std::uint32_t>(p[0]) << 24) | (static_cast<std::uint32_t>(p[1]) << 16) |
+           (static_cast<std::uint32_t>(p[2]) << 8) | p[3];
+}
+
+/**
+ * @brief 解析帧头
+ * @param data 至少frame_header_size字节
+ * @return 帧头，流ID的保留位已清除
+ */
+inline FrameHeader parse_frame_header(const std::uint8_t* data) noexcept {
+    return FrameHeader{
+        (static_cast<std::uint32_t>(data[0]) << 16) | (static_cast<std::uint32_t>(data[1]) << 8) | data[2],
+        static_cast<FrameType>(data[3]),
+        data[4],
+        read_u32(data + 5) & 0x7fffffff
+    };
+}
+
+/**
+ * @brief 写出帧头
+ * @param out 输出
+ * @param length 负载长度
+ * @param type 帧类型
+ * @param frame_flags 标志位
+ * @param stream_id 流ID
+ */
+inline void write_frame_header(std::string& out, std::uint32_t length, FrameType type,
+                               std::uint8_t frame_flags, std::uint32_t stream_id) {
+    const char header[frame_header_size] = {
+        static_cast<char>(length >> 16), static_cast<char>(length >> 8), static_cast<char>(length),
+        static_cast<char>(type), static_cast<char>(frame_flags),
+        static_cast<char>((stream_id >> 24) & 0x7f), static_cast<char>(stream_id >> 16),
+        static_cast<char>(stream_id >> 8), static_cast<char>(stream_id)
+    };
+    out.append(header, frame_header_size);
+}
+
+inline void write_u32(std::string& out, std::uint32_t value) {
+    const char bytes[4] = {
+        static_cast<char>(value >> 24), static_cast<char>(value >> 16),
+        static_cast<char>(value >> 8), static_cast<char>(value)
+    };
+    out.append(bytes, 4);
+}
+
+} // namespace http2
+} // namespace hsmm
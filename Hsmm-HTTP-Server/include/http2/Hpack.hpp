@@ -0,0 +1,171 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace hsmm {
+namespace http2 {
+
+/**
+ * @brief Huffman编码（RFC 7541 附录B）
+ * @param input 原始字符串
+ * @param out 编码结果追加到这里
+ */
+void huffman_encode(std::string_view input, std::string& out);
+
+/**
+ * @brief 计算Huffman编码后的长度
+ * @param input 原始字符串
+ * @return 编码后的字节数
+ */
+std::size_t huffman_encoded_size(std::string_view input) noexcept;
+
+/**
+ * @brief Huffman解码
+ * @param input 编码数据
+ * @param out 解码结果追加到这里
+ * @return 是否解码成功，填充位不是EOS前缀或出现EOS时返回false
+ */
+bool huffman_decode(std::span<const std::uint8_t> input, std::string& out);
+
+/**
+ * @brief HPACK动态表
+ *
+ * 新条目插入在表头，索引从静态表之后（62）开始编号，超出容量时从表尾淘汰
+ */
+class HpackTable {
+public:
+    /**
+     * @brief 构造函数
+     * @param max_size 最大容量（字节，按RFC 7541每个条目额外计32字节）
+     */
+    explicit HpackTable(std::size_t max_size = 4096) : max_size_(max_size) {}
+
+    /**
+     * @brief 插入条目，超出容量时淘汰最旧的条目
+     * @param name 字段名
+     * @param value 字段值
+     */
+    void add(std::string_view name, std::string_view value);
+
+    /**
+     * @brief 修改最大容量
+     * @param max_size 新的最大容量
+     */
+    void set_max_size(std::size_t max_size);
+
+    /**
+     * @brief 按动态表内的位置获取条目
+     * @param index 从0开始，0是最新插入的条目
+     * @return 条目
+     */
+    const std::pair<std::string, std::string>& at(std::size_t index) const { return entries_[index]; }
+
+    std::size_t count() const noexcept { return entries_.size(); }
+    std::size_t size() const noexcept { return size_; }
+    std::size_t max_size() const noexcept { return max_size_; }
+
+    /**
+     * @brief 查找条目
+     * @param name 字段名
+     * @param value 字段值
+     * @param name_index 只有字段名匹配时输出其位置
+     * @return 完全匹配的位置，没有时返回-1
+     */
+    long find(std::string_view name, std::string_view value, long& name_index) const noexcept;
+
+    /**
+     * @brief 条目占用的容量
+     */
+    static constexpr std::size_t entry_size(std::string_view name, std::string_view value) noexcept {
+        return name.size() + value.size() + 32;
+    }
+
+private:
+    void evict(std::size_t target);
+
+    std::deque<std::pair<std::string, std::string>> entries_;
+    std::size_t size_{0};
+    std::size_t max_size_;
+};
+
+/**
+ * @brief HPACK解码器，每个连接一个，状态跨头部块保持
+ */
+class HpackDecoder {
+public:
+    using HeaderCallback = std::function<void(std::string_view name, std::string_view value)>;
+
+    /**
+     * @brief 构造函数
+     * @param max_table_size 本端通过SETTINGS_HEADER_TABLE_SIZE允许的动态表容量
+     */
+    explicit HpackDecoder(std::size_t max_table_size = 4096)
+        : table_(max_table_size), settings_max_size_(max_table_size) {}
+
+    /**
+     * @brief 解码一个完整的头部块
+     *
+     * 即使调用方不需要结果也必须解码，否则动态表会与对端不一致
+     * @param block 头部块（HEADERS及其后续CONTINUATION帧的片段拼接）
+     * @param on_header 每个头部字段的回调，参数只在回调期间有效
+     * @return 是否解码成功，失败时连接必须以COMPRESSION_ERROR关闭
+     */
+    bool decode(std::span<const std::uint8_t> block, const HeaderCallback& on_header);
+
+private:
+    bool read_string(std::span<const std::uint8_t> block, std::size_t& pos, std::string& out);
+    bool lookup(std::uint64_t index, std::string& name, std::string* value) const;
+
+    HpackTable table_;
+    std::size_t settings_max_size_;
+    std::string name_;
+    std::string value_;
+};
+
+/**
+ * @brief HPACK编码器，每个连接一个
+ *
+ * 优先使用静态表和动态表的完全匹配；内容经常变化的字段（content-length、etag等）不加入动态表，
+ * 敏感字段（set-cookie、authorization）使用never-indexed表示。字符串在Huffman编码更短时使用Huffman编码。
+ */
+class HpackEncoder {
+public:
+    /**
+     * @brief 对端通过SETTINGS_HEADER_TABLE_SIZE修改了动态表容量
+     * @param size 对端允许的容量
+     */
+    void set_max_table_size(std::size_t size);
+
+    /**
+     * @brief 开始一个新的头部块，输出挂起的动态表容量更新
+     * @param out 输出
+     */
+    void begin_block(std::string& out);
+
+    /**
+     * @brief 编码一个头部字段
+     * @param name 字段名，必须是小写
+     * @param value 字段值
+     * @param out 输出
+     */
+    void encode(std::string_view name, std::string_view value, std::string& out);
+
+private:
+    void write_string(std::string_view str, std::string& out);
+
+    HpackTable table_{4096};
+    // 本端使用的容量上限，不超过4096，减少两端的内存占用
+    static constexpr std::size_t preferred_table_size = 4096;
+    bool size_update_pending_{false};
+    std::size_t min_size_since_update_{preferred_table_size};
+};
+
+} // namespace http2
+} // namespace hsmm
@@ -0,0 +1,220 @@
+#pragma once
+
+#include "http/HttpParser.hpp"
+#include "http/Router.hpp"
+#include "http2/Frame.hpp"
+#include "http2/Hpack.hpp"
+#include "server/AdmissionControl.hpp"
+#include "server/ServerOptions.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace hsmm {
+namespace http2 {
+
+/**
+ * @brief HTTP/2服务端会话（h2c）
+ *
+ * 只处理协议，不做IO：连接把收到的数据交给receive()，再用take_output()取出要发送的数据。
+ * 处理函数在请求结束时同步调用，与HTTP/1.1路径一致；异步路由的处理函数完成后通过post回到连接上继续。
+ * 各个流的响应数据按流量控制窗口轮流取出，一次take_output()可以包含多个流的帧，由连接一次写出。
+ */
+class Session {
+public:
+    /**
+     * @brief 把异步处理函数的后续处理投递回连接，可以在任意线程调用
+     */
+    using Post = std::function<void(std::function<void()>)>;
+
+    /**
+     * @brief 构造函数
+     * @param router 路由器
+     * @param options 服务器配置，http2和compression部分用于会话
+     * @param post 投递后续处理的函数，为空时异步路由返回501
+     * @param admission 准入控制，为空时不限速
+     * @param client 客户端地址，用于按客户端限速
+     */
+    Session(const http::Router& router, const ServerOptions& options, Post post = {},
+            AdmissionControl* admission = nullptr, AdmissionControl::ClientAddress client = {});
+    ~Session();
+
+    Session(const Session&) = delete;
+    Session& operator=(const Session&) = delete;
+
+    /**
+     * @brief 开始会话，输出服务器的SETTINGS帧（服务器连接前言）
+     */
+    void start();
+
+    /**
+     * @brief 从HTTP/1.1升级开始会话（Upgrade: h2c）
+     *
+     * 升级请求作为流1处理，其响应在服务器SETTINGS之后发送。请求中的字符串会被复制。
+     * @param request 升级请求，不能带请求体
+     * @param settings HTTP2-Settings头（base64url编码的SETTINGS负载）
+     * @return HTTP2-Settings是否合法
+     */
+    bool start_upgrade(const http::HttpRequest& request, std::string_view settings);
+
+    /**
+     * @brief 处理收到的数据
+     * @param data 收到的数据，可以在任意位置切分
+     * @return 是否没有发生连接错误；返回false时GOAWAY已写入输出，发送后应关闭连接
+     */
+    bool receive(std::span<const char> data);
+
+    /**
+     * @brief 取出待发送的数据
+     *
+     * 先按流量控制窗口从各个流取出响应数据，每次最多约Http2Options::max_write_batch字节
+     * @param out 输出，为空时直接交换缓冲区
+     * @return 是否有数据要发送
+     */
+    bool take_output(std::string& out);
+
+    /**
+     * @brief 开始优雅关闭：发送GOAWAY，不再接受新的流，已有的流继续处理
+     */
+    void shutdown();
+
+    /**
+     * @brief 会话是否已经结束，输出发送完后可以关闭连接
+     */
+    bool closed() const noexcept;
+
+    /**
+     * @brief 是否没有进行中的流
+     */
+    bool idle() const noexcept { return streams_.empty(); }
+
+    /**
+     * @brief 已生成但还没有取走的输出字节数，用于在客户端不读取时暂停接收
+     */
+    std::size_t pending_output() const noexcept { return output_.size(); }
+
+    /**
+     * @brief 是否有异步处理函数还没有完成，此时会话不能销毁
+     */
+    bool busy() const noexcept { return async_pending_ > 0; }
+
+private:
+    struct Stream;
+
+    bool process_frame(const FrameHeader& header, std::span<const std::uint8_t> payload);
+    bool on_headers(const FrameHeader& header, std::span<const std::uint8_t> payload);
+    bool on_continuation(const FrameHeader& header, std::span<const std::uint8_t> payload);
+    bool on_data(const FrameHeader& header, std::span<const std::uint8_t> payload);
+    bool on_settings(const FrameHeader& header, std::span<const std::uint8_t> payload);
+    bool on_window_update(const FrameHeader& header, std::span<const std::uint8_t> payload);
+    bool on_rst_stream(const FrameHeader& header, std::span<const std::uint8_t> payload);
+
+    /**
+     * @brief 应用一组SETTINGS参数
+     * @return 参数不合法时对应的错误码，合法时返回no_error
+     */
+    ErrorCode apply_settings(std::span<const std::uint8_t> payload);
+
+    /**
+     * @brief 头部块接收完整后解码，创建流或处理trailer
+     */
+    bool end_header_block(std::uint32_t stream_id, bool end_stream);
+
+    /**
+     * @brief 请求结束，调用处理函数生成响应
+     */
+    void complete_request(Stream& stream);
+
+    /**
+     * @brief 异步处理函数完成，在连接上继续发送响应
+     */
+    void resume(Stream* stream);
+
+    /**
+     * @brief 在请求结束前直接响应（错误、拒绝请求体等），之后的请求体被丢弃
+     */
+    void respond_early(Stream& stream);
+
+    /**
+     * @brief 请求头接收完后进行准入检查，拒绝时生成429或503响应
+     * @return 是否继续处理请求
+     */
+    bool admit(Stream& stream);
+
+    /**
+     * @brief 编码响应头并加入发送队列
+     */
+    void start_response(Stream& stream);
+
+    /**
+     * @brief 为一个流生成一个DATA帧
+     * @return 该流的响应是否已经发送完毕
+     */
+    bool write_data(Stream& stream, std::size_t limit);
+
+    /**
+     * @brief 流的响应发送完毕或被重置，释放流
+     */
+    void close_stream(std::uint32_t stream_id);
+
+    /**
+     * @brief 从流表中移除流，等待异步处理函数的流延后到处理完成时释放
+     */
+    void erase_stream(std::unordered_map<std::uint32_t, std::unique_ptr<Stream>>::iterator it);
+
+    void reset_stream(std::uint32_t stream_id, ErrorCode code);
+    bool connection_error(ErrorCode code);
+    void write_window_update(std::uint32_t stream_id, std::uint32_t increment);
+    void write_header_block(std::uint32_t stream_id, std::string_view block, bool end_stream);
+
+    const http::Router& router_;
+    const ServerOptions& options_;
+    Post post_;
+    AdmissionControl* admission_;
+    const AdmissionControl::ClientAddress client_;
+
+    HpackDecoder decoder_;
+    HpackEncoder encoder_;
+
+    std::unordered_map<std::uint32_t, std::unique_ptr<Stream>> streams_;
+    // 有响应数据待发送的流，按轮转顺序排列
+    std::deque<Stream*> sending_;
+    std::uint32_t last_stream_id_{0};
+    // 已被重置、但异步处理函数还在使用其请求和响应的流
+    std::vector<std::unique_ptr<Stream>> detached_;
+    std::size_t async_pending_{0};
+
+    // 未处理完的输入（不完整的帧）
+    std::string input_;
+    bool preface_received_{false};
+    // 正在接收CONTINUATION的流，0表示没有
+    std::uint32_t continuation_stream_{0};
+    bool continuation_end_stream_{false};
+    std::string header_block_;
+
+    std::string output_;
+    std::string scratch_;
+
+    // 对端参数
+    std::uint32_t peer_initial_window_{default_window_size};
+    std::uint32_t peer_max_frame_size_{default_max_frame_size};
+    std::int64_t send_window_{default_window_size};
+
+    // 本端接收窗口中已消耗、尚未通过WINDOW_UPDATE归还的字节数
+    std::int64_t recv_window_;
+    std::uint32_t recv_unacked_{0};
+
+    bool goaway_sent_{false};
+    bool goaway_received_{false};
+    bool failed_{false};
+};
+
+} // namespace http2
+} // namespace hsmm
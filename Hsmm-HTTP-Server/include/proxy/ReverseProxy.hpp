@@ -0,0 +1,134 @@
+#pragma once
+
+#include "http/HttpParser.hpp"
+#include "http/Router.hpp"
+#include <boost/asio.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace hsmm {
+namespace proxy {
+
+/**
+ * @brief 反向代理处理器
+ *
+ * 作为异步路由把请求转发到一组上游服务器（HTTP/1.1），URI保持不变。
+ * 每个上游维护一个keep-alive连接池，按轮询或最少连接数选择上游；连接失败、超时和
+ * 幂等请求在收到响应前失败时换一个上游重试。上游状态由被动检查（请求失败）和定期的主动健康检查共同决定。
+ * 请求体从请求缓冲区直接聚集写到上游；上游响应读入一个缓冲区，响应体作为该缓冲区的视图交给连接发送，不再复制。
+ */
+class ReverseProxy : public std::enable_shared_from_this<ReverseProxy> {
+public:
+    /**
+     * @brief 负载均衡策略
+     */
+    enum class Balance {
+        round_robin,        // 轮询
+        least_connections   // 进行中请求最少的上游，相同时轮询
+    };
+
+    /**
+     * @brief 代理配置
+     */
+    struct Options {
+        Balance balance = Balance::round_robin;
+        // 每个上游保留的空闲连接数上限
+        size_t max_idle_connections = 32;
+        // 空闲连接超过这个时间不再复用，应小于上游的keep-alive超时
+        std::chrono::milliseconds idle_timeout{std::chrono::seconds(30)};
+        std::chrono::milliseconds connect_timeout{std::chrono::seconds(3)};
+        // 从发出请求到收完响应的最长时间
+        std::chrono::milliseconds response_timeout{std::chrono::seconds(30)};
+        // 请求失败后换一个上游重试的最多次数
+        unsigned retries = 2;
+        // 上游响应（头部和响应体）的大小上限，超出时返回502
+        size_t max_response_size = 64 * 1024 * 1024;
+        // 主动健康检查的路径，返回2xx/3xx视为健康；为空时只检查能否建立连接
+        std::string health_path;
+        std::chrono::milliseconds health_interval{std::chrono::seconds(5)};
+        std::chrono::milliseconds health_timeout{std::chrono::seconds(2)};
+        // 连续失败fall次后标记为不可用，不可用的上游连续成功rise次后恢复
+        unsigned fall = 3;
+        unsigned rise = 2;
+    };
+
+    /**
+     * @brief 构造函数，创建后需要调用start()
+     * @param io_context 上游连接和健康检查使用的io_context
+     * @param upstreams 上游地址列表，格式为"host:port"
+     * @param options 代理配置
+     * @throws std::runtime_error 如果上游列表为空或地址无法解析
+     */
+    ReverseProxy(boost::asio::io_context& io_context, const std::vector<std::string>& upstreams, Options options);
+    ~ReverseProxy();
+
+    ReverseProxy(const ReverseProxy&) = delete;
+    ReverseProxy& operator=(const ReverseProxy&) = delete;
+
+    /**
+     * @brief 开始定期健康检查
+     */
+    void start();
+
+    /**
+     * @brief 转发请求，作为Router::AsyncHandler使用
+     * @param request HTTP请求，请求体已经完整收到
+     * @param response HTTP响应
+     * @param done 响应填写完成后调用
+     */
+    void handle(const http::HttpRequest& request, http::HttpResponse& response, http::Router::Completion done);
+
+private:
+    struct Upstream;
+    class Exchange;
+    class Probe;
+
+    /**
+     * @brief 选择上游，优先选择可用的上游，全部不可用时仍然尝试
+     * @param tried 本次请求已经失败过的上游
+     * @return 选中的上游，都已尝试过时返回nullptr
+     */
+    Upstream* select(const std::vector<bool>& tried);
+
+    /**
+     * @brief 从连接池取出一个可用的空闲连接
+     * @param upstream 上游
+     * @return 连接，没有可用的空闲连接时返回std::nullopt
+     */
+    std::optional<boost::asio::ip::tcp::socket> acquire(Upstream& upstream);
+
+    /**
+     * @brief 把完成一次请求的连接放回连接池
+     * @param upstream 上游
+     * @param socket 连接
+     */
+    void release(Upstream& upstream, boost::asio::ip::tcp::socket socket);
+
+    /**
+     * @brief 记录一次请求或健康检查的结果，按连续成功/失败次数切换上游状态
+     * @param upstream 上游
+     * @param ok 是否成功
+     */
+    void report(Upstream& upstream, bool ok);
+
+    /**
+     * @brief 安排下一轮健康检查，同时清理过期的空闲连接
+     */
+    void schedule_health_check();
+
+    boost::asio::io_context& io_context_;
+    const Options options_;
+    std::vector<std::unique_ptr<Upstream>> upstreams_;
+    std::atomic<size_t> next_{0};
+    boost::asio::steady_timer health_timer_;
+};
+
+} // namespace proxy
+} // namespace hsmm
@@ -0,0 +1,157 @@
+#pragma once
+
+#include "server/ServerOptions.hpp"
+#include <boost/asio/ip/tcp.hpp>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+namespace hsmm {
+
+namespace http {
+class HttpResponse;
+}
+
+/**
+ * @brief 准入控制：按客户端IP和路由限速，过载时快速拒绝请求
+ *
+ * 限速使用令牌桶（以GCRA实现）：每个桶只有一个原子变量（下一个令牌的理论到达时间），
+ * 补充令牌不需要定时器，取令牌是一次CAS。桶按键的哈希分到多个分片，查找只加分片的读锁，
+ * 只有新客户端第一次出现时才加写锁，不同IO线程之间几乎不会互相等待。
+ *
+ * 过载检测在解析请求头之后进行：正在处理的请求数超过上限，或者一个统计周期内请求的最小
+ * 排队和处理耗时超过目标值（说明存在持续的队列，而不是偶发的慢请求）时，新请求直接返回503。
+ * 所有限制都未配置时admit()不访问任何共享状态。
+ */
+class AdmissionControl {
+public:
+    /**
+     * @brief 客户端地址，IPv4地址映射为IPv6形式
+     */
+    using ClientAddress = std::array<std::uint8_t, 16>;
+
+    /**
+     * @brief 准入结果
+     */
+    enum class Decision {
+        admit,          // 允许处理
+        rate_limited,   // 超出客户端的请求速率，返回429
+        overloaded      // 服务器过载，返回503
+    };
+
+    /**
+     * @brief 已准入请求的凭证，生成响应或销毁时从正在处理的请求数中减去
+     */
+    class Ticket {
+    public:
+        Ticket() = default;
+        Ticket(Ticket&& other) noexcept;
+        Ticket& operator=(Ticket&& other) noexcept;
+        ~Ticket() { reset(); }
+
+        /**
+         * @brief 响应已经生成，记录请求的排队和处理耗时并释放凭证
+         */
+        void respond() noexcept;
+
+        /**
+         * @brief 没有生成响应（例如连接出错），只释放凭证
+         */
+        void reset() noexcept;
+
+    private:
+        friend class AdmissionControl;
+
+        AdmissionControl* owner_{nullptr};
+        std::int64_t start_ns_{0};
+    };
+
+    /**
+     * @brief 构造函数
+     * @param options 限速和过载检测配置
+     */
+    explicit AdmissionControl(const AdmissionOptions& options);
+    ~AdmissionControl();
+
+    AdmissionControl(const AdmissionControl&) = delete;
+    AdmissionControl& operator=(const AdmissionControl&) = delete;
+
+    /**
+     * @brief 获取socket对端的客户端地址
+     * @param socket 已连接的socket
+     * @return 客户端地址，获取失败时全为0
+     */
+    static ClientAddress client_address(const boost::asio::ip::tcp::socket& socket) noexcept;
+
+    /**
+     * @brief 是否配置了按客户端的请求限速，未配置时连接不需要获取对端地址
+     */
+    bool limits_requests() const noexcept { return limits_requests_; }
+
+    /**
+     * @brief 是否配置了任何限速或过载检测
+     */
+    bool enabled() const noexcept {
+        return limits_connections_ || limits_requests_ || tracks_inflight_;
+    }
+
+    /**
+     * @brief 在accept之后检查客户端的新建连接速率
+     * @param socket 新接受的连接
+     * @return 是否接受该连接，拒绝时调用者直接关闭连接
+     */
+    bool allow_connection(const boost::asio::ip::tcp::socket& socket);
+
+    /**
+     * @brief 在解析请求头之后决定是否处理请求
+     * @param client 客户端地址
+     * @param uri 请求URI，用于匹配路由限速
+     * @param ticket 准入时写入凭证，请求结束时销毁
+     * @return 准入结果
+     */
+    Decision admit(const ClientAddress& client, std::string_view uri, Ticket& ticket);
+
+    /**
+     * @brief 为被拒绝的请求生成响应（429或503，带Retry-After）
+     * @param response 响应
+     * @param decision admit()的结果
+     */
+    static void set_rejection(http::HttpResponse& response, Decision decision);
+
+    /**
+     * @brief 正在处理的请求数（只在配置了过载检测时统计）
+     */
+    size_t inflight() const noexcept { return inflight_.load(std::memory_order_relaxed); }
+
+private:
+    class BucketTable;
+
+    static std::int64_t now_ns() noexcept;
+
+    /**
+     * @brief 记录一个请求从准入到生成响应的耗时
+     */
+    void record_latency(std::int64_t latency_ns, std::int64_t now) noexcept;
+
+    /**
+     * @brief 统计周期结束时根据周期内的最小耗时更新过载状态
+     */
+    void roll_window(std::int64_t now) noexcept;
+
+    const AdmissionOptions options_;
+    const bool limits_connections_;
+    const bool limits_requests_;
+    const bool tracks_inflight_;
+    std::unique_ptr<BucketTable> buckets_;
+
+    // 正在处理的请求数和延迟统计被所有IO线程修改，各占一个缓存行
+    alignas(64) std::atomic<size_t> inflight_{0};
+    alignas(64) std::atomic<std::int64_t> window_min_ns_;
+    std::atomic<std::int64_t> window_end_ns_{0};
+    std::atomic<bool> overloaded_{false};
+};
+
+} // namespace hsmm
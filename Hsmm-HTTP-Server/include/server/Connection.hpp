@@ -1,42 +1,295 @@
 #pragma once
 
+#include "http/Compression.hpp"
+#include "http/HttpParser.hpp"
+#include "http/Router.hpp"
+#include "http2/Session.hpp"
+#include "server/AdmissionControl.hpp"
+#include "server/TimerWheel.hpp"
+#include "tls/Stream.hpp"
+#include "utils/IoBuffer.hpp"
+#include "websocket/Session.hpp"
 #include <boost/asio.hpp>
+#include <atomic>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <memory_resource>
+#include <optional>
+#include <string>
 #include <string_view>
 #include <span>
 #include <array>
+#include <vector>
 
 namespace hsmm {
 
+class ConnectionPool;
+struct ServerContext;
+
 /**
  * @brief HTTP连接类
- * 
- * 使用RAII管理单个HTTP连接的生命周期
+ *
+ * 使用RAII管理单个HTTP连接的生命周期。连接关闭后对象回收到创建它的ConnectionPool中复用，
+ * 请求内存池随对象一起复用，读缓冲区的内存块归还给线程本地的池。
+ * 连接上的所有异步操作都在各自的strand上执行，超时由服务器共享的TimerWheel驱动。
+ * 请求体按Content-Length或分块编码逐段读取：流式路由边读边交给BodyReader，
+ * 普通路由缓存到ServerOptions::max_body_size为止。读缓冲区中剩余的数据作为下一个请求处理（pipelining）。
+ * 收到HTTP/2连接前言或"Upgrade: h2c"请求后，连接切换为HTTP/2，协议处理交给http2::Session；
+ * WebSocket路由的升级请求握手成功后，连接切换为WebSocket，协议处理交给websocket::Session。
+ * 服务器配置了TLS时先完成TLS握手，之后所有读写都经过tls::Stream，协议处理与明文连接相同。
  */
-class Connection : public std::enable_shared_from_this<Connection> {
+class Connection : public std::enable_shared_from_this<Connection>, private TimerWheel::Entry {
 public:
     /**
      * @brief 构造函数
-     * @param socket 已接受的TCP socket
+     * @param pool 创建连接的池，连接属于池的io_context，关闭后归还到这个池
      */
-    explicit Connection(boost::asio::ip::tcp::socket socket);
+    explicit Connection(ConnectionPool& pool);
+
+    /**
+     * @brief 获取底层socket，用于直接在其上接受新连接
+     * @return TCP socket引用
+     */
+    boost::asio::ip::tcp::socket& socket() noexcept { return socket_; }
+
+    /**
+     * @brief 获取连接所属的io_context
+     * @return io_context引用
+     */
+    boost::asio::io_context& io_context() const noexcept { return strand_.get_inner_executor().context(); }
 
     /**
      * @brief 开始处理连接
+     * @param context 服务器共享状态，在连接生命周期内必须保持有效
      */
-    void start();
+    void start(ServerContext& context);
+
+    /**
+     * @brief 重置连接状态以便复用
+     *
+     * 关闭socket并释放本次连接遗留的请求内存
+     */
+    void reset() noexcept;
 
 private:
     /**
-     * @brief 异步读取HTTP请求
+     * @brief 从连接读取一些数据，TLS连接读取解密后的数据
+     *
+     * 明文连接一次分散读入所有缓冲区；TLS连接每次解密一个记录，只读入第一个缓冲区
+     * @param buffers 读缓冲区序列
+     * @param handler void(error_code, size_t)
+     */
+    template <typename MutableBufferSequence, typename Handler>
+    void read_some(const MutableBufferSequence& buffers, Handler&& handler);
+
+    /**
+     * @brief 向连接写出全部数据，TLS连接加密后写出
+     * @param buffers 数据，写操作完成前保持有效
+     * @param handler void(error_code, size_t)
+     */
+    template <typename ConstBufferSequence, typename Handler>
+    void write(const ConstBufferSequence& buffers, Handler&& handler);
+
+    /**
+     * @brief 异步读取更多数据
      */
     void do_read();
 
+    /**
+     * @brief 等待并解析请求头
+     */
+    void read_header();
+
+    /**
+     * @brief 请求体需要继续读取时，把请求头复制到请求内存池并重新解析，然后从读缓冲区中丢弃
+     * @param header 读缓冲区中的请求头
+     * @return 重新解析是否成功，失败时应回复400
+     */
+    bool copy_header(std::span<const char> header);
+
+    /**
+     * @brief 处理读缓冲区中的请求体数据，请求体未结束时继续读取
+     */
+    void read_body();
+
+    /**
+     * @brief 把一段请求体交给BodyReader或追加到缓存的请求体
+     * @param data 请求体数据
+     */
+    void deliver_body(std::span<const char> data);
+
+    /**
+     * @brief 发送"100 Continue"后开始读取请求体
+     */
+    void send_continue();
+
+    /**
+     * @brief 请求体接收完毕，调用处理函数并发送响应
+     */
+    void complete_request();
+
+    /**
+     * @brief 调用异步路由的处理函数，完成后回到strand发送响应
+     */
+    void call_async_handler();
+
+    /**
+     * @brief 发送错误响应，发送后关闭连接
+     * @param code HTTP状态码
+     * @param reason 状态消息
+     */
+    void reply_error(int code, std::string_view reason);
+
+    /**
+     * @brief 发送response_，需要压缩时先交给压缩线程池
+     */
+    void send_response();
+
+    /**
+     * @brief 在压缩线程池上压缩响应体，完成后回到strand发送
+     * @param encoding 协商出的内容编码
+     */
+    void compress_response(http::ContentEncoding encoding);
+
+    /**
+     * @brief 序列化response_并开始发送
+     */
+    void write_response();
+
     /**
      * @brief 异步发送HTTP响应
-     * @param response 要发送的响应数据
+     *
+     * 先发送write_head_和write_body_中的数据，如果有文件响应体再通过sendfile发送
      */
-    void do_write(std::string_view response);
+    void do_write();
+
+    /**
+     * @brief 发送文件响应体
+     */
+    void do_send_file();
+
+    /**
+     * @brief 分块读取文件并写出，用于没有sendfile或者TLS没有交给内核的情况
+     */
+    void send_file_copy();
+
+    /**
+     * @brief 通过kTLS发送文件，内核加密，文件数据不经过用户态
+     */
+    void send_file_ktls();
+
+    /**
+     * @brief 从数据源取出下一段数据，按分块编码发送
+     */
+    void do_write_chunk();
+
+    /**
+     * @brief 获取分块发送使用的缓冲区，第一次调用时从请求内存池分配
+     * @return 缓冲区
+     */
+    std::span<char> chunk_buffer();
+
+    /**
+     * @brief 结束当前请求，释放请求内存池
+     */
+    void finish_request() noexcept;
+
+    /**
+     * @brief 响应发送完成后等待下一个请求，正在优雅关闭时直接关闭连接
+     */
+    void next_request();
+
+    /**
+     * @brief 创建HTTP/2会话，异步处理函数完成后回到连接的strand继续
+     * @return 会话
+     */
+    std::unique_ptr<http2::Session> make_http2_session();
+
+    /**
+     * @brief 收到HTTP/2连接前言（prior knowledge），切换为HTTP/2，读缓冲区中的数据从连接前言开始
+     */
+    void start_http2();
+
+    /**
+     * @brief 处理"Upgrade: h2c"请求，发送101后切换为HTTP/2，请求本身作为流1处理
+     * @param settings HTTP2-Settings头
+     * @return 是否已经切换，HTTP2-Settings不合法时按HTTP/1.1处理请求
+     */
+    bool upgrade_http2(std::string_view settings);
+
+    /**
+     * @brief 把读缓冲区中的数据交给HTTP/2会话，发送生成的帧并继续读取
+     */
+    void h2_receive();
+
+    /**
+     * @brief HTTP/2模式下读取数据，与写操作相互独立
+     */
+    void h2_read();
+
+    /**
+     * @brief 取出会话的待发送数据一次写出，同一时间只有一个写操作
+     */
+    void h2_flush();
+
+    /**
+     * @brief 关闭HTTP/2连接，等挂起的读写操作都结束后再回收
+     */
+    void h2_close();
+
+    /**
+     * @brief 处理WebSocket路由的升级请求，握手成功后发送101并切换为WebSocket
+     */
+    void start_websocket();
+
+    /**
+     * @brief 把读缓冲区中的数据交给WebSocket会话，发送生成的帧并继续读取，负载在读缓冲区中原地去除掩码
+     */
+    void ws_receive();
+
+    /**
+     * @brief WebSocket模式下读取数据，与写操作相互独立
+     */
+    void ws_read();
+
+    /**
+     * @brief 取出发送队列中的帧聚集写出，同一时间只有一个写操作
+     */
+    void ws_flush();
+
+    /**
+     * @brief 关闭WebSocket连接，等挂起的读写操作都结束后再回收
+     */
+    void ws_close();
+
+    /**
+     * @brief WebSocket连接的超时处理：空闲时发送ping，ping没有回应或者写操作超时时关闭
+     * @param expired 截止时间是否已到，否则是优雅关闭提前触发
+     */
+    void ws_timeout(bool expired);
+
+    /**
+     * @brief 设置当前阶段的超时时间
+     * @param timeout 从现在起的超时时长
+     */
+    void set_deadline(std::chrono::milliseconds timeout);
+
+    /**
+     * @brief 时间轮到期回调，投递到连接的strand上处理
+     */
+    void on_expire() override;
+
+    /**
+     * @brief 在strand上检查超时
+     * @param generation 触发时的连接代数，连接已被关闭复用时忽略
+     */
+    void handle_timeout(std::uint32_t generation);
+
+    /**
+     * @brief 关闭连接并归还给连接池
+     */
+    void close();
 
     /**
      * @brief 解析HTTP请求
@@ -47,16 +300,93 @@ private:
     bool parse_request(std::span<const char> data);
 
 private:
+    ConnectionPool& pool_;
+    boost::asio::strand<boost::asio::io_context::executor_type> strand_;
+    // 投递到strand_，由异步处理函数通过HttpRequest::post使用
+    std::function<void(std::function<void()>)> post_;
     boost::asio::ip::tcp::socket socket_;
-    
-    // 使用固定大小的缓冲区，防止缓冲区溢出
-    static constexpr size_t max_buffer_size = 8192;
-    std::array<char, max_buffer_size> buffer_;
-    
+    // TLS连接状态，服务器配置了TLS时在start()中创建
+    std::optional<tls::Stream> tls_;
+
+    // 分块编码响应每次读取的数据大小
+    static constexpr size_t chunk_size = 8192;
+    // 超过这个大小的响应体不复制到输出缓冲区
+    static constexpr size_t gather_body_size = 16 * 1024;
+    // WebSocket一次聚集写出的最大帧数
+    static constexpr size_t max_ws_batch = 64;
+    // 已收到但尚未处理的数据，开头是当前请求
+    utils::IoBuffer input_;
+    // 当前请求在input_中占用的字节数，解析结果引用这些数据，请求结束时丢弃
+    size_t request_size_{0};
+
+    // 单个请求的内存池：解析结果和响应都分配在这里，请求结束时整体重置
+    static constexpr size_t arena_size = 16 * 1024;
+    alignas(std::max_align_t) std::array<std::byte, arena_size> arena_buffer_;
+    std::pmr::monotonic_buffer_resource arena_;
+
+    ServerContext* context_{nullptr};
+
+    // 每次关闭连接时递增，用于识别过期的超时回调
+    std::atomic<std::uint32_t> generation_{0};
+    // 是否在两个请求之间空闲等待
+    bool idle_{false};
+    // 对端地址，只在配置了按客户端限速时获取
+    AdmissionControl::ClientAddress client_{};
+
+    // 当前请求，解析结果和响应都分配在arena_上
+    std::optional<http::HttpRequest> request_;
+    std::optional<http::HttpResponse> response_;
+    const http::Router::Route* route_{nullptr};
+    // 当前请求的准入凭证，生成响应时释放
+    AdmissionControl::Ticket ticket_;
+    // 请求体需要多次读取时，请求头复制到这里，不再引用input_
+    std::optional<std::pmr::string> header_copy_;
+    // 普通路由缓存的请求体
+    std::optional<std::pmr::string> body_;
+    bool body_too_large_{false};
+    // 流式路由的请求体接收者
+    std::unique_ptr<http::BodyReader> body_reader_;
+    http::ChunkedDecoder chunked_decoder_;
+    // Content-Length中尚未读取的字节数
+    std::uint64_t body_remaining_{0};
+    // 响应发送后关闭连接（错误响应、请求体未读完等）
+    bool close_after_response_{false};
+    // 开始发送响应的时间，用于统计发送耗时
+    std::uint64_t write_start_ns_{0};
+
+    // 序列化的响应数据，分配在arena_上，生命周期覆盖整个异步写操作
+    std::optional<std::pmr::string> output_;
+    std::span<char> chunk_buffer_;
+    std::array<char, 20> chunk_header_;
+
+    // 本次要发送的响应头部（或完整响应），以及保证其有效的持有者
+    std::string_view write_head_;
+    // 不复制到输出缓冲区、和头部一起聚集写出的响应体
+    std::string_view write_body_;
+    std::shared_ptr<const void> payload_owner_;
+    std::optional<http::HttpResponse::FileBody> file_body_;
+
+    // HTTP/2会话，连接切换为HTTP/2后创建
+    std::unique_ptr<http2::Session> h2_;
+    // 正在写出的HTTP/2数据
+    std::string h2_output_;
+    bool h2_reading_{false};
+    bool h2_writing_{false};
+
+    // WebSocket会话，握手成功后创建
+    std::unique_ptr<websocket::Session> ws_;
+    // 正在写出的帧，和其他连接共享，写操作完成前保持引用
+    std::vector<websocket::SharedFrame> ws_frames_;
+    std::vector<boost::asio::const_buffer> ws_buffers_;
+    bool ws_reading_{false};
+    bool ws_writing_{false};
+    // 空闲时发出的ping还没有收到任何数据
+    bool ws_ping_sent_{false};
+
     // 请求解析结果
     std::string_view method_;
     std::string_view uri_;
     std::string_view version_;
 };
 
-} // namespace hsmm 
\ No newline at end of file
+} // namespace hsmm
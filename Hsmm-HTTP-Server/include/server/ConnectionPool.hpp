@@ -0,0 +1,78 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace hsmm {
+
+class Connection;
+
+/**
+ * @brief 单个io_context的连接对象池
+ *
+ * 每个io_context（共享io_context时只有一个，配置CPU绑定时每个IO线程一个）对应一个池，
+ * 回收已关闭的Connection对象（连同其内部的请求内存池）。连接总是归还到创建它的池中，
+ * 与关闭它的线程无关，所以两种模式下稳态接受新连接时都不再进行堆分配。
+ * 空闲列表由互斥锁保护：配置CPU绑定时只有一个线程访问，锁没有竞争。
+ * 池必须在所属的io_context之前销毁。
+ */
+class ConnectionPool {
+public:
+    /**
+     * @brief 构造函数
+     * @param io_context 池中连接所属的io_context
+     */
+    explicit ConnectionPool(boost::asio::io_context& io_context);
+
+    ConnectionPool(const ConnectionPool&) = delete;
+    ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+    /**
+     * @brief 获取池中连接所属的io_context
+     * @return io_context引用
+     */
+    boost::asio::io_context& io_context() const noexcept { return io_context_; }
+
+    /**
+     * @brief 取出一个可用的连接对象，池为空时新建
+     * @return 处于初始状态的连接对象
+     */
+    std::shared_ptr<Connection> acquire();
+
+    /**
+     * @brief 归还一个已关闭的连接对象，可以在任意线程上调用
+     * @param connection 要回收的连接，必须由这个池创建
+     */
+    void recycle(std::shared_ptr<Connection> connection);
+
+    /**
+     * @brief 预先创建连接对象，连同其请求内存池一起放入池中
+     *
+     * 在运行io_context的线程上调用时，内存按该线程的NUMA策略分配
+     * @param count 池中至少要有的空闲连接数，不超过池的容量
+     */
+    void preallocate(size_t count);
+
+    /**
+     * @brief 释放池中所有空闲连接
+     */
+    void clear() noexcept;
+
+    /**
+     * @brief 获取空闲连接数量
+     * @return 当前池中的空闲连接数
+     */
+    size_t idle_count() const;
+
+private:
+    // 每个池最多缓存的空闲连接数，超出部分直接释放
+    static constexpr size_t max_idle_connections = 1024;
+
+    boost::asio::io_context& io_context_;
+    mutable std::mutex mutex_;
+    std::vector<std::shared_ptr<Connection>> idle_;
+};
+
+} // namespace hsmm
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace hsmm {
+
+/**
+ * @brief 执行阻塞处理函数的有界线程池
+ *
+ * 会阻塞的处理函数（数据库、磁盘、耗时计算）放在这里执行，IO线程不被占用，
+ * 同一IO线程上的其他连接不受影响。队列有上限：排满时submit()立即失败，
+ * 由调用者直接返回503，而不是让请求无限排队。
+ */
+class HandlerPool {
+public:
+    using Task = std::function<void()>;
+
+    /**
+     * @brief 构造函数，立即启动线程
+     * @param threads 线程数，至少为1
+     * @param max_queue 排队等待线程的任务数上限
+     */
+    HandlerPool(size_t threads, size_t max_queue);
+    ~HandlerPool();
+
+    HandlerPool(const HandlerPool&) = delete;
+    HandlerPool& operator=(const HandlerPool&) = delete;
+
+    /**
+     * @brief 提交任务，可以在任意线程调用
+     * @param task 任务，应自行处理异常并完成请求；抛出的异常只记录日志
+     * @return 是否已加入队列，队列已满或线程池已停止时返回false
+     */
+    bool submit(Task task);
+
+    /**
+     * @brief 执行完已排队的任务后停止所有线程，可以重复调用
+     */
+    void stop();
+
+    /**
+     * @brief 排队等待线程的任务数
+     */
+    size_t queue_depth() const noexcept { return queue_depth_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 正在执行任务的线程数
+     */
+    size_t busy_threads() const noexcept { return busy_threads_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 线程数
+     */
+    size_t thread_count() const noexcept { return threads_.size(); }
+
+private:
+    struct Item {
+        Task task;
+        // 入队时间，用于统计排队耗时
+        std::uint64_t queued_ns;
+    };
+
+    /**
+     * @brief 线程函数
+     */
+    void worker();
+
+    const size_t max_queue_;
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    std::deque<Item> queue_;
+    bool stopping_{false};
+    std::vector<std::thread> threads_;
+
+    // 只用于导出指标，读取时不加锁
+    std::atomic<size_t> queue_depth_{0};
+    std::atomic<size_t> busy_threads_{0};
+};
+
+} // namespace hsmm
@@ -1,19 +1,37 @@
 #pragma once
 
+#include "http/ResponseCache.hpp"
+#include "http/Router.hpp"
+#include "proxy/ReverseProxy.hpp"
+#include "server/AdmissionControl.hpp"
+#include "server/ConnectionPool.hpp"
+#include "server/HandlerPool.hpp"
+#include "server/ServerContext.hpp"
+#include "server/ServerOptions.hpp"
+#include "server/TimerWheel.hpp"
 #include <boost/asio.hpp>
+#include <filesystem>
 #include <memory>
 #include <string>
 #include <thread>
 #include <vector>
-#include <memory_resource>
 #include <atomic>
 
 namespace hsmm {
 
+class UringBackend;
+
+namespace tls {
+class Context;
+}
+
 /**
  * @brief HTTP服务器核心类
  * 
- * 使用RAII管理资源生命周期，实现内存安全的HTTP服务器
+ * 使用RAII管理资源生命周期，实现内存安全的HTTP服务器。
+ * ServerOptions::tls配置了证书时，监听端口只接受TLS连接。
+ * ServerOptions::cpu配置了CPU绑定时，每个IO线程绑定一个核心，使用独立的io_context和监听socket。
+ * 收到SIGINT/SIGTERM时优雅关闭：停止accept，等待进行中的请求完成后退出，再次收到信号则立即退出。
  */
 class Server {
 public:
@@ -22,43 +40,197 @@ public:
      * @param address 服务器监听地址
      * @param port 服务器监听端口
      * @param thread_count 工作线程数量
+     * @param options 超时、连接数上限等运行参数
      */
-    Server(const std::string& address, unsigned short port, size_t thread_count = std::thread::hardware_concurrency());
+    Server(const std::string& address, unsigned short port,
+           size_t thread_count = std::thread::hardware_concurrency(),
+           ServerOptions options = {});
+    ~Server();
 
     /**
-     * @brief 启动服务器
+     * @brief 启动服务器，阻塞到服务器停止并且所有工作线程退出
      * @throws boost::system::system_error 如果启动失败
      */
     void run();
 
     /**
-     * @brief 停止服务器
+     * @brief 开始优雅关闭，可以从任意线程调用，不等待关闭完成
+     *
+     * 停止accept并关闭空闲连接，进行中的请求处理完后关闭连接；
+     * 所有连接关闭或超过drain_timeout后run()返回
      */
     void stop();
 
+    /**
+     * @brief 获取当前打开的连接数
+     * @return 连接数
+     */
+    size_t active_connections() const noexcept {
+        return context_.active_connections.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief 获取请求路由表，用于在run()之前注册处理函数
+     * @return 路由表引用
+     */
+    http::Router& router() noexcept { return router_; }
+
+    /**
+     * @brief 将目录挂载为静态文件服务
+     * @param root 静态文件根目录
+     * @param url_prefix 挂载的URL前缀，例如"/static/"
+     * @throws std::runtime_error 如果目录不存在
+     */
+    void serve_static(const std::filesystem::path& root, const std::string& url_prefix);
+
+    /**
+     * @brief 注册经过响应缓存的精确匹配路由
+     *
+     * 处理函数通过Cache-Control: max-age（或CacheOptions::default_ttl）声明响应可以缓存的时间。
+     * 需要Asio后端，io_uring后端对这样的路由返回501；缓存未启用时注册为普通路由
+     * @param path 请求路径
+     * @param handler 处理函数
+     */
+    void add_cached_route(std::string path, http::Router::Handler handler);
+
+    /**
+     * @brief 注册会阻塞的精确匹配路由，处理函数在独立的线程池上执行
+     *
+     * 处理函数完成后回到连接的strand发送响应，IO线程在等待期间继续处理其他连接。
+     * 线程池的队列满时直接返回503。需要Asio后端，io_uring后端对这样的路由返回501
+     * @param path 请求路径
+     * @param handler 处理函数，可以阻塞
+     */
+    void add_blocking_route(std::string path, http::Router::Handler handler);
+
+    /**
+     * @brief 将URL前缀下的请求转发到一组上游服务器
+     *
+     * 缓存启用时，上游响应按其Cache-Control缓存
+     *
+     * 需要Asio后端，io_uring后端对转发的请求返回501
+     * @param url_prefix 转发的URL前缀，例如"/api/"，URI原样转发
+     * @param upstreams 上游地址列表，格式为"host:port"
+     * @param options 连接池、负载均衡和健康检查配置
+     * @throws std::runtime_error 如果上游列表为空或地址无法解析
+     */
+    void reverse_proxy(const std::string& url_prefix, const std::vector<std::string>& upstreams,
+                       proxy::ReverseProxy::Options options = {});
+
 private:
+    /**
+     * @brief 监听socket和它的accept循环
+     */
+    struct Listener {
+        Listener(const boost::asio::any_io_executor& executor, boost::asio::io_context& io_context,
+                 std::chrono::milliseconds backoff);
+
+        boost::asio::ip::tcp::acceptor acceptor;
+        boost::asio::steady_timer timer;
+        // 接受的连接所属的io_context
+        boost::asio::io_context& io_context;
+        // 这个io_context的连接对象池，在io_context之前销毁
+        ConnectionPool pool;
+        std::chrono::milliseconds backoff;
+    };
+
+    /**
+     * @brief 绑定核心的IO线程：独立的io_context和监听socket，连接从accept到关闭都在这个线程上
+     */
+    struct Shard {
+        Shard(int cpu, std::chrono::milliseconds backoff);
+
+        // 单线程运行，不需要加锁
+        boost::asio::io_context io_context{1};
+        boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work_guard;
+        Listener listener;
+        const int cpu;
+    };
+
+    /**
+     * @brief 打开、绑定并开始监听
+     * @throws std::runtime_error 如果任何一步失败
+     */
+    void open_acceptor(boost::asio::ip::tcp::acceptor& acceptor, const boost::asio::ip::tcp::endpoint& endpoint,
+                       bool reuse_port);
+
     /**
      * @brief 接受新的连接
      */
-    void do_accept();
+    void do_accept(Listener& listener);
+
+    /**
+     * @brief 暂停accept一段时间后重试，间隔按指数退避增长
+     */
+    void pause_accept(Listener& listener);
+
+    /**
+     * @brief 等待系统信号
+     */
+    void wait_signal();
+
+    /**
+     * @brief 在strand_上开始优雅关闭
+     */
+    void begin_drain();
+
+    /**
+     * @brief 定期检查连接是否已全部关闭
+     */
+    void check_drained();
 
     /**
      * @brief 工作线程函数
      */
     void worker_thread();
 
+    /**
+     * @brief 绑定核心的IO线程函数：设置CPU和NUMA内存策略后运行shard的io_context
+     */
+    void shard_thread(Shard& shard);
+
+    /**
+     * @brief 运行io_context直到停止，配置了CpuOptions::spin时空闲后先忙等再睡眠
+     */
+    void run_loop(boost::asio::io_context& io_context);
+
+    /**
+     * @brief 启动io_uring后端的工作线程（需要HSMM_ENABLE_IO_URING）
+     */
+    void run_uring();
+
 private:
     boost::asio::io_context io_context_;
     boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work_guard_;
-    boost::asio::ip::tcp::acceptor acceptor_;
+    // accept循环、信号和关闭流程都在这个strand上执行
+    boost::asio::strand<boost::asio::io_context::executor_type> strand_;
+    // 没有配置CPU绑定时所有IO线程共享的监听socket，在strand_上accept
+    Listener listener_;
+    boost::asio::steady_timer drain_timer_;
+    boost::asio::signal_set signals_;
     std::vector<std::thread> worker_threads_;
-    
-    // 使用PMR内存池管理连接对象
-    std::pmr::synchronized_pool_resource connection_pool_;
+    http::Router router_;
+    std::shared_ptr<http::ResponseCache> cache_;
+    std::unique_ptr<UringBackend> uring_backend_;
     
     // 服务器配置
     const size_t thread_count_;
+    const ServerOptions options_;
     std::atomic<bool> running_{false};
+    // 主循环已退出，io_uring工作线程随之退出
+    std::atomic<bool> stopped_{false};
+    // 使用io_uring后端（需要HSMM_ENABLE_IO_URING，内核支持并且没有启用TLS）
+    bool use_uring_{false};
+
+    boost::asio::thread_pool compression_pool_;
+    std::unique_ptr<HandlerPool> handler_pool_;
+    TimerWheel timers_;
+    AdmissionControl admission_;
+    std::unique_ptr<tls::Context> tls_;
+    ServerContext context_;
+    std::chrono::steady_clock::time_point drain_deadline_;
+    // 配置CPU绑定时每个IO线程一个，最先销毁，其中的连接还会访问上面的共享状态
+    std::vector<std::unique_ptr<Shard>> shards_;
 };
 
 } // namespace hsmm 
\ No newline at end of file
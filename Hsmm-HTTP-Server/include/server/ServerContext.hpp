@@ -0,0 +1,42 @@
+#pragma once
+
+#include "server/AdmissionControl.hpp"
+#include "server/ServerOptions.hpp"
+#include "server/TimerWheel.hpp"
+#include <boost/asio/thread_pool.hpp>
+#include <atomic>
+#include <cstddef>
+
+namespace hsmm {
+
+namespace http {
+class Router;
+}
+
+namespace tls {
+class Context;
+}
+
+/**
+ * @brief 所有连接共享的服务器状态
+ *
+ * 由Server持有，连接在其生命周期内通过引用访问
+ */
+struct ServerContext {
+    const http::Router& router;
+    const ServerOptions& options;
+    TimerWheel& timers;
+    // 压缩动态响应的线程池，压缩完成后回到连接的strand继续发送
+    boost::asio::thread_pool& compression_pool;
+    // 按客户端限速和过载检测
+    AdmissionControl& admission;
+    // 启用TLS时所有连接共享的TLS配置，否则为nullptr
+    const tls::Context* tls;
+
+    // 当前打开的连接数
+    std::atomic<size_t> active_connections{0};
+    // 正在优雅关闭：连接处理完当前请求后关闭，不再读取下一个请求
+    std::atomic<bool> draining{false};
+};
+
+} // namespace hsmm
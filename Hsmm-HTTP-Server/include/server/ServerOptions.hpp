@@ -0,0 +1,184 @@
+#pragma once
+
+#include "http/Compression.hpp"
+#include "http/ResponseCache.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace hsmm {
+
+/**
+ * @brief HTTP/2参数
+ */
+struct Http2Options {
+    // 是否接受h2c（明文HTTP/2），包括直接以连接前言开始和通过Upgrade升级两种方式
+    bool enabled{true};
+    // 一个连接上同时进行的流数上限，超出的流被拒绝（REFUSED_STREAM）
+    std::uint32_t max_concurrent_streams{100};
+    // 每个流的接收窗口，请求体交给处理函数后立即归还
+    std::uint32_t initial_window_size{1024 * 1024};
+    // 连接级的接收窗口
+    std::uint32_t connection_window_size{16 * 1024 * 1024};
+    // 允许对端发送的最大帧负载
+    std::uint32_t max_frame_size{16384};
+    // 请求头列表（解码后）的大小上限，超出时返回431
+    std::uint32_t max_header_list_size{64 * 1024};
+    // 一次写出的数据量上限，写完后再从各个流取下一批
+    size_t max_write_batch{256 * 1024};
+};
+
+/**
+ * @brief WebSocket参数
+ */
+struct WebSocketOptions {
+    // 单条消息（合并分片后）的大小上限，超出时以1009关闭连接
+    size_t max_message_size{1024 * 1024};
+    // 每个连接排队等待发送的字节数上限，超出时认为客户端太慢，直接断开连接
+    size_t max_queued_bytes{4 * 1024 * 1024};
+    // 这段时间内连接上没有读写时发送ping，再过同样的时间仍没有收到数据则关闭连接
+    std::chrono::milliseconds ping_interval{std::chrono::seconds(30)};
+};
+
+/**
+ * @brief TLS参数，certificate_file为空时只提供明文HTTP
+ */
+struct TlsOptions {
+    // PEM格式的证书链和私钥
+    std::string certificate_file;
+    std::string private_key_file;
+    // 会话票据（无状态恢复），票据密钥每隔ticket_key_lifetime更换，旧密钥加密的票据再接受一个周期
+    bool session_tickets{true};
+    std::chrono::seconds ticket_key_lifetime{std::chrono::hours(1)};
+    // 所有IO线程共享的服务器端会话缓存（有状态恢复）
+    size_t session_cache_size{20480};
+    // 会话可以恢复的时间
+    std::chrono::seconds session_timeout{std::chrono::minutes(5)};
+    // 握手后把记录层交给内核（kTLS），内核不支持时自动使用OpenSSL加密
+    bool ktls{true};
+};
+
+/**
+ * @brief 阻塞处理函数线程池参数
+ *
+ * 构造Server时的thread_count是IO线程数，这里是处理函数线程数，两者一起决定核心的划分
+ */
+struct HandlerPoolOptions {
+    // 线程数，为0时使用IO线程之外剩余的核心（至少1个）
+    size_t threads{0};
+    // 排队等待线程的请求数上限，队列满时直接返回503
+    size_t max_queue{1024};
+};
+
+/**
+ * @brief 令牌桶参数
+ */
+struct RateLimit {
+    // 每秒补充的令牌数，为0时不限制
+    double rate{0};
+    // 桶的容量，即允许的突发数量，小于1时按1处理
+    double burst{0};
+};
+
+/**
+ * @brief 限速和过载保护参数（只用于Asio后端）
+ */
+struct AdmissionOptions {
+    // 每个客户端IP每秒新建的连接数，在accept之后检查，超出时直接关闭连接
+    RateLimit connections_per_ip;
+    // 每个客户端IP每秒的请求数（所有路由合计），在解析请求头之后检查，超出时返回429
+    RateLimit requests_per_ip;
+    // 按URL前缀对每个客户端IP的额外限制，请求只受最长匹配前缀的限制
+    std::vector<std::pair<std::string, RateLimit>> route_limits;
+    // 跟踪的令牌桶数上限，满了以后先清理已经回满的桶，仍然没有空间时新客户端不受限制
+    size_t max_tracked_clients{100000};
+
+    // 正在处理（已解析请求头、响应还没生成）的请求数上限，超出时返回503；为0时不限制
+    size_t max_inflight_requests{0};
+    // 请求从解析完请求头到生成响应的耗时目标：一个统计周期内的最小耗时超过该值时，
+    // 在下一个周期内拒绝新请求并返回503；为0时不检查
+    std::chrono::milliseconds latency_target{0};
+    std::chrono::milliseconds latency_window{100};
+};
+
+/**
+ * @brief IO线程的CPU绑定、NUMA内存和忙轮询参数（仅Linux）
+ */
+struct CpuOptions {
+    // IO线程依次绑定的CPU编号，第i个线程绑定affinity[i % affinity.size()]。
+    // 非空时每个IO线程使用独立的io_context和监听socket（SO_REUSEPORT），连接从accept到关闭都在同一个线程上；
+    // 主线程只处理信号、超时和反向代理等共享任务，不绑定
+    std::vector<int> affinity;
+    // 绑定后把IO线程的内存分配优先放在所在的NUMA节点，并在该线程上预先分配连接对象和读缓冲区内存块
+    bool numa_local{false};
+    // numa_local时每个IO线程预先分配的连接对象数，读缓冲区内存块数与之相同
+    size_t preallocate_connections{256};
+    // 监听socket的SO_BUSY_POLL（由accept得到的连接继承），读取时在网卡队列上忙轮询这么久再睡眠；
+    // 为0时不设置，超过net.core.busy_read需要CAP_NET_ADMIN
+    std::chrono::microseconds busy_poll{0};
+    // IO线程没有就绪事件时先忙等这么久再进入epoll_wait，以CPU占用换取唤醒延迟；为0时直接睡眠
+    std::chrono::microseconds spin{0};
+};
+
+/**
+ * @brief 服务器运行参数
+ */
+struct ServerOptions {
+    // 新连接或请求开始后，必须在该时间内收到完整的请求头
+    std::chrono::milliseconds header_timeout{std::chrono::seconds(10)};
+    // 读取请求体时两次收到数据之间的最长间隔
+    std::chrono::milliseconds body_timeout{std::chrono::seconds(30)};
+    // 发送响应时两次写出数据之间的最长间隔
+    std::chrono::milliseconds write_timeout{std::chrono::seconds(30)};
+    // keep-alive连接在两个请求之间的最长空闲时间
+    std::chrono::milliseconds idle_timeout{std::chrono::seconds(60)};
+    // 等待异步处理函数（例如反向代理）完成的最长时间，超时后关闭连接
+    std::chrono::milliseconds handler_timeout{std::chrono::seconds(60)};
+
+    // 请求头的最大长度，超过时返回431
+    size_t max_header_size{64 * 1024};
+
+    // 普通路由在内存中缓存的请求体上限，超出时返回413；流式路由不受限制
+    size_t max_body_size{1024 * 1024};
+
+    // 同时处理的最大连接数，达到上限后暂停accept
+    size_t max_connections{10000};
+    // 暂停accept后重新检查的初始间隔，连续失败时加倍直到max_accept_backoff
+    std::chrono::milliseconds accept_backoff{std::chrono::milliseconds(10)};
+    std::chrono::milliseconds max_accept_backoff{std::chrono::seconds(1)};
+
+    // 优雅关闭时等待进行中请求完成的最长时间，超时后强制关闭
+    std::chrono::milliseconds drain_timeout{std::chrono::seconds(30)};
+
+    // 以Prometheus文本格式导出运行指标的路径，为空时不注册
+    std::string metrics_path{"/metrics"};
+
+    // 响应压缩，静态文件在加载时预先压缩，动态响应在压缩线程池上压缩
+    http::CompressionOptions compression;
+
+    // 响应缓存，用于add_cached_route注册的路由和反向代理；max_bytes为0时不启用
+    http::CacheOptions cache;
+
+    // HTTP/2（h2c）
+    Http2Options http2;
+
+    // WebSocket，用于Router::add_websocket_route注册的路由
+    WebSocketOptions websocket;
+
+    // TLS，启用后监听端口只接受TLS连接，HTTP/2通过ALPN协商
+    TlsOptions tls;
+
+    // 按客户端限速和过载时的快速拒绝
+    AdmissionOptions admission;
+
+    // 执行add_blocking_route注册的处理函数的线程池，第一次注册时创建
+    HandlerPoolOptions blocking;
+
+    // IO线程的CPU绑定、NUMA内存和忙轮询
+    CpuOptions cpu;
+};
+
+} // namespace hsmm
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace hsmm {
+
+/**
+ * @brief 哈希时间轮，管理大量连接的超时
+ *
+ * 每个条目按截止时间挂在对应槽位的侵入式双向链表上，加入和移除都是O(1)。
+ * 延长截止时间（连接上的每次读写）只是一次原子写入，不加锁：条目所在槽位到期时，
+ * 如果截止时间已被延后，就把它挪到新的槽位。只有缩短截止时间时才需要加锁重新挂接。
+ */
+class TimerWheel {
+public:
+    using clock = std::chrono::steady_clock;
+
+    /**
+     * @brief 时间轮条目，由需要超时管理的对象继承
+     */
+    class Entry {
+    public:
+        virtual ~Entry() = default;
+
+    protected:
+        /**
+         * @brief 条目到期时在时间轮的锁内调用，实现中只应投递后续处理而不能阻塞
+         */
+        virtual void on_expire() = 0;
+
+    private:
+        friend class TimerWheel;
+
+        Entry* prev_{nullptr};
+        Entry* next_{nullptr};
+        // 截止时间（自clock纪元起的纳秒数），可以被无锁地延后
+        std::atomic<std::int64_t> deadline_{0};
+        // 条目所在槽位对应的截止时间
+        std::atomic<std::int64_t> bucket_deadline_{0};
+        bool linked_{false};
+    };
+
+    /**
+     * @brief 构造函数
+     * @param io_context 运行时钟的io_context
+     * @param tick 时钟间隔，即超时精度
+     * @param slots 槽位数量
+     */
+    TimerWheel(boost::asio::io_context& io_context, std::chrono::milliseconds tick, size_t slots = 512);
+
+    /**
+     * @brief 启动时钟
+     */
+    void start();
+
+    /**
+     * @brief 停止时钟，已加入的条目不再到期
+     */
+    void stop();
+
+    /**
+     * @brief 加入条目
+     * @param entry 条目，必须在移除前保持有效
+     * @param deadline 截止时间
+     */
+    void add(Entry& entry, clock::time_point deadline);
+
+    /**
+     * @brief 移除条目，条目未加入时什么也不做
+     * @param entry 条目
+     */
+    void remove(Entry& entry);
+
+    /**
+     * @brief 更新条目的截止时间
+     *
+     * 延后截止时间不加锁
+     * @param entry 已加入的条目
+     * @param deadline 新的截止时间
+     */
+    void update(Entry& entry, clock::time_point deadline);
+
+    /**
+     * @brief 重新加入被提前触发的条目，截止时间保持不变
+     * @param entry 条目
+     */
+    void reinsert(Entry& entry);
+
+    /**
+     * @brief 立即触发所有条目，不论截止时间是否已到
+     *
+     * 用于优雅关闭：由条目自行判断是关闭还是调用reinsert()继续等待
+     */
+    void expire_all();
+
+    /**
+     * @brief 判断条目是否已经到期
+     * @param entry 条目
+     * @param now 当前时间
+     * @return 截止时间是否已过
+     */
+    static bool expired(const Entry& entry, clock::time_point now) noexcept {
+        return entry.deadline_.load(std::memory_order_relaxed) <= to_ticks(now);
+    }
+
+private:
+    static std::int64_t to_ticks(clock::time_point time) noexcept {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+    }
+
+    size_t slot_of(std::int64_t deadline) const noexcept;
+    void link(Entry& entry, std::int64_t deadline);
+    void unlink(Entry& entry);
+    void do_tick();
+
+private:
+    boost::asio::steady_timer timer_;
+    const std::int64_t tick_;
+    std::mutex mutex_;
+    std::vector<Entry*> slots_;
+    // 下一个要处理的时钟周期
+    std::int64_t current_tick_{0};
+    bool running_{false};
+};
+
+} // namespace hsmm
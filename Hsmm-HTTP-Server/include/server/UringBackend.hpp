@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+namespace hsmm {
+
+struct ServerContext;
+
+/**
+ * @brief 基于io_uring的网络后端
+ *
+ * 替代Boost.Asio的epoll reactor处理accept/read/write循环：每个线程持有独立的io_uring实例，
+ * 在共享的监听socket上提交multishot accept，读取使用内核提供的缓冲区环（provided buffer ring），
+ * 一轮事件处理中产生的所有提交在下一次io_uring_enter时批量提交。
+ * 连接计入ServerContext::active_connections，遵守ServerOptions中的超时、连接数上限和accept退避；
+ * ServerContext::draining变为true后取消accept并关闭空闲连接，处理中的连接发送完当前响应后关闭。
+ * 仅在CMake选项HSMM_ENABLE_IO_URING打开时编译。
+ */
+class UringBackend {
+public:
+    /**
+     * @brief 构造函数
+     * @param listen_fd 已处于监听状态的socket
+     * @param context 共享的服务器状态（路由表、运行参数、连接计数和关闭状态）
+     * @param stopped 停止标志，变为true后各线程在下一个时钟周期内退出
+     */
+    UringBackend(int listen_fd, ServerContext& context, const std::atomic<bool>& stopped);
+
+    /**
+     * @brief 检查当前内核是否支持所需的io_uring特性
+     * @return 是否可用
+     */
+    static bool available() noexcept;
+
+    /**
+     * @brief 在当前线程运行一个事件循环，直到stopped变为true
+     * @throws std::system_error 如果io_uring初始化失败
+     */
+    void run_worker();
+
+private:
+    int listen_fd_;
+    ServerContext& context_;
+    const std::atomic<bool>& stopped_;
+};
+
+} // namespace hsmm
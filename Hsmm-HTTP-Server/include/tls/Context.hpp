@@ -0,0 +1,86 @@
+#pragma once
+
+#include "server/ServerOptions.hpp"
+#include <openssl/ssl.h>
+#include <array>
+#include <chrono>
+#include <optional>
+#include <shared_mutex>
+
+namespace hsmm {
+namespace tls {
+
+/**
+ * @brief 服务器的TLS配置，所有IO线程上的连接共享
+ *
+ * 封装一个SSL_CTX：证书和私钥、ALPN（h2和http/1.1）、会话缓存和会话票据。
+ * 会话缓存在SSL_CTX内部，所有线程共享；票据密钥由这里生成并定期更换，
+ * 新的票据总是用当前密钥加密，用上一个密钥加密的票据仍然可以恢复会话，同时换发新票据。
+ */
+class Context {
+public:
+    /**
+     * @brief 构造函数
+     * @param options TLS参数
+     * @param http2 是否通过ALPN提供HTTP/2
+     * @throws std::runtime_error 如果证书或私钥无法加载
+     */
+    Context(const TlsOptions& options, bool http2);
+    ~Context();
+
+    Context(const Context&) = delete;
+    Context& operator=(const Context&) = delete;
+
+    /**
+     * @brief 获取OpenSSL上下文，用于创建连接
+     */
+    SSL_CTX* native_handle() const noexcept { return ctx_; }
+
+private:
+    struct TicketKey {
+        std::array<unsigned char, 16> name;
+        std::array<unsigned char, 32> aes_key;
+        std::array<unsigned char, 32> hmac_key;
+    };
+
+    /**
+     * @brief ALPN回调：客户端支持时优先选择h2
+     */
+    static int select_alpn(SSL* ssl, const unsigned char** out, unsigned char* out_length,
+                           const unsigned char* in, unsigned int in_length, void* arg);
+
+    /**
+     * @brief 会话票据的加解密回调
+     * @return 1使用该密钥，2使用该密钥并换发新票据，0不认识的票据（完整握手），-1出错
+     */
+    static int ticket_key_callback(SSL* ssl, unsigned char* name, unsigned char* iv,
+                                   EVP_CIPHER_CTX* cipher, EVP_MAC_CTX* mac, int encrypt);
+
+    /**
+     * @brief 获取当前的票据密钥，到期时先更换
+     */
+    TicketKey current_ticket_key();
+
+    /**
+     * @brief 按名称查找票据密钥
+     * @return 密钥，以及它是否为当前密钥
+     */
+    std::optional<std::pair<TicketKey, bool>> find_ticket_key(const unsigned char* name);
+
+    /**
+     * @brief 生成随机的票据密钥
+     */
+    static TicketKey make_ticket_key();
+
+    SSL_CTX* ctx_{nullptr};
+    const bool http2_;
+    const std::chrono::seconds ticket_key_lifetime_;
+
+    std::shared_mutex ticket_mutex_;
+    // [0]为当前密钥，[1]为上一个密钥
+    std::array<TicketKey, 2> ticket_keys_;
+    std::chrono::steady_clock::time_point ticket_key_created_;
+};
+
+} // namespace tls
+} // namespace hsmm
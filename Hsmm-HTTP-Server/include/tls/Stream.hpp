@@ -0,0 +1,305 @@
+#pragma once
+
+#include "tls/Context.hpp"
+#include <boost/asio.hpp>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace hsmm {
+namespace tls {
+
+/**
+ * @brief 单个TLS连接
+ *
+ * OpenSSL直接使用socket的文件描述符（非阻塞），需要等待时通过socket的async_wait等待可读或可写，
+ * 这样握手后OpenSSL可以把记录层交给内核（kTLS）：之后的加解密在内核中完成，
+ * 文件响应体通过SSL_sendfile发送，不经过用户态。
+ * 接口与Asio的异步操作一致，完成回调总是投递到socket的执行器（连接的strand）上，不会在发起操作时直接调用。
+ * 同一时间最多一个读操作和一个写操作。
+ */
+class Stream {
+public:
+    using socket_type = boost::asio::ip::tcp::socket;
+
+    /**
+     * @brief 构造函数
+     * @param context 服务器的TLS配置
+     * @param socket 已经建立的TCP连接，在Stream生命周期内保持有效
+     */
+    Stream(const Context& context, socket_type& socket);
+    ~Stream();
+
+    Stream(const Stream&) = delete;
+    Stream& operator=(const Stream&) = delete;
+
+    /**
+     * @brief 完成服务器端握手
+     * @param handler void(error_code)
+     */
+    template <typename Handler>
+    void async_handshake(Handler handler);
+
+    /**
+     * @brief 读取一些解密后的数据
+     * @param buffer 读缓冲区
+     * @param handler void(error_code, size_t)，对端关闭时为eof
+     */
+    template <typename Handler>
+    void async_read_some(boost::asio::mutable_buffer buffer, Handler handler);
+
+    /**
+     * @brief 写出全部数据
+     *
+     * 总长度不超过一个记录的小块数据先合并，避免每块数据单独成为一个记录
+     * @param buffers 数据，写操作完成前保持有效
+     * @param handler void(error_code, size_t)
+     */
+    template <typename ConstBufferSequence, typename Handler>
+    void async_write(const ConstBufferSequence& buffers, Handler handler);
+
+    /**
+     * @brief 通过kTLS发送文件的一部分，只在ktls_send()时可用
+     * @param fd 文件描述符
+     * @param offset 文件中的偏移
+     * @param length 最多发送的字节数
+     * @param handler void(error_code, size_t)，完成时至少发送了一个字节
+     */
+    template <typename Handler>
+    void async_sendfile(int fd, std::uint64_t offset, size_t length, Handler handler);
+
+    /**
+     * @brief 发送方向是否已经交给内核
+     */
+    bool ktls_send() const noexcept { return ktls_send_; }
+
+    /**
+     * @brief 握手协商出的ALPN协议，没有协商时为空
+     */
+    std::string_view alpn() const noexcept;
+
+    /**
+     * @brief 尽力发送close_notify，不等待对端回应，必须在关闭socket之前调用
+     */
+    void shutdown() noexcept;
+
+private:
+    // 单个记录的最大明文长度，不超过它的写操作合并后一次写出
+    static constexpr size_t max_record_size = 16 * 1024;
+
+    /**
+     * @brief 执行一步握手
+     * @return SSL_ERROR_NONE表示握手完成，否则为SSL_get_error的结果
+     */
+    int handshake_step() noexcept;
+
+    /**
+     * @brief 握手完成后检查kTLS并记录指标
+     */
+    void handshake_done() noexcept;
+
+    /**
+     * @brief SSL_get_error的结果是否表示需要等待socket就绪
+     */
+    static bool would_block(int status) noexcept {
+        return status == SSL_ERROR_WANT_READ || status == SSL_ERROR_WANT_WRITE;
+    }
+
+    /**
+     * @brief 等待socket可读或可写后重试
+     * @param status SSL_get_error的结果，必须满足would_block()
+     * @param retry void(error_code)，等待失败时以错误调用
+     */
+    template <typename Retry>
+    void wait(int status, Retry retry) {
+        socket_.async_wait(status == SSL_ERROR_WANT_READ ? socket_type::wait_read : socket_type::wait_write,
+            std::move(retry));
+    }
+
+    /**
+     * @brief 把SSL_get_error的结果转换为错误码，致命错误之后不再发送close_notify
+     */
+    boost::system::error_code error(int status) noexcept;
+
+    /**
+     * @brief 把完成回调投递到socket的执行器上
+     */
+    template <typename Handler, typename... Args>
+    void complete(Handler&& handler, Args... args) {
+        boost::asio::post(socket_.get_executor(),
+            [handler = std::forward<Handler>(handler), args...]() mutable { handler(args...); });
+    }
+
+    template <typename Handler>
+    void write_next(Handler handler);
+
+    SSL* ssl_;
+    socket_type& socket_;
+    bool failed_{false};
+    bool ktls_send_{false};
+    // 握手期间在OpenSSL中花费的时间，即握手的CPU开销
+    std::uint64_t handshake_ns_{0};
+
+    // 当前写操作
+    std::vector<boost::asio::const_buffer> write_buffers_;
+    std::string write_staging_;
+    size_t write_index_{0};
+    size_t written_{0};
+};
+
+template <typename Handler>
+void Stream::async_handshake(Handler handler) {
+    const int status = handshake_step();
+    if (status == SSL_ERROR_NONE) {
+        handshake_done();
+        complete(std::move(handler), boost::system::error_code());
+        return;
+    }
+
+    if (!would_block(status)) {
+        complete(std::move(handler), error(status));
+        return;
+    }
+    wait(status, [this, handler = std::move(handler)](boost::system::error_code ec) mutable {
+        if (ec) {
+            handler(ec);
+        } else {
+            async_handshake(std::move(handler));
+        }
+    });
+}
+
+template <typename Handler>
+void Stream::async_read_some(boost::asio::mutable_buffer buffer, Handler handler) {
+    if (!socket_.is_open()) {
+        complete(std::move(handler), boost::system::error_code(boost::asio::error::bad_descriptor), size_t{0});
+        return;
+    }
+
+    ERR_clear_error();
+    size_t length = 0;
+    const int ret = SSL_read_ex(ssl_, buffer.data(), buffer.size(), &length);
+    if (ret == 1) {
+        complete(std::move(handler), boost::system::error_code(), length);
+        return;
+    }
+
+    const int status = SSL_get_error(ssl_, ret);
+    if (!would_block(status)) {
+        complete(std::move(handler), error(status), size_t{0});
+        return;
+    }
+    wait(status, [this, buffer, handler = std::move(handler)](boost::system::error_code ec) mutable {
+        if (ec) {
+            handler(ec, size_t{0});
+        } else {
+            async_read_some(buffer, std::move(handler));
+        }
+    });
+}
+
+template <typename ConstBufferSequence, typename Handler>
+void Stream::async_write(const ConstBufferSequence& buffers, Handler handler) {
+    write_buffers_.clear();
+    write_index_ = 0;
+    written_ = 0;
+
+    const auto total = boost::asio::buffer_size(buffers);
+    if (total <= max_record_size) {
+        write_staging_.clear();
+        for (auto it = boost::asio::buffer_sequence_begin(buffers); it != boost::asio::buffer_sequence_end(buffers); ++it) {
+            const boost::asio::const_buffer buffer(*it);
+            write_staging_.append(static_cast<const char*>(buffer.data()), buffer.size());
+        }
+        write_buffers_.emplace_back(write_staging_.data(), write_staging_.size());
+    } else {
+        for (auto it = boost::asio::buffer_sequence_begin(buffers); it != boost::asio::buffer_sequence_end(buffers); ++it) {
+            write_buffers_.emplace_back(*it);
+        }
+    }
+    write_next(std::move(handler));
+}
+
+template <typename Handler>
+void Stream::write_next(Handler handler) {
+    if (!socket_.is_open()) {
+        complete(std::move(handler), boost::system::error_code(boost::asio::error::bad_descriptor), written_);
+        return;
+    }
+
+    while (write_index_ < write_buffers_.size()) {
+        const auto& buffer = write_buffers_[write_index_];
+        if (buffer.size() == 0) {
+            ++write_index_;
+            continue;
+        }
+
+        ERR_clear_error();
+        size_t length = 0;
+        const int ret = SSL_write_ex(ssl_, buffer.data(), buffer.size(), &length);
+        if (ret == 1) {
+            // 没有启用部分写入，成功时整块数据都已写出
+            written_ += length;
+            ++write_index_;
+            continue;
+        }
+
+        // 重试时必须使用相同的参数
+        const int status = SSL_get_error(ssl_, ret);
+        if (!would_block(status)) {
+            complete(std::move(handler), error(status), written_);
+            return;
+        }
+        wait(status, [this, handler = std::move(handler)](boost::system::error_code ec) mutable {
+            if (ec) {
+                handler(ec, written_);
+            } else {
+                write_next(std::move(handler));
+            }
+        });
+        return;
+    }
+
+    if (write_staging_.capacity() > 4 * max_record_size) {
+        std::string().swap(write_staging_);
+    }
+    complete(std::move(handler), boost::system::error_code(), written_);
+}
+
+template <typename Handler>
+void Stream::async_sendfile(int fd, std::uint64_t offset, size_t length, Handler handler) {
+    if (!socket_.is_open()) {
+        complete(std::move(handler), boost::system::error_code(boost::asio::error::bad_descriptor), size_t{0});
+        return;
+    }
+
+    ERR_clear_error();
+    const auto sent = SSL_sendfile(ssl_, fd, static_cast<off_t>(offset), length, 0);
+    if (sent > 0) {
+        complete(std::move(handler), boost::system::error_code(), static_cast<size_t>(sent));
+        return;
+    }
+
+    const int status = SSL_get_error(ssl_, static_cast<int>(sent));
+    if (!would_block(status)) {
+        // 返回0表示文件在发送过程中被截断
+        complete(std::move(handler),
+            sent == 0 ? boost::system::error_code(boost::asio::error::eof) : error(status), size_t{0});
+        return;
+    }
+    wait(status, [this, fd, offset, length, handler = std::move(handler)](boost::system::error_code ec) mutable {
+        if (ec) {
+            handler(ec, size_t{0});
+        } else {
+            async_sendfile(fd, offset, length, std::move(handler));
+        }
+    });
+}
+
+} // namespace tls
+} // namespace hsmm
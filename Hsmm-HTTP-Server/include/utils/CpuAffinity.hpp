@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+
+namespace hsmm {
+namespace utils {
+
+/**
+ * @brief 解析CPU列表，格式与taskset/cpuset相同，例如"0-3,8,10-11"
+ * @param list CPU列表
+ * @return 按出现顺序排列的CPU编号
+ * @throws std::invalid_argument 如果格式错误
+ */
+std::vector<int> parse_cpu_list(std::string_view list);
+
+/**
+ * @brief 把当前线程绑定到一个CPU上
+ * @param cpu CPU编号
+ * @return 是否成功，非Linux平台总是返回false
+ */
+bool pin_current_thread(int cpu) noexcept;
+
+/**
+ * @brief 查询CPU所在的NUMA节点
+ * @param cpu CPU编号
+ * @return 节点编号，没有NUMA信息时返回-1
+ */
+int numa_node_of_cpu(int cpu) noexcept;
+
+/**
+ * @brief 让当前线程之后的内存分配优先使用指定的NUMA节点（MPOL_PREFERRED）
+ *
+ * 即使进程以numactl --interleave等策略启动，也能保证线程自己分配的内存在本地节点上，
+ * 节点内存不足时仍然可以使用其他节点
+ * @param node 节点编号
+ * @return 是否成功
+ */
+bool prefer_numa_node(int node) noexcept;
+
+} // namespace utils
+} // namespace hsmm
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <boost/asio/buffer.hpp>
+#include <cstddef>
+#include <iterator>
+#include <span>
+#include <vector>
+
+namespace hsmm {
+namespace utils {
+
+/**
+ * @brief 链式IO缓冲区
+ *
+ * 数据存放在一串内存块中：普通内存块大小固定（slab_size），由线程本地的池分配和回收，
+ * 只有需要连续存放的数据超过一个内存块时（例如很长的请求头）才分配更大的内存块。
+ * 写入使用prepare/commit：先取得可写空间，读取完成后提交实际写入的长度。
+ * 读出的一端consume时只移动偏移，不搬移数据，整块用完后立即归还给池。
+ * data()和prepare_buffers()可以直接作为Asio的ConstBufferSequence/MutableBufferSequence使用。
+ *
+ * consume之前，front()等返回的视图一直有效；consume之后对应的内存可能被复用，不能再访问。
+ */
+class IoBuffer {
+    struct Block {
+        char* data;
+        size_t capacity;
+        // 可读数据区间[begin, end)，[end, capacity)为可写空间
+        size_t begin;
+        size_t end;
+    };
+
+public:
+    // 普通内存块的大小，正好容纳一个最大的TLS记录
+    static constexpr size_t slab_size = 16 * 1024;
+
+    /**
+     * @brief Asio缓冲区序列，每个内存块对应一个缓冲区
+     * @tparam Buffer const_buffer或mutable_buffer
+     * @tparam Writable 为true时是可写空间，否则是可读数据
+     */
+    template <typename Buffer, bool Writable>
+    class Sequence {
+    public:
+        class const_iterator {
+        public:
+            using iterator_category = std::bidirectional_iterator_tag;
+            using value_type = Buffer;
+            using difference_type = std::ptrdiff_t;
+            using pointer = void;
+            using reference = Buffer;
+
+            const_iterator() = default;
+            explicit const_iterator(const Block* block) noexcept : block_(block) {}
+
+            Buffer operator*() const noexcept {
+                return Writable ? Buffer(block_->data + block_->end, block_->capacity - block_->end)
+                                : Buffer(block_->data + block_->begin, block_->end - block_->begin);
+            }
+            const_iterator& operator++() noexcept { ++block_; return *this; }
+            const_iterator operator++(int) noexcept { auto it = *this; ++block_; return it; }
+            const_iterator& operator--() noexcept { --block_; return *this; }
+            const_iterator operator--(int) noexcept { auto it = *this; --block_; return it; }
+            bool operator==(const const_iterator& other) const noexcept { return block_ == other.block_; }
+
+        private:
+            const Block* block_{nullptr};
+        };
+
+        Sequence(const Block* first, const Block* last) noexcept : first_(first), last_(last) {}
+
+        const_iterator begin() const noexcept { return const_iterator(first_); }
+        const_iterator end() const noexcept { return const_iterator(last_); }
+
+    private:
+        const Block* first_;
+        const Block* last_;
+    };
+
+    using const_buffers_type = Sequence<boost::asio::const_buffer, false>;
+    using mutable_buffers_type = Sequence<boost::asio::mutable_buffer, true>;
+
+    IoBuffer() = default;
+    ~IoBuffer();
+
+    IoBuffer(IoBuffer&& other) noexcept;
+    IoBuffer& operator=(IoBuffer&& other) noexcept;
+    IoBuffer(const IoBuffer&) = delete;
+    IoBuffer& operator=(const IoBuffer&) = delete;
+
+    /**
+     * @brief 可读数据的总长度
+     */
+    size_t size() const noexcept { return size_; }
+
+    /**
+     * @brief 是否没有可读数据
+     */
+    bool empty() const noexcept { return size_ == 0; }
+
+    /**
+     * @brief 取得一段连续的可写空间，当前内存块剩余空间不足时追加新的内存块
+     * @param min_size 至少需要的长度
+     * @return 可写空间，commit之前有效
+     */
+    std::span<char> prepare(size_t min_size = 1);
+
+    /**
+     * @brief 取得至少length字节的可写空间，可能分布在多个内存块中
+     * @param length 至少需要的长度
+     * @return 可写空间的缓冲区序列，用于分散读取，第一个缓冲区不为空
+     */
+    mutable_buffers_type prepare_buffers(size_t length);
+
+    /**
+     * @brief 提交写入可写空间的数据，成为可读数据
+     * @param length 实际写入的长度，不超过prepare得到的空间
+     */
+    void commit(size_t length) noexcept;
+
+    /**
+     * @brief 第一段连续的可读数据
+     */
+    std::span<char> front() noexcept;
+    std::span<const char> front() const noexcept;
+
+    /**
+     * @brief 把全部可读数据合并到一个连续的内存块中
+     *
+     * 数据已经连续时不复制；否则复制到一个留有同样大小可写空间的新内存块，
+     * 之后读取的数据直接追加在后面，反复合并的代价按长度翻倍摊销
+     * @return 全部可读数据
+     */
+    std::span<char> linearize();
+
+    /**
+     * @brief 丢弃开头的数据，用完的内存块归还给池
+     * @param length 丢弃的长度，不超过size()
+     */
+    void consume(size_t length) noexcept;
+
+    /**
+     * @brief 把另一个缓冲区的全部可读数据移动到末尾，只转移内存块，不复制数据
+     * @param other 源缓冲区，之后为空
+     */
+    void splice(IoBuffer& other);
+
+    /**
+     * @brief 全部可读数据的缓冲区序列，用于聚集写出
+     */
+    const_buffers_type data() const noexcept {
+        return const_buffers_type(blocks_.data(), blocks_.data() + (blocks_.empty() ? 0 : write_ + 1));
+    }
+
+    /**
+     * @brief 释放所有内存块
+     */
+    void clear() noexcept;
+
+    /**
+     * @brief 在当前线程的池中预先分配内存块并逐页写入
+     *
+     * 内存页在第一次写入时才分配物理内存，由绑定核心的线程调用时内存块落在该线程所在的NUMA节点上
+     * @param count 池中至少要有的空闲内存块数，不超过池的容量
+     */
+    static void preallocate(size_t count);
+
+private:
+    /**
+     * @brief 分配内存块，不超过slab_size时从线程本地的池中取
+     */
+    static Block allocate(size_t capacity);
+
+    /**
+     * @brief 释放内存块，普通内存块归还给线程本地的池
+     */
+    static void release(const Block& block) noexcept;
+
+    // write_之前的内存块都有数据，write_是正在写入的内存块，之后的是prepare_buffers预留的空内存块
+    std::vector<Block> blocks_;
+    size_t write_{0};
+    size_t size_{0};
+};
+
+} // namespace utils
+} // namespace hsmm
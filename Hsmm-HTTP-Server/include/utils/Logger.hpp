@@ -2,13 +2,27 @@
 
 #include <string>
 #include <string_view>
-#include <fstream>
+#include <array>
+#include <atomic>
 #include <mutex>
+#include <condition_variable>
 #include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
 #include <chrono>
-#include <sstream>
-#include <iomanip>
-#include <iostream>
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+
+// 编译期日志级别：低于该级别的日志调用在编译期被整体消除（0=DEBUG, 1=INFO, 2=WARNING, 3=ERROR）
+#ifndef HSMM_LOG_COMPILE_LEVEL
+#define HSMM_LOG_COMPILE_LEVEL 0
+#endif
 
 namespace hsmm {
 namespace utils {
@@ -23,8 +37,91 @@ enum class LogLevel {
     ERROR
 };
 
+namespace detail {
+
+/**
+ * @brief 单条日志记录，固定大小以便在环形缓冲区中原地存放
+ */
+struct LogRecord {
+    static constexpr size_t max_text = 480;
+
+    std::int64_t timestamp_us;
+    LogLevel level;
+    std::uint16_t length;
+    char text[max_text];
+};
+
 /**
- * @brief 线程安全的日志类
+ * @brief 单生产者单消费者的无锁环形缓冲区
+ *
+ * 每个写日志的线程独占一个实例作为生产者，后台写线程是唯一的消费者
+ */
+class LogRing {
+public:
+    static constexpr size_t capacity = 256;
+    static_assert((capacity & (capacity - 1)) == 0, "capacity必须是2的幂");
+
+    /**
+     * @brief 写入一条日志，缓冲区已满时立即失败而不阻塞
+     * @return 是否写入成功
+     */
+    bool try_push(LogLevel level, std::int64_t timestamp_us, std::string_view message) noexcept {
+        const auto tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == capacity) {
+            return false;
+        }
+
+        auto& record = records_[tail & (capacity - 1)];
+        record.timestamp_us = timestamp_us;
+        record.level = level;
+        auto length = std::min(message.size(), LogRecord::max_text);
+        // 截断时不拆开UTF-8多字节字符
+        if (length < message.size()) {
+            while (length > 0 && (static_cast<unsigned char>(message[length]) & 0xC0) == 0x80) --length;
+        }
+        record.length = static_cast<std::uint16_t>(length);
+        std::memcpy(record.text, message.data(), record.length);
+
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief 取出当前所有可读的日志
+     * @param consume 对每条记录调用的函数
+     * @return 取出的记录数
+     */
+    template<typename F>
+    size_t drain(F&& consume) {
+        const auto head = head_.load(std::memory_order_relaxed);
+        const auto tail = tail_.load(std::memory_order_acquire);
+        for (auto i = head; i != tail; ++i) {
+            consume(records_[i & (capacity - 1)]);
+        }
+        head_.store(tail, std::memory_order_release);
+        return tail - head;
+    }
+
+    bool empty() const noexcept {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+    // 所属线程已退出，缓冲区排空后由写线程回收
+    std::atomic<bool> retired{false};
+
+private:
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> tail_{0};
+    std::array<LogRecord, capacity> records_;
+};
+
+} // namespace detail
+
+/**
+ * @brief 异步日志类
+ *
+ * 调用线程只把消息拷贝进自己的无锁环形缓冲区，格式化和IO由后台写线程批量完成。
+ * 同一线程内的日志保持顺序，不同线程之间的日志按写线程的收集顺序输出。
  */
 class Logger {
 public:
@@ -39,40 +136,54 @@ public:
 
     /**
      * @brief 初始化日志系统
+     *
+     * 新文件由写线程在两批输出之间换上，旧文件也由写线程关闭，不会关闭一个正在写入的文件描述符
      * @param filename 日志文件名
      * @param level 最低日志级别
      */
     void init(const std::string& filename, LogLevel level = LogLevel::INFO) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        file_.open(filename, std::ios::app);
-        level_ = level;
+        const int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            // 上一次init打开的文件还没被写线程换上，直接关闭
+            if (pending_fd_ >= 0) {
+                ::close(pending_fd_);
+            }
+            pending_fd_ = fd;
+            reopen_ = true;
+        }
+        level_.store(level, std::memory_order_relaxed);
+        wakeup_.notify_one();
+    }
+
+    /**
+     * @brief 判断某个级别的日志当前是否会被输出
+     * @param level 日志级别
+     * @return 是否输出
+     */
+    bool enabled(LogLevel level) const noexcept {
+        return level >= level_.load(std::memory_order_relaxed);
     }
 
     /**
      * @brief 写入日志
      * @param level 日志级别
-     * @param message 日志消息
+     * @param message 日志消息，超过LogRecord::max_text的部分被截断
      */
     void log(LogLevel level, std::string_view message) {
-        if (level < level_) return;
-
-        std::lock_guard<std::mutex> lock(mutex_);
-        
-        auto now = std::chrono::system_clock::now();
-        auto time = std::chrono::system_clock::to_time_t(now);
-        
-        std::stringstream ss;
-        ss << "[" << std::put_time(std::localtime(&time), "%Y-%m-%d %H:%M:%S") << "] "
-           << level_to_string(level) << ": "
-           << message << std::endl;
-
-        if (file_.is_open()) {
-            file_ << ss.str();
-            file_.flush();
+        if (!enabled(level)) return;
+
+        const auto now = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+
+        if (!local_ring().try_push(level, now, message)) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // 错误日志尽快落盘，其余日志等待写线程的下一次批量输出
+        if (level >= LogLevel::ERROR) {
+            wakeup_.notify_one();
         }
-        
-        // 同时输出到控制台
-        std::cout << ss.str();
     }
 
     // 便捷日志方法
@@ -82,10 +193,19 @@ public:
     void error(std::string_view message) { log(LogLevel::ERROR, message); }
 
 private:
-    Logger() = default;
+    Logger() : writer_([this] { writer_loop(); }) {}
     ~Logger() {
-        if (file_.is_open()) {
-            file_.close();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wakeup_.notify_one();
+        writer_.join();
+
+        for (const int fd : {file_fd_, pending_fd_}) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
         }
     }
 
@@ -95,6 +215,147 @@ private:
     Logger(Logger&&) = delete;
     Logger& operator=(Logger&&) = delete;
 
+    /**
+     * @brief 线程退出时标记其缓冲区可回收
+     */
+    struct RingHandle {
+        std::shared_ptr<detail::LogRing> ring;
+        ~RingHandle() {
+            if (ring) ring->retired.store(true, std::memory_order_release);
+        }
+    };
+
+    /**
+     * @brief 获取当前线程的环形缓冲区，首次调用时注册到写线程
+     * @return 当前线程独占的缓冲区
+     */
+    detail::LogRing& local_ring() {
+        thread_local RingHandle handle;
+        if (!handle.ring) {
+            handle.ring = std::make_shared<detail::LogRing>();
+            std::lock_guard<std::mutex> lock(mutex_);
+            rings_.push_back(handle.ring);
+        }
+        return *handle.ring;
+    }
+
+    /**
+     * @brief 后台写线程：收集所有线程的日志，格式化后批量写出
+     */
+    void writer_loop() {
+        std::string batch;
+        batch.reserve(batch_size + detail::LogRecord::max_text + 64);
+        std::vector<std::shared_ptr<detail::LogRing>> rings;
+
+        for (;;) {
+            bool stopping;
+            bool reopen;
+            int next_fd = -1;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wakeup_.wait_for(lock, flush_interval);
+                stopping = stopping_;
+                reopen = std::exchange(reopen_, false);
+                if (reopen) {
+                    next_fd = std::exchange(pending_fd_, -1);
+                }
+
+                // 回收已退出线程的空缓冲区
+                std::erase_if(rings_, [](const auto& ring) {
+                    return ring->retired.load(std::memory_order_acquire) && ring->empty();
+                });
+                rings = rings_;
+            }
+
+            // 上一批已经全部写出，此时关闭旧文件是安全的
+            if (reopen) {
+                if (file_fd_ >= 0) {
+                    ::close(file_fd_);
+                }
+                file_fd_ = next_fd;
+            }
+
+            if (const auto dropped = dropped_.exchange(0, std::memory_order_relaxed)) {
+                append_record(batch, LogLevel::WARNING,
+                    std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::system_clock::now().time_since_epoch()).count(),
+                    "日志缓冲区已满，丢弃 " + std::to_string(dropped) + " 条日志");
+            }
+
+            for (const auto& ring : rings) {
+                ring->drain([&](const detail::LogRecord& record) {
+                    append_record(batch, record.level, record.timestamp_us,
+                                  std::string_view(record.text, record.length));
+                    if (batch.size() >= batch_size) {
+                        flush(batch);
+                    }
+                });
+            }
+            flush(batch);
+
+            if (stopping) {
+                // 退出前再检查一遍，确保停止前写入的日志全部输出
+                bool remaining = false;
+                for (const auto& ring : rings) remaining = remaining || !ring->empty();
+                if (!remaining) return;
+            }
+        }
+    }
+
+    /**
+     * @brief 格式化一条日志并追加到批量缓冲区
+     */
+    void append_record(std::string& batch, LogLevel level, std::int64_t timestamp_us, std::string_view message) {
+        batch.push_back('[');
+        batch.append(format_time(timestamp_us / 1000000));
+        batch.append("] ");
+        batch.append(level_to_string(level));
+        batch.append(": ");
+        batch.append(message);
+        batch.push_back('\n');
+    }
+
+    /**
+     * @brief 格式化时间戳，同一秒内复用上一次的结果
+     * @param seconds 自纪元起的秒数
+     * @return "YYYY-mm-dd HH:MM:SS"格式的时间
+     */
+    std::string_view format_time(std::time_t seconds) {
+        if (seconds != cached_second_) {
+            std::tm tm{};
+            localtime_r(&seconds, &tm);
+            cached_length_ = std::strftime(cached_time_.data(), cached_time_.size(), "%Y-%m-%d %H:%M:%S", &tm);
+            cached_second_ = seconds;
+        }
+        return std::string_view(cached_time_.data(), cached_length_);
+    }
+
+    /**
+     * @brief 将批量缓冲区写入日志文件和控制台
+     */
+    void flush(std::string& batch) {
+        if (batch.empty()) return;
+
+        if (file_fd_ >= 0) {
+            write_all(file_fd_, batch);
+        }
+
+        // 同时输出到控制台
+        write_all(STDOUT_FILENO, batch);
+        batch.clear();
+    }
+
+    static void write_all(int fd, std::string_view data) {
+        while (!data.empty()) {
+            const auto written = ::write(fd, data.data(), data.size());
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                return;
+            }
+            data.remove_prefix(static_cast<size_t>(written));
+        }
+    }
+
     /**
      * @brief 将日志级别转换为字符串
      * @param level 日志级别
@@ -111,16 +372,43 @@ private:
     }
 
 private:
+    static constexpr size_t batch_size = 64 * 1024;
+    static constexpr auto flush_interval = std::chrono::milliseconds(20);
+
     std::mutex mutex_;
-    std::ofstream file_;
-    LogLevel level_{LogLevel::INFO};
+    std::condition_variable wakeup_;
+    std::vector<std::shared_ptr<detail::LogRing>> rings_;
+    bool stopping_{false};
+    // init()打开的新文件，由写线程换上
+    bool reopen_{false};
+    int pending_fd_{-1};
+
+    // 仅由写线程访问的日志文件
+    int file_fd_{-1};
+    std::atomic<LogLevel> level_{LogLevel::INFO};
+    std::atomic<size_t> dropped_{0};
+
+    // 仅由写线程访问的时间戳缓存
+    std::time_t cached_second_{-1};
+    std::array<char, 32> cached_time_{};
+    size_t cached_length_{0};
+
+    std::thread writer_;
 };
 
 } // namespace utils
 } // namespace hsmm
 
-// 便捷宏定义
-#define LOG_DEBUG(msg) hsmm::utils::Logger::instance().debug(msg)
-#define LOG_INFO(msg) hsmm::utils::Logger::instance().info(msg)
-#define LOG_WARNING(msg) hsmm::utils::Logger::instance().warning(msg)
-#define LOG_ERROR(msg) hsmm::utils::Logger::instance().error(msg) 
\ No newline at end of file
+// 便捷宏定义：编译期级别过滤掉的调用不生成任何代码，运行期级别过滤掉的调用不会构造消息
+#define HSMM_LOG(level, msg)                                                            \
+    do {                                                                                \
+        if constexpr (static_cast<int>(level) >= HSMM_LOG_COMPILE_LEVEL) {              \
+            auto& hsmm_logger_ = hsmm::utils::Logger::instance();                       \
+            if (hsmm_logger_.enabled(level)) hsmm_logger_.log(level, msg);              \
+        }                                                                               \
+    } while (0)
+
+#define LOG_DEBUG(msg) HSMM_LOG(hsmm::utils::LogLevel::DEBUG, msg)
+#define LOG_INFO(msg) HSMM_LOG(hsmm::utils::LogLevel::INFO, msg)
+#define LOG_WARNING(msg) HSMM_LOG(hsmm::utils::LogLevel::WARNING, msg)
+#define LOG_ERROR(msg) HSMM_LOG(hsmm::utils::LogLevel::ERROR, msg)
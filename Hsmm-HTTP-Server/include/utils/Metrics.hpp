@@ -0,0 +1,221 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace hsmm {
+namespace utils {
+
+/**
+ * @brief 计数器
+ */
+enum class Counter : size_t {
+    connections_accepted,
+    requests,
+    bytes_received,
+    bytes_sent,
+    responses_1xx,
+    responses_2xx,
+    responses_3xx,
+    responses_4xx,
+    responses_5xx,
+    cache_hits,       // 响应缓存命中
+    cache_stale,      // 返回过期的缓存条目，同时在后台刷新
+    cache_misses,     // 未命中，调用处理函数
+    cache_coalesced,  // 未命中，等待同一个键正在进行的处理函数调用
+    cache_passes,     // 同一个键最近的响应不能缓存，不等待直接调用处理函数
+    connections_rejected,   // 超出客户端新建连接速率，accept后直接关闭
+    requests_rate_limited,  // 超出客户端请求速率，返回429
+    requests_shed,          // 服务器过载，返回503
+    handler_rejected,       // 阻塞处理函数线程池的队列已满，返回503
+    tls_handshakes,         // 完成的TLS握手
+    tls_resumed,            // 其中恢复了会话的握手
+    tls_handshake_errors,   // 因协议错误失败的TLS握手
+    tls_ktls,               // 发送方向交给内核（kTLS）的TLS连接
+    count
+};
+
+/**
+ * @brief 耗时直方图（纳秒）
+ */
+enum class Timer : size_t {
+    parse,    // 解析请求头
+    handler,  // 执行处理函数
+    write,    // 发送响应（从开始发送到最后一个字节写入socket）
+    handler_queue,  // 在阻塞处理函数线程池中排队
+    tls_handshake,  // TLS握手在OpenSSL中花费的时间（不含等待网络）
+    count
+};
+
+/**
+ * @brief 对数线性分桶的直方图（HDR风格）
+ *
+ * 每个2的幂区间再均分为16个子桶，相对误差不超过1/16。只由所属线程写入，
+ * 写入是一次计算下标和两次relaxed存储，不使用原子读-改-写指令。
+ */
+class LatencyHistogram {
+public:
+    static constexpr unsigned sub_bucket_bits = 4;
+    static constexpr std::uint64_t sub_bucket_count = 1u << sub_bucket_bits;
+    // 超过2^40纳秒（约18分钟）的值记入最后一个桶
+    static constexpr unsigned max_value_bits = 40;
+    static constexpr size_t bucket_count = (max_value_bits - sub_bucket_bits + 1) * sub_bucket_count;
+
+    /**
+     * @brief 计算值所在的桶
+     * @param value 记录的值
+     * @return 桶下标
+     */
+    static constexpr size_t bucket_of(std::uint64_t value) noexcept {
+        if (value < 2 * sub_bucket_count) {
+            return static_cast<size_t>(value);
+        }
+        const auto msb = static_cast<unsigned>(std::bit_width(value)) - 1;
+        if (msb >= max_value_bits) {
+            return bucket_count - 1;
+        }
+        const auto shift = msb - sub_bucket_bits;
+        return static_cast<size_t>((shift + 1) * sub_bucket_count + (value >> shift) - sub_bucket_count);
+    }
+
+    /**
+     * @brief 计算桶中值的上界
+     * @param bucket 桶下标
+     * @return 桶中可能出现的最大值
+     */
+    static constexpr std::uint64_t bucket_upper(size_t bucket) noexcept {
+        if (bucket < 2 * sub_bucket_count) {
+            return bucket;
+        }
+        const auto shift = bucket / sub_bucket_count - 1;
+        const auto sub = bucket % sub_bucket_count + sub_bucket_count;
+        return ((sub + 1) << shift) - 1;
+    }
+
+    /**
+     * @brief 记录一个值，只能由所属线程调用
+     * @param value 记录的值
+     */
+    void record(std::uint64_t value) noexcept {
+        auto& bucket = buckets_[bucket_of(value)];
+        bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        sum_.store(sum_.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief 把当前计数累加到快照中，可以由任意线程调用
+     * @param buckets 各桶计数
+     * @param sum 所有值之和
+     */
+    void merge_into(std::array<std::uint64_t, bucket_count>& buckets, std::uint64_t& sum) const noexcept {
+        for (size_t i = 0; i < bucket_count; ++i) {
+            buckets[i] += buckets_[i].load(std::memory_order_relaxed);
+        }
+        sum += sum_.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::array<std::atomic<std::uint64_t>, bucket_count> buckets_{};
+    std::atomic<std::uint64_t> sum_{0};
+};
+
+/**
+ * @brief 服务器运行指标
+ *
+ * 每个线程第一次记录时分配独立的分片，之后的记录只写本线程分片，没有锁也没有缓存行竞争；
+ * 导出时遍历所有分片汇总。线程退出后分片保留，计数不会丢失。
+ */
+class Metrics {
+public:
+    /**
+     * @brief 获取单例实例
+     * @return Metrics实例
+     */
+    static Metrics& instance();
+
+    /**
+     * @brief 增加计数器
+     * @param counter 计数器
+     * @param value 增量
+     */
+    static void add(Counter counter, std::uint64_t value = 1) noexcept {
+        auto& slot = shard().counters[static_cast<size_t>(counter)];
+        slot.store(slot.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief 记录一次耗时
+     * @param timer 直方图
+     * @param nanoseconds 耗时（纳秒）
+     */
+    static void record(Timer timer, std::uint64_t nanoseconds) noexcept {
+        shard().timers[static_cast<size_t>(timer)].record(nanoseconds);
+    }
+
+    /**
+     * @brief 按状态码类别记录一个响应
+     * @param status HTTP状态码
+     */
+    static void count_response(int status) noexcept {
+        if (status >= 100 && status < 600) {
+            add(static_cast<Counter>(static_cast<size_t>(Counter::responses_1xx) + static_cast<size_t>(status / 100 - 1)));
+        }
+    }
+
+    /**
+     * @brief 获取用于计算耗时的单调时钟读数
+     * @return 纳秒
+     */
+    static std::uint64_t now_ns() noexcept {
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    /**
+     * @brief 汇总所有线程的指标，以Prometheus文本格式追加到输出
+     * @param out 输出
+     */
+    void render(std::string& out) const;
+
+    /**
+     * @brief 以Prometheus文本格式追加一个瞬时值指标
+     * @param out 输出
+     * @param name 指标名
+     * @param help 说明
+     * @param value 当前值
+     */
+    static void render_gauge(std::string& out, std::string_view name, std::string_view help, double value);
+
+private:
+    struct alignas(64) Shard {
+        std::array<std::atomic<std::uint64_t>, static_cast<size_t>(Counter::count)> counters{};
+        std::array<LatencyHistogram, static_cast<size_t>(Timer::count)> timers;
+    };
+
+    Metrics() = default;
+
+    static Shard& shard() noexcept {
+        thread_local Shard* local = nullptr;
+        if (!local) [[unlikely]] {
+            local = instance().register_shard();
+        }
+        return *local;
+    }
+
+    Shard* register_shard();
+
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+} // namespace utils
+} // namespace hsmm
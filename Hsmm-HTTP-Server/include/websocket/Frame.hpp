@@ -0,0 +1,112 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace hsmm {
+namespace websocket {
+
+// 帧头最长为2字节 + 8字节扩展长度 + 4字节掩码（RFC 6455 5.2）
+inline constexpr std::size_t max_frame_header_size = 14;
+// 控制帧的负载不能超过125字节
+inline constexpr std::size_t max_control_payload = 125;
+
+/**
+ * @brief 帧类型
+ */
+enum class Opcode : std::uint8_t {
+    continuation = 0x0,
+    text = 0x1,
+    binary = 0x2,
+    close = 0x8,
+    ping = 0x9,
+    pong = 0xa
+};
+
+/**
+ * @brief 关闭状态码（RFC 6455 7.4.1）
+ */
+namespace close_code {
+    inline constexpr std::uint16_t normal = 1000;
+    inline constexpr std::uint16_t going_away = 1001;
+    inline constexpr std::uint16_t protocol_error = 1002;
+    inline constexpr std::uint16_t unsupported_data = 1003;
+    // 对端没有提供状态码，不能出现在Close帧中
+    inline constexpr std::uint16_t no_status = 1005;
+    // 连接没有经过关闭握手就断开，不能出现在Close帧中
+    inline constexpr std::uint16_t abnormal = 1006;
+    inline constexpr std::uint16_t invalid_payload = 1007;
+    inline constexpr std::uint16_t policy_violation = 1008;
+    inline constexpr std::uint16_t message_too_big = 1009;
+    inline constexpr std::uint16_t internal_error = 1011;
+}
+
+/**
+ * @brief 帧头
+ */
+struct FrameHeader {
+    bool fin;
+    // RSV1-3，没有协商扩展时必须为0
+    std::uint8_t reserved;
+    Opcode opcode;
+    bool masked;
+    std::uint64_t length;
+    std::array<std::uint8_t, 4> mask;
+    // 帧头的字节数
+    std::size_t size;
+};
+
+/**
+ * @brief 判断是否为控制帧
+ */
+inline constexpr bool is_control(Opcode opcode) noexcept {
+    return (static_cast<std::uint8_t>(opcode) & 0x8) != 0;
+}
+
+/**
+ * @brief 解析帧头
+ * @param data 从帧头开始的数据
+ * @param header 解析结果
+ * @return 帧头是否完整
+ */
+bool parse_frame_header(std::span<const char> data, FrameHeader& header) noexcept;
+
+/**
+ * @brief 写入服务器发送的帧头（不带掩码）
+ * @param out 输出
+ * @param opcode 帧类型
+ * @param fin 是否为消息的最后一帧
+ * @param length 负载长度
+ */
+void write_frame_header(std::string& out, Opcode opcode, bool fin, std::uint64_t length);
+
+/**
+ * @brief 原地去除负载的掩码
+ *
+ * 按SSE2/AVX2向量宽度（没有时按64位字）处理，负载可以分多次处理，offset为本段在负载中的偏移
+ * @param data 负载数据
+ * @param mask 帧头中的掩码
+ * @param offset data在整个负载中的偏移
+ */
+void unmask(std::span<char> data, const std::array<std::uint8_t, 4>& mask, std::uint64_t offset) noexcept;
+
+/**
+ * @brief 检查文本消息是否为合法的UTF-8
+ * @param data 消息内容
+ * @return 是否合法
+ */
+bool valid_utf8(std::string_view data) noexcept;
+
+/**
+ * @brief 计算握手响应的Sec-WebSocket-Accept
+ * @param key 请求中的Sec-WebSocket-Key
+ * @return base64(SHA-1(key + GUID))
+ */
+std::string accept_key(std::string_view key);
+
+} // namespace websocket
+} // namespace hsmm
@@ -0,0 +1,149 @@
+#pragma once
+
+#include "http/HttpParser.hpp"
+#include "server/ServerOptions.hpp"
+#include "websocket/Frame.hpp"
+#include "websocket/WebSocket.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace hsmm {
+namespace websocket {
+
+/**
+ * @brief 检查WebSocket握手请求（RFC 6455 4.2）
+ * @param request WebSocket路由收到的请求
+ * @param response 握手失败时填写错误响应（不是升级请求或版本不支持时426，其他错误400）
+ * @return 握手成功时返回101响应的完整数据
+ */
+std::optional<std::string> handshake(const http::HttpRequest& request, http::HttpResponse& response);
+
+/**
+ * @brief 单个WebSocket连接的协议处理
+ *
+ * 和http2::Session一样只处理协议，不做IO：连接把收到的数据交给receive()，
+ * 再用take_output()取出要发送的帧聚集写出。receive()在连接的读缓冲区中原地去除掩码，
+ * 完整在一次读取中收到的单帧消息直接交给处理函数，只有分片或跨读取的消息才复制到消息缓冲区。
+ */
+class Session {
+public:
+    /**
+     * @brief 构造函数
+     * @param handler 路由的回调
+     * @param uri 握手请求的URI
+     * @param options 服务器配置的websocket部分
+     * @param wake 发送队列从空变为非空时通知连接，可以在任意线程调用
+     */
+    Session(std::shared_ptr<const Handler> handler, std::string uri, const WebSocketOptions& options, Socket::Wake wake);
+    ~Session();
+
+    Session(const Session&) = delete;
+    Session& operator=(const Session&) = delete;
+
+    /**
+     * @brief 握手完成，调用on_open
+     */
+    void open();
+
+    /**
+     * @brief 处理收到的数据
+     * @param data 收到的数据，负载在这里原地去除掩码，可以在任意位置切分
+     */
+    void receive(std::span<char> data);
+
+    /**
+     * @brief 取出待发送的帧
+     * @param out 追加到这里
+     * @param max_frames 最多取出的帧数
+     * @return 取出的帧数
+     */
+    size_t take_output(std::vector<SharedFrame>& out, size_t max_frames) { return socket_->take(out, max_frames); }
+
+    /**
+     * @brief 发送ping，用于检测空闲连接
+     */
+    void ping();
+
+    /**
+     * @brief 服务器关闭时发送Close帧（1001）
+     */
+    void shutdown();
+
+    /**
+     * @brief 关闭握手已经完成或者发生了协议错误，发送完排队的帧后应关闭连接
+     */
+    bool done() const noexcept { return done_; }
+
+    /**
+     * @brief 已经发送Close帧，正在等待对端的Close帧
+     */
+    bool closing() const { return socket_->close_sent(); }
+
+    /**
+     * @brief 客户端读取太慢，应立即断开连接
+     */
+    bool overflowed() const { return socket_->overflowed(); }
+
+    /**
+     * @brief 连接结束，调用on_close，只有第一次调用有效
+     */
+    void finish() noexcept;
+
+private:
+    /**
+     * @brief 收到帧头后检查帧是否合法
+     */
+    bool begin_frame();
+
+    /**
+     * @brief 一个帧的负载接收完毕
+     * @param direct 整个消息都在本次读取中时为负载本身，否则为空，消息在message_中
+     */
+    void end_frame(std::optional<std::string_view> direct);
+
+    /**
+     * @brief 处理控制帧
+     */
+    void handle_control();
+
+    /**
+     * @brief 协议错误：发送Close帧，不再处理之后收到的数据
+     * @param code 关闭状态码
+     */
+    void fail(std::uint16_t code);
+
+    /**
+     * @brief 发送控制帧
+     */
+    void send_control(Opcode opcode, std::string_view payload);
+
+    const std::shared_ptr<const Handler> handler_;
+    const WebSocketOptions& options_;
+    std::shared_ptr<Socket> socket_;
+
+    // 跨读取的不完整帧头
+    std::string header_buffer_;
+    // 当前帧
+    FrameHeader frame_{};
+    bool in_frame_{false};
+    std::uint64_t frame_offset_{0};
+
+    // 分片或跨读取的数据消息
+    bool in_message_{false};
+    bool message_binary_{false};
+    std::string message_;
+    // 当前控制帧的负载
+    std::string control_;
+
+    bool done_{false};
+    bool finished_{false};
+    std::uint16_t close_code_{close_code::abnormal};
+};
+
+} // namespace websocket
+} // namespace hsmm
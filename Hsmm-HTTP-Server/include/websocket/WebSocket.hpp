@@ -0,0 +1,203 @@
+#pragma once
+
+#include "websocket/Frame.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace hsmm {
+namespace websocket {
+
+/**
+ * @brief 序列化好的帧，不可修改，可以同时排在任意多个连接的发送队列中
+ */
+using SharedFrame = std::shared_ptr<const std::string>;
+
+/**
+ * @brief 把一条消息序列化为单个帧
+ * @param payload 消息内容
+ * @param binary 是否为二进制消息，否则为文本消息（必须是UTF-8）
+ * @return 序列化好的帧
+ */
+SharedFrame make_frame(std::string_view payload, bool binary = false);
+
+/**
+ * @brief 一个WebSocket连接的发送端，应用通过它发送消息
+ *
+ * 可以在任意线程使用，并且可以在连接关闭后继续持有（此时发送失败）。
+ * 发送只是把帧的共享指针放入队列，由连接在自己的strand上聚集写出，不复制帧的内容。
+ * 队列中积压的字节数超过WebSocketOptions::max_queued_bytes时认为客户端读取太慢，直接断开连接。
+ */
+class Socket {
+public:
+    /**
+     * @brief 队列从空变为非空时通知连接，可以在任意线程调用，实现中只能投递而不能直接写
+     */
+    using Wake = std::function<void()>;
+
+    /**
+     * @brief 构造函数，由Session创建
+     * @param uri 握手请求的URI
+     * @param max_queued_bytes 发送队列的字节数上限
+     * @param wake 通知连接的函数
+     */
+    Socket(std::string uri, size_t max_queued_bytes, Wake wake);
+
+    Socket(const Socket&) = delete;
+    Socket& operator=(const Socket&) = delete;
+
+    /**
+     * @brief 获取握手请求的URI，例如用于选择订阅的频道
+     */
+    const std::string& uri() const noexcept { return uri_; }
+
+    /**
+     * @brief 发送一条消息
+     * @param payload 消息内容，会被复制
+     * @param binary 是否为二进制消息
+     * @return 是否已加入发送队列
+     */
+    bool send(std::string_view payload, bool binary = false) { return send(make_frame(payload, binary)); }
+
+    /**
+     * @brief 发送序列化好的帧，只增加引用计数
+     * @param frame make_frame()的结果
+     * @return 是否已加入发送队列，连接已关闭或客户端太慢时返回false
+     */
+    bool send(SharedFrame frame);
+
+    /**
+     * @brief 开始关闭握手：发送Close帧，之后不能再发送消息
+     * @param code 关闭状态码
+     * @param reason 关闭原因，超过123字节的部分被截断
+     */
+    void close(std::uint16_t code = close_code::normal, std::string_view reason = {});
+
+    /**
+     * @brief 是否还能发送消息
+     */
+    bool is_open() const;
+
+private:
+    friend class Session;
+
+    /**
+     * @brief 把帧加入队列，需要时通知连接
+     * @param frame 帧
+     * @param last 是否为Close帧，之后不再接受新的帧
+     */
+    bool enqueue(SharedFrame frame, bool last);
+
+    /**
+     * @brief 取出待发送的帧
+     * @param out 追加到这里
+     * @param max_frames 最多取出的帧数
+     * @return 取出的帧数，为0时下一次enqueue()会重新通知连接
+     */
+    size_t take(std::vector<SharedFrame>& out, size_t max_frames);
+
+    /**
+     * @brief 连接关闭，丢弃队列并拒绝之后的发送
+     */
+    void detach() noexcept;
+
+    /**
+     * @brief 是否因为客户端太慢而需要断开
+     */
+    bool overflowed() const;
+
+    /**
+     * @brief 是否已经发送（排队）了Close帧
+     */
+    bool close_sent() const;
+
+    const std::string uri_;
+    const size_t max_queued_bytes_;
+
+    mutable std::mutex mutex_;
+    Wake wake_;
+    std::deque<SharedFrame> queue_;
+    size_t queued_bytes_{0};
+    // 已经通知连接，或者连接正在写出，之后的enqueue()不需要再通知
+    bool wake_pending_{false};
+    bool open_{true};
+    bool close_sent_{false};
+    bool overflowed_{false};
+};
+
+/**
+ * @brief WebSocket路由的回调，都在连接的strand上调用
+ */
+struct Handler {
+    // 握手完成
+    std::function<void(const std::shared_ptr<Socket>&)> on_open;
+    // 收到一条完整的消息（分片已合并），message只在调用期间有效
+    std::function<void(const std::shared_ptr<Socket>&, std::string_view message, bool binary)> on_message;
+    // 连接关闭，code为对端Close帧中的状态码，没有完成关闭握手时为close_code::abnormal
+    std::function<void(const std::shared_ptr<Socket>&, std::uint16_t code)> on_close;
+};
+
+/**
+ * @brief 广播频道：把同一条消息发送给所有订阅者
+ *
+ * 消息只序列化一次，每个订阅者的队列中只是同一个帧的共享指针。订阅者按指针地址分到多个分片，
+ * 发布时逐个分片加锁，订阅和退订只锁一个分片；已经关闭的订阅者在发布时顺便移除。
+ */
+class Channel {
+public:
+    /**
+     * @brief 订阅
+     * @param socket 订阅者
+     */
+    void subscribe(std::shared_ptr<Socket> socket);
+
+    /**
+     * @brief 退订
+     * @param socket 订阅者
+     */
+    void unsubscribe(const Socket& socket);
+
+    /**
+     * @brief 发布一条消息
+     * @param payload 消息内容
+     * @param binary 是否为二进制消息
+     * @return 加入了发送队列的订阅者数
+     */
+    size_t publish(std::string_view payload, bool binary = false) { return publish(make_frame(payload, binary)); }
+
+    /**
+     * @brief 发布序列化好的帧
+     * @param frame make_frame()的结果
+     * @return 加入了发送队列的订阅者数
+     */
+    size_t publish(const SharedFrame& frame);
+
+    /**
+     * @brief 订阅者数
+     */
+    size_t size() const;
+
+private:
+    static constexpr size_t shard_count = 16;
+
+    struct alignas(64) Shard {
+        mutable std::mutex mutex;
+        std::vector<std::shared_ptr<Socket>> sockets;
+    };
+
+    static size_t shard_of(const Socket& socket) noexcept {
+        return (reinterpret_cast<std::uintptr_t>(&socket) >> 6) % shard_count;
+    }
+
+    std::array<Shard, shard_count> shards_;
+};
+
+} // namespace websocket
+} // namespace hsmm
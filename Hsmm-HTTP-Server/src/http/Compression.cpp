@@ -0,0 +1,273 @@
+#include "http/Compression.hpp"
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <zlib.h>
+#ifdef HSMM_HAS_BROTLI
+#include <brotli/encode.h>
+#endif
+
+namespace hsmm {
+namespace http {
+
+namespace {
+#ifdef HSMM_HAS_BROTLI
+    constexpr std::array<ContentEncoding, 3> available_encodings{
+        ContentEncoding::br, ContentEncoding::gzip, ContentEncoding::deflate
+    };
+#else
+    constexpr std::array<ContentEncoding, 2> available_encodings{
+        ContentEncoding::gzip, ContentEncoding::deflate
+    };
+#endif
+
+    char ascii_lower(char c) noexcept {
+        return c >= 'A' && c <= 'Z' ? static_cast<char>(c + ('a' - 'A')) : c;
+    }
+
+    bool iequals(std::string_view a, std::string_view b) noexcept {
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+            return ascii_lower(x) == ascii_lower(y);
+        });
+    }
+
+    bool istarts_with(std::string_view str, std::string_view prefix) noexcept {
+        return str.size() >= prefix.size() && iequals(str.substr(0, prefix.size()), prefix);
+    }
+
+    bool iends_with(std::string_view str, std::string_view suffix) noexcept {
+        return str.size() >= suffix.size() && iequals(str.substr(str.size() - suffix.size()), suffix);
+    }
+
+    std::string_view trim(std::string_view str) noexcept {
+        while (!str.empty() && (str.front() == ' ' || str.front() == '\t')) str.remove_prefix(1);
+        while (!str.empty() && (str.back() == ' ' || str.back() == '\t')) str.remove_suffix(1);
+        return str;
+    }
+
+    // 解析q值，以千分之一为单位返回，格式错误时按1处理
+    int parse_qvalue(std::string_view value) noexcept {
+        if (value.empty() || (value[0] != '0' && value[0] != '1')) return 1000;
+        int result = (value[0] - '0') * 1000;
+        if (value.size() > 1 && value[1] == '.') {
+            int scale = 100;
+            for (size_t i = 2; i < value.size() && i < 5 && value[i] >= '0' && value[i] <= '9'; ++i) {
+                result += (value[i] - '0') * scale;
+                scale /= 10;
+            }
+        }
+        return std::min(result, 1000);
+    }
+
+    /**
+     * @brief 每个线程复用的zlib压缩流
+     *
+     * deflateInit2要分配约256KB的内部状态，复用时只需deflateReset
+     */
+    class DeflateStream {
+    public:
+        DeflateStream() = default;
+        DeflateStream(const DeflateStream&) = delete;
+        DeflateStream& operator=(const DeflateStream&) = delete;
+
+        ~DeflateStream() {
+            if (initialized_) {
+                deflateEnd(&stream_);
+            }
+        }
+
+        z_stream* get(int window_bits, int level) {
+            if (initialized_ && level == level_) {
+                return deflateReset(&stream_) == Z_OK ? &stream_ : nullptr;
+            }
+            if (initialized_) {
+                deflateEnd(&stream_);
+                initialized_ = false;
+            }
+            stream_ = z_stream{};
+            if (deflateInit2(&stream_, level, Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+                return nullptr;
+            }
+            initialized_ = true;
+            level_ = level;
+            return &stream_;
+        }
+
+    private:
+        z_stream stream_{};
+        bool initialized_{false};
+        int level_{0};
+    };
+
+    bool compress_zlib(std::string_view input, std::string& output, int window_bits, int level) {
+        thread_local std::array<DeflateStream, 2> streams;
+        auto* stream = streams[window_bits > 15 ? 1 : 0].get(window_bits, std::clamp(level, 1, 9));
+        if (!stream) {
+            return false;
+        }
+
+        output.resize(deflateBound(stream, static_cast<uLong>(input.size())));
+        stream->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+        stream->avail_in = static_cast<uInt>(input.size());
+        stream->next_out = reinterpret_cast<Bytef*>(output.data());
+        stream->avail_out = static_cast<uInt>(output.size());
+        if (deflate(stream, Z_FINISH) != Z_STREAM_END) {
+            return false;
+        }
+        output.resize(stream->total_out);
+        return true;
+    }
+
+    // 压缩后的响应体，同时保留原响应体的持有者（响应头可能引用其中的数据）
+    struct CompressedBody {
+        std::string data;
+        std::shared_ptr<const void> previous;
+    };
+}
+
+std::string_view encoding_token(ContentEncoding encoding) noexcept {
+    switch (encoding) {
+        case ContentEncoding::gzip: return "gzip";
+        case ContentEncoding::deflate: return "deflate";
+        case ContentEncoding::br: return "br";
+        case ContentEncoding::identity: break;
+    }
+    return "identity";
+}
+
+std::span<const ContentEncoding> supported_encodings() noexcept {
+    return available_encodings;
+}
+
+ContentEncoding negotiate_encoding(std::string_view accept_encoding,
+                                   std::span<const ContentEncoding> available) noexcept {
+    // 各编码的q值，-1表示没有显式列出
+    std::array<int, 4> qvalues{-1, -1, -1, -1};
+    int wildcard = -1;
+
+    size_t start = 0;
+    while (start < accept_encoding.size()) {
+        const auto end = std::min(accept_encoding.find(',', start), accept_encoding.size());
+        auto item = accept_encoding.substr(start, end - start);
+        start = end + 1;
+
+        int q = 1000;
+        const auto semicolon = item.find(';');
+        if (semicolon != std::string_view::npos) {
+            auto params = trim(item.substr(semicolon + 1));
+            if (istarts_with(params, "q=")) {
+                q = parse_qvalue(trim(params.substr(2)));
+            }
+            item = item.substr(0, semicolon);
+        }
+        item = trim(item);
+
+        if (item == "*") {
+            wildcard = q;
+        } else if (iequals(item, "gzip") || iequals(item, "x-gzip")) {
+            qvalues[static_cast<size_t>(ContentEncoding::gzip)] = q;
+        } else if (iequals(item, "deflate")) {
+            qvalues[static_cast<size_t>(ContentEncoding::deflate)] = q;
+        } else if (iequals(item, "br")) {
+            qvalues[static_cast<size_t>(ContentEncoding::br)] = q;
+        }
+    }
+
+    auto best = ContentEncoding::identity;
+    int best_q = 0;
+    for (const auto encoding : available) {
+        auto q = qvalues[static_cast<size_t>(encoding)];
+        if (q < 0) q = wildcard;
+        if (q > best_q) {
+            best = encoding;
+            best_q = q;
+        }
+    }
+    return best;
+}
+
+bool is_compressible_type(std::string_view content_type) noexcept {
+    const auto type = trim(content_type.substr(0, content_type.find(';')));
+    if (istarts_with(type, "text/")) {
+        return true;
+    }
+    constexpr std::array<std::string_view, 6> types{
+        "application/json", "application/javascript", "application/x-javascript",
+        "application/xml", "application/wasm", "image/svg+xml"
+    };
+    for (const auto candidate : types) {
+        if (iequals(type, candidate)) return true;
+    }
+    return iends_with(type, "+json") || iends_with(type, "+xml");
+}
+
+bool compress(ContentEncoding encoding, std::string_view input, std::string& output, int level) {
+    switch (encoding) {
+        case ContentEncoding::gzip:
+            return compress_zlib(input, output, 15 + 16, level);
+        case ContentEncoding::deflate:
+            // HTTP的deflate编码是带zlib头的格式（RFC 9110）
+            return compress_zlib(input, output, 15, level);
+        case ContentEncoding::br: {
+#ifdef HSMM_HAS_BROTLI
+            size_t size = BrotliEncoderMaxCompressedSize(input.size());
+            if (size == 0) return false;
+            output.resize(size);
+            if (!BrotliEncoderCompress(std::clamp(level, BROTLI_MIN_QUALITY, BROTLI_MAX_QUALITY),
+                                       BROTLI_DEFAULT_WINDOW, BROTLI_MODE_GENERIC, input.size(),
+                                       reinterpret_cast<const std::uint8_t*>(input.data()), &size,
+                                       reinterpret_cast<std::uint8_t*>(output.data()))) {
+                return false;
+            }
+            output.resize(size);
+            return true;
+#else
+            return false;
+#endif
+        }
+        case ContentEncoding::identity:
+            break;
+    }
+    return false;
+}
+
+ContentEncoding negotiate_response_encoding(const HttpRequest& request, HttpResponse& response,
+                                            const CompressionOptions& options) {
+    if (!options.enabled || !response.prebuilt().empty() || response.file_body() || response.chunked_body() ||
+        response.body().size() < options.min_size) {
+        return ContentEncoding::identity;
+    }
+    const auto status = response.status_code();
+    if (status < 200 || status == 204 || status == 206 || status == 304) {
+        return ContentEncoding::identity;
+    }
+    const auto content_type = response.header("Content-Type");
+    if (!content_type || !is_compressible_type(*content_type) || response.header("Content-Encoding")) {
+        return ContentEncoding::identity;
+    }
+
+    response.add_header("Vary", "Accept-Encoding");
+    const auto accept = request.headers.get(Header::accept_encoding);
+    if (!accept) {
+        return ContentEncoding::identity;
+    }
+    return negotiate_encoding(*accept, supported_encodings());
+}
+
+bool compress_response(HttpResponse& response, ContentEncoding encoding, const CompressionOptions& options) {
+    const auto level = encoding == ContentEncoding::br ? options.brotli_quality : options.gzip_level;
+    auto compressed = std::make_shared<CompressedBody>();
+    if (!compress(encoding, response.body(), compressed->data, level) ||
+        compressed->data.size() >= response.body().size()) {
+        return false;
+    }
+
+    compressed->previous = response.owner();
+    const std::string_view body(compressed->data);
+    response.set_body(body, std::move(compressed));
+    response.add_header("Content-Encoding", encoding_token(encoding));
+    return true;
+}
+
+} // namespace http
+} // namespace hsmm
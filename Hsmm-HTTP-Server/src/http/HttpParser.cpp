@@ -1,8 +1,8 @@
 #include "http/HttpParser.hpp"
 #include "utils/Logger.hpp"
 #include <algorithm>
+#include <charconv>
 #include <string_view>
-#include <vector>
 
 namespace hsmm {
 namespace http {
@@ -17,27 +17,77 @@ namespace {
         return str.substr(start, end - start + 1);
     }
 
-    // 辅助函数：分割字符串
-    std::vector<std::string_view> split(std::string_view str, char delim) {
-        std::vector<std::string_view> result;
-        size_t start = 0;
-        size_t end = str.find(delim);
+    // 辅助函数：取出下一个以分隔符结尾的片段，并将输入前移到分隔符之后
+    std::string_view next_token(std::string_view& str, char delim) {
+        const auto pos = str.find(delim);
+        auto token = str.substr(0, pos);
+        str = pos == std::string_view::npos ? std::string_view{} : str.substr(pos + 1);
+        return token;
+    }
+
+    // 辅助函数：取出下一个以CRLF结尾的行，并将输入前移到CRLF之后
+    std::string_view next_line(std::string_view& str) {
+        const auto pos = str.find("\r\n");
+        auto line = str.substr(0, pos);
+        str = pos == std::string_view::npos ? std::string_view{} : str.substr(pos + 2);
+        return line;
+    }
+
+    // 辅助函数：不区分大小写比较ASCII字符串
+    bool iequals(std::string_view a, std::string_view b) noexcept {
+        return a.size() == b.size() &&
+               std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+                   return (x | 0x20) == (y | 0x20);
+               });
+    }
+
+    // 辅助函数：按HTTP/1.1格式写出响应，out可以是std::string或std::pmr::string
+    // content_length为std::nullopt时使用分块传输编码
+    template<typename String>
+    void write_response(String& out, int status_code, std::string_view status_message,
+                        std::span<const std::pair<std::string_view, std::string_view>> headers,
+                        std::string_view body, std::optional<std::uint64_t> content_length) {
+        char number[24];
 
-        while (end != std::string_view::npos) {
-            result.push_back(str.substr(start, end - start));
-            start = end + 1;
-            end = str.find(delim, start);
+        std::size_t header_bytes = 0;
+        for (const auto& [name, value] : headers) {
+            header_bytes += name.size() + value.size() + 4;
         }
+        out.reserve(out.size() + 64 + status_message.size() + header_bytes + body.size());
 
-        if (start < str.length()) {
-            result.push_back(str.substr(start));
+        // 状态行
+        out.append("HTTP/1.1 ");
+        out.append(number, std::to_chars(number, number + sizeof(number), status_code).ptr);
+        out.push_back(' ');
+        out.append(status_message);
+        out.append("\r\n");
+
+        // 添加Content-Length头，长度未知时分块发送
+        if (content_length) {
+            out.append("Content-Length: ");
+            out.append(number, std::to_chars(number, number + sizeof(number), *content_length).ptr);
+            out.append("\r\n");
+        } else {
+            out.append("Transfer-Encoding: chunked\r\n");
         }
 
-        return result;
+        // 其他头部字段
+        for (const auto& [name, value] : headers) {
+            out.append(name);
+            out.append(": ");
+            out.append(value);
+            out.append("\r\n");
+        }
+
+        // 空行分隔头部和主体
+        out.append("\r\n");
+
+        // 响应主体
+        out.append(body);
     }
 }
 
-std::optional<HttpRequest> HttpParser::parse(std::span<const char> data) {
+std::optional<HttpRequest> HttpParser::parse(std::span<const char> data, std::pmr::memory_resource* resource) {
     // 将数据转换为string_view
     std::string_view content(data.data(), data.size());
     
@@ -52,98 +102,272 @@ std::optional<HttpRequest> HttpParser::parse(std::span<const char> data) {
     auto headers = content.substr(0, header_end);
     auto body = content.substr(header_end + 4);
 
-    // 按行分割请求头
-    auto lines = split(headers, '\n');
-    if (lines.empty()) {
+    // 逐行解析请求头，不为行列表分配内存
+    if (headers.empty()) {
         LOG_WARNING("空的HTTP请求");
         return std::nullopt;
     }
 
-    HttpRequest request;
+    HttpRequest request{HttpRequest::allocator_type(resource)};
+
+    // 每行必须以CRLF结尾：单独的CR或LF在前端代理和本服务器上可能被切成不同的行，
+    // 可被用于请求走私，直接拒绝。以下逐行解析时检查行内是否还有CR或LF
 
     // 解析请求行
-    if (!parse_request_line(trim(lines[0]), request)) {
+    const auto request_line = next_line(headers);
+    if (request_line.find_first_of("\r\n") != std::string_view::npos ||
+        !parse_request_line(request_line, request)) {
         LOG_WARNING("解析请求行失败");
         return std::nullopt;
     }
 
     // 解析请求头
-    for (size_t i = 1; i < lines.size(); ++i) {
-        if (!parse_header(trim(lines[i]), request)) {
-            LOG_WARNING("解析请求头失败: " + std::string(lines[i]));
+    while (!headers.empty()) {
+        const auto line = next_line(headers);
+        if (line.find_first_of("\r\n") != std::string_view::npos || !parse_header(line, request)) {
+            LOG_WARNING("解析请求头失败: " + std::string(line));
             return std::nullopt;
         }
     }
 
-    // 设置请求体
-    request.body = body;
+    // 同时出现两种长度信息的请求可能被用于请求走私，直接拒绝
+    if (request.chunked && request.content_length) {
+        LOG_WARNING("请求同时包含Content-Length和Transfer-Encoding");
+        return std::nullopt;
+    }
+
+    // 设置请求体：只取属于本请求的部分，之后的数据属于下一个请求
+    if (request.content_length) {
+        request.body = body.substr(0, static_cast<size_t>(std::min<std::uint64_t>(*request.content_length, body.size())));
+    }
 
     return request;
 }
 
+std::size_t HttpParser::header_size(std::span<const char> data) noexcept {
+    const std::string_view content(data.data(), data.size());
+    const auto header_end = content.find("\r\n\r\n");
+    return header_end == std::string_view::npos ? 0 : header_end + 4;
+}
+
 bool HttpParser::parse_request_line(std::string_view line, HttpRequest& request) {
-    auto parts = split(line, ' ');
-    if (parts.size() != 3) {
+    const auto method = next_token(line, ' ');
+    const auto uri = next_token(line, ' ');
+    const auto version = line;
+    if (method.empty() || uri.empty() || version.empty() ||
+        version.find(' ') != std::string_view::npos) {
         return false;
     }
 
-    request.method = parts[0];
-    request.uri = parts[1];
-    request.version = parts[2];
+    request.method = method;
+    request.uri = uri;
+    request.version = version;
 
     return true;
 }
 
 bool HttpParser::parse_header(std::string_view line, HttpRequest& request) {
-    if (line.empty()) return true;
+    // 拒绝以空白开头的续行（obs-fold）
+    if (line.empty() || line.front() == ' ' || line.front() == '\t') {
+        return false;
+    }
 
+    // 字段名与冒号之间不允许有空白，否则前后端可能得到不同的字段名
     const auto separator = line.find(':');
-    if (separator == std::string_view::npos) {
+    if (separator == std::string_view::npos || separator == 0 ||
+        line.substr(0, separator).find_first_of(" \t") != std::string_view::npos) {
         return false;
     }
 
-    auto name = trim(line.substr(0, separator));
+    auto name = line.substr(0, separator);
     auto value = trim(line.substr(separator + 1));
 
-    request.headers.emplace(name, value);
+    // 常用请求头在这里解析为槽位编号，决定请求体边界的头部同时解析出值
+    const auto header = request.headers.add(name, value);
+    if (header == Header::content_length) {
+        std::uint64_t length = 0;
+        const auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), length);
+        if (ec != std::errc() || ptr != value.data() + value.size() || value.empty() ||
+            (request.content_length && *request.content_length != length)) {
+            return false;
+        }
+        request.content_length = length;
+    } else if (header == Header::transfer_encoding) {
+        // 只支持chunked作为最后一层编码
+        const auto comma = value.find_last_of(',');
+        const auto last = trim(comma == std::string_view::npos ? value : value.substr(comma + 1));
+        if (!iequals(last, "chunked")) {
+            return false;
+        }
+        request.chunked = true;
+    } else if (header == Header::expect) {
+        request.expect_continue = iequals(value, "100-continue");
+    } else if (header == Header::connection) {
+        // 逗号分隔的连接选项，重复的Connection头部也逐个检查
+        for (auto options = value; !options.empty();) {
+            const auto option = trim(next_token(options, ','));
+            if (iequals(option, "close")) {
+                request.connection_close = true;
+            } else if (iequals(option, "keep-alive")) {
+                request.connection_keep_alive = true;
+            }
+        }
+    }
     return true;
 }
 
+bool ChunkedDecoder::step(char c) noexcept {
+    switch (state_) {
+    case State::size: {
+        int digit = -1;
+        if (c >= '0' && c <= '9') digit = c - '0';
+        else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+
+        if (digit >= 0) {
+            // 超过16位十六进制数的分块大小视为错误
+            if (++digits_ > 16) return false;
+            remaining_ = remaining_ * 16 + static_cast<std::uint64_t>(digit);
+            return true;
+        }
+        if (digits_ == 0) return false;
+        if (c == '\r') {
+            state_ = State::size_lf;
+        } else if (c == ';' || c == ' ' || c == '\t') {
+            state_ = State::extension;
+        } else {
+            return false;
+        }
+        return true;
+    }
+    case State::extension:
+        // 忽略分块扩展；单独的LF可能被其他实现当作行结束，不接受
+        if (c == '\n') return false;
+        if (c == '\r') state_ = State::size_lf;
+        return true;
+    case State::size_lf:
+        if (c != '\n') return false;
+        digits_ = 0;
+        state_ = remaining_ == 0 ? State::trailer_start : State::data;
+        return true;
+    case State::data_cr:
+        if (c != '\r') return false;
+        state_ = State::data_lf;
+        return true;
+    case State::data_lf:
+        if (c != '\n') return false;
+        state_ = State::size;
+        return true;
+    case State::trailer_start:
+        state_ = c == '\r' ? State::final_lf : State::trailer_line;
+        return true;
+    case State::trailer_line:
+        // 忽略trailer字段，同样不接受单独的LF
+        if (c == '\n') return false;
+        if (c == '\r') state_ = State::trailer_lf;
+        return true;
+    case State::trailer_lf:
+        if (c != '\n') return false;
+        state_ = State::trailer_start;
+        return true;
+    case State::final_lf:
+        if (c != '\n') return false;
+        state_ = State::done;
+        return true;
+    case State::data:
+    case State::done:
+        break;
+    }
+    return false;
+}
+
 void HttpResponse::set_status(int code, std::string_view message) {
     status_code_ = code;
     status_message_ = message;
 }
 
 void HttpResponse::add_header(std::string_view name, std::string_view value) {
-    headers_.emplace(name, value);
+    headers_.emplace_back(name, value);
+}
+
+std::optional<std::string_view> HttpResponse::header(std::string_view name) const noexcept {
+    for (const auto& [key, value] : headers_) {
+        if (key.size() == name.size() &&
+            std::equal(key.begin(), key.end(), name.begin(), [](char a, char b) {
+                return (a >= 'A' && a <= 'Z' ? a + 32 : a) == (b >= 'A' && b <= 'Z' ? b + 32 : b);
+            })) {
+            return value;
+        }
+    }
+    return std::nullopt;
 }
 
 void HttpResponse::set_body(std::string_view body) {
     body_ = body;
 }
 
+void HttpResponse::set_body(std::string_view body, std::shared_ptr<const void> owner) {
+    body_ = body;
+    owner_ = std::move(owner);
+}
+
+void HttpResponse::set_chunked_body(ChunkSource source) {
+    chunked_body_ = std::move(source);
+}
+
+void HttpResponse::set_prebuilt(std::string_view data, std::shared_ptr<const void> owner) {
+    prebuilt_ = data;
+    owner_ = std::move(owner);
+}
+
+void HttpResponse::set_file_body(int fd, std::uint64_t offset, std::uint64_t length, std::shared_ptr<const void> owner) {
+    file_body_ = FileBody{fd, offset, length};
+    owner_ = std::move(owner);
+}
+
+std::optional<std::uint64_t> HttpResponse::content_length() const noexcept {
+    if (chunked_body_) return std::nullopt;
+    return file_body_ ? file_body_->length : body_.size();
+}
+
 std::string HttpResponse::to_string() const {
-    std::stringstream ss;
-    
-    // 状态行
-    ss << "HTTP/1.1 " << status_code_ << " " << status_message_ << "\r\n";
-    
-    // 添加Content-Length头
-    ss << "Content-Length: " << body_.length() << "\r\n";
-    
-    // 其他头部字段
-    for (const auto& [name, value] : headers_) {
-        ss << name << ": " << value << "\r\n";
+    std::string out;
+    if (!prebuilt_.empty()) {
+        out.append(prebuilt_);
+        return out;
     }
-    
-    // 空行分隔头部和主体
-    ss << "\r\n";
-    
-    // 响应主体
-    ss << body_;
-    
-    return ss.str();
+    write_response(out, status_code_, status_message_, headers_, body_, content_length());
+    return out;
+}
+
+void HttpResponse::serialize(std::pmr::string& out) const {
+    if (!prebuilt_.empty()) {
+        out.append(prebuilt_);
+        return;
+    }
+    write_response(out, status_code_, status_message_, headers_, body_, content_length());
+}
+
+void HttpResponse::serialize_head(std::pmr::string& out) const {
+    write_response(out, status_code_, status_message_, headers_, {}, content_length());
+}
+
+std::string_view HttpResponse::serialize_prebuilt_head(std::pmr::string& out, std::string_view name,
+                                                       std::string_view value) const {
+    const auto header_size = HttpParser::header_size(prebuilt_);
+    if (header_size == 0) {
+        out.append(prebuilt_);
+        return {};
+    }
+    // 去掉头部结尾的空行，追加字段后重新结束头部
+    out.reserve(out.size() + header_size + name.size() + value.size() + 4);
+    out.append(prebuilt_.substr(0, header_size - 2));
+    out.append(name);
+    out.append(": ");
+    out.append(value);
+    out.append("\r\n\r\n");
+    return prebuilt_.substr(header_size);
 }
 
 } // namespace http
-} // namespace hsmm 
\ No newline at end of file
+} // namespace hsmm
@@ -0,0 +1,567 @@
+#include "http/ResponseCache.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Metrics.hpp"
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
+namespace hsmm {
+namespace http {
+
+namespace {
+    constexpr size_t shard_count = 16;
+    // 条目在键和响应数据之外的估计开销（链表节点、哈希表项、Stored本身）
+    constexpr size_t entry_overhead = 256;
+    // 每个分片最多记录的hit-for-pass键，超出时先清理过期的，仍然超出时丢弃任意一个
+    constexpr size_t max_passes = 1024;
+
+    bool iequals(std::string_view a, std::string_view b) noexcept {
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+            const auto lower = [](char c) { return c >= 'A' && c <= 'Z' ? static_cast<char>(c + ('a' - 'A')) : c; };
+            return lower(x) == lower(y);
+        });
+    }
+
+    std::string_view trim(std::string_view str) noexcept {
+        while (!str.empty() && (str.front() == ' ' || str.front() == '\t')) str.remove_prefix(1);
+        while (!str.empty() && (str.back() == ' ' || str.back() == '\t')) str.remove_suffix(1);
+        return str;
+    }
+
+    /**
+     * @brief 逐个处理逗号分隔的指令（Cache-Control、Vary），参数去掉引号
+     */
+    template<typename F>
+    void for_each_directive(std::string_view value, F&& f) {
+        while (!value.empty()) {
+            const auto comma = value.find(',');
+            const auto item = trim(value.substr(0, comma));
+            const auto eq = item.find('=');
+            const auto name = trim(item.substr(0, eq));
+            auto argument = eq == std::string_view::npos ? std::string_view{} : trim(item.substr(eq + 1));
+            if (argument.size() >= 2 && argument.front() == '"' && argument.back() == '"') {
+                argument = argument.substr(1, argument.size() - 2);
+            }
+            if (!name.empty()) f(name, argument);
+            if (comma == std::string_view::npos) break;
+            value.remove_prefix(comma + 1);
+        }
+    }
+
+    std::optional<std::chrono::seconds> parse_seconds(std::string_view value) noexcept {
+        std::uint32_t seconds = 0;
+        const auto* last = value.data() + value.size();
+        const auto [ptr, ec] = std::from_chars(value.data(), last, seconds);
+        if (ec == std::errc::result_out_of_range) return std::chrono::seconds(UINT32_MAX);
+        if (ec != std::errc{} || ptr != last) return std::nullopt;
+        return std::chrono::seconds(seconds);
+    }
+
+    /**
+     * @brief TinyLFU的频率估计（Count-Min Sketch）
+     *
+     * 每个键在4行计数器中各占一个，估计值取最小值。计数器饱和于15，
+     * 累计的增加次数达到计数器数的10倍时全部减半，使很久以前的访问逐渐失去作用。
+     */
+    class FrequencySketch {
+    public:
+        FrequencySketch() : counters_(width * depth, 0) {}
+
+        void increment(std::uint64_t hash) noexcept {
+            for (size_t row = 0; row < depth; ++row) {
+                auto& counter = counters_[row * width + index(hash, row)];
+                if (counter < 15) ++counter;
+            }
+            if (++additions_ >= width * 10) {
+                for (auto& counter : counters_) counter >>= 1;
+                additions_ /= 2;
+            }
+        }
+
+        unsigned estimate(std::uint64_t hash) const noexcept {
+            unsigned result = 15;
+            for (size_t row = 0; row < depth; ++row) {
+                result = std::min<unsigned>(result, counters_[row * width + index(hash, row)]);
+            }
+            return result;
+        }
+
+    private:
+        static constexpr size_t width_bits = 12;
+        static constexpr size_t width = size_t{1} << width_bits;
+        static constexpr size_t depth = 4;
+
+        static size_t index(std::uint64_t hash, size_t row) noexcept {
+            static constexpr std::array<std::uint64_t, depth> seeds{
+                0x9E3779B97F4A7C15ull, 0xC2B2AE3D27D4EB4Full, 0x165667B19E3779F9ull, 0xD6E8FEB86659FD93ull
+            };
+            return static_cast<size_t>((hash * seeds[row]) >> (64 - width_bits));
+        }
+
+        std::vector<std::uint8_t> counters_;
+        size_t additions_{0};
+    };
+}
+
+/**
+ * @brief 缓存条目：预先序列化的完整响应，发送期间作为响应数据的持有者
+ */
+struct ResponseCache::Stored {
+    int status{200};
+    std::string reason;
+    std::chrono::steady_clock::time_point expires;
+    std::chrono::steady_clock::time_point stale_until;
+    // 是否按Accept-Encoding选择变体
+    bool compressible{false};
+    // responses[0]是未压缩的响应；variant按ContentEncoding索引responses，压缩后没有变小的编码指向0
+    std::vector<std::pmr::string> responses;
+    std::array<std::uint8_t, 4> variant{};
+    // 占用的字节数，不包括键
+    size_t charge{0};
+};
+
+/**
+ * @brief 同一个键正在进行的一次处理函数调用，等待其结果的请求
+ */
+struct ResponseCache::Fill {
+    struct Waiter {
+        const HttpRequest* request;
+        HttpResponse* response;
+        Router::Completion done;
+    };
+    std::vector<Waiter> waiters;
+};
+
+struct ResponseCache::Shard {
+    struct Entry {
+        std::string key;
+        std::uint64_t hash;
+        std::shared_ptr<const Stored> stored;
+
+        size_t cost() const noexcept { return key.size() + stored->charge; }
+    };
+
+    std::mutex mutex;
+    // 最近使用的条目在前
+    std::list<Entry> lru;
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> entries;
+    std::unordered_map<std::string, std::shared_ptr<Fill>> fills;
+    // 最近的响应不能缓存的键及记录的截止时间，期间的请求不合并等待
+    std::unordered_map<std::string, std::chrono::steady_clock::time_point> passes;
+    FrequencySketch sketch;
+    size_t bytes{0};
+    size_t capacity{0};
+
+    void erase(std::list<Entry>::iterator entry) {
+        bytes -= entry->cost();
+        entries.erase(entry->key);
+        lru.erase(entry);
+    }
+};
+
+ResponseCache::ResponseCache(CacheOptions options, CompressionOptions compression, Post post)
+    : options_(std::move(options))
+    , compression_(std::move(compression))
+    , post_(std::move(post)) {
+    shards_.reserve(shard_count);
+    for (size_t i = 0; i < shard_count; ++i) {
+        auto shard = std::make_unique<Shard>();
+        shard->capacity = options_.max_bytes / shard_count;
+        shards_.push_back(std::move(shard));
+    }
+}
+
+ResponseCache::~ResponseCache() = default;
+
+Router::AsyncHandler ResponseCache::wrap(Router::Handler handler) {
+    return wrap(Router::AsyncHandler(
+        [handler = std::move(handler)](const HttpRequest& request, HttpResponse& response, Router::Completion done) {
+            handler(request, response);
+            done();
+        }));
+}
+
+Router::AsyncHandler ResponseCache::wrap(Router::AsyncHandler handler) {
+    auto shared = std::make_shared<const Router::AsyncHandler>(std::move(handler));
+    return [self = shared_from_this(), shared](const HttpRequest& request, HttpResponse& response, Router::Completion done) {
+        self->handle(shared, request, response, std::move(done));
+    };
+}
+
+size_t ResponseCache::size_bytes() const {
+    size_t total = 0;
+    for (const auto& shard : shards_) {
+        std::lock_guard lock(shard->mutex);
+        total += shard->bytes;
+    }
+    return total;
+}
+
+ResponseCache::Shard& ResponseCache::shard_for(std::uint64_t hash) noexcept {
+    return *shards_[hash % shard_count];
+}
+
+void ResponseCache::handle(const SharedHandler& handler, const HttpRequest& request, HttpResponse& response,
+                           Router::Completion done) {
+    std::string key;
+    if (!make_key(request, key)) {
+        (*handler)(request, response, std::move(done));
+        return;
+    }
+
+    const std::uint64_t hash = std::hash<std::string_view>{}(key);
+    auto& shard = shard_for(hash);
+    const auto now = std::chrono::steady_clock::now();
+    std::shared_ptr<const Stored> stored;
+    bool refresh = false;
+    bool pass = false;
+    {
+        std::lock_guard lock(shard.mutex);
+        shard.sketch.increment(hash);
+
+        if (const auto it = shard.entries.find(key); it != shard.entries.end()) {
+            const auto entry = it->second;
+            if (now < entry->stored->stale_until) {
+                shard.lru.splice(shard.lru.begin(), shard.lru, entry);
+                stored = entry->stored;
+                // 过期的条目只由第一个请求触发刷新，刷新期间继续返回旧响应
+                if (now >= stored->expires && !shard.fills.contains(key)) {
+                    shard.fills.emplace(key, std::make_shared<Fill>());
+                    refresh = true;
+                }
+            } else {
+                shard.erase(entry);
+            }
+        }
+
+        if (!stored) {
+            if (const auto it = shard.passes.find(key); it != shard.passes.end()) {
+                pass = now < it->second;
+                if (!pass) {
+                    shard.passes.erase(it);
+                }
+            }
+        }
+
+        if (!stored && !pass) {
+            if (const auto it = shard.fills.find(key); it != shard.fills.end()) {
+                // 同一个键已经有请求在调用处理函数，等待其结果
+                it->second->waiters.push_back({&request, &response, std::move(done)});
+                utils::Metrics::add(utils::Counter::cache_coalesced);
+                return;
+            }
+            shard.fills.emplace(key, std::make_shared<Fill>());
+        }
+    }
+
+    if (stored) {
+        utils::Metrics::add(now < stored->expires ? utils::Counter::cache_hits : utils::Counter::cache_stale);
+        if (refresh) {
+            // 先复制请求，调用done之后请求不再有效
+            revalidate(handler, shard, std::move(key), hash, request);
+        }
+        apply(stored, request, response);
+        done();
+        return;
+    }
+
+    if (pass) {
+        // 最近的响应不能共享，等待进行中的调用也只会各自重新调用处理函数
+        utils::Metrics::add(utils::Counter::cache_passes);
+        (*handler)(request, response, std::move(done));
+        return;
+    }
+
+    utils::Metrics::add(utils::Counter::cache_misses);
+    try {
+        (*handler)(request, response,
+            [self = shared_from_this(), handler, &shard, key, hash, &request, &response, done = std::move(done)] {
+                auto stored = self->make_stored(response);
+                if (stored) {
+                    apply(stored, request, response);
+                }
+                done();
+                self->complete(handler, shard, key, hash, std::move(stored));
+            });
+    }
+    catch (...) {
+        // 由调用者生成500响应，等待的请求各自调用处理函数
+        complete(handler, shard, key, hash, nullptr);
+        throw;
+    }
+}
+
+void ResponseCache::complete(const SharedHandler& handler, Shard& shard, const std::string& key, std::uint64_t hash,
+                             std::shared_ptr<const Stored> stored) {
+    std::shared_ptr<Fill> fill;
+    {
+        std::lock_guard lock(shard.mutex);
+        if (const auto it = shard.fills.find(key); it != shard.fills.end()) {
+            fill = std::move(it->second);
+            shard.fills.erase(it);
+        }
+        if (stored) {
+            shard.passes.erase(key);
+            insert(shard, key, hash, stored);
+        } else {
+            if (const auto it = shard.entries.find(key); it != shard.entries.end()) {
+                // 刷新得到的响应不能缓存，旧条目也不再使用
+                shard.erase(it->second);
+            }
+            if (options_.hit_for_pass > std::chrono::seconds::zero()) {
+                const auto now = std::chrono::steady_clock::now();
+                if (shard.passes.size() >= max_passes) {
+                    std::erase_if(shard.passes, [now](const auto& pass) { return pass.second <= now; });
+                    if (shard.passes.size() >= max_passes) {
+                        shard.passes.erase(shard.passes.begin());
+                    }
+                }
+                shard.passes.insert_or_assign(key, now + options_.hit_for_pass);
+            }
+        }
+    }
+    if (!fill) {
+        return;
+    }
+
+    for (auto& waiter : fill->waiters) {
+        if (stored) {
+            apply(stored, *waiter.request, *waiter.response);
+            waiter.done();
+            continue;
+        }
+
+        // 不能缓存的响应不能共享（例如private响应），每个等待的请求回到自己的连接上调用处理函数，
+        // 不在完成调用的线程上依次执行
+        auto task = [handler, request = waiter.request, response = waiter.response, done = std::move(waiter.done)] {
+            try {
+                (*handler)(*request, *response, done);
+            }
+            catch (const std::exception& e) {
+                LOG_ERROR("处理请求时发生错误: " + std::string(e.what()));
+                set_error_response(*response, 500, "Internal Server Error");
+                done();
+            }
+        };
+        if (waiter.request->post && *waiter.request->post) {
+            (*waiter.request->post)(std::move(task));
+        } else {
+            task();
+        }
+    }
+}
+
+void ResponseCache::revalidate(const SharedHandler& handler, Shard& shard, std::string key, std::uint64_t hash,
+                               const HttpRequest& request) {
+    // 请求的副本：字符串复制到一块存储中，头部表的视图指向这块存储
+    struct Copy {
+        std::string storage;
+        HttpRequest request;
+        HttpResponse response;
+    };
+    auto copy = std::make_shared<Copy>();
+    size_t total = request.method.size() + request.uri.size() + request.version.size();
+    for (const auto& [name, value] : request.headers) {
+        total += name.size() + value.size();
+    }
+    copy->storage.reserve(total);
+    const auto keep = [&](std::string_view str) {
+        const auto offset = copy->storage.size();
+        copy->storage.append(str);
+        return std::string_view(copy->storage.data() + offset, str.size());
+    };
+    copy->request.method = keep(request.method);
+    copy->request.uri = keep(request.uri);
+    copy->request.version = keep(request.version);
+    for (const auto& [name, value] : request.headers) {
+        copy->request.headers.add(keep(name), keep(value));
+    }
+
+    auto task = [self = shared_from_this(), handler, &shard, key = std::move(key), hash, copy] {
+        try {
+            (*handler)(copy->request, copy->response, [self, handler, &shard, key, hash, copy] {
+                self->complete(handler, shard, key, hash, self->make_stored(copy->response));
+            });
+        }
+        catch (const std::exception& e) {
+            LOG_ERROR("刷新缓存条目时发生错误: " + std::string(e.what()));
+            self->complete(handler, shard, key, hash, nullptr);
+        }
+    };
+    if (post_) {
+        post_(std::move(task));
+    } else {
+        task();
+    }
+}
+
+std::shared_ptr<const ResponseCache::Stored> ResponseCache::make_stored(const HttpResponse& response) const {
+    const int status = response.status_code();
+    if (!response.prebuilt().empty() || response.file_body() || response.chunked_body() ||
+        response.body().size() > options_.max_entry_size || status < 200 || status == 206) {
+        return nullptr;
+    }
+
+    bool cacheable = true;
+    bool shared_max_age = false;
+    std::optional<std::chrono::seconds> max_age;
+    std::optional<std::chrono::seconds> stale;
+    for (const auto& [name, value] : response.headers()) {
+        if (iequals(name, "Set-Cookie")) {
+            return nullptr;
+        }
+        if (iequals(name, "Vary")) {
+            // 缓存键不包含的请求头会让不同的请求共享同一个表示
+            for_each_directive(value, [&](std::string_view header, std::string_view) {
+                cacheable = cacheable && !iequals(header, "*") && (iequals(header, "Accept-Encoding") ||
+                    std::any_of(options_.key_headers.begin(), options_.key_headers.end(),
+                                [&](const std::string& key_header) { return iequals(header, key_header); }));
+            });
+        } else if (iequals(name, "Cache-Control")) {
+            for_each_directive(value, [&](std::string_view directive, std::string_view argument) {
+                if (iequals(directive, "no-store") || iequals(directive, "private") || iequals(directive, "no-cache")) {
+                    cacheable = false;
+                } else if (iequals(directive, "s-maxage")) {
+                    max_age = parse_seconds(argument);
+                    shared_max_age = true;
+                } else if (iequals(directive, "max-age") && !shared_max_age) {
+                    max_age = parse_seconds(argument);
+                } else if (iequals(directive, "stale-while-revalidate")) {
+                    stale = parse_seconds(argument);
+                }
+            });
+        }
+    }
+
+    const auto lifetime = max_age.value_or(options_.default_ttl);
+    if (!cacheable || lifetime <= std::chrono::seconds::zero()) {
+        return nullptr;
+    }
+
+    auto stored = std::make_shared<Stored>();
+    stored->status = status;
+    stored->reason = response.status_message();
+    stored->expires = std::chrono::steady_clock::now() + lifetime;
+    stored->stale_until = stored->expires + stale.value_or(options_.stale_while_revalidate);
+
+    // 原响应中的数据在请求结束后失效，序列化后的响应独立保存
+    const auto build = [&] {
+        HttpResponse copy;
+        copy.set_status(status, response.status_message());
+        for (const auto& [name, value] : response.headers()) {
+            copy.add_header(name, value);
+        }
+        copy.set_body(response.body());
+        return copy;
+    };
+
+    auto identity = build();
+    // 没有Accept-Encoding的请求只用于判断响应是否适合压缩，适合时会添加Vary: Accept-Encoding
+    const auto header_count = identity.headers().size();
+    negotiate_response_encoding(HttpRequest{}, identity, compression_);
+    stored->compressible = identity.headers().size() > header_count;
+    identity.serialize(stored->responses.emplace_back());
+
+    if (stored->compressible) {
+        for (const auto encoding : supported_encodings()) {
+            auto compressed = build();
+            compressed.add_header("Vary", "Accept-Encoding");
+            if (compress_response(compressed, encoding, compression_)) {
+                stored->variant[static_cast<size_t>(encoding)] = static_cast<std::uint8_t>(stored->responses.size());
+                compressed.serialize(stored->responses.emplace_back());
+            }
+        }
+    }
+
+    stored->charge = entry_overhead + stored->reason.size();
+    for (const auto& data : stored->responses) {
+        stored->charge += data.size();
+    }
+    return stored;
+}
+
+void ResponseCache::apply(const std::shared_ptr<const Stored>& stored, const HttpRequest& request,
+                          HttpResponse& response) {
+    auto encoding = ContentEncoding::identity;
+    if (stored->compressible) {
+        if (const auto accept = request.headers.get(Header::accept_encoding)) {
+            encoding = negotiate_encoding(*accept, supported_encodings());
+        }
+    }
+    response.set_status(stored->status, stored->reason);
+    response.set_prebuilt(stored->responses[stored->variant[static_cast<size_t>(encoding)]], stored);
+}
+
+bool ResponseCache::make_key(const HttpRequest& request, std::string& key) const {
+    if ((request.method != "GET" && request.method != "HEAD") || request.headers.contains(Header::authorization)) {
+        return false;
+    }
+    if (const auto cache_control = request.headers.get(Header::cache_control)) {
+        // 客户端要求重新获取时直接调用处理函数
+        bool bypass = false;
+        for_each_directive(*cache_control, [&](std::string_view directive, std::string_view argument) {
+            bypass = bypass || iequals(directive, "no-cache") || iequals(directive, "no-store") ||
+                     (iequals(directive, "max-age") && argument == "0");
+        });
+        if (bypass) return false;
+    }
+
+    key.reserve(request.method.size() + request.uri.size() + 1);
+    key.append(request.method).append(" ").append(request.uri);
+    for (const auto& name : options_.key_headers) {
+        key.push_back('\n');
+        if (const auto value = request.headers.find(name)) {
+            key.append(*value);
+        }
+    }
+    return true;
+}
+
+void ResponseCache::insert(Shard& shard, const std::string& key, std::uint64_t hash,
+                           std::shared_ptr<const Stored> stored) {
+    const auto cost = key.size() + stored->charge;
+    const auto existing = shard.entries.find(key);
+    if (cost > shard.capacity) {
+        if (existing != shard.entries.end()) shard.erase(existing->second);
+        return;
+    }
+
+    if (existing != shard.entries.end()) {
+        // 刷新已有的条目，不需要重新准入
+        const auto entry = existing->second;
+        shard.bytes = shard.bytes - entry->cost() + cost;
+        entry->stored = std::move(stored);
+        shard.lru.splice(shard.lru.begin(), shard.lru, entry);
+    } else {
+        // TinyLFU准入：从LRU尾部找出需要淘汰的条目，其中任何一个比新条目更常用时放弃存入
+        const auto frequency = shard.sketch.estimate(hash);
+        auto victim = shard.lru.end();
+        size_t freed = 0;
+        while (shard.bytes - freed + cost > shard.capacity) {
+            --victim;
+            if (frequency <= shard.sketch.estimate(victim->hash)) {
+                return;
+            }
+            freed += victim->cost();
+        }
+        while (victim != shard.lru.end()) {
+            shard.erase(victim++);
+        }
+
+        shard.lru.push_front({key, hash, std::move(stored)});
+        shard.entries.emplace(shard.lru.front().key, shard.lru.begin());
+        shard.bytes += cost;
+    }
+
+    // 刷新后条目变大时按LRU淘汰，最近使用的条目保留
+    while (shard.bytes > shard.capacity && shard.lru.size() > 1) {
+        shard.erase(std::prev(shard.lru.end()));
+    }
+}
+
+} // namespace http
+} // namespace hsmm
@@ -0,0 +1,123 @@
+#include "http/Router.hpp"
+#include "utils/Logger.hpp"
+#include <algorithm>
+#include <exception>
+
+namespace hsmm {
+namespace http {
+
+std::string_view uri_path(std::string_view uri) noexcept {
+    return uri.substr(0, uri.find_first_of("?#"));
+}
+
+void set_error_response(HttpResponse& response, int code, std::string_view reason) {
+    response = HttpResponse(response.resource());
+    response.set_status(code, reason);
+    response.add_header("Content-Type", "text/plain");
+    response.set_body(reason);
+}
+
+void Router::add_route(std::string path, Handler handler) {
+    exact_routes_.insert_or_assign(std::move(path), Route{std::move(handler), {}, {}, {}});
+}
+
+void Router::add_stream_route(std::string path, StreamHandler handler) {
+    exact_routes_.insert_or_assign(std::move(path), Route{{}, std::move(handler), {}, {}});
+}
+
+void Router::add_async_route(std::string path, AsyncHandler handler) {
+    exact_routes_.insert_or_assign(std::move(path), Route{{}, {}, std::move(handler), {}});
+}
+
+void Router::add_websocket_route(std::string path, websocket::Handler handler) {
+    exact_routes_.insert_or_assign(std::move(path),
+        Route{{}, {}, {}, std::make_shared<const websocket::Handler>(std::move(handler))});
+}
+
+void Router::add_prefix_route(std::string prefix, Handler handler) {
+    const auto pos = std::find_if(prefix_routes_.begin(), prefix_routes_.end(),
+        [&](const auto& route) { return route.first.size() < prefix.size(); });
+    prefix_routes_.emplace(pos, std::move(prefix), Route{std::move(handler), {}, {}, {}});
+}
+
+void Router::add_async_prefix_route(std::string prefix, AsyncHandler handler) {
+    const auto pos = std::find_if(prefix_routes_.begin(), prefix_routes_.end(),
+        [&](const auto& route) { return route.first.size() < prefix.size(); });
+    prefix_routes_.emplace(pos, std::move(prefix), Route{{}, {}, std::move(handler), {}});
+}
+
+void Router::set_default(Handler handler) {
+    default_route_ = Route{std::move(handler), {}, {}, {}};
+}
+
+const Router::Route& Router::find(std::string_view uri) const {
+    const auto path = uri_path(uri);
+
+    if (const auto it = exact_routes_.find(path); it != exact_routes_.end()) {
+        return it->second;
+    }
+
+    for (const auto& [prefix, route] : prefix_routes_) {
+        if (path.starts_with(prefix)) {
+            return route;
+        }
+    }
+
+    return default_route_;
+}
+
+std::unique_ptr<BodyReader> Router::handle(const Route& route, const HttpRequest& request, HttpResponse& response) {
+    std::unique_ptr<BodyReader> reader;
+    try {
+        if (route.stream_handler) {
+            reader = route.stream_handler(request, response);
+            if (reader) {
+                if (!request.body.empty()) {
+                    reader->on_data(request.body);
+                }
+                reader->on_complete(response);
+            }
+        } else if (route.async_handler) {
+            // 调用者无法等待异步处理完成（io_uring后端）
+            set_error_response(response, 501, "Not Implemented");
+        } else if (route.websocket) {
+            // 不是HTTP/1.1的升级请求（HTTP/2或者io_uring后端）
+            set_error_response(response, 426, "Upgrade Required");
+            response.add_header("Upgrade", "websocket");
+        } else {
+            route.handler(request, response);
+        }
+    }
+    catch (const std::exception& e) {
+        LOG_ERROR("处理请求时发生错误: " + std::string(e.what()));
+        set_error_response(response, 500, "Internal Server Error");
+    }
+    return reader;
+}
+
+std::unique_ptr<BodyReader> Router::dispatch(std::span<const char> data, HttpResponse& response,
+                                             std::pmr::memory_resource* resource) const {
+    auto request = HttpParser::parse(data, resource);
+    if (!request) {
+        // 请求解析失败
+        response.set_status(400, "Bad Request");
+        response.add_header("Content-Type", "text/plain");
+        response.set_body("Invalid HTTP request");
+        return nullptr;
+    }
+
+    // 这里只处理一次读取到的完整请求，需要继续读取的请求体由Connection流式处理
+    if (request->chunked) {
+        set_error_response(response, 411, "Length Required");
+        return nullptr;
+    }
+    if (request->content_length.value_or(0) > request->body.size()) {
+        set_error_response(response, 413, "Payload Too Large");
+        return nullptr;
+    }
+
+    return handle(find(request->uri), *request, response);
+}
+
+} // namespace http
+} // namespace hsmm
@@ -0,0 +1,527 @@
+#include "http/StaticFileHandler.hpp"
+#include "http/Router.hpp"
+#include "utils/Logger.hpp"
+#include <charconv>
+#include <ctime>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+namespace hsmm {
+namespace http {
+
+/**
+ * @brief 缓存条目
+ *
+ * response保存预先生成的完整响应；大文件只保存响应头，文件内容通过fd发送。
+ * variants保存可压缩小文件的各个压缩版本，每个版本有独立的ETag。
+ */
+struct StaticFileHandler::Entry {
+    struct Variant {
+        ContentEncoding encoding;
+        std::string response;
+        size_t header_size{0};
+        std::string not_modified;
+        std::string etag;
+    };
+
+    std::string response;
+    size_t header_size{0};
+    std::string not_modified;
+    std::string etag;
+    std::uint64_t size{0};
+    std::int64_t mtime_ns{0};
+    int fd{-1};
+    std::vector<Variant> variants;
+    // variants中各版本的编码，按服务器优先顺序排列，用于协商
+    std::vector<ContentEncoding> encodings;
+
+    ~Entry() {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+
+    // 计入缓存容量的字节数
+    size_t footprint() const noexcept {
+        auto bytes = response.size() + not_modified.size();
+        for (const auto& variant : variants) {
+            bytes += variant.response.size() + variant.not_modified.size();
+        }
+        return bytes;
+    }
+};
+
+namespace {
+    std::string_view content_type(std::string_view path) {
+        static const std::unordered_map<std::string_view, std::string_view> types = {
+            {"html", "text/html; charset=utf-8"},
+            {"htm", "text/html; charset=utf-8"},
+            {"css", "text/css; charset=utf-8"},
+            {"js", "application/javascript; charset=utf-8"},
+            {"json", "application/json"},
+            {"txt", "text/plain; charset=utf-8"},
+            {"xml", "application/xml"},
+            {"svg", "image/svg+xml"},
+            {"png", "image/png"},
+            {"jpg", "image/jpeg"},
+            {"jpeg", "image/jpeg"},
+            {"gif", "image/gif"},
+            {"webp", "image/webp"},
+            {"ico", "image/x-icon"},
+            {"woff", "font/woff"},
+            {"woff2", "font/woff2"},
+            {"wasm", "application/wasm"},
+            {"pdf", "application/pdf"},
+        };
+
+        const auto dot = path.rfind('.');
+        if (dot == std::string_view::npos || path.find('/', dot) != std::string_view::npos) {
+            return "application/octet-stream";
+        }
+        const auto it = types.find(path.substr(dot + 1));
+        return it != types.end() ? it->second : "application/octet-stream";
+    }
+
+    // 拒绝包含".."、空字符或反斜杠的路径，防止越出根目录
+    bool is_safe_path(std::string_view path) {
+        if (path.find('\0') != std::string_view::npos || path.find('\\') != std::string_view::npos) {
+            return false;
+        }
+        size_t start = 0;
+        while (start <= path.size()) {
+            const auto end = std::min(path.find('/', start), path.size());
+            if (path.substr(start, end - start) == "..") {
+                return false;
+            }
+            start = end + 1;
+        }
+        return true;
+    }
+
+    // 解码URL中的百分号编码，非法编码返回false
+    bool percent_decode(std::string_view in, std::string& out) {
+        out.clear();
+        out.reserve(in.size());
+        for (size_t i = 0; i < in.size(); ++i) {
+            if (in[i] != '%') {
+                out.push_back(in[i]);
+                continue;
+            }
+            unsigned value = 0;
+            if (i + 2 >= in.size() ||
+                std::from_chars(in.data() + i + 1, in.data() + i + 3, value, 16).ptr != in.data() + i + 3) {
+                return false;
+            }
+            out.push_back(static_cast<char>(value));
+            i += 2;
+        }
+        return true;
+    }
+
+    std::string http_date(std::time_t seconds) {
+        std::tm tm{};
+        gmtime_r(&seconds, &tm);
+        char buffer[64];
+        const auto length = std::strftime(buffer, sizeof(buffer), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+        return std::string(buffer, length);
+    }
+
+    std::int64_t mtime_of(const struct stat& st) {
+#ifdef __APPLE__
+        return static_cast<std::int64_t>(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+        return static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+    }
+
+    // If-None-Match可能是逗号分隔的列表或"*"
+    bool etag_matches(std::string_view header, std::string_view etag) {
+        if (header == "*") return true;
+        size_t start = 0;
+        while (start < header.size()) {
+            auto end = std::min(header.find(',', start), header.size());
+            auto candidate = header.substr(start, end - start);
+            while (!candidate.empty() && candidate.front() == ' ') candidate.remove_prefix(1);
+            while (!candidate.empty() && candidate.back() == ' ') candidate.remove_suffix(1);
+            if (candidate.starts_with("W/")) candidate.remove_prefix(2);
+            if (candidate == etag) return true;
+            start = end + 1;
+        }
+        return false;
+    }
+
+    std::string not_modified_response(std::string_view etag, std::string_view last_modified, bool vary) {
+        HttpResponse not_modified;
+        not_modified.set_status(304, "Not Modified");
+        not_modified.add_header("ETag", etag);
+        not_modified.add_header("Last-Modified", last_modified);
+        if (vary) {
+            not_modified.add_header("Vary", "Accept-Encoding");
+        }
+        not_modified.add_header("Server", "HSMM-HTTP-Server");
+        return not_modified.to_string();
+    }
+
+    void simple_response(HttpResponse& response, int code, std::string_view message) {
+        response.set_status(code, message);
+        response.add_header("Content-Type", "text/plain");
+        response.add_header("Server", "HSMM-HTTP-Server");
+        response.set_body(message);
+    }
+}
+
+StaticFileHandler::StaticFileHandler(boost::asio::io_context& io_context, std::filesystem::path root,
+                                     std::string url_prefix, Options options)
+    : root_(std::move(root))
+    , url_prefix_(std::move(url_prefix))
+    , options_(options)
+#ifdef __linux__
+    , inotify_(io_context)
+#endif
+{
+    if (!std::filesystem::is_directory(root_)) {
+        throw std::runtime_error("静态文件目录不存在: " + root_.string());
+    }
+
+#ifdef __linux__
+    const int fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        LOG_WARNING("inotify初始化失败，静态文件缓存将不会自动失效");
+    } else {
+        inotify_.assign(fd);
+        do_watch();
+    }
+#else
+    (void)io_context;
+#endif
+
+    LOG_INFO("静态文件目录: " + root_.string() + " 挂载于 " + url_prefix_);
+}
+
+StaticFileHandler::~StaticFileHandler() {
+#ifdef __linux__
+    boost::system::error_code ec;
+    inotify_.close(ec);
+#endif
+}
+
+void StaticFileHandler::handle(const HttpRequest& request, HttpResponse& response) {
+    const bool head = request.method == "HEAD";
+    if (!head && request.method != "GET") {
+        simple_response(response, 405, "Method Not Allowed");
+        response.add_header("Allow", "GET, HEAD");
+        return;
+    }
+
+    // 计算相对于根目录的路径
+    auto path = uri_path(request.uri);
+    if (!path.starts_with(url_prefix_)) {
+        simple_response(response, 404, "Not Found");
+        return;
+    }
+    path.remove_prefix(url_prefix_.size());
+    while (path.starts_with('/')) path.remove_prefix(1);
+
+    // 只有包含百分号编码或指向目录时才需要构造新的路径
+    std::string decoded;
+    std::string_view key = path;
+    if (path.find('%') != std::string_view::npos) {
+        if (!percent_decode(path, decoded)) {
+            simple_response(response, 400, "Bad Request");
+            return;
+        }
+        key = decoded;
+    }
+    if (key.empty() || key.ends_with('/')) {
+        if (decoded.empty()) decoded = key;
+        decoded += "index.html";
+        key = decoded;
+    }
+
+    if (!is_safe_path(key)) {
+        simple_response(response, 403, "Forbidden");
+        return;
+    }
+
+    auto entry = lookup(key);
+    if (!entry) {
+        simple_response(response, 404, "Not Found");
+        return;
+    }
+
+    // 有预压缩版本时按Accept-Encoding选择，各版本的ETag不同
+    std::string_view etag = entry->etag;
+    std::string_view full = entry->response;
+    std::string_view not_modified = entry->not_modified;
+    size_t header_size = entry->header_size;
+    if (!entry->variants.empty()) {
+        if (const auto accept = request.headers.get(Header::accept_encoding)) {
+            const auto encoding = negotiate_encoding(*accept, entry->encodings);
+            for (const auto& variant : entry->variants) {
+                if (variant.encoding == encoding) {
+                    etag = variant.etag;
+                    full = variant.response;
+                    not_modified = variant.not_modified;
+                    header_size = variant.header_size;
+                    break;
+                }
+            }
+        }
+    }
+
+    if (const auto match = request.headers.get(Header::if_none_match); match && etag_matches(*match, etag)) {
+        response.set_status(304, "Not Modified");
+        response.set_prebuilt(not_modified, entry);
+        return;
+    }
+
+    if (head) {
+        response.set_prebuilt(full.substr(0, header_size), entry);
+        return;
+    }
+
+    if (entry->fd >= 0) {
+        // 大文件：发送缓存的响应头，文件内容交给sendfile
+        response.set_prebuilt(entry->response, entry);
+        response.set_file_body(entry->fd, 0, entry->size, entry);
+    } else {
+        response.set_prebuilt(full, entry);
+    }
+}
+
+std::shared_ptr<const StaticFileHandler::Entry> StaticFileHandler::lookup(std::string_view key) {
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        if (const auto it = cache_.find(key); it != cache_.end()) {
+#ifdef __linux__
+            return it->second;
+#else
+            // 没有inotify时，通过比较文件大小和修改时间判断缓存是否仍然有效
+            struct stat st{};
+            const auto full_path = root_ / std::string(key);
+            if (::stat(full_path.c_str(), &st) == 0 &&
+                static_cast<std::uint64_t>(st.st_size) == it->second->size &&
+                mtime_of(st) == it->second->mtime_ns) {
+                return it->second;
+            }
+#endif
+        }
+    }
+
+    return load(std::string(key));
+}
+
+std::shared_ptr<const StaticFileHandler::Entry> StaticFileHandler::load(const std::string& key) {
+    const auto full_path = root_ / key;
+
+    const int fd = ::open(full_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat st{};
+    if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        ::close(fd);
+        return nullptr;
+    }
+
+    auto entry = std::make_shared<Entry>();
+    entry->size = static_cast<std::uint64_t>(st.st_size);
+    entry->mtime_ns = mtime_of(st);
+
+    char etag[64];
+    auto* etag_end = etag;
+    *etag_end++ = '"';
+    etag_end = std::to_chars(etag_end, etag + sizeof(etag), entry->size, 16).ptr;
+    *etag_end++ = '-';
+    etag_end = std::to_chars(etag_end, etag + sizeof(etag), entry->mtime_ns, 16).ptr;
+    *etag_end++ = '"';
+    entry->etag.assign(etag, etag_end);
+
+    const auto last_modified = http_date(st.st_mtime);
+
+    HttpResponse head;
+    head.set_status(200, "OK");
+    head.add_header("Content-Type", content_type(key));
+    head.add_header("ETag", entry->etag);
+    head.add_header("Last-Modified", last_modified);
+    head.add_header("Server", "HSMM-HTTP-Server");
+
+    if (entry->size <= options_.max_cached_file_size) {
+        // 小文件：读入内存，与响应头拼接成完整响应
+        std::string body(entry->size, '\0');
+        size_t done = 0;
+        while (done < body.size()) {
+            const auto n = ::pread(fd, body.data() + done, body.size() - done, static_cast<off_t>(done));
+            if (n <= 0) {
+                if (n < 0 && errno == EINTR) continue;
+                break;
+            }
+            done += static_cast<size_t>(n);
+        }
+        ::close(fd);
+        if (done != body.size()) {
+            return nullptr;
+        }
+
+        const auto& compression = options_.compression;
+        const bool compressible = compression.enabled && entry->size >= compression.min_size &&
+                                  is_compressible_type(content_type(key));
+        if (compressible) {
+            head.add_header("Vary", "Accept-Encoding");
+            load_variants(*entry, content_type(key), body, last_modified);
+        }
+
+        head.set_body(body);
+        entry->response = head.to_string();
+        entry->header_size = entry->response.size() - body.size();
+    } else {
+        // 大文件：只缓存响应头，保留文件描述符供sendfile使用
+        head.set_file_body(fd, 0, entry->size, nullptr);
+        entry->fd = fd;
+        entry->response = head.to_string();
+        entry->header_size = entry->response.size();
+    }
+
+    entry->not_modified = not_modified_response(entry->etag, last_modified, !entry->variants.empty());
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (const auto it = cache_.find(key); it != cache_.end()) {
+        cached_bytes_ -= it->second->footprint();
+        cache_.erase(it);
+    }
+    // 超出缓存容量时不缓存，只用于本次响应
+    if (cached_bytes_ + entry->footprint() <= options_.cache_capacity &&
+        cache_.size() < options_.max_entries) {
+        cached_bytes_ += entry->footprint();
+        cache_.emplace(key, entry);
+
+        const auto slash = key.rfind('/');
+        watch_directory(slash == std::string::npos ? std::string{} : key.substr(0, slash));
+    }
+    return entry;
+}
+
+void StaticFileHandler::load_variants(Entry& entry, std::string_view type, std::string_view body,
+                                      std::string_view last_modified) const {
+    const auto& compression = options_.compression;
+    for (const auto encoding : supported_encodings()) {
+        // deflate与gzip只差容器格式，客户端都支持gzip，不再单独缓存一份
+        if (encoding == ContentEncoding::deflate) continue;
+
+        std::string compressed;
+        const auto level = encoding == ContentEncoding::br ? compression.static_brotli_quality
+                                                           : compression.static_gzip_level;
+        if (!compress(encoding, body, compressed, level) || compressed.size() >= body.size()) {
+            continue;
+        }
+
+        // ETag加上编码后缀，让缓存和条件请求区分不同的表示
+        const auto token = encoding_token(encoding);
+        Entry::Variant variant{encoding, {}, 0, {}, entry.etag};
+        variant.etag.insert(variant.etag.size() - 1, "-" + std::string(token));
+
+        HttpResponse response;
+        response.set_status(200, "OK");
+        response.add_header("Content-Type", type);
+        response.add_header("Content-Encoding", token);
+        response.add_header("ETag", variant.etag);
+        response.add_header("Last-Modified", last_modified);
+        response.add_header("Vary", "Accept-Encoding");
+        response.add_header("Server", "HSMM-HTTP-Server");
+        response.set_body(compressed);
+        variant.response = response.to_string();
+        variant.header_size = variant.response.size() - compressed.size();
+        variant.not_modified = not_modified_response(variant.etag, last_modified, true);
+
+        entry.encodings.push_back(encoding);
+        entry.variants.push_back(std::move(variant));
+    }
+}
+
+void StaticFileHandler::invalidate(std::string_view key, bool recursive) {
+    for (auto it = cache_.begin(); it != cache_.end();) {
+        const auto& entry_key = it->first;
+        const bool match = entry_key == key ||
+            (recursive && (key.empty() ||
+                (entry_key.size() > key.size() && entry_key.starts_with(key) && entry_key[key.size()] == '/')));
+        if (match) {
+            cached_bytes_ -= it->second->footprint();
+            it = cache_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void StaticFileHandler::watch_directory([[maybe_unused]] const std::string& dir_key) {
+#ifdef __linux__
+    if (!inotify_.is_open() || watched_dirs_.contains(dir_key)) {
+        return;
+    }
+
+    const auto dir_path = root_ / dir_key;
+    const int wd = ::inotify_add_watch(inotify_.native_handle(), dir_path.c_str(),
+        IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+        IN_DELETE_SELF | IN_MOVE_SELF);
+    if (wd < 0) {
+        LOG_WARNING("无法监听目录: " + dir_path.string());
+        return;
+    }
+    watches_[wd] = dir_key;
+    watched_dirs_[dir_key] = wd;
+#endif
+}
+
+void StaticFileHandler::do_watch() {
+#ifdef __linux__
+    inotify_.async_read_some(
+        boost::asio::buffer(event_buffer_),
+        [this](boost::system::error_code ec, std::size_t length) {
+            if (ec) {
+                if (ec != boost::asio::error::operation_aborted) {
+                    LOG_ERROR("读取inotify事件失败: " + ec.message());
+                }
+                return;
+            }
+
+            std::unique_lock<std::shared_mutex> lock(mutex_);
+            for (size_t offset = 0; offset + sizeof(inotify_event) <= length;) {
+                const auto* event = reinterpret_cast<const inotify_event*>(event_buffer_.data() + offset);
+                offset += sizeof(inotify_event) + event->len;
+
+                const auto watch = watches_.find(event->wd);
+                if (watch == watches_.end()) continue;
+                const auto dir_key = watch->second;
+
+                if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+                    // 目录本身被删除或移动：清除目录下的全部缓存
+                    invalidate(dir_key, true);
+                    if (event->mask & IN_IGNORED) {
+                        watched_dirs_.erase(dir_key);
+                        watches_.erase(watch);
+                    }
+                    continue;
+                }
+
+                if (event->len == 0) continue;
+                const std::string_view name(event->name);
+                const auto key = dir_key.empty() ? std::string(name) : dir_key + "/" + std::string(name);
+                invalidate(key, (event->mask & IN_ISDIR) != 0);
+            }
+            lock.unlock();
+
+            do_watch();
+        });
+#endif
+}
+
+} // namespace http
+} // namespace hsmm
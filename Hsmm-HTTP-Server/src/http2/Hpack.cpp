@@ -0,0 +1,445 @@
+#include "http2/Hpack.hpp"
+#include <algorithm>
+#include <array>
+#include <unordered_map>
+
+namespace hsmm {
+namespace http2 {
+
+namespace {
+    struct HuffmanCode {
+        std::uint32_t code;
+        std::uint8_t bits;
+    };
+
+    // RFC 7541 附录B，下标为符号，256为EOS
+    constexpr std::array<HuffmanCode, 257> huffman_codes{{
+        {0x1ff8, 13}, {0x7fffd8, 23}, {0xfffffe2, 28}, {0xfffffe3, 28},
+        {0xfffffe4, 28}, {0xfffffe5, 28}, {0xfffffe6, 28}, {0xfffffe7, 28},
+        {0xfffffe8, 28}, {0xffffea, 24}, {0x3ffffffc, 30}, {0xfffffe9, 28},
+        {0xfffffea, 28}, {0x3ffffffd, 30}, {0xfffffeb, 28}, {0xfffffec, 28},
+        {0xfffffed, 28}, {0xfffffee, 28}, {0xfffffef, 28}, {0xffffff0, 28},
+        {0xffffff1, 28}, {0xffffff2, 28}, {0x3ffffffe, 30}, {0xffffff3, 28},
+        {0xffffff4, 28}, {0xffffff5, 28}, {0xffffff6, 28}, {0xffffff7, 28},
+        {0xffffff8, 28}, {0xffffff9, 28}, {0xffffffa, 28}, {0xffffffb, 28},
+        {0x14, 6}, {0x3f8, 10}, {0x3f9, 10}, {0xffa, 12},
+        {0x1ff9, 13}, {0x15, 6}, {0xf8, 8}, {0x7fa, 11},
+        {0x3fa, 10}, {0x3fb, 10}, {0xf9, 8}, {0x7fb, 11},
+        {0xfa, 8}, {0x16, 6}, {0x17, 6}, {0x18, 6},
+        {0x0, 5}, {0x1, 5}, {0x2, 5}, {0x19, 6},
+        {0x1a, 6}, {0x1b, 6}, {0x1c, 6}, {0x1d, 6},
+        {0x1e, 6}, {0x1f, 6}, {0x5c, 7}, {0xfb, 8},
+        {0x7ffc, 15}, {0x20, 6}, {0xffb, 12}, {0x3fc, 10},
+        {0x1ffa, 13}, {0x21, 6}, {0x5d, 7}, {0x5e, 7},
+        {0x5f, 7}, {0x60, 7}, {0x61, 7}, {0x62, 7},
+        {0x63, 7}, {0x64, 7}, {0x65, 7}, {0x66, 7},
+        {0x67, 7}, {0x68, 7}, {0x69, 7}, {0x6a, 7},
+        {0x6b, 7}, {0x6c, 7}, {0x6d, 7}, {0x6e, 7},
+        {0x6f, 7}, {0x70, 7}, {0x71, 7}, {0x72, 7},
+        {0xfc, 8}, {0x73, 7}, {0xfd, 8}, {0x1ffb, 13},
+        {0x7fff0, 19}, {0x1ffc, 13}, {0x3ffc, 14}, {0x22, 6},
+        {0x7ffd, 15}, {0x3, 5}, {0x23, 6}, {0x4, 5},
+        {0x24, 6}, {0x5, 5}, {0x25, 6}, {0x26, 6},
+        {0x27, 6}, {0x6, 5}, {0x74, 7}, {0x75, 7},
+        {0x28, 6}, {0x29, 6}, {0x2a, 6}, {0x7, 5},
+        {0x2b, 6}, {0x76, 7}, {0x2c, 6}, {0x8, 5},
+        {0x9, 5}, {0x2d, 6}, {0x77, 7}, {0x78, 7},
+        {0x79, 7}, {0x7a, 7}, {0x7b, 7}, {0x7ffe, 15},
+        {0x7fc, 11}, {0x3ffd, 14}, {0x1ffd, 13}, {0xffffffc, 28},
+        {0xfffe6, 20}, {0x3fffd2, 22}, {0xfffe7, 20}, {0xfffe8, 20},
+        {0x3fffd3, 22}, {0x3fffd4, 22}, {0x3fffd5, 22}, {0x7fffd9, 23},
+        {0x3fffd6, 22}, {0x7fffda, 23}, {0x7fffdb, 23}, {0x7fffdc, 23},
+        {0x7fffdd, 23}, {0x7fffde, 23}, {0xffffeb, 24}, {0x7fffdf, 23},
+        {0xffffec, 24}, {0xffffed, 24}, {0x3fffd7, 22}, {0x7fffe0, 23},
+        {0xffffee, 24}, {0x7fffe1, 23}, {0x7fffe2, 23}, {0x7fffe3, 23},
+        {0x7fffe4, 23}, {0x1fffdc, 21}, {0x3fffd8, 22}, {0x7fffe5, 23},
+        {0x3fffd9, 22}, {0x7fffe6, 23}, {0x7fffe7, 23}, {0xffffef, 24},
+        {0x3fffda, 22}, {0x1fffdd, 21}, {0xfffe9, 20}, {0x3fffdb, 22},
+        {0x3fffdc, 22}, {0x7fffe8, 23}, {0x7fffe9, 23}, {0x1fffde, 21},
+        {0x7fffea, 23}, {0x3fffdd, 22}, {0x3fffde, 22}, {0xfffff0, 24},
+        {0x1fffdf, 21}, {0x3fffdf, 22}, {0x7fffeb, 23}, {0x7fffec, 23},
+        {0x1fffe0, 21}, {0x1fffe1, 21}, {0x3fffe0, 22}, {0x1fffe2, 21},
+        {0x7fffed, 23}, {0x3fffe1, 22}, {0x7fffee, 23}, {0x7fffef, 23},
+        {0xfffea, 20}, {0x3fffe2, 22}, {0x3fffe3, 22}, {0x3fffe4, 22},
+        {0x7ffff0, 23}, {0x3fffe5, 22}, {0x3fffe6, 22}, {0x7ffff1, 23},
+        {0x3ffffe0, 26}, {0x3ffffe1, 26}, {0xfffeb, 20}, {0x7fff1, 19},
+        {0x3fffe7, 22}, {0x7ffff2, 23}, {0x3fffe8, 22}, {0x1ffffec, 25},
+        {0x3ffffe2, 26}, {0x3ffffe3, 26}, {0x3ffffe4, 26}, {0x7ffffde, 27},
+        {0x7ffffdf, 27}, {0x3ffffe5, 26}, {0xfffff1, 24}, {0x1ffffed, 25},
+        {0x7fff2, 19}, {0x1fffe3, 21}, {0x3ffffe6, 26}, {0x7ffffe0, 27},
+        {0x7ffffe1, 27}, {0x3ffffe7, 26}, {0x7ffffe2, 27}, {0xfffff2, 24},
+        {0x1fffe4, 21}, {0x1fffe5, 21}, {0x3ffffe8, 26}, {0x3ffffe9, 26},
+        {0xffffffd, 28}, {0x7ffffe3, 27}, {0x7ffffe4, 27}, {0x7ffffe5, 27},
+        {0xfffec, 20}, {0xfffff3, 24}, {0xfffed, 20}, {0x1fffe6, 21},
+        {0x3fffe9, 22}, {0x1fffe7, 21}, {0x1fffe8, 21}, {0x7ffff3, 23},
+        {0x3fffea, 22}, {0x3fffeb, 22}, {0x1ffffee, 25}, {0x1ffffef, 25},
+        {0xfffff4, 24}, {0xfffff5, 24}, {0x3ffffea, 26}, {0x7ffff4, 23},
+        {0x3ffffeb, 26}, {0x7ffffe6, 27}, {0x3ffffec, 26}, {0x3ffffed, 26},
+        {0x7ffffe7, 27}, {0x7ffffe8, 27}, {0x7ffffe9, 27}, {0x7ffffea, 27},
+        {0x7ffffeb, 27}, {0xffffffe, 28}, {0x7ffffec, 27}, {0x7ffffed, 27},
+        {0x7ffffee, 27}, {0x7ffffef, 27}, {0x7fffff0, 27}, {0x3ffffee, 26},
+        {0x3fffffff, 30},
+    }};
+
+    /**
+     * @brief 范式Huffman解码表
+     *
+     * HPACK的编码是范式编码：同一长度的码字连续递增，按(长度, 符号)排序即可得到全部码字。
+     * limit[n]是长度为n的码字之后的第一个值，first[n]是长度为n的第一个码字在symbols中的位置。
+     */
+    struct HuffmanDecodeTable {
+        std::array<std::uint32_t, 31> limit{};
+        std::array<std::uint32_t, 31> first_code{};
+        std::array<std::uint16_t, 31> first{};
+        std::array<std::uint16_t, 257> symbols{};
+    };
+
+    constexpr HuffmanDecodeTable build_decode_table() {
+        HuffmanDecodeTable table;
+        std::uint16_t position = 0;
+        for (unsigned bits = 5; bits <= 30; ++bits) {
+            table.first[bits] = position;
+            bool found = false;
+            for (std::uint16_t symbol = 0; symbol < 257; ++symbol) {
+                if (huffman_codes[symbol].bits != bits) continue;
+                if (!found) {
+                    table.first_code[bits] = huffman_codes[symbol].code;
+                    found = true;
+                }
+                table.symbols[position++] = symbol;
+            }
+            const auto count = static_cast<std::uint32_t>(position - table.first[bits]);
+            table.limit[bits] = found ? table.first_code[bits] + count
+                                      : (bits > 5 ? table.limit[bits - 1] << 1 : 0);
+            if (!found) {
+                table.first_code[bits] = table.limit[bits];
+            }
+        }
+        return table;
+    }
+
+    constexpr HuffmanDecodeTable huffman_decode_table = build_decode_table();
+
+    struct StaticEntry {
+        std::string_view name;
+        std::string_view value;
+    };
+
+    // RFC 7541 附录A，下标0对应索引1
+    constexpr std::array<StaticEntry, 61> static_table{{
+        {":authority", ""}, {":method", "GET"}, {":method", "POST"}, {":path", "/"},
+        {":path", "/index.html"}, {":scheme", "http"}, {":scheme", "https"}, {":status", "200"},
+        {":status", "204"}, {":status", "206"}, {":status", "304"}, {":status", "400"},
+        {":status", "404"}, {":status", "500"}, {"accept-charset", ""}, {"accept-encoding", "gzip, deflate"},
+        {"accept-language", ""}, {"accept-ranges", ""}, {"accept", ""}, {"access-control-allow-origin", ""},
+        {"age", ""}, {"allow", ""}, {"authorization", ""}, {"cache-control", ""},
+        {"content-disposition", ""}, {"content-encoding", ""}, {"content-language", ""}, {"content-length", ""},
+        {"content-location", ""}, {"content-range", ""}, {"content-type", ""}, {"cookie", ""},
+        {"date", ""}, {"etag", ""}, {"expect", ""}, {"expires", ""},
+        {"from", ""}, {"host", ""}, {"if-match", ""}, {"if-modified-since", ""},
+        {"if-none-match", ""}, {"if-range", ""}, {"if-unmodified-since", ""}, {"last-modified", ""},
+        {"link", ""}, {"location", ""}, {"max-forwards", ""}, {"proxy-authenticate", ""},
+        {"proxy-authorization", ""}, {"range", ""}, {"referer", ""}, {"refresh", ""},
+        {"retry-after", ""}, {"server", ""}, {"set-cookie", ""}, {"strict-transport-security", ""},
+        {"transfer-encoding", ""}, {"user-agent", ""}, {"vary", ""}, {"via", ""},
+        {"www-authenticate", ""}
+    }};
+
+    // 字段名到静态表中第一个同名条目的索引（从1开始）
+    const std::unordered_map<std::string_view, std::size_t>& static_names() {
+        static const auto names = [] {
+            std::unordered_map<std::string_view, std::size_t> map;
+            for (std::size_t i = static_table.size(); i > 0; --i) {
+                map[static_table[i - 1].name] = i;
+            }
+            return map;
+        }();
+        return names;
+    }
+
+    // 值经常变化的字段，加入动态表只会挤掉有用的条目
+    bool skip_indexing(std::string_view name) noexcept {
+        return name == "content-length" || name == "etag" || name == "last-modified" ||
+               name == "date" || name == "age" || name == "expires" || name == "location" ||
+               name == "content-range";
+    }
+
+    // 敏感字段，中间节点也不能加入动态表
+    bool never_index(std::string_view name) noexcept {
+        return name == "set-cookie" || name == "authorization" || name == "proxy-authorization";
+    }
+
+    void write_integer(std::string& out, std::uint64_t value, unsigned prefix_bits, std::uint8_t first_byte) {
+        const std::uint64_t max_prefix = (1u << prefix_bits) - 1;
+        if (value < max_prefix) {
+            out.push_back(static_cast<char>(first_byte | value));
+            return;
+        }
+        out.push_back(static_cast<char>(first_byte | max_prefix));
+        value -= max_prefix;
+        while (value >= 128) {
+            out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    bool read_integer(std::span<const std::uint8_t> data, std::size_t& pos, unsigned prefix_bits, std::uint64_t& value) {
+        if (pos >= data.size()) return false;
+        const std::uint64_t max_prefix = (1u << prefix_bits) - 1;
+        value = data[pos++] & max_prefix;
+        if (value < max_prefix) return true;
+
+        unsigned shift = 0;
+        while (pos < data.size()) {
+            const auto byte = data[pos++];
+            value += static_cast<std::uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                // 超过32位的整数没有合法用途
+                return value <= 0xffffffffu;
+            }
+            shift += 7;
+            if (shift > 28) return false;
+        }
+        return false;
+    }
+}
+
+void huffman_encode(std::string_view input, std::string& out) {
+    std::uint64_t bits = 0;
+    unsigned count = 0;
+    for (const auto c : input) {
+        const auto& code = huffman_codes[static_cast<std::uint8_t>(c)];
+        bits = (bits << code.bits) | code.code;
+        count += code.bits;
+        while (count >= 8) {
+            count -= 8;
+            out.push_back(static_cast<char>(bits >> count));
+        }
+    }
+    if (count > 0) {
+        // 用EOS的前缀（全1）填充最后一个字节
+        out.push_back(static_cast<char>((bits << (8 - count)) | (0xffu >> count)));
+    }
+}
+
+std::size_t huffman_encoded_size(std::string_view input) noexcept {
+    std::size_t bits = 0;
+    for (const auto c : input) {
+        bits += huffman_codes[static_cast<std::uint8_t>(c)].bits;
+    }
+    return (bits + 7) / 8;
+}
+
+bool huffman_decode(std::span<const std::uint8_t> input, std::string& out) {
+    const auto& table = huffman_decode_table;
+    // bits的最高位对齐，count是其中有效的位数
+    std::uint64_t bits = 0;
+    unsigned count = 0;
+    std::size_t pos = 0;
+
+    while (true) {
+        while (count <= 56 && pos < input.size()) {
+            bits |= static_cast<std::uint64_t>(input[pos++]) << (56 - count);
+            count += 8;
+        }
+        if (count == 0) return true;
+
+        // 数据不足30位时用1补齐后匹配，补齐的部分只可能是EOS的前缀
+        const auto window = count >= 64 ? bits : bits | (~std::uint64_t{0} >> count);
+        unsigned length = 5;
+        std::uint32_t code = 0;
+        for (; length <= 30; ++length) {
+            code = static_cast<std::uint32_t>(window >> (64 - length));
+            if (code < table.limit[length]) break;
+        }
+        if (length > 30) return false;
+        if (length > count) {
+            // 剩余的是填充：必须少于8位且全为1
+            return count < 8 && (bits >> (64 - count)) == (std::uint64_t{1} << count) - 1;
+        }
+
+        const auto symbol = table.symbols[table.first[length] + (code - table.first_code[length])];
+        if (symbol == 256) return false;
+        out.push_back(static_cast<char>(symbol));
+        bits = length < 64 ? bits << length : 0;
+        count -= length;
+    }
+}
+
+void HpackTable::add(std::string_view name, std::string_view value) {
+    const auto size = entry_size(name, value);
+    if (size > max_size_) {
+        // 比整个表还大的条目使表清空，本身不插入
+        entries_.clear();
+        size_ = 0;
+        return;
+    }
+    evict(max_size_ - size);
+    entries_.emplace_front(std::string(name), std::string(value));
+    size_ += size;
+}
+
+void HpackTable::set_max_size(std::size_t max_size) {
+    max_size_ = max_size;
+    evict(max_size_);
+}
+
+void HpackTable::evict(std::size_t target) {
+    while (size_ > target && !entries_.empty()) {
+        const auto& [name, value] = entries_.back();
+        size_ -= entry_size(name, value);
+        entries_.pop_back();
+    }
+}
+
+long HpackTable::find(std::string_view name, std::string_view value, long& name_index) const noexcept {
+    for (std::size_t i = 0; i < entries_.size(); ++i) {
+        if (entries_[i].first != name) continue;
+        if (entries_[i].second == value) return static_cast<long>(i);
+        if (name_index < 0) name_index = static_cast<long>(i);
+    }
+    return -1;
+}
+
+bool HpackDecoder::lookup(std::uint64_t index, std::string& name, std::string* value) const {
+    if (index == 0) return false;
+    if (index <= static_table.size()) {
+        const auto& entry = static_table[index - 1];
+        name.assign(entry.name);
+        if (value) value->assign(entry.value);
+        return true;
+    }
+    index -= static_table.size() + 1;
+    if (index >= table_.count()) return false;
+    const auto& entry = table_.at(static_cast<std::size_t>(index));
+    name.assign(entry.first);
+    if (value) value->assign(entry.second);
+    return true;
+}
+
+bool HpackDecoder::read_string(std::span<const std::uint8_t> block, std::size_t& pos, std::string& out) {
+    if (pos >= block.size()) return false;
+    const bool huffman = block[pos] & 0x80;
+    std::uint64_t length = 0;
+    if (!read_integer(block, pos, 7, length) || length > block.size() - pos) return false;
+
+    out.clear();
+    const auto data = block.subspan(pos, static_cast<std::size_t>(length));
+    pos += static_cast<std::size_t>(length);
+    if (huffman) {
+        return huffman_decode(data, out);
+    }
+    out.assign(reinterpret_cast<const char*>(data.data()), data.size());
+    return true;
+}
+
+bool HpackDecoder::decode(std::span<const std::uint8_t> block, const HeaderCallback& on_header) {
+    std::size_t pos = 0;
+    bool header_seen = false;
+    while (pos < block.size()) {
+        const auto byte = block[pos];
+        std::uint64_t index = 0;
+
+        if (byte & 0x80) {
+            // 索引表示
+            if (!read_integer(block, pos, 7, index) || !lookup(index, name_, &value_)) return false;
+            on_header(name_, value_);
+            header_seen = true;
+        } else if ((byte & 0xc0) == 0x40) {
+            // 带增量索引的字面量
+            if (!read_integer(block, pos, 6, index)) return false;
+            if (index == 0 ? !read_string(block, pos, name_) : !lookup(index, name_, nullptr)) return false;
+            if (!read_string(block, pos, value_)) return false;
+            on_header(name_, value_);
+            table_.add(name_, value_);
+            header_seen = true;
+        } else if ((byte & 0xe0) == 0x20) {
+            // 动态表容量更新，只能出现在头部块开头
+            if (header_seen || !read_integer(block, pos, 5, index) || index > settings_max_size_) return false;
+            table_.set_max_size(static_cast<std::size_t>(index));
+        } else {
+            // 不索引或永不索引的字面量
+            if (!read_integer(block, pos, 4, index)) return false;
+            if (index == 0 ? !read_string(block, pos, name_) : !lookup(index, name_, nullptr)) return false;
+            if (!read_string(block, pos, value_)) return false;
+            on_header(name_, value_);
+            header_seen = true;
+        }
+    }
+    return true;
+}
+
+void HpackEncoder::set_max_table_size(std::size_t size) {
+    const auto new_size = std::min(size, preferred_table_size);
+    if (new_size == table_.max_size()) return;
+    min_size_since_update_ = std::min(min_size_since_update_, new_size);
+    table_.set_max_size(new_size);
+    size_update_pending_ = true;
+}
+
+void HpackEncoder::begin_block(std::string& out) {
+    if (!size_update_pending_) return;
+    // 两次头部块之间容量先减小后增大时，先通知最小值使对端同样淘汰条目
+    if (min_size_since_update_ < table_.max_size()) {
+        write_integer(out, min_size_since_update_, 5, 0x20);
+    }
+    write_integer(out, table_.max_size(), 5, 0x20);
+    size_update_pending_ = false;
+    min_size_since_update_ = table_.max_size();
+}
+
+void HpackEncoder::write_string(std::string_view str, std::string& out) {
+    const auto huffman_size = huffman_encoded_size(str);
+    if (huffman_size < str.size()) {
+        write_integer(out, huffman_size, 7, 0x80);
+        huffman_encode(str, out);
+    } else {
+        write_integer(out, str.size(), 7, 0x00);
+        out.append(str);
+    }
+}
+
+void HpackEncoder::encode(std::string_view name, std::string_view value, std::string& out) {
+    // 静态表：同名条目是连续的，在其中查找完全匹配
+    std::size_t name_index = 0;
+    const auto& names = static_names();
+    if (const auto it = names.find(name); it != names.end()) {
+        name_index = it->second;
+        for (auto i = name_index; i <= static_table.size() && static_table[i - 1].name == name; ++i) {
+            if (static_table[i - 1].value == value) {
+                write_integer(out, i, 7, 0x80);
+                return;
+            }
+        }
+    }
+
+    if (never_index(name)) {
+        write_integer(out, name_index, 4, 0x10);
+        if (name_index == 0) write_string(name, out);
+        write_string(value, out);
+        return;
+    }
+
+    long dynamic_name = -1;
+    const auto dynamic = table_.find(name, value, dynamic_name);
+    if (dynamic >= 0) {
+        write_integer(out, static_table.size() + 1 + static_cast<std::size_t>(dynamic), 7, 0x80);
+        return;
+    }
+    if (name_index == 0 && dynamic_name >= 0) {
+        name_index = static_table.size() + 1 + static_cast<std::size_t>(dynamic_name);
+    }
+
+    if (skip_indexing(name) || HpackTable::entry_size(name, value) > table_.max_size()) {
+        write_integer(out, name_index, 4, 0x00);
+    } else {
+        write_integer(out, name_index, 6, 0x40);
+        table_.add(name, value);
+    }
+    if (name_index == 0) write_string(name, out);
+    write_string(value, out);
+}
+
+} // namespace http2
+} // namespace hsmm
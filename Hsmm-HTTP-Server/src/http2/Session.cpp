@@ -0,0 +1,999 @@
+#include "http2/Session.hpp"
+#include "http/Compression.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Metrics.hpp"
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstring>
+#include <memory_resource>
+#include <optional>
+#include <unistd.h>
+
+namespace hsmm {
+namespace http2 {
+
+namespace {
+    constexpr std::uint32_t max_frame_size_limit = (1u << 24) - 1;
+
+    // HTTP/2禁止使用的连接级头部（RFC 9113 8.2.2）
+    bool is_connection_specific(std::string_view name) noexcept {
+        return name == "connection" || name == "keep-alive" || name == "proxy-connection" ||
+               name == "transfer-encoding" || name == "upgrade";
+    }
+
+    void to_lower(std::string_view in, std::string& out) {
+        out.assign(in);
+        for (auto& c : out) {
+            if (c >= 'A' && c <= 'Z') c = static_cast<char>(c + ('a' - 'A'));
+        }
+    }
+
+    bool decode_base64url(std::string_view in, std::string& out) {
+        std::uint32_t buffer = 0;
+        int bits = 0;
+        for (const auto c : in) {
+            int value;
+            if (c >= 'A' && c <= 'Z') value = c - 'A';
+            else if (c >= 'a' && c <= 'z') value = c - 'a' + 26;
+            else if (c >= '0' && c <= '9') value = c - '0' + 52;
+            else if (c == '-' || c == '+') value = 62;
+            else if (c == '_' || c == '/') value = 63;
+            else if (c == '=') break;
+            else return false;
+            buffer = (buffer << 6) | static_cast<std::uint32_t>(value);
+            bits += 6;
+            if (bits >= 8) {
+                bits -= 8;
+                out.push_back(static_cast<char>((buffer >> bits) & 0xff));
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief 拆分预先生成的HTTP/1.1响应
+     * @param data 响应数据
+     * @param status 状态码
+     * @param lines 头部行（每行以CRLF结尾）
+     * @param body 头部之后的响应体
+     */
+    bool parse_prebuilt(std::string_view data, int& status, std::string_view& lines, std::string_view& body) {
+        const auto line_end = data.find("\r\n");
+        const auto head_end = data.find("\r\n\r\n");
+        const auto space = data.find(' ');
+        if (line_end == std::string_view::npos || head_end == std::string_view::npos || space > line_end) {
+            return false;
+        }
+        const auto* begin = data.data() + space + 1;
+        if (std::from_chars(begin, data.data() + line_end, status).ec != std::errc{}) {
+            return false;
+        }
+        lines = data.substr(line_end + 2, head_end + 2 - (line_end + 2));
+        body = data.substr(head_end + 4);
+        return true;
+    }
+
+    void write_settings_entry(std::string& out, SettingId id, std::uint32_t value) {
+        out.push_back(static_cast<char>(static_cast<std::uint16_t>(id) >> 8));
+        out.push_back(static_cast<char>(static_cast<std::uint16_t>(id)));
+        write_u32(out, value);
+    }
+
+    bool strip_padding(const FrameHeader& header, std::span<const std::uint8_t>& payload) noexcept {
+        if (!(header.flags & flags::padded)) return true;
+        if (payload.empty() || payload[0] >= payload.size()) return false;
+        payload = payload.subspan(1, payload.size() - 1 - payload[0]);
+        return true;
+    }
+}
+
+/**
+ * @brief 单个流的状态
+ *
+ * 请求的字符串、解析结果和响应都分配在流自己的内存池上，流结束时一起释放
+ */
+struct Session::Stream {
+    Stream(std::uint32_t stream_id, std::int64_t initial_send_window, std::int64_t initial_recv_window)
+        : arena(arena_buffer.data(), arena_buffer.size())
+        , id(stream_id)
+        , send_window(initial_send_window)
+        , recv_window(initial_recv_window) {}
+
+    // 把字符串复制到流的内存池
+    std::string_view store(std::string_view str) {
+        auto* data = static_cast<char*>(arena.allocate(std::max<std::size_t>(str.size(), 1), 1));
+        std::memcpy(data, str.data(), str.size());
+        return {data, str.size()};
+    }
+
+    alignas(std::max_align_t) std::array<std::byte, 2048> arena_buffer;
+    std::pmr::monotonic_buffer_resource arena;
+
+    std::uint32_t id;
+    std::int64_t send_window;
+    std::int64_t recv_window;
+    std::uint32_t recv_unacked{0};
+
+    std::optional<http::HttpRequest> request;
+    const http::Router::Route* route{nullptr};
+    // 准入凭证，生成响应或流结束时释放
+    AdmissionControl::Ticket ticket;
+    std::optional<std::pmr::string> body;
+    std::uint64_t body_received{0};
+    std::unique_ptr<http::BodyReader> reader;
+    bool remote_closed{false};
+    bool head{false};
+    // 异步处理函数还没有完成
+    bool waiting{false};
+    // 等待期间流被重置，完成后直接释放
+    bool cancelled{false};
+    std::uint64_t handler_start{0};
+
+    std::optional<http::HttpResponse> response;
+    // 响应头已经发送，之后收到的请求体被丢弃
+    bool responded{false};
+    std::string_view pending_body;
+    std::optional<http::HttpResponse::FileBody> file;
+    bool chunked{false};
+};
+
+Session::Session(const http::Router& router, const ServerOptions& options, Post post,
+                 AdmissionControl* admission, AdmissionControl::ClientAddress client)
+    : router_(router)
+    , options_(options)
+    , post_(std::move(post))
+    , admission_(admission)
+    , client_(client)
+    , recv_window_(std::max(options.http2.connection_window_size, default_window_size)) {
+}
+
+Session::~Session() = default;
+
+void Session::start() {
+    const auto& h2 = options_.http2;
+    std::string payload;
+    write_settings_entry(payload, SettingId::max_concurrent_streams, h2.max_concurrent_streams);
+    write_settings_entry(payload, SettingId::initial_window_size, std::min(h2.initial_window_size, max_window_size));
+    write_settings_entry(payload, SettingId::max_frame_size,
+                         std::clamp(h2.max_frame_size, default_max_frame_size, max_frame_size_limit));
+    write_settings_entry(payload, SettingId::max_header_list_size, h2.max_header_list_size);
+    write_frame_header(output_, static_cast<std::uint32_t>(payload.size()), FrameType::settings, 0, 0);
+    output_.append(payload);
+
+    // 连接级窗口不能通过SETTINGS修改，只能用WINDOW_UPDATE扩大
+    if (h2.connection_window_size > default_window_size) {
+        write_window_update(0, h2.connection_window_size - default_window_size);
+    }
+}
+
+bool Session::start_upgrade(const http::HttpRequest& request, std::string_view settings) {
+    std::string decoded;
+    if (!decode_base64url(settings, decoded) || decoded.size() % 6 != 0 ||
+        apply_settings({reinterpret_cast<const std::uint8_t*>(decoded.data()), decoded.size()}) != ErrorCode::no_error) {
+        return false;
+    }
+    start();
+
+    auto stream = std::make_unique<Stream>(1, peer_initial_window_, options_.http2.initial_window_size);
+    auto& s = *stream;
+    s.request.emplace(&s.arena);
+    s.request->method = s.store(request.method);
+    s.request->uri = s.store(request.uri);
+    s.request->version = "HTTP/2.0";
+    for (const auto& [name, value] : request.headers) {
+        const auto header = http::HeaderMap::lookup(name);
+        if (header == http::Header::connection || header == http::Header::upgrade ||
+            header == http::Header::http2_settings || header == http::Header::keep_alive) {
+            continue;
+        }
+        if (header) {
+            s.request->headers.add(*header, s.store(value));
+        } else {
+            s.request->headers.add(s.store(name), s.store(value));
+        }
+    }
+    s.remote_closed = true;
+    s.head = request.method == "HEAD";
+    s.response.emplace(&s.arena);
+    s.route = &router_.find(s.request->uri);
+
+    last_stream_id_ = 1;
+    streams_.emplace(1, std::move(stream));
+    if (!admit(s)) {
+        start_response(s);
+        return true;
+    }
+    complete_request(s);
+    return true;
+}
+
+bool Session::receive(std::span<const char> data) {
+    if (failed_) return false;
+
+    // 有不完整的帧时先拼接，否则直接处理收到的数据
+    std::string_view view(data.data(), data.size());
+    if (!input_.empty()) {
+        input_.append(data.data(), data.size());
+        view = input_;
+    }
+    const auto* bytes = reinterpret_cast<const std::uint8_t*>(view.data());
+    std::size_t pos = 0;
+
+    if (!preface_received_) {
+        const auto n = std::min(view.size(), client_preface.size());
+        if (view.substr(0, n) != client_preface.substr(0, n)) {
+            input_.clear();
+            return connection_error(ErrorCode::protocol_error);
+        }
+        if (n < client_preface.size()) {
+            input_.assign(view);
+            return true;
+        }
+        preface_received_ = true;
+        pos = client_preface.size();
+    }
+
+    const auto max_frame_size = std::clamp(options_.http2.max_frame_size, default_max_frame_size, max_frame_size_limit);
+    bool ok = true;
+    while (ok && view.size() - pos >= frame_header_size) {
+        const auto header = parse_frame_header(bytes + pos);
+        if (header.length > max_frame_size) {
+            ok = connection_error(ErrorCode::frame_size_error);
+            break;
+        }
+        if (view.size() - pos - frame_header_size < header.length) {
+            break;
+        }
+        ok = process_frame(header, {bytes + pos + frame_header_size, header.length});
+        pos += frame_header_size + header.length;
+    }
+
+    if (!ok) {
+        input_.clear();
+        return false;
+    }
+    if (view.data() == input_.data()) {
+        input_.erase(0, pos);
+    } else {
+        input_.assign(view.substr(pos));
+    }
+    return true;
+}
+
+bool Session::process_frame(const FrameHeader& header, std::span<const std::uint8_t> payload) {
+    // 头部块必须连续：HEADERS之后只能是同一个流的CONTINUATION
+    if (continuation_stream_ != 0 && header.type != FrameType::continuation) {
+        return connection_error(ErrorCode::protocol_error);
+    }
+
+    switch (header.type) {
+        case FrameType::data:
+            return on_data(header, payload);
+        case FrameType::headers:
+            return on_headers(header, payload);
+        case FrameType::continuation:
+            return on_continuation(header, payload);
+        case FrameType::settings:
+            return on_settings(header, payload);
+        case FrameType::window_update:
+            return on_window_update(header, payload);
+        case FrameType::rst_stream:
+            return on_rst_stream(header, payload);
+        case FrameType::priority:
+            // 不实现优先级，只检查格式
+            if (header.stream_id == 0) return connection_error(ErrorCode::protocol_error);
+            if (payload.size() != 5) reset_stream(header.stream_id, ErrorCode::frame_size_error);
+            return true;
+        case FrameType::ping:
+            if (header.stream_id != 0) return connection_error(ErrorCode::protocol_error);
+            if (payload.size() != 8) return connection_error(ErrorCode::frame_size_error);
+            if (!(header.flags & flags::ack)) {
+                write_frame_header(output_, 8, FrameType::ping, flags::ack, 0);
+                output_.append(reinterpret_cast<const char*>(payload.data()), payload.size());
+            }
+            return true;
+        case FrameType::goaway:
+            if (header.stream_id != 0) return connection_error(ErrorCode::protocol_error);
+            goaway_received_ = true;
+            return true;
+        case FrameType::push_promise:
+            // 客户端不能推送
+            return connection_error(ErrorCode::protocol_error);
+    }
+    // 未知类型的帧直接忽略
+    return true;
+}
+
+bool Session::on_headers(const FrameHeader& header, std::span<const std::uint8_t> payload) {
+    if (header.stream_id == 0 || !strip_padding(header, payload)) {
+        return connection_error(ErrorCode::protocol_error);
+    }
+    if (header.flags & flags::priority) {
+        if (payload.size() < 5) return connection_error(ErrorCode::frame_size_error);
+        payload = payload.subspan(5);
+    }
+
+    header_block_.assign(reinterpret_cast<const char*>(payload.data()), payload.size());
+    const bool end_stream = header.flags & flags::end_stream;
+    if (header.flags & flags::end_headers) {
+        return end_header_block(header.stream_id, end_stream);
+    }
+    continuation_stream_ = header.stream_id;
+    continuation_end_stream_ = end_stream;
+    return true;
+}
+
+bool Session::on_continuation(const FrameHeader& header, std::span<const std::uint8_t> payload) {
+    if (continuation_stream_ == 0 || header.stream_id != continuation_stream_) {
+        return connection_error(ErrorCode::protocol_error);
+    }
+    header_block_.append(reinterpret_cast<const char*>(payload.data()), payload.size());
+    // 压缩后的头部块不会比解码后的上限大很多，防止用CONTINUATION无限占用内存
+    if (header_block_.size() > 2 * static_cast<std::size_t>(options_.http2.max_header_list_size) + 16384) {
+        return connection_error(ErrorCode::enhance_your_calm);
+    }
+    if (header.flags & flags::end_headers) {
+        continuation_stream_ = 0;
+        return end_header_block(header.stream_id, continuation_end_stream_);
+    }
+    return true;
+}
+
+bool Session::end_header_block(std::uint32_t stream_id, bool end_stream) {
+    const std::span<const std::uint8_t> block(reinterpret_cast<const std::uint8_t*>(header_block_.data()),
+                                              header_block_.size());
+    const auto discard = [](std::string_view, std::string_view) {};
+
+    if (const auto it = streams_.find(stream_id); it != streams_.end()) {
+        // 已有的流上的HEADERS是trailer，解码以保持HPACK状态，内容不使用
+        if (!decoder_.decode(block, discard)) return connection_error(ErrorCode::compression_error);
+        auto& s = *it->second;
+        if (s.remote_closed || !end_stream) {
+            reset_stream(stream_id, s.remote_closed ? ErrorCode::stream_closed : ErrorCode::protocol_error);
+            return true;
+        }
+        s.remote_closed = true;
+        if (!s.responded) {
+            complete_request(s);
+        }
+        return true;
+    }
+
+    if ((stream_id & 1) == 0) {
+        return connection_error(ErrorCode::protocol_error);
+    }
+    if (stream_id <= last_stream_id_ || goaway_sent_) {
+        // 已经关闭的流，或发送GOAWAY之后新建的流：只解码，不处理
+        return decoder_.decode(block, discard) || connection_error(ErrorCode::compression_error);
+    }
+    last_stream_id_ = stream_id;
+
+    auto stream = std::make_unique<Stream>(stream_id, peer_initial_window_, options_.http2.initial_window_size);
+    auto& s = *stream;
+    s.request.emplace(&s.arena);
+    auto& request = *s.request;
+
+    std::size_t list_size = 0;
+    bool too_large = false;
+    bool malformed = false;
+    bool regular_seen = false;
+    std::string_view authority;
+    const auto on_header = [&](std::string_view name, std::string_view value) {
+        list_size += name.size() + value.size() + 32;
+        if (list_size > options_.http2.max_header_list_size) {
+            too_large = true;
+            return;
+        }
+        if (name.empty() || std::any_of(name.begin(), name.end(), [](char c) { return c >= 'A' && c <= 'Z'; })) {
+            malformed = true;
+            return;
+        }
+
+        if (name[0] == ':') {
+            // 伪头部必须在普通头部之前
+            if (regular_seen) malformed = true;
+            else if (name == ":method") request.method = s.store(value);
+            else if (name == ":path") request.uri = s.store(value);
+            else if (name == ":authority") authority = s.store(value);
+            else if (name != ":scheme") malformed = true;
+            return;
+        }
+        regular_seen = true;
+        if (is_connection_specific(name) || (name == "te" && value != "trailers")) {
+            malformed = true;
+            return;
+        }
+
+        // HTTP/2的字段名都是小写，常用请求头解析为槽位编号，不需要保存字段名
+        const auto header = http::HeaderMap::lookup(name);
+        if (header == http::Header::content_length) {
+            std::uint64_t length = 0;
+            const auto* end = value.data() + value.size();
+            if (value.empty() || std::from_chars(value.data(), end, length).ptr != end ||
+                (request.content_length && *request.content_length != length)) {
+                malformed = true;
+                return;
+            }
+            request.content_length = length;
+        }
+        if (header == http::Header::cookie) {
+            // HTTP/2允许把Cookie拆成多个字段，合并回一个
+            if (const auto cookie = request.headers.get(http::Header::cookie)) {
+                std::string merged(*cookie);
+                merged.append("; ").append(value);
+                request.headers.set(http::Header::cookie, s.store(merged));
+                return;
+            }
+        }
+        if (header) {
+            request.headers.add(*header, s.store(value));
+        } else {
+            request.headers.add(s.store(name), s.store(value));
+        }
+    };
+    if (!decoder_.decode(block, on_header)) {
+        return connection_error(ErrorCode::compression_error);
+    }
+
+    if (streams_.size() >= options_.http2.max_concurrent_streams) {
+        reset_stream(stream_id, ErrorCode::refused_stream);
+        return true;
+    }
+    if (malformed || (!too_large && (request.method.empty() || request.uri.empty()))) {
+        reset_stream(stream_id, ErrorCode::protocol_error);
+        return true;
+    }
+
+    request.version = "HTTP/2.0";
+    if (!authority.empty()) {
+        request.headers.add(http::Header::host, authority);
+    }
+    s.head = request.method == "HEAD";
+    s.remote_closed = end_stream;
+    s.response.emplace(&s.arena);
+    streams_.emplace(stream_id, std::move(stream));
+
+    if (too_large) {
+        http::set_error_response(*s.response, 431, "Request Header Fields Too Large");
+        respond_early(s);
+        return true;
+    }
+
+    s.route = &router_.find(request.uri);
+    if (!admit(s)) {
+        // 请求体即使已经在路上也不再接收
+        respond_early(s);
+        return true;
+    }
+    if (end_stream) {
+        complete_request(s);
+        return true;
+    }
+
+    if (s.route->stream_handler) {
+        try {
+            s.reader = s.route->stream_handler(request, *s.response);
+        }
+        catch (const std::exception& e) {
+            LOG_ERROR("处理请求时发生错误: " + std::string(e.what()));
+            http::set_error_response(*s.response, 500, "Internal Server Error");
+        }
+        if (!s.reader) {
+            // 处理函数拒绝了请求，请求体不再接收
+            respond_early(s);
+        }
+    } else if (request.content_length.value_or(0) > options_.max_body_size) {
+        http::set_error_response(*s.response, 413, "Payload Too Large");
+        respond_early(s);
+    } else {
+        s.body.emplace(&s.arena);
+        s.body->reserve(static_cast<std::size_t>(request.content_length.value_or(0)));
+    }
+    return true;
+}
+
+bool Session::on_data(const FrameHeader& header, std::span<const std::uint8_t> payload) {
+    if (header.stream_id == 0) {
+        return connection_error(ErrorCode::protocol_error);
+    }
+
+    // 连接级流量控制按整个帧（包括填充）计算，收到的数据立即处理，窗口随即可以归还
+    recv_window_ -= header.length;
+    if (recv_window_ < 0) {
+        return connection_error(ErrorCode::flow_control_error);
+    }
+    recv_unacked_ += header.length;
+    if (recv_unacked_ >= options_.http2.connection_window_size / 2) {
+        write_window_update(0, recv_unacked_);
+        recv_window_ += recv_unacked_;
+        recv_unacked_ = 0;
+    }
+
+    const auto it = streams_.find(header.stream_id);
+    if (it == streams_.end()) {
+        // 空闲的流上不能有数据；已经重置或完成的流上还在路上的数据直接丢弃
+        return header.stream_id <= last_stream_id_ || connection_error(ErrorCode::protocol_error);
+    }
+    auto& s = *it->second;
+    if (s.remote_closed) {
+        reset_stream(header.stream_id, ErrorCode::stream_closed);
+        return true;
+    }
+    s.recv_window -= header.length;
+    if (s.recv_window < 0) {
+        reset_stream(header.stream_id, ErrorCode::flow_control_error);
+        return true;
+    }
+    if (!strip_padding(header, payload)) {
+        return connection_error(ErrorCode::protocol_error);
+    }
+
+    const std::span<const char> data(reinterpret_cast<const char*>(payload.data()), payload.size());
+    s.body_received += data.size();
+    if (!s.responded) {
+        if (s.reader) {
+            try {
+                s.reader->on_data(data);
+            }
+            catch (const std::exception& e) {
+                LOG_ERROR("处理请求体时发生错误: " + std::string(e.what()));
+                http::set_error_response(*s.response, 500, "Internal Server Error");
+                respond_early(s);
+            }
+        } else if (s.body->size() + data.size() > options_.max_body_size) {
+            http::set_error_response(*s.response, 413, "Payload Too Large");
+            respond_early(s);
+        } else {
+            s.body->append(data.data(), data.size());
+        }
+    }
+
+    // 提前响应且没有响应体的流在respond_early中已经释放
+    const auto current = streams_.find(header.stream_id);
+    if (current == streams_.end()) {
+        return true;
+    }
+    if (header.flags & flags::end_stream) {
+        s.remote_closed = true;
+        if (!s.responded) {
+            complete_request(s);
+        }
+        return true;
+    }
+
+    s.recv_unacked += header.length;
+    if (s.recv_unacked >= options_.http2.initial_window_size / 2) {
+        write_window_update(s.id, s.recv_unacked);
+        s.recv_window += s.recv_unacked;
+        s.recv_unacked = 0;
+    }
+    return true;
+}
+
+bool Session::on_settings(const FrameHeader& header, std::span<const std::uint8_t> payload) {
+    if (header.stream_id != 0) {
+        return connection_error(ErrorCode::protocol_error);
+    }
+    if (header.flags & flags::ack) {
+        return payload.empty() || connection_error(ErrorCode::frame_size_error);
+    }
+    if (payload.size() % 6 != 0) {
+        return connection_error(ErrorCode::frame_size_error);
+    }
+    if (const auto error = apply_settings(payload); error != ErrorCode::no_error) {
+        return connection_error(error);
+    }
+    write_frame_header(output_, 0, FrameType::settings, flags::ack, 0);
+    return true;
+}
+
+ErrorCode Session::apply_settings(std::span<const std::uint8_t> payload) {
+    for (std::size_t pos = 0; pos + 6 <= payload.size(); pos += 6) {
+        const auto id = static_cast<SettingId>((payload[pos] << 8) | payload[pos + 1]);
+        const auto value = read_u32(payload.data() + pos + 2);
+        switch (id) {
+            case SettingId::header_table_size:
+                encoder_.set_max_table_size(value);
+                break;
+            case SettingId::enable_push:
+                if (value > 1) return ErrorCode::protocol_error;
+                break;
+            case SettingId::initial_window_size: {
+                if (value > max_window_size) return ErrorCode::flow_control_error;
+                // 新的初始窗口按差值调整所有已打开的流
+                const auto delta = static_cast<std::int64_t>(value) - peer_initial_window_;
+                for (auto& [stream_id, stream] : streams_) {
+                    stream->send_window += delta;
+                    if (stream->send_window > max_window_size) return ErrorCode::flow_control_error;
+                }
+                peer_initial_window_ = value;
+                break;
+            }
+            case SettingId::max_frame_size:
+                if (value < default_max_frame_size || value > max_frame_size_limit) return ErrorCode::protocol_error;
+                peer_max_frame_size_ = value;
+                break;
+            default:
+                break;
+        }
+    }
+    return ErrorCode::no_error;
+}
+
+bool Session::on_window_update(const FrameHeader& header, std::span<const std::uint8_t> payload) {
+    if (payload.size() != 4) {
+        return connection_error(ErrorCode::frame_size_error);
+    }
+    const auto increment = read_u32(payload.data()) & 0x7fffffff;
+
+    if (header.stream_id == 0) {
+        if (increment == 0) return connection_error(ErrorCode::protocol_error);
+        send_window_ += increment;
+        return send_window_ <= max_window_size || connection_error(ErrorCode::flow_control_error);
+    }
+
+    const auto it = streams_.find(header.stream_id);
+    if (it == streams_.end()) {
+        return header.stream_id <= last_stream_id_ || connection_error(ErrorCode::protocol_error);
+    }
+    auto& s = *it->second;
+    if (increment == 0) {
+        reset_stream(s.id, ErrorCode::protocol_error);
+        return true;
+    }
+    s.send_window += increment;
+    if (s.send_window > max_window_size) {
+        reset_stream(s.id, ErrorCode::flow_control_error);
+    }
+    return true;
+}
+
+bool Session::on_rst_stream(const FrameHeader& header, std::span<const std::uint8_t> payload) {
+    if (payload.size() != 4) {
+        return connection_error(ErrorCode::frame_size_error);
+    }
+    if (header.stream_id == 0 || header.stream_id > last_stream_id_) {
+        return connection_error(ErrorCode::protocol_error);
+    }
+    // 客户端取消了请求，不再发送响应
+    if (const auto it = streams_.find(header.stream_id); it != streams_.end()) {
+        erase_stream(it);
+    }
+    return true;
+}
+
+void Session::complete_request(Stream& s) {
+    auto& request = *s.request;
+    if (request.content_length && *request.content_length != s.body_received) {
+        // 请求体长度与content-length不符是格式错误（RFC 9113 8.1.1）
+        reset_stream(s.id, ErrorCode::protocol_error);
+        return;
+    }
+
+    if (s.route->async_handler && post_) {
+        if (s.body) {
+            request.body = *s.body;
+        }
+        request.post = &post_;
+        s.waiting = true;
+        s.handler_start = utils::Metrics::now_ns();
+        ++async_pending_;
+        try {
+            s.route->async_handler(request, *s.response, [this, post = post_, stream = &s] {
+                post([this, stream] { resume(stream); });
+            });
+        }
+        catch (const std::exception& e) {
+            LOG_ERROR("处理请求时发生错误: " + std::string(e.what()));
+            http::set_error_response(*s.response, 500, "Internal Server Error");
+            s.waiting = false;
+            --async_pending_;
+            start_response(s);
+        }
+        return;
+    }
+
+    const auto handler_start = utils::Metrics::now_ns();
+    if (s.reader) {
+        try {
+            s.reader->on_complete(*s.response);
+        }
+        catch (const std::exception& e) {
+            LOG_ERROR("处理请求时发生错误: " + std::string(e.what()));
+            http::set_error_response(*s.response, 500, "Internal Server Error");
+        }
+    } else {
+        if (s.body) {
+            request.body = *s.body;
+        }
+        s.reader = http::Router::handle(*s.route, request, *s.response);
+    }
+    utils::Metrics::record(utils::Timer::handler, utils::Metrics::now_ns() - handler_start);
+    start_response(s);
+}
+
+void Session::resume(Stream* s) {
+    --async_pending_;
+    s->waiting = false;
+    if (s->cancelled) {
+        std::erase_if(detached_, [s](const auto& stream) { return stream.get() == s; });
+        return;
+    }
+    utils::Metrics::record(utils::Timer::handler, utils::Metrics::now_ns() - s->handler_start);
+    start_response(*s);
+}
+
+void Session::respond_early(Stream& s) {
+    start_response(s);
+}
+
+bool Session::admit(Stream& s) {
+    if (!admission_) {
+        return true;
+    }
+    const auto decision = admission_->admit(client_, s.request->uri, s.ticket);
+    if (decision == AdmissionControl::Decision::admit) {
+        return true;
+    }
+    AdmissionControl::set_rejection(*s.response, decision);
+    return false;
+}
+
+void Session::start_response(Stream& s) {
+    s.responded = true;
+    s.ticket.respond();
+    auto& response = *s.response;
+
+    // 多路复用的连接上压缩直接在IO线程执行，避免响应顺序依赖线程池
+    if (const auto encoding = http::negotiate_response_encoding(*s.request, response, options_.compression);
+        encoding != http::ContentEncoding::identity) {
+        try {
+            http::compress_response(response, encoding, options_.compression);
+        }
+        catch (const std::exception& e) {
+            LOG_ERROR("压缩响应失败: " + std::string(e.what()));
+        }
+    }
+
+    auto& block = scratch_;
+    block.clear();
+    encoder_.begin_block(block);
+    std::string name;
+    char digits[24];
+    int status = response.status_code();
+
+    if (!response.prebuilt().empty()) {
+        // 预先生成的HTTP/1.1响应：拆出状态码和头部，头部之后的部分作为响应体
+        std::string_view lines;
+        std::string_view body;
+        if (!parse_prebuilt(response.prebuilt(), status, lines, body)) {
+            reset_stream(s.id, ErrorCode::internal_error);
+            return;
+        }
+        encoder_.encode(":status", std::string_view(digits, std::to_chars(digits, digits + sizeof(digits), status).ptr), block);
+        while (!lines.empty()) {
+            const auto line = lines.substr(0, lines.find("\r\n"));
+            lines.remove_prefix(std::min(lines.size(), line.size() + 2));
+            const auto colon = line.find(':');
+            if (colon == std::string_view::npos) continue;
+            auto value = line.substr(colon + 1);
+            while (!value.empty() && value.front() == ' ') value.remove_prefix(1);
+            to_lower(line.substr(0, colon), name);
+            if (!is_connection_specific(name)) {
+                encoder_.encode(name, value, block);
+            }
+        }
+        s.pending_body = body;
+        s.file = response.file_body();
+    } else {
+        encoder_.encode(":status", std::string_view(digits, std::to_chars(digits, digits + sizeof(digits), status).ptr), block);
+        bool has_length = false;
+        for (const auto& [header_name, value] : response.headers()) {
+            to_lower(header_name, name);
+            if (is_connection_specific(name)) continue;
+            has_length = has_length || name == "content-length";
+            encoder_.encode(name, value, block);
+        }
+
+        const bool bodiless = status < 200 || status == 204 || status == 304;
+        if (!bodiless) {
+            const auto length = response.content_length();
+            if (length && !has_length) {
+                encoder_.encode("content-length",
+                    std::string_view(digits, std::to_chars(digits, digits + sizeof(digits), *length).ptr), block);
+            }
+            s.pending_body = response.body();
+            s.file = response.file_body();
+            s.chunked = static_cast<bool>(response.chunked_body());
+        }
+    }
+
+    utils::Metrics::add(utils::Counter::requests);
+    utils::Metrics::count_response(status);
+
+    if (s.head) {
+        s.pending_body = {};
+        s.file.reset();
+        s.chunked = false;
+    }
+    const bool has_data = !s.pending_body.empty() || (s.file && s.file->length > 0) || s.chunked;
+    write_header_block(s.id, block, !has_data);
+    if (has_data) {
+        sending_.push_back(&s);
+    } else {
+        close_stream(s.id);
+    }
+}
+
+bool Session::write_data(Stream& s, std::size_t limit) {
+    const auto header_pos = output_.size();
+    std::size_t length = 0;
+    bool end = false;
+
+    if (!s.pending_body.empty()) {
+        length = std::min(limit, s.pending_body.size());
+        output_.resize(header_pos + frame_header_size);
+        output_.append(s.pending_body.substr(0, length));
+        s.pending_body.remove_prefix(length);
+        end = s.pending_body.empty() && !(s.file && s.file->length > 0) && !s.chunked;
+    } else if (s.file && s.file->length > 0) {
+        auto& file = *s.file;
+        length = static_cast<std::size_t>(std::min<std::uint64_t>(limit, file.length));
+        output_.resize(header_pos + frame_header_size + length);
+        std::size_t done = 0;
+        while (done < length) {
+            const auto n = ::pread(file.fd, output_.data() + header_pos + frame_header_size + done,
+                                   length - done, static_cast<off_t>(file.offset + done));
+            if (n <= 0) {
+                if (n < 0 && errno == EINTR) continue;
+                // 文件在发送过程中被截断或读取失败，响应已无法完整发送
+                output_.resize(header_pos);
+                throw std::runtime_error("读取文件失败");
+            }
+            done += static_cast<std::size_t>(n);
+        }
+        file.offset += length;
+        file.length -= length;
+        end = file.length == 0 && !s.chunked;
+    } else {
+        // 分块数据源直接写入输出缓冲区，返回0表示结束
+        output_.resize(header_pos + frame_header_size + limit);
+        try {
+            length = s.response->chunked_body()({output_.data() + header_pos + frame_header_size, limit});
+        }
+        catch (...) {
+            output_.resize(header_pos);
+            throw;
+        }
+        length = std::min(length, limit);
+        output_.resize(header_pos + frame_header_size + length);
+        end = length == 0;
+    }
+
+    std::string header;
+    write_frame_header(header, static_cast<std::uint32_t>(length), FrameType::data,
+                       end ? flags::end_stream : 0, s.id);
+    std::memcpy(output_.data() + header_pos, header.data(), frame_header_size);
+
+    s.send_window -= static_cast<std::int64_t>(length);
+    send_window_ -= static_cast<std::int64_t>(length);
+    return end;
+}
+
+bool Session::take_output(std::string& out) {
+    // 轮流从各个流取一个帧，直到窗口用完或达到一次写出的上限
+    const auto batch = options_.http2.max_write_batch;
+    std::size_t blocked = 0;
+    while (!sending_.empty() && output_.size() < batch && send_window_ > 0 && blocked < sending_.size()) {
+        auto* s = sending_.front();
+        sending_.pop_front();
+        if (s->send_window <= 0) {
+            sending_.push_back(s);
+            ++blocked;
+            continue;
+        }
+        blocked = 0;
+
+        const auto limit = static_cast<std::size_t>(std::min<std::int64_t>(
+            {static_cast<std::int64_t>(peer_max_frame_size_), s->send_window, send_window_}));
+        try {
+            if (write_data(*s, limit)) {
+                close_stream(s->id);
+            } else {
+                sending_.push_back(s);
+            }
+        }
+        catch (const std::exception& e) {
+            LOG_ERROR("发送响应数据失败: " + std::string(e.what()));
+            reset_stream(s->id, ErrorCode::internal_error);
+        }
+    }
+
+    if (output_.empty()) {
+        return false;
+    }
+    if (out.empty()) {
+        out.swap(output_);
+    } else {
+        out.append(output_);
+        output_.clear();
+    }
+    return true;
+}
+
+void Session::close_stream(std::uint32_t stream_id) {
+    const auto it = streams_.find(stream_id);
+    if (it == streams_.end()) return;
+    if (!it->second->remote_closed) {
+        // 请求体还没收完就已经响应：通知客户端停止发送
+        write_frame_header(output_, 4, FrameType::rst_stream, 0, stream_id);
+        write_u32(output_, static_cast<std::uint32_t>(ErrorCode::no_error));
+    }
+    erase_stream(it);
+}
+
+void Session::reset_stream(std::uint32_t stream_id, ErrorCode code) {
+    write_frame_header(output_, 4, FrameType::rst_stream, 0, stream_id);
+    write_u32(output_, static_cast<std::uint32_t>(code));
+    if (const auto it = streams_.find(stream_id); it != streams_.end()) {
+        erase_stream(it);
+    }
+}
+
+void Session::erase_stream(std::unordered_map<std::uint32_t, std::unique_ptr<Stream>>::iterator it) {
+    auto& stream = it->second;
+    std::erase(sending_, stream.get());
+    if (stream->waiting) {
+        stream->cancelled = true;
+        detached_.push_back(std::move(stream));
+    }
+    streams_.erase(it);
+}
+
+bool Session::connection_error(ErrorCode code) {
+    LOG_DEBUG("HTTP/2连接错误: " + std::to_string(static_cast<std::uint32_t>(code)));
+    write_frame_header(output_, 8, FrameType::goaway, 0, 0);
+    write_u32(output_, last_stream_id_);
+    write_u32(output_, static_cast<std::uint32_t>(code));
+    goaway_sent_ = true;
+    failed_ = true;
+    return false;
+}
+
+void Session::shutdown() {
+    if (goaway_sent_) return;
+    goaway_sent_ = true;
+    write_frame_header(output_, 8, FrameType::goaway, 0, 0);
+    write_u32(output_, last_stream_id_);
+    write_u32(output_, static_cast<std::uint32_t>(ErrorCode::no_error));
+}
+
+bool Session::closed() const noexcept {
+    return failed_ || ((goaway_sent_ || goaway_received_) && streams_.empty());
+}
+
+void Session::write_window_update(std::uint32_t stream_id, std::uint32_t increment) {
+    write_frame_header(output_, 4, FrameType::window_update, 0, stream_id);
+    write_u32(output_, increment);
+}
+
+void Session::write_header_block(std::uint32_t stream_id, std::string_view block, bool end_stream) {
+    // 超过对端最大帧长度的头部块拆成HEADERS和若干CONTINUATION
+    std::size_t pos = 0;
+    bool first = true;
+    do {
+        const auto length = std::min<std::size_t>(block.size() - pos, peer_max_frame_size_);
+        const bool last = pos + length == block.size();
+        std::uint8_t frame_flags = last ? flags::end_headers : 0;
+        if (first && end_stream) frame_flags |= flags::end_stream;
+        write_frame_header(output_, static_cast<std::uint32_t>(length),
+                           first ? FrameType::headers : FrameType::continuation, frame_flags, stream_id);
+        output_.append(block.substr(pos, length));
+        pos += length;
+        first = false;
+    } while (pos < block.size());
+}
+
+} // namespace http2
+} // namespace hsmm
@@ -1,18 +1,63 @@
 #include "server/Server.hpp"
+#include "utils/CpuAffinity.hpp"
 #include "utils/Logger.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
 #include <iostream>
 #include <stdexcept>
 #include <cstdlib>
-#include <csignal>
 #include <filesystem>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
 
 namespace {
-    std::unique_ptr<hsmm::Server> server;
+    // 示例：流式接收上传的数据，只统计字节数，请求体不缓存在内存中
+    class UploadCounter : public hsmm::http::BodyReader {
+    public:
+        void on_data(std::span<const char> data) override {
+            received_ += data.size();
+        }
+
+        void on_complete(hsmm::http::HttpResponse& response) override {
+            result_ = "received " + std::to_string(received_) + " bytes\n";
+            response.set_status(200, "OK");
+            response.add_header("Content-Type", "text/plain");
+            response.set_body(result_);
+        }
 
-    void signal_handler(int signal) {
-        if (server) {
-            std::cout << "\n正在关闭服务器..." << std::endl;
-            server->stop();
+    private:
+        std::uint64_t received_{0};
+        std::string result_;
+    };
+
+    // 解析"--名称=值"形式的选项，不是选项的参数按原顺序放入positional
+    void parse_options(int argc, char* argv[], hsmm::ServerOptions& options, std::vector<char*>& positional) {
+        for (int i = 1; i < argc; ++i) {
+            const std::string_view arg(argv[i]);
+            if (arg.substr(0, 2) != "--") {
+                positional.push_back(argv[i]);
+                continue;
+            }
+            const auto eq = arg.find('=');
+            const auto name = arg.substr(2, eq == std::string_view::npos ? std::string_view::npos : eq - 2);
+            const std::string value(eq == std::string_view::npos ? std::string_view() : arg.substr(eq + 1));
+            if (name == "cpus") {
+                // IO线程依次绑定的CPU，例如 --cpus=0-7,16-23
+                options.cpu.affinity = hsmm::utils::parse_cpu_list(value);
+            } else if (name == "numa-local") {
+                options.cpu.numa_local = true;
+            } else if (name == "busy-poll") {
+                // SO_BUSY_POLL，单位微秒
+                options.cpu.busy_poll = std::chrono::microseconds(std::stoul(value));
+            } else if (name == "spin") {
+                // IO线程空闲后忙等的时间，单位微秒
+                options.cpu.spin = std::chrono::microseconds(std::stoul(value));
+            } else {
+                throw std::runtime_error("未知选项: " + std::string(arg));
+            }
         }
     }
 }
@@ -26,27 +71,109 @@ int main(int argc, char* argv[]) {
         
         LOG_INFO("正在启动服务器...");
 
-        // 设置信号处理
-        std::signal(SIGINT, signal_handler);
-        std::signal(SIGTERM, signal_handler);
-
         // 默认配置
         const char* address = "0.0.0.0";
         unsigned short port = 8080;
         size_t thread_count = std::thread::hardware_concurrency();
+        const char* static_root = nullptr;
+        const char* proxy_spec = nullptr;
+        hsmm::ServerOptions options;
 
-        // 解析命令行参数
-        if (argc > 1) address = argv[1];
-        if (argc > 2) port = static_cast<unsigned short>(std::atoi(argv[2]));
-        if (argc > 3) thread_count = static_cast<size_t>(std::atoi(argv[3]));
+        // 解析命令行参数：--开头的是选项，可以出现在任意位置，其余按位置解析
+        std::vector<char*> args;
+        parse_options(argc, argv, options, args);
+        if (args.size() > 0) address = args[0];
+        if (args.size() > 1) port = static_cast<unsigned short>(std::atoi(args[1]));
+        if (args.size() > 2) thread_count = static_cast<size_t>(std::atoi(args[2]));
+        // 静态文件目录为空字符串时不提供静态文件服务
+        if (args.size() > 3 && args[3][0] != '\0') static_root = args[3];
+        // 反向代理："/prefix/=host:port,host:port"
+        if (args.size() > 4 && args[4][0] != '\0') proxy_spec = args[4];
+        // TLS：证书链文件和私钥文件（PEM），配置后端口只接受HTTPS
+        if (args.size() > 6) {
+            options.tls.certificate_file = args[5];
+            options.tls.private_key_file = args[6];
+        }
 
         // 创建并启动服务器
         LOG_INFO("配置信息：");
         LOG_INFO("  - 监听地址: " + std::string(address));
         LOG_INFO("  - 端口: " + std::to_string(port));
         LOG_INFO("  - 线程数: " + std::to_string(thread_count));
+        if (!options.cpu.affinity.empty()) {
+            std::string cpus;
+            for (const int cpu : options.cpu.affinity) {
+                if (!cpus.empty()) cpus += ',';
+                cpus += std::to_string(cpu);
+            }
+            LOG_INFO("  - 绑定CPU: " + cpus + (options.cpu.numa_local ? "（NUMA本地内存）" : ""));
+        }
+
+        if (!options.tls.certificate_file.empty()) {
+            LOG_INFO("  - TLS证书: " + options.tls.certificate_file);
+        }
 
-        server = std::make_unique<hsmm::Server>(address, port, thread_count);
+        // SIGINT/SIGTERM由服务器内部处理，收到后优雅关闭，run()在关闭完成后返回
+        auto server = std::make_unique<hsmm::Server>(address, port, thread_count, options);
+        if (static_root) {
+            LOG_INFO("  - 静态文件目录: " + std::string(static_root));
+            server->serve_static(static_root, "/static/");
+        }
+        if (proxy_spec) {
+            const std::string spec(proxy_spec);
+            const auto eq = spec.find('=');
+            if (eq == std::string::npos || eq == 0) {
+                throw std::runtime_error("反向代理参数格式错误，应为 /prefix/=host:port,host:port");
+            }
+            std::vector<std::string> upstreams;
+            for (size_t pos = eq + 1; pos <= spec.size();) {
+                const auto comma = std::min(spec.find(',', pos), spec.size());
+                if (comma > pos) upstreams.push_back(spec.substr(pos, comma - pos));
+                pos = comma + 1;
+            }
+            LOG_INFO("  - 反向代理: " + spec);
+            server->reverse_proxy(spec.substr(0, eq), upstreams);
+        }
+        // 示例：经过响应缓存的动态路由，1秒内的请求直接使用缓存的响应，
+        // 过期后5秒内先返回旧响应，同时在后台刷新
+        server->add_cached_route("/cached/time",
+            [](const hsmm::http::HttpRequest&, hsmm::http::HttpResponse& response) {
+                const auto now = std::chrono::system_clock::now().time_since_epoch();
+                auto text = std::make_shared<std::string>(
+                    std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(now).count()) + "\n");
+                response.set_status(200, "OK");
+                response.add_header("Content-Type", "text/plain");
+                response.add_header("Cache-Control", "max-age=1, stale-while-revalidate=5");
+                const std::string_view body(*text);
+                response.set_body(body, std::move(text));
+            });
+        // 示例：会阻塞的处理函数（模拟一次50ms的数据库查询），在处理函数线程池上执行，不占用IO线程
+        server->add_blocking_route("/blocking/query",
+            [](const hsmm::http::HttpRequest&, hsmm::http::HttpResponse& response) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+                response.set_status(200, "OK");
+                response.add_header("Content-Type", "text/plain");
+                response.set_body("query done\n");
+            });
+        // 示例：WebSocket回显
+        server->router().add_websocket_route("/ws/echo", hsmm::websocket::Handler{
+            nullptr,
+            [](const std::shared_ptr<hsmm::websocket::Socket>& socket, std::string_view message, bool binary) {
+                socket->send(message, binary);
+            },
+            nullptr});
+        // 示例：WebSocket聊天室，每条消息只序列化一次，广播给所有连接
+        auto chat = std::make_shared<hsmm::websocket::Channel>();
+        server->router().add_websocket_route("/ws/chat", hsmm::websocket::Handler{
+            [chat](const std::shared_ptr<hsmm::websocket::Socket>& socket) { chat->subscribe(socket); },
+            [chat](const std::shared_ptr<hsmm::websocket::Socket>&, std::string_view message, bool binary) {
+                chat->publish(message, binary);
+            },
+            [chat](const std::shared_ptr<hsmm::websocket::Socket>& socket, std::uint16_t) { chat->unsubscribe(*socket); }});
+        server->router().add_stream_route("/upload",
+            [](const hsmm::http::HttpRequest&, hsmm::http::HttpResponse&) {
+                return std::make_unique<UploadCounter>();
+            });
         
         LOG_INFO("服务器创建成功，开始运行...");
         server->run();
@@ -0,0 +1,771 @@
+#include "proxy/ReverseProxy.hpp"
+#include "utils/Logger.hpp"
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+#include <sys/socket.h>
+
+namespace hsmm {
+namespace proxy {
+
+using boost::asio::ip::tcp;
+
+namespace {
+    // 上游响应头的大小上限
+    constexpr size_t max_head_size = 64 * 1024;
+    constexpr size_t initial_buffer_size = 16 * 1024;
+
+    bool iequals(std::string_view a, std::string_view b) noexcept {
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+            const auto lower = [](char c) { return c >= 'A' && c <= 'Z' ? static_cast<char>(c + ('a' - 'A')) : c; };
+            return lower(x) == lower(y);
+        });
+    }
+
+    std::string_view trim(std::string_view str) noexcept {
+        while (!str.empty() && (str.front() == ' ' || str.front() == '\t')) str.remove_prefix(1);
+        while (!str.empty() && (str.back() == ' ' || str.back() == '\t')) str.remove_suffix(1);
+        return str;
+    }
+
+    // 逐跳头部，只对一个连接有效，不转发（RFC 9110 7.6.1）
+    bool is_hop_by_hop(std::string_view name) noexcept {
+        static constexpr std::array<std::string_view, 8> names{
+            "Connection", "Keep-Alive", "Proxy-Connection", "TE", "Trailer", "Transfer-Encoding", "Upgrade",
+            "Proxy-Authorization"
+        };
+        return std::any_of(names.begin(), names.end(), [&](std::string_view hop) { return iequals(name, hop); });
+    }
+
+    // 名字出现在Connection头中的字段同样只对当前连接有效
+    bool listed_in(std::string_view connection, std::string_view name) noexcept {
+        while (!connection.empty()) {
+            const auto comma = connection.find(',');
+            if (iequals(trim(connection.substr(0, comma)), name)) return true;
+            if (comma == std::string_view::npos) break;
+            connection.remove_prefix(comma + 1);
+        }
+        return false;
+    }
+
+    bool is_idempotent(std::string_view method) noexcept {
+        return method == "GET" || method == "HEAD" || method == "PUT" || method == "DELETE" ||
+               method == "OPTIONS" || method == "TRACE";
+    }
+}
+
+/**
+ * @brief 上游服务器
+ */
+struct ReverseProxy::Upstream {
+    size_t index;
+    std::string address;
+    std::vector<tcp::endpoint> endpoints;
+
+    std::atomic<bool> healthy{true};
+    std::atomic<unsigned> failures_in_row{0};
+    std::atomic<unsigned> successes_in_row{0};
+    // 进行中的请求数，用于最少连接数均衡
+    std::atomic<size_t> active{0};
+
+    struct Idle {
+        tcp::socket socket;
+        std::chrono::steady_clock::time_point since;
+    };
+    // 空闲连接，按放回的顺序排列，从尾部取出最近使用过的连接
+    std::mutex mutex;
+    std::vector<Idle> idle;
+};
+
+/**
+ * @brief 一次请求的转发过程
+ *
+ * 所有回调在自己的strand上执行。请求和响应属于客户端连接，在调用done之前保持有效。
+ */
+class ReverseProxy::Exchange : public std::enable_shared_from_this<Exchange> {
+public:
+    Exchange(std::shared_ptr<ReverseProxy> proxy, const http::HttpRequest& request,
+             http::HttpResponse& response, http::Router::Completion done)
+        : proxy_(std::move(proxy))
+        , request_(request)
+        , response_(response)
+        , done_(std::move(done))
+        , strand_(boost::asio::make_strand(proxy_->io_context_))
+        , timer_(strand_)
+        , tried_(proxy_->upstreams_.size(), false)
+        , idempotent_(is_idempotent(request.method)) {
+    }
+
+    void start() {
+        boost::asio::post(strand_, [self = shared_from_this()] { self->attempt(); });
+    }
+
+private:
+    // 上游响应的缓冲区，同时作为交给客户端的响应数据的持有者
+    struct Buffer {
+        std::unique_ptr<char[]> data;
+        size_t capacity{0};
+        // HEAD请求的响应头，作为预先生成的响应发送
+        std::string head;
+    };
+
+    enum class Framing { none, length, chunked, close };
+    enum class Progress { more, done, error };
+
+    void attempt() {
+        upstream_ = proxy_->select(tried_);
+        if (!upstream_) {
+            reply(502, "Bad Gateway");
+            return;
+        }
+        upstream_->active.fetch_add(1, std::memory_order_relaxed);
+        filled_ = 0;
+        head_size_ = 0;
+        timed_out_ = false;
+
+        if (auto socket = proxy_->acquire(*upstream_)) {
+            socket_.emplace(std::move(*socket));
+            reused_ = true;
+            write_request();
+        } else {
+            reused_ = false;
+            connect();
+        }
+    }
+
+    void connect() {
+        connecting_ = true;
+        socket_.emplace(proxy_->io_context_);
+        arm(proxy_->options_.connect_timeout);
+        boost::asio::async_connect(*socket_, upstream_->endpoints, boost::asio::bind_executor(strand_,
+            [self = shared_from_this()](boost::system::error_code ec, const tcp::endpoint&) {
+                if (ec) {
+                    self->fail();
+                    return;
+                }
+                boost::system::error_code ignored;
+                self->socket_->set_option(tcp::no_delay(true), ignored);
+                self->write_request();
+            }));
+    }
+
+    void write_request() {
+        connecting_ = false;
+        arm(proxy_->options_.response_timeout);
+        if (head_.empty()) {
+            build_head();
+        }
+
+        // 请求头和请求体一次聚集写出，请求体不复制
+        const std::array<boost::asio::const_buffer, 2> buffers{
+            boost::asio::buffer(head_.data(), head_.size()),
+            boost::asio::buffer(request_.body.data(), request_.body.size())
+        };
+        boost::asio::async_write(*socket_, buffers, boost::asio::bind_executor(strand_,
+            [self = shared_from_this()](boost::system::error_code ec, std::size_t) {
+                if (ec) {
+                    self->fail();
+                    return;
+                }
+                self->read_response();
+            }));
+    }
+
+    void build_head() {
+        head_.reserve(256);
+        head_.append(request_.method).append(" ").append(request_.uri).append(" HTTP/1.1\r\n");
+
+        const auto connection_value = request_.headers.get(http::Header::connection).value_or(std::string_view{});
+        for (const auto& [name, value] : request_.headers) {
+            if (is_hop_by_hop(name) || iequals(name, "Content-Length") || iequals(name, "Expect") ||
+                listed_in(connection_value, name)) {
+                continue;
+            }
+            head_.append(name).append(": ").append(value).append("\r\n");
+        }
+        // 客户端的分块请求体已经解码，按实际长度转发
+        if (!request_.body.empty() || request_.method == "POST" || request_.method == "PUT" ||
+            request_.method == "PATCH") {
+            char number[24];
+            head_.append("Content-Length: ");
+            head_.append(number, std::to_chars(number, number + sizeof(number), request_.body.size()).ptr);
+            head_.append("\r\n");
+        }
+        head_.append("\r\n");
+    }
+
+    void read_response() {
+        if (!buffer_) {
+            buffer_ = std::make_shared<Buffer>();
+            buffer_->data = std::make_unique_for_overwrite<char[]>(initial_buffer_size);
+            buffer_->capacity = initial_buffer_size;
+        }
+        if (filled_ == buffer_->capacity && !make_room()) {
+            LOG_WARNING("上游响应过大: " + upstream_->address);
+            finish_error(502, "Bad Gateway");
+            return;
+        }
+
+        socket_->async_read_some(
+            boost::asio::buffer(buffer_->data.get() + filled_, buffer_->capacity - filled_),
+            boost::asio::bind_executor(strand_,
+                [self = shared_from_this()](boost::system::error_code ec, std::size_t length) {
+                    self->on_read(ec, length);
+                }));
+    }
+
+    void on_read(boost::system::error_code ec, std::size_t length) {
+        if (ec == boost::asio::error::eof && head_size_ > 0 && framing_ == Framing::close) {
+            // 没有长度信息的响应以上游关闭连接结束
+            body_end_ = filled_;
+            keep_alive_ = false;
+            finish();
+            return;
+        }
+        if (ec) {
+            fail();
+            return;
+        }
+
+        filled_ += length;
+        switch (parse()) {
+            case Progress::more:
+                read_response();
+                break;
+            case Progress::done:
+                finish();
+                break;
+            case Progress::error:
+                LOG_WARNING("上游响应格式错误: " + upstream_->address);
+                finish_error(502, "Bad Gateway");
+                break;
+        }
+    }
+
+    /**
+     * @brief 缓冲区已满时腾出空间：先压缩分块解码留下的空隙，再按两倍扩容
+     * @return 是否还能继续读取
+     */
+    bool make_room() {
+        auto& buffer = *buffer_;
+        if (head_size_ > 0 && framing_ == Framing::chunked && decode_pos_ > body_end_) {
+            std::memmove(buffer.data.get() + body_end_, buffer.data.get() + decode_pos_, filled_ - decode_pos_);
+            filled_ -= decode_pos_ - body_end_;
+            decode_pos_ = body_end_;
+            return true;
+        }
+        return reserve(buffer.capacity * 2);
+    }
+
+    bool reserve(size_t capacity) {
+        auto& buffer = *buffer_;
+        if (capacity <= buffer.capacity) return true;
+        if (buffer.capacity >= proxy_->options_.max_response_size) return false;
+        capacity = std::min(capacity, proxy_->options_.max_response_size);
+        auto data = std::make_unique_for_overwrite<char[]>(capacity);
+        std::memcpy(data.get(), buffer.data.get(), filled_);
+
+        // 已解析的响应头是旧缓冲区的视图，移到新缓冲区
+        const auto rebase = [old = buffer.data.get(), now = data.get()](std::string_view& view) {
+            if (!view.empty()) view = {now + (view.data() - old), view.size()};
+        };
+        rebase(reason_);
+        for (auto& [name, value] : headers_) {
+            rebase(name);
+            rebase(value);
+        }
+        buffer.data = std::move(data);
+        buffer.capacity = capacity;
+        return true;
+    }
+
+    Progress parse() {
+        auto* data = buffer_->data.get();
+        while (head_size_ == 0) {
+            const auto size = http::HttpParser::header_size({data, filled_});
+            if (size == 0) {
+                return filled_ >= max_head_size ? Progress::error : Progress::more;
+            }
+            if (!parse_head({data, size})) {
+                return Progress::error;
+            }
+            if (status_ >= 100 && status_ < 200) {
+                if (status_ == 101) return Progress::error;
+                // 跳过中间响应（100 Continue等）
+                std::memmove(data, data + size, filled_ - size);
+                filled_ -= size;
+                continue;
+            }
+            head_size_ = size;
+            body_end_ = decode_pos_ = size;
+            if (framing_ == Framing::length && !reserve(size + content_length_)) {
+                return Progress::error;
+            }
+            data = buffer_->data.get();
+        }
+
+        switch (framing_) {
+            case Framing::none:
+                keep_alive_ = keep_alive_ && filled_ == head_size_;
+                return Progress::done;
+            case Framing::length:
+                if (filled_ - head_size_ < content_length_) return Progress::more;
+                body_end_ = head_size_ + content_length_;
+                keep_alive_ = keep_alive_ && filled_ == body_end_;
+                return Progress::done;
+            case Framing::chunked: {
+                // 解码后的数据前移到body_end_，响应体在缓冲区中保持连续
+                std::size_t consumed = 0;
+                const auto status = chunked_.decode({data + decode_pos_, filled_ - decode_pos_}, consumed,
+                    [&](std::span<const char> chunk) {
+                        std::memmove(data + body_end_, chunk.data(), chunk.size());
+                        body_end_ += chunk.size();
+                    });
+                decode_pos_ += consumed;
+                if (status == http::ChunkedDecoder::Status::error) return Progress::error;
+                if (status == http::ChunkedDecoder::Status::need_more) return Progress::more;
+                keep_alive_ = keep_alive_ && decode_pos_ == filled_;
+                return Progress::done;
+            }
+            case Framing::close:
+                return Progress::more;
+        }
+        return Progress::error;
+    }
+
+    bool parse_head(std::string_view head) {
+        headers_.clear();
+        const auto line_end = head.find("\r\n");
+        const auto status_line = head.substr(0, line_end);
+        if (!status_line.starts_with("HTTP/1.") || status_line.size() < 12 || status_line[8] != ' ') {
+            return false;
+        }
+        const bool http10 = status_line[7] == '0';
+        if (std::from_chars(status_line.data() + 9, status_line.data() + 12, status_).ec != std::errc{}) {
+            return false;
+        }
+        reason_ = status_line.size() > 13 ? status_line.substr(13) : std::string_view{};
+
+        std::optional<std::uint64_t> length;
+        bool chunked = false;
+        bool close = http10;
+        auto lines = head.substr(line_end + 2);
+        while (!lines.empty()) {
+            const auto end = lines.find("\r\n");
+            const auto line = lines.substr(0, end);
+            lines.remove_prefix(std::min(lines.size(), end + 2));
+            if (line.empty()) break;
+            const auto colon = line.find(':');
+            if (colon == std::string_view::npos) return false;
+            const auto name = line.substr(0, colon);
+            const auto value = trim(line.substr(colon + 1));
+            if (iequals(name, "Content-Length")) {
+                std::uint64_t parsed = 0;
+                const auto* last = value.data() + value.size();
+                if (std::from_chars(value.data(), last, parsed).ptr != last || (length && *length != parsed)) {
+                    return false;
+                }
+                length = parsed;
+            } else if (iequals(name, "Transfer-Encoding")) {
+                chunked = value.size() >= 7 && iequals(value.substr(value.size() - 7), "chunked");
+            } else if (iequals(name, "Connection")) {
+                close = listed_in(value, "close") || (http10 && !listed_in(value, "keep-alive"));
+            }
+            headers_.emplace_back(name, value);
+        }
+
+        keep_alive_ = !close;
+        content_length_ = length.value_or(0);
+        if (request_.method == "HEAD" || status_ == 204 || status_ == 304 || (status_ >= 100 && status_ < 200)) {
+            framing_ = Framing::none;
+        } else if (chunked) {
+            framing_ = Framing::chunked;
+            chunked_.reset();
+        } else if (length) {
+            framing_ = *length == 0 ? Framing::none : Framing::length;
+        } else {
+            framing_ = Framing::close;
+            keep_alive_ = false;
+        }
+        return true;
+    }
+
+    void arm(std::chrono::milliseconds timeout) {
+        timer_.expires_after(timeout);
+        timer_.async_wait([self = shared_from_this()](boost::system::error_code ec) {
+            if (!ec && self->socket_) {
+                // 关闭socket使挂起的操作以错误结束
+                self->timed_out_ = true;
+                boost::system::error_code ignored;
+                self->socket_->close(ignored);
+            }
+        });
+    }
+
+    /**
+     * @brief 连接或请求失败，能重试时换一个上游
+     */
+    void fail() {
+        timer_.cancel();
+        socket_.reset();
+        upstream_->active.fetch_sub(1, std::memory_order_relaxed);
+
+        // 复用的连接在收到任何响应数据之前出错，通常是上游已经关闭了这个空闲连接，不算上游故障
+        const bool stale = reused_ && filled_ == 0 && !timed_out_;
+        if (!stale) {
+            LOG_WARNING(std::string(connecting_ ? "连接上游失败: " : "上游请求失败: ") + upstream_->address);
+            proxy_->report(*upstream_, false);
+            tried_[upstream_->index] = true;
+        }
+
+        // 请求还没有发出时总能重试；已经发出的请求只有幂等的、且还没收到响应时才重试
+        const bool retryable = connecting_ || (idempotent_ && filled_ == 0);
+        if (retryable && attempts_ < proxy_->options_.retries) {
+            ++attempts_;
+            attempt();
+            return;
+        }
+        reply(timed_out_ ? 504 : 502, timed_out_ ? "Gateway Timeout" : "Bad Gateway");
+    }
+
+    /**
+     * @brief 收到无效响应，连接不再复用
+     */
+    void finish_error(int code, std::string_view reason) {
+        timer_.cancel();
+        socket_.reset();
+        upstream_->active.fetch_sub(1, std::memory_order_relaxed);
+        proxy_->report(*upstream_, false);
+        reply(code, reason);
+    }
+
+    void finish() {
+        timer_.cancel();
+        upstream_->active.fetch_sub(1, std::memory_order_relaxed);
+        proxy_->report(*upstream_, true);
+        if (keep_alive_) {
+            proxy_->release(*upstream_, std::move(*socket_));
+        }
+        socket_.reset();
+
+        // 响应头和响应体都是缓冲区的视图，由缓冲区持有
+        const auto* data = buffer_->data.get();
+        response_.set_status(status_, reason_);
+        std::optional<std::string_view> length;
+        std::string_view connection;
+        for (const auto& [name, value] : headers_) {
+            if (iequals(name, "Connection")) connection = value;
+        }
+        for (const auto& [name, value] : headers_) {
+            if (iequals(name, "Content-Length")) {
+                length = value;
+                continue;
+            }
+            if (is_hop_by_hop(name) || listed_in(connection, name)) continue;
+            response_.add_header(name, value);
+        }
+
+        if (request_.method == "HEAD") {
+            // HEAD响应没有响应体，Content-Length按上游的值转发，不能由响应体长度计算
+            auto& head = buffer_->head;
+            char number[8];
+            head.append("HTTP/1.1 ");
+            head.append(number, std::to_chars(number, number + sizeof(number), status_).ptr);
+            head.append(" ").append(reason_).append("\r\n");
+            if (length) head.append("Content-Length: ").append(*length).append("\r\n");
+            for (const auto& [name, value] : response_.headers()) {
+                head.append(name).append(": ").append(value).append("\r\n");
+            }
+            head.append("\r\n");
+            response_.set_prebuilt(head, buffer_);
+        } else {
+            response_.set_body(std::string_view(data + head_size_, body_end_ - head_size_), buffer_);
+        }
+        complete();
+    }
+
+    void reply(int code, std::string_view reason) {
+        http::set_error_response(response_, code, reason);
+        complete();
+    }
+
+    void complete() {
+        // 调用之后请求和响应可能随时被连接释放
+        auto done = std::move(done_);
+        done_ = nullptr;
+        done();
+    }
+
+    std::shared_ptr<ReverseProxy> proxy_;
+    const http::HttpRequest& request_;
+    http::HttpResponse& response_;
+    http::Router::Completion done_;
+
+    boost::asio::strand<boost::asio::io_context::executor_type> strand_;
+    boost::asio::steady_timer timer_;
+    std::optional<tcp::socket> socket_;
+    Upstream* upstream_{nullptr};
+    std::vector<bool> tried_;
+    unsigned attempts_{0};
+    const bool idempotent_;
+    bool reused_{false};
+    bool connecting_{false};
+    bool timed_out_{false};
+    std::string head_;
+
+    // 上游响应的解析状态
+    std::shared_ptr<Buffer> buffer_;
+    size_t filled_{0};
+    size_t head_size_{0};
+    int status_{0};
+    std::string_view reason_;
+    std::vector<std::pair<std::string_view, std::string_view>> headers_;
+    Framing framing_{Framing::none};
+    std::uint64_t content_length_{0};
+    bool keep_alive_{false};
+    http::ChunkedDecoder chunked_;
+    // 分块解码：下一个待解码的位置和已解码响应体的结尾
+    size_t decode_pos_{0};
+    size_t body_end_{0};
+};
+
+/**
+ * @brief 一次主动健康检查
+ */
+class ReverseProxy::Probe : public std::enable_shared_from_this<Probe> {
+public:
+    Probe(std::shared_ptr<ReverseProxy> proxy, Upstream& upstream)
+        : proxy_(std::move(proxy))
+        , upstream_(upstream)
+        , strand_(boost::asio::make_strand(proxy_->io_context_))
+        , socket_(strand_)
+        , timer_(strand_) {
+    }
+
+    void start() {
+        auto self = shared_from_this();
+        timer_.expires_after(proxy_->options_.health_timeout);
+        timer_.async_wait([self](boost::system::error_code ec) {
+            if (!ec) self->done(false);
+        });
+        boost::asio::async_connect(socket_, upstream_.endpoints,
+            boost::asio::bind_executor(strand_, [self](boost::system::error_code ec, const tcp::endpoint&) {
+                if (ec) {
+                    self->done(false);
+                } else if (self->proxy_->options_.health_path.empty()) {
+                    self->done(true);
+                } else {
+                    self->send();
+                }
+            }));
+    }
+
+private:
+    void send() {
+        request_ = "GET " + proxy_->options_.health_path + " HTTP/1.1\r\nHost: " + upstream_.address +
+                   "\r\nUser-Agent: hsmm-health-check\r\nConnection: close\r\n\r\n";
+        boost::asio::async_write(socket_, boost::asio::buffer(request_),
+            boost::asio::bind_executor(strand_, [self = shared_from_this()](boost::system::error_code ec, std::size_t) {
+                if (ec) {
+                    self->done(false);
+                } else {
+                    self->receive();
+                }
+            }));
+    }
+
+    void receive() {
+        socket_.async_read_some(boost::asio::buffer(buffer_.data() + filled_, buffer_.size() - filled_),
+            boost::asio::bind_executor(strand_, [self = shared_from_this()](boost::system::error_code ec, std::size_t length) {
+                if (ec) {
+                    self->done(false);
+                    return;
+                }
+                self->filled_ += length;
+                // 只需要状态行
+                const std::string_view data(self->buffer_.data(), self->filled_);
+                if (data.find("\r\n") == std::string_view::npos) {
+                    if (self->filled_ < self->buffer_.size()) {
+                        self->receive();
+                    } else {
+                        self->done(false);
+                    }
+                    return;
+                }
+                int status = 0;
+                const bool parsed = data.size() >= 12 && data.starts_with("HTTP/1.") &&
+                    std::from_chars(data.data() + 9, data.data() + 12, status).ec == std::errc{};
+                self->done(parsed && status >= 200 && status < 400);
+            }));
+    }
+
+    void done(bool ok) {
+        if (finished_) return;
+        finished_ = true;
+        timer_.cancel();
+        boost::system::error_code ignored;
+        socket_.close(ignored);
+        proxy_->report(upstream_, ok);
+    }
+
+    std::shared_ptr<ReverseProxy> proxy_;
+    Upstream& upstream_;
+    boost::asio::strand<boost::asio::io_context::executor_type> strand_;
+    tcp::socket socket_;
+    boost::asio::steady_timer timer_;
+    std::string request_;
+    std::array<char, 512> buffer_;
+    size_t filled_{0};
+    bool finished_{false};
+};
+
+ReverseProxy::ReverseProxy(boost::asio::io_context& io_context, const std::vector<std::string>& upstreams,
+                           Options options)
+    : io_context_(io_context)
+    , options_(std::move(options))
+    , health_timer_(io_context) {
+    if (upstreams.empty()) {
+        throw std::runtime_error("反向代理至少需要一个上游");
+    }
+
+    tcp::resolver resolver(io_context);
+    for (const auto& address : upstreams) {
+        const auto colon = address.rfind(':');
+        if (colon == std::string::npos) {
+            throw std::runtime_error("上游地址格式错误: " + address);
+        }
+        // 支持[::1]:8080形式的IPv6地址
+        auto host = address.substr(0, colon);
+        if (host.size() >= 2 && host.front() == '[' && host.back() == ']') {
+            host = host.substr(1, host.size() - 2);
+        }
+
+        auto upstream = std::make_unique<Upstream>();
+        upstream->index = upstreams_.size();
+        upstream->address = address;
+        boost::system::error_code ec;
+        for (const auto& entry : resolver.resolve(host, address.substr(colon + 1), ec)) {
+            upstream->endpoints.push_back(entry.endpoint());
+        }
+        if (ec || upstream->endpoints.empty()) {
+            throw std::runtime_error("无法解析上游地址: " + address);
+        }
+        upstreams_.push_back(std::move(upstream));
+    }
+}
+
+ReverseProxy::~ReverseProxy() = default;
+
+void ReverseProxy::start() {
+    schedule_health_check();
+}
+
+void ReverseProxy::handle(const http::HttpRequest& request, http::HttpResponse& response,
+                          http::Router::Completion done) {
+    std::make_shared<Exchange>(shared_from_this(), request, response, std::move(done))->start();
+}
+
+ReverseProxy::Upstream* ReverseProxy::select(const std::vector<bool>& tried) {
+    const auto count = upstreams_.size();
+    const auto start = next_.fetch_add(1, std::memory_order_relaxed);
+    Upstream* best = nullptr;
+
+    // 第一轮只考虑可用的上游；全部不可用时第二轮仍然尝试，避免健康检查误判时完全无法服务
+    for (int pass = 0; pass < 2 && !best; ++pass) {
+        for (size_t i = 0; i < count; ++i) {
+            const auto index = (start + i) % count;
+            auto& upstream = *upstreams_[index];
+            if (tried[index] || (pass == 0 && !upstream.healthy.load(std::memory_order_relaxed))) {
+                continue;
+            }
+            if (options_.balance == Balance::round_robin) {
+                return &upstream;
+            }
+            if (!best || upstream.active.load(std::memory_order_relaxed) < best->active.load(std::memory_order_relaxed)) {
+                best = &upstream;
+            }
+        }
+    }
+    return best;
+}
+
+std::optional<tcp::socket> ReverseProxy::acquire(Upstream& upstream) {
+    const auto now = std::chrono::steady_clock::now();
+    std::lock_guard lock(upstream.mutex);
+    while (!upstream.idle.empty()) {
+        auto idle = std::move(upstream.idle.back());
+        upstream.idle.pop_back();
+        if (now - idle.since > options_.idle_timeout) {
+            continue;
+        }
+
+        // 空闲期间上游关闭了连接（读到EOF）或发来了多余的数据，都不能再使用
+        char byte;
+        const auto n = ::recv(idle.socket.native_handle(), &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return std::move(idle.socket);
+        }
+    }
+    return std::nullopt;
+}
+
+void ReverseProxy::release(Upstream& upstream, tcp::socket socket) {
+    std::lock_guard lock(upstream.mutex);
+    if (upstream.idle.size() >= options_.max_idle_connections) {
+        // 淘汰最久没有使用的连接
+        upstream.idle.erase(upstream.idle.begin());
+    }
+    upstream.idle.push_back({std::move(socket), std::chrono::steady_clock::now()});
+}
+
+void ReverseProxy::report(Upstream& upstream, bool ok) {
+    if (ok) {
+        upstream.failures_in_row.store(0, std::memory_order_relaxed);
+        if (!upstream.healthy.load(std::memory_order_relaxed) &&
+            upstream.successes_in_row.fetch_add(1, std::memory_order_relaxed) + 1 >= options_.rise) {
+            bool expected = false;
+            if (upstream.healthy.compare_exchange_strong(expected, true)) {
+                LOG_INFO("上游恢复可用: " + upstream.address);
+            }
+        }
+        return;
+    }
+
+    upstream.successes_in_row.store(0, std::memory_order_relaxed);
+    if (upstream.failures_in_row.fetch_add(1, std::memory_order_relaxed) + 1 >= options_.fall) {
+        bool expected = true;
+        if (upstream.healthy.compare_exchange_strong(expected, false)) {
+            LOG_WARNING("上游标记为不可用: " + upstream.address);
+            // 不可用期间空闲连接很可能已经失效
+            std::lock_guard lock(upstream.mutex);
+            upstream.idle.clear();
+        }
+    }
+}
+
+void ReverseProxy::schedule_health_check() {
+    health_timer_.expires_after(options_.health_interval);
+    health_timer_.async_wait([weak = weak_from_this()](boost::system::error_code ec) {
+        const auto self = weak.lock();
+        if (ec || !self) {
+            return;
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+        for (const auto& upstream : self->upstreams_) {
+            {
+                std::lock_guard lock(upstream->mutex);
+                std::erase_if(upstream->idle, [&](const auto& idle) {
+                    return now - idle.since > self->options_.idle_timeout;
+                });
+            }
+            std::make_shared<Probe>(self, *upstream)->start();
+        }
+        self->schedule_health_check();
+    });
+}
+
+} // namespace proxy
+} // namespace hsmm
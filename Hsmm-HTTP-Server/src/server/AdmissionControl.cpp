@@ -0,0 +1,310 @@
+#include "server/AdmissionControl.hpp"
+#include "http/HttpParser.hpp"
+#include "http/Router.hpp"
+#include "utils/Metrics.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <limits>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace hsmm {
+
+namespace {
+    constexpr std::int64_t no_sample = std::numeric_limits<std::int64_t>::max();
+
+    // 令牌桶换算成GCRA参数：interval为补充一个令牌的时间，tolerance为桶满时可以提前的时间
+    struct Limit {
+        std::int64_t interval{0};
+        std::int64_t tolerance{0};
+
+        explicit operator bool() const noexcept { return interval > 0; }
+    };
+
+    Limit make_limit(const RateLimit& limit) {
+        if (!(limit.rate > 0)) {
+            return {};
+        }
+        const auto interval = std::max<std::int64_t>(static_cast<std::int64_t>(1e9 / limit.rate), 1);
+        return {interval, static_cast<std::int64_t>(static_cast<double>(interval) * std::max(limit.burst, 1.0))};
+    }
+
+    // 取一个令牌：tat是下一个令牌的理论到达时间，早于now说明桶是满的
+    bool take(std::atomic<std::int64_t>& tat, std::int64_t now, const Limit& limit) noexcept {
+        auto current = tat.load(std::memory_order_relaxed);
+        for (;;) {
+            const auto next = std::max(current, now) + limit.interval;
+            if (next - now > limit.tolerance) {
+                return false;
+            }
+            if (tat.compare_exchange_weak(current, next, std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+    }
+}
+
+/**
+ * @brief 按(客户端地址, 限制范围)分片保存的令牌桶
+ *
+ * 范围0为新建连接，1为所有请求，2开始依次为各个路由限制
+ */
+class AdmissionControl::BucketTable {
+public:
+    static constexpr size_t shard_count = 64;
+    static constexpr std::uint32_t connection_scope = 0;
+    static constexpr std::uint32_t request_scope = 1;
+
+    explicit BucketTable(const AdmissionOptions& options)
+        : shard_capacity_(std::max<size_t>(options.max_tracked_clients / shard_count, 1)) {
+        limits_.push_back(make_limit(options.connections_per_ip));
+        limits_.push_back(make_limit(options.requests_per_ip));
+        for (const auto& [prefix, limit] : options.route_limits) {
+            routes_.emplace_back(prefix, static_cast<std::uint32_t>(limits_.size()));
+            limits_.push_back(make_limit(limit));
+        }
+        // 最长前缀优先
+        std::stable_sort(routes_.begin(), routes_.end(), [](const auto& a, const auto& b) {
+            return a.first.size() > b.first.size();
+        });
+    }
+
+    const Limit& limit(std::uint32_t scope) const noexcept { return limits_[scope]; }
+
+    bool has_route_limits() const noexcept { return !routes_.empty(); }
+
+    /**
+     * @brief 查找URI路径匹配的路由限制
+     * @return 限制范围，没有匹配时返回0
+     */
+    std::uint32_t match_route(std::string_view uri) const noexcept {
+        const auto path = http::uri_path(uri);
+        for (const auto& [prefix, scope] : routes_) {
+            if (path.starts_with(prefix)) {
+                return scope;
+            }
+        }
+        return 0;
+    }
+
+    /**
+     * @brief 从客户端在指定范围的桶中取一个令牌
+     * @return 是否取到
+     */
+    bool take(const ClientAddress& client, std::uint32_t scope, std::int64_t now) {
+        const auto& limit = limits_[scope];
+        const Key key{client, scope};
+        const auto hash = KeyHash{}(key);
+        auto& shard = shards_[hash % shard_count];
+
+        {
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            const auto it = shard.buckets.find(key);
+            if (it != shard.buckets.end()) {
+                return hsmm::take(it->second, now, limit);
+            }
+        }
+
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.buckets.find(key);
+        if (it == shard.buckets.end()) {
+            if (shard.buckets.size() >= shard_capacity_) {
+                // 已经回满的桶和新建的桶等价，可以丢弃
+                std::erase_if(shard.buckets, [now](const auto& entry) {
+                    return entry.second.load(std::memory_order_relaxed) <= now;
+                });
+                if (shard.buckets.size() >= shard_capacity_) {
+                    // 跟踪的客户端太多时不限制新客户端，而不是拒绝
+                    return true;
+                }
+            }
+            it = shard.buckets.try_emplace(key, std::int64_t{0}).first;
+        }
+        return hsmm::take(it->second, now, limit);
+    }
+
+private:
+    struct Key {
+        ClientAddress address;
+        std::uint32_t scope;
+
+        bool operator==(const Key&) const noexcept = default;
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const noexcept {
+            // FNV-1a
+            std::uint64_t hash = 1469598103934665603ull;
+            for (const auto byte : key.address) {
+                hash = (hash ^ byte) * 1099511628211ull;
+            }
+            hash = (hash ^ key.scope) * 1099511628211ull;
+            return static_cast<size_t>(hash ^ (hash >> 32));
+        }
+    };
+
+    struct alignas(64) Shard {
+        std::shared_mutex mutex;
+        std::unordered_map<Key, std::atomic<std::int64_t>, KeyHash> buckets;
+    };
+
+    const size_t shard_capacity_;
+    std::vector<Limit> limits_;
+    std::vector<std::pair<std::string, std::uint32_t>> routes_;
+    std::array<Shard, shard_count> shards_;
+};
+
+AdmissionControl::Ticket::Ticket(Ticket&& other) noexcept
+    : owner_(std::exchange(other.owner_, nullptr))
+    , start_ns_(other.start_ns_) {
+}
+
+AdmissionControl::Ticket& AdmissionControl::Ticket::operator=(Ticket&& other) noexcept {
+    if (this != &other) {
+        reset();
+        owner_ = std::exchange(other.owner_, nullptr);
+        start_ns_ = other.start_ns_;
+    }
+    return *this;
+}
+
+void AdmissionControl::Ticket::respond() noexcept {
+    if (owner_) {
+        const auto now = now_ns();
+        owner_->record_latency(now - start_ns_, now);
+        reset();
+    }
+}
+
+void AdmissionControl::Ticket::reset() noexcept {
+    if (owner_) {
+        owner_->inflight_.fetch_sub(1, std::memory_order_relaxed);
+        owner_ = nullptr;
+    }
+}
+
+AdmissionControl::AdmissionControl(const AdmissionOptions& options)
+    : options_(options)
+    , limits_connections_(options.connections_per_ip.rate > 0)
+    , limits_requests_(options.requests_per_ip.rate > 0
+        || std::any_of(options.route_limits.begin(), options.route_limits.end(),
+            [](const auto& route) { return route.second.rate > 0; }))
+    , tracks_inflight_(options.max_inflight_requests > 0 || options.latency_target.count() > 0)
+    , window_min_ns_(no_sample) {
+    if (limits_connections_ || limits_requests_) {
+        buckets_ = std::make_unique<BucketTable>(options_);
+    }
+}
+
+AdmissionControl::~AdmissionControl() = default;
+
+std::int64_t AdmissionControl::now_ns() noexcept {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+AdmissionControl::ClientAddress AdmissionControl::client_address(const boost::asio::ip::tcp::socket& socket) noexcept {
+    boost::system::error_code ec;
+    const auto endpoint = socket.remote_endpoint(ec);
+    if (ec) {
+        return {};
+    }
+    const auto address = endpoint.address();
+    if (address.is_v4()) {
+        return boost::asio::ip::make_address_v6(boost::asio::ip::v4_mapped, address.to_v4()).to_bytes();
+    }
+    return address.to_v6().to_bytes();
+}
+
+bool AdmissionControl::allow_connection(const boost::asio::ip::tcp::socket& socket) {
+    if (!limits_connections_) {
+        return true;
+    }
+    if (buckets_->take(client_address(socket), BucketTable::connection_scope, now_ns())) {
+        return true;
+    }
+    utils::Metrics::add(utils::Counter::connections_rejected);
+    return false;
+}
+
+AdmissionControl::Decision AdmissionControl::admit(const ClientAddress& client, std::string_view uri, Ticket& ticket) {
+    if (!tracks_inflight_ && !limits_requests_) {
+        return Decision::admit;
+    }
+    const auto now = now_ns();
+
+    // 先检查过载：过载时拒绝的代价最低，也不消耗客户端的令牌
+    if (tracks_inflight_) {
+        if (options_.latency_target.count() > 0 && now >= window_end_ns_.load(std::memory_order_relaxed)) {
+            roll_window(now);
+        }
+        if (overloaded_.load(std::memory_order_relaxed)
+            || (options_.max_inflight_requests > 0
+                && inflight_.load(std::memory_order_relaxed) >= options_.max_inflight_requests)) {
+            utils::Metrics::add(utils::Counter::requests_shed);
+            return Decision::overloaded;
+        }
+    }
+
+    if (limits_requests_) {
+        const auto route = buckets_->has_route_limits() ? buckets_->match_route(uri) : 0;
+        if ((buckets_->limit(BucketTable::request_scope)
+                && !buckets_->take(client, BucketTable::request_scope, now))
+            || (route != 0 && buckets_->limit(route) && !buckets_->take(client, route, now))) {
+            utils::Metrics::add(utils::Counter::requests_rate_limited);
+            return Decision::rate_limited;
+        }
+    }
+
+    if (tracks_inflight_) {
+        ticket.reset();
+        inflight_.fetch_add(1, std::memory_order_relaxed);
+        ticket.owner_ = this;
+        ticket.start_ns_ = now;
+    }
+    return Decision::admit;
+}
+
+void AdmissionControl::set_rejection(http::HttpResponse& response, Decision decision) {
+    if (decision == Decision::rate_limited) {
+        http::set_error_response(response, 429, "Too Many Requests");
+    } else {
+        http::set_error_response(response, 503, "Service Unavailable");
+    }
+    response.add_header("Retry-After", "1");
+}
+
+void AdmissionControl::record_latency(std::int64_t latency_ns, std::int64_t now) noexcept {
+    if (options_.latency_target.count() <= 0) {
+        return;
+    }
+    if (now >= window_end_ns_.load(std::memory_order_relaxed)) {
+        roll_window(now);
+    }
+    auto current = window_min_ns_.load(std::memory_order_relaxed);
+    while (latency_ns < current
+        && !window_min_ns_.compare_exchange_weak(current, latency_ns, std::memory_order_relaxed)) {
+    }
+}
+
+void AdmissionControl::roll_window(std::int64_t now) noexcept {
+    auto end = window_end_ns_.load(std::memory_order_relaxed);
+    if (now < end) {
+        return;
+    }
+    const auto window = std::chrono::duration_cast<std::chrono::nanoseconds>(options_.latency_window).count();
+    // 只有一个线程负责结束当前周期
+    if (!window_end_ns_.compare_exchange_strong(end, now + std::max<std::int64_t>(window, 1), std::memory_order_relaxed)) {
+        return;
+    }
+    // 周期内最快的请求也超过目标说明请求在持续排队；没有样本时说明没有请求在处理，不算过载
+    const auto minimum = window_min_ns_.exchange(no_sample, std::memory_order_relaxed);
+    const auto target = std::chrono::duration_cast<std::chrono::nanoseconds>(options_.latency_target).count();
+    overloaded_.store(minimum != no_sample && minimum > target, std::memory_order_relaxed);
+}
+
+} // namespace hsmm
@@ -1,72 +1,1075 @@
 #include "server/Connection.hpp"
+#include "server/ConnectionPool.hpp"
+#include "server/ServerContext.hpp"
+#include "tls/Context.hpp"
 #include "http/HttpParser.hpp"
+#include "http/Router.hpp"
 #include "utils/Logger.hpp"
+#include "utils/Metrics.hpp"
 #include <boost/asio.hpp>
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
 #include <memory>
 #include <string>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
 
 namespace hsmm {
 
-Connection::Connection(boost::asio::ip::tcp::socket socket)
-    : socket_(std::move(socket)) {
+Connection::Connection(ConnectionPool& pool)
+    : pool_(pool)
+    , strand_(boost::asio::make_strand(pool.io_context()))
+    , post_([this](std::function<void()> task) { boost::asio::post(strand_, std::move(task)); })
+    , socket_(strand_)
+    , arena_(arena_buffer_.data(), arena_buffer_.size()) {
 }
 
-void Connection::start() {
-    do_read();
+template <typename MutableBufferSequence, typename Handler>
+void Connection::read_some(const MutableBufferSequence& buffers, Handler&& handler) {
+    if (tls_) {
+        tls_->async_read_some(*boost::asio::buffer_sequence_begin(buffers), std::forward<Handler>(handler));
+    } else {
+        socket_.async_read_some(buffers, std::forward<Handler>(handler));
+    }
+}
+
+template <typename ConstBufferSequence, typename Handler>
+void Connection::write(const ConstBufferSequence& buffers, Handler&& handler) {
+    if (tls_) {
+        tls_->async_write(buffers, std::forward<Handler>(handler));
+    } else {
+        boost::asio::async_write(socket_, buffers, std::forward<Handler>(handler));
+    }
+}
+
+void Connection::start(ServerContext& context) {
+    context_ = &context;
+    context_->active_connections.fetch_add(1, std::memory_order_relaxed);
+    if (context_->admission.limits_requests()) {
+        client_ = AdmissionControl::client_address(socket_);
+    }
+
+    // 新连接必须在header_timeout内发来完整的请求头
+    idle_ = false;
+    context_->timers.add(*this, TimerWheel::clock::now() + context_->options.header_timeout);
+    if (!context_->tls) {
+        do_read();
+        return;
+    }
+
+    // TLS握手也算在请求头的超时时间内
+    tls_.emplace(*context_->tls, socket_);
+    tls_->async_handshake([this, self = shared_from_this()](boost::system::error_code ec) {
+        if (ec) {
+            LOG_DEBUG("TLS握手失败: " + ec.message());
+            close();
+        } else {
+            do_read();
+        }
+    });
+}
+
+void Connection::reset() noexcept {
+    generation_.fetch_add(1, std::memory_order_relaxed);
+    if (tls_) {
+        if (socket_.is_open()) {
+            tls_->shutdown();
+        }
+        tls_.reset();
+    }
+    boost::system::error_code ec;
+    socket_.close(ec);
+    finish_request();
+    // 内存块归还给池，空闲在池中的连接不占用读缓冲区
+    input_.clear();
+    close_after_response_ = false;
+    h2_.reset();
+    h2_reading_ = h2_writing_ = false;
+    h2_output_.clear();
+    if (h2_output_.capacity() > 64 * 1024) {
+        // 连接对象会被复用，不长期保留大块的写缓冲区
+        std::string().swap(h2_output_);
+    }
+    // 会话销毁时调用on_close，并断开Socket对连接的引用
+    ws_.reset();
+    ws_frames_.clear();
+    ws_buffers_.clear();
+    ws_reading_ = ws_writing_ = ws_ping_sent_ = false;
+}
+
+void Connection::set_deadline(std::chrono::milliseconds timeout) {
+    context_->timers.update(*this, TimerWheel::clock::now() + timeout);
+}
+
+void Connection::on_expire() {
+    // 在时间轮的锁内调用，连接此时一定还未被回收
+    boost::asio::post(strand_,
+        [self = shared_from_this(), generation = generation_.load(std::memory_order_relaxed)] {
+            self->handle_timeout(generation);
+        });
+}
+
+void Connection::handle_timeout(std::uint32_t generation) {
+    if (generation != generation_.load(std::memory_order_relaxed) || !socket_.is_open()) {
+        return;
+    }
+
+    if (ws_) {
+        ws_timeout(TimerWheel::expired(*this, TimerWheel::clock::now()));
+        return;
+    }
+
+    if (TimerWheel::expired(*this, TimerWheel::clock::now())) {
+        LOG_DEBUG("连接超时，关闭连接");
+    } else if (!(idle_ && context_->draining.load(std::memory_order_relaxed))) {
+        // 优雅关闭时只关闭空闲连接，处理中的连接继续等待自己的截止时间
+        context_->timers.reinsert(*this);
+        return;
+    }
+
+    // 关闭socket使挂起的异步操作以operation_aborted结束，由其完成回调回收连接
+    boost::system::error_code ec;
+    socket_.close(ec);
 }
 
 void Connection::do_read() {
     auto self(shared_from_this());
-    
-    socket_.async_read_some(
-        boost::asio::buffer(buffer_),
+
+    // 已有的数据不移动，读入当前内存块的剩余空间，不够一个内存块时接着读入下一个内存块
+    read_some(
+        input_.prepare_buffers(utils::IoBuffer::slab_size),
         [this, self](boost::system::error_code ec, std::size_t length) {
             if (!ec) {
-                // 解析HTTP请求
-                if (auto request = http::HttpParser::parse(std::span<const char>(buffer_.data(), length))) {
-                    // 创建响应
-                    http::HttpResponse response;
-                    response.set_status(200, "OK");
-                    response.add_header("Content-Type", "text/plain");
-                    response.add_header("Server", "HSMM-HTTP-Server");
-                    response.set_body("Hello from HSMM HTTP Server!");
-
-                    // 发送响应
-                    do_write(response.to_string());
+                utils::Metrics::add(utils::Counter::bytes_received, length);
+                input_.commit(length);
+                if (request_) {
+                    read_body();
                 } else {
-                    // 请求解析失败
-                    http::HttpResponse response;
-                    response.set_status(400, "Bad Request");
-                    response.add_header("Content-Type", "text/plain");
-                    response.set_body("Invalid HTTP request");
-                    
-                    do_write(response.to_string());
+                    read_header();
+                }
+            } else {
+                if (ec != boost::asio::error::operation_aborted) {
+                    LOG_ERROR("读取连接数据失败: " + std::string(ec.message()));
                 }
-            } else if (ec != boost::asio::error::operation_aborted) {
-                LOG_ERROR("读取连接数据失败: " + std::string(ec.message()));
+                close();
             }
         });
 }
 
-void Connection::do_write(std::string_view response) {
+void Connection::read_header() {
+    std::span<const char> pending = input_.front();
+    auto header_size = http::HttpParser::header_size(pending);
+    if (header_size == 0 && pending.size() < input_.size()) {
+        // 请求头跨越了内存块，合并后再查找结尾
+        pending = input_.linearize();
+        header_size = http::HttpParser::header_size(pending);
+    }
+    if (header_size == 0) {
+        if (input_.size() >= context_->options.max_header_size) {
+            reply_error(431, "Request Header Fields Too Large");
+            return;
+        }
+        if (idle_ && !input_.empty()) {
+            // 收到了请求的一部分，从空闲超时切换为请求头超时
+            idle_ = false;
+            set_deadline(context_->options.header_timeout);
+        }
+        do_read();
+        return;
+    }
+    idle_ = false;
+
+    // 连接前言"PRI * HTTP/2.0\r\n\r\n"恰好可以被识别为一个完整的请求头
+    if (context_->options.http2.enabled &&
+        std::string_view(pending.data(), pending.size()).starts_with("PRI * HTTP/2.0\r\n\r\n")) {
+        start_http2();
+        return;
+    }
+
+    // 响应和解析结果都分配在请求内存池上
+    response_.emplace(&arena_);
+    const auto parse_start = utils::Metrics::now_ns();
+    auto request = http::HttpParser::parse(pending, &arena_);
+    utils::Metrics::record(utils::Timer::parse, utils::Metrics::now_ns() - parse_start);
+    if (!request) {
+        reply_error(400, "Bad Request");
+        return;
+    }
+    request_.emplace(std::move(*request));
+    route_ = &context_->router.find(request_->uri);
+    // 解析结果引用读缓冲区中的请求头，请求结束时再丢弃
+    request_size_ = header_size;
+
+    if (context_->options.http2.enabled && !request_->has_body()) {
+        const auto upgrade = request_->headers.get(http::Header::upgrade);
+        const auto settings = request_->headers.get(http::Header::http2_settings);
+        if (upgrade && settings && upgrade->find("h2c") != std::string_view::npos && upgrade_http2(*settings)) {
+            return;
+        }
+    }
+
+    // 客户端要求关闭连接（Connection: close或没有keep-alive的HTTP/1.0）时，响应中带上Connection: close
+    if (!request_->keep_alive()) {
+        close_after_response_ = true;
+    }
+
+    // 限速和过载检查在读取请求体和调用处理函数之前，拒绝的代价只有一次解析
+    if (const auto decision = context_->admission.admit(client_, request_->uri, ticket_);
+        decision != AdmissionControl::Decision::admit) {
+        AdmissionControl::set_rejection(*response_, decision);
+        if (request_->has_body()) {
+            // 请求体不再读取
+            close_after_response_ = true;
+        }
+        send_response();
+        return;
+    }
+
+    if (route_->websocket) {
+        start_websocket();
+        return;
+    }
+
+    if (!request_->has_body()) {
+        complete_request();
+        return;
+    }
+
+    const auto buffered = input_.size() - header_size;
+    if (route_->stream_handler) {
+        if (!copy_header(pending.first(header_size))) {
+            reply_error(400, "Bad Request");
+            return;
+        }
+        try {
+            body_reader_ = route_->stream_handler(*request_, *response_);
+        }
+        catch (const std::exception& e) {
+            LOG_ERROR("处理请求时发生错误: " + std::string(e.what()));
+            reply_error(500, "Internal Server Error");
+            return;
+        }
+        if (!body_reader_) {
+            // 处理函数拒绝了请求，请求体不再读取
+            close_after_response_ = true;
+            send_response();
+            return;
+        }
+    } else if (request_->content_length.value_or(0) > context_->options.max_body_size) {
+        reply_error(413, "Payload Too Large");
+        return;
+    } else if (request_->content_length && *request_->content_length <= pending.size() - header_size) {
+        // 请求体已经完整地和请求头在同一个内存块中，直接使用解析结果，不复制
+        request_size_ += static_cast<size_t>(*request_->content_length);
+        complete_request();
+        return;
+    } else {
+        if (!copy_header(pending.first(header_size))) {
+            reply_error(400, "Bad Request");
+            return;
+        }
+        body_.emplace(&arena_);
+        body_->reserve(static_cast<size_t>(request_->content_length.value_or(0)));
+    }
+
+    if (request_->chunked) {
+        chunked_decoder_.reset();
+    } else {
+        body_remaining_ = *request_->content_length;
+    }
+
+    if (request_->expect_continue && buffered == 0) {
+        send_continue();
+    } else {
+        read_body();
+    }
+}
+
+bool Connection::copy_header(std::span<const char> header) {
+    // 请求体会继续读入input_，解析结果不能再引用其中的数据
+    header_copy_.emplace(header.data(), header.size(), &arena_);
+    auto request = http::HttpParser::parse(*header_copy_, &arena_);
+    if (!request) {
+        return false;
+    }
+    request_.emplace(std::move(*request));
+    input_.consume(header.size());
+    request_size_ = 0;
+    return true;
+}
+
+void Connection::read_body() {
+    bool done = !request_->chunked && body_remaining_ == 0;
+    try {
+        // 请求体逐个内存块处理，处理过的数据立即丢弃
+        while (!done && !input_.empty()) {
+            const std::span<const char> pending = input_.front();
+            if (request_->chunked) {
+                size_t consumed = 0;
+                const auto status = chunked_decoder_.decode(pending, consumed,
+                    [this](std::span<const char> data) { deliver_body(data); });
+                input_.consume(consumed);
+                if (status == http::ChunkedDecoder::Status::error) {
+                    reply_error(400, "Bad Request");
+                    return;
+                }
+                done = status == http::ChunkedDecoder::Status::done;
+            } else {
+                const auto length = static_cast<size_t>(std::min<std::uint64_t>(body_remaining_, pending.size()));
+                deliver_body(pending.first(length));
+                input_.consume(length);
+                body_remaining_ -= length;
+                done = body_remaining_ == 0;
+            }
+        }
+    }
+    catch (const std::exception& e) {
+        LOG_ERROR("处理请求体时发生错误: " + std::string(e.what()));
+        reply_error(500, "Internal Server Error");
+        return;
+    }
+
+    if (body_too_large_) {
+        reply_error(413, "Payload Too Large");
+        return;
+    }
+    if (done) {
+        complete_request();
+        return;
+    }
+
+    // 请求体数据都已处理，读缓冲区可以从头复用
+    set_deadline(context_->options.body_timeout);
+    do_read();
+}
+
+void Connection::deliver_body(std::span<const char> data) {
+    if (body_reader_) {
+        body_reader_->on_data(data);
+    } else if (body_->size() + data.size() > context_->options.max_body_size) {
+        body_too_large_ = true;
+    } else if (!body_too_large_) {
+        body_->append(data.data(), data.size());
+    }
+}
+
+void Connection::send_continue() {
+    auto self(shared_from_this());
+    static constexpr std::string_view continue_response = "HTTP/1.1 100 Continue\r\n\r\n";
+
+    write(
+        boost::asio::buffer(continue_response.data(), continue_response.size()),
+        [this, self](boost::system::error_code ec, std::size_t length) {
+            utils::Metrics::add(utils::Counter::bytes_sent, length);
+            utils::Metrics::count_response(100);
+            if (!ec) {
+                read_body();
+            } else {
+                if (ec != boost::asio::error::operation_aborted) {
+                    LOG_ERROR("写入响应数据失败: " + std::string(ec.message()));
+                }
+                close();
+            }
+        });
+}
+
+void Connection::complete_request() {
+    if (route_->async_handler) {
+        if (body_) {
+            request_->body = *body_;
+        }
+        call_async_handler();
+        return;
+    }
+
+    const auto handler_start = utils::Metrics::now_ns();
+    if (body_reader_) {
+        try {
+            body_reader_->on_complete(*response_);
+        }
+        catch (const std::exception& e) {
+            LOG_ERROR("处理请求时发生错误: " + std::string(e.what()));
+            http::set_error_response(*response_, 500, "Internal Server Error");
+        }
+    } else {
+        if (body_) {
+            request_->body = *body_;
+        }
+        body_reader_ = http::Router::handle(*route_, *request_, *response_);
+    }
+    utils::Metrics::record(utils::Timer::handler, utils::Metrics::now_ns() - handler_start);
+    send_response();
+}
+
+void Connection::call_async_handler() {
+    auto self(shared_from_this());
+    const auto handler_start = utils::Metrics::now_ns();
+
+    // 等待期间连接上没有挂起的异步操作，超时只关闭socket，连接在发送响应失败后回收
+    set_deadline(context_->options.handler_timeout);
+    request_->post = &post_;
+    try {
+        route_->async_handler(*request_, *response_, [this, self, handler_start] {
+            boost::asio::post(strand_, [this, self, handler_start] {
+                utils::Metrics::record(utils::Timer::handler, utils::Metrics::now_ns() - handler_start);
+                send_response();
+            });
+        });
+    }
+    catch (const std::exception& e) {
+        LOG_ERROR("处理请求时发生错误: " + std::string(e.what()));
+        reply_error(500, "Internal Server Error");
+    }
+}
+
+void Connection::reply_error(int code, std::string_view reason) {
+    // 请求的剩余部分没有读取，无法确定下一个请求从哪里开始
+    if (!response_) {
+        response_.emplace(&arena_);
+    }
+    http::set_error_response(*response_, code, reason);
+    close_after_response_ = true;
+    send_response();
+}
+
+void Connection::send_response() {
+    // 解析失败的请求没有request_，错误响应不压缩
+    if (request_) {
+        const auto& options = context_->options.compression;
+        const auto encoding = http::negotiate_response_encoding(*request_, *response_, options);
+        if (encoding != http::ContentEncoding::identity) {
+            compress_response(encoding);
+            return;
+        }
+    }
+    write_response();
+}
+
+void Connection::compress_response(http::ContentEncoding encoding) {
+    const auto& options = context_->options.compression;
+    if (options.threads == 0) {
+        http::compress_response(*response_, encoding, options);
+        write_response();
+        return;
+    }
+
+    // 压缩期间连接上没有挂起的异步操作，超时只关闭socket，连接在发送失败后回收
+    auto self(shared_from_this());
+    set_deadline(context_->options.write_timeout);
+    boost::asio::post(context_->compression_pool, [this, self, encoding] {
+        try {
+            http::compress_response(*response_, encoding, context_->options.compression);
+        }
+        catch (const std::exception& e) {
+            // 压缩失败时发送未压缩的响应
+            LOG_ERROR("压缩响应失败: " + std::string(e.what()));
+        }
+        boost::asio::post(strand_, [this, self] { write_response(); });
+    });
+}
+
+void Connection::write_response() {
+    auto& response = *response_;
+    ticket_.respond();
+    utils::Metrics::add(utils::Counter::requests);
+    utils::Metrics::count_response(response.status_code());
+    write_start_ns_ = utils::Metrics::now_ns();
+
+    const bool close_connection = close_after_response_ || context_->draining.load(std::memory_order_relaxed);
+    if (close_connection) {
+        // 通知客户端不要在这个连接上继续发送请求
+        response.add_header("Connection", "close");
+    }
+
+    // 预先生成的响应直接发送，其余响应序列化到请求内存池
+    payload_owner_ = response.owner();
+    file_body_ = response.file_body();
+    if (!response.prebuilt().empty() && close_connection) {
+        // 预先生成的响应不受add_header()影响，重新生成带Connection: close的头部，响应体不复制
+        output_.emplace(&arena_);
+        write_body_ = response.serialize_prebuilt_head(*output_, "Connection", "close");
+        write_head_ = *output_;
+    } else if (!response.prebuilt().empty()) {
+        write_head_ = response.prebuilt();
+    } else if (response.body().size() >= gather_body_size) {
+        // 较大的响应体（例如反向代理转发的上游响应）直接和头部一起写出，不复制
+        output_.emplace(&arena_);
+        response.serialize_head(*output_);
+        write_head_ = *output_;
+        write_body_ = response.body();
+    } else {
+        output_.emplace(&arena_);
+        response.serialize(*output_);
+        write_head_ = *output_;
+    }
+
+    set_deadline(context_->options.write_timeout);
+    do_write();
+}
+
+void Connection::do_write() {
     auto self(shared_from_this());
     
-    boost::asio::async_write(
-        socket_,
-        boost::asio::buffer(response.data(), response.size()),
-        [this, self](boost::system::error_code ec, std::size_t /*length*/) {
+    const std::array<boost::asio::const_buffer, 2> buffers{
+        boost::asio::buffer(write_head_.data(), write_head_.size()),
+        boost::asio::buffer(write_body_.data(), write_body_.size())
+    };
+    write(
+        buffers,
+        [this, self](boost::system::error_code ec, std::size_t length) {
+            utils::Metrics::add(utils::Counter::bytes_sent, length);
             if (!ec) {
-                // 继续读取下一个请求
-                do_read();
-            } else if (ec != boost::asio::error::operation_aborted) {
-                LOG_ERROR("写入响应数据失败: " + std::string(ec.message()));
+                if (file_body_ && file_body_->length > 0) {
+                    do_send_file();
+                    return;
+                }
+                if (response_ && response_->chunked_body()) {
+                    do_write_chunk();
+                    return;
+                }
+                next_request();
+            } else {
+                if (ec != boost::asio::error::operation_aborted) {
+                    LOG_ERROR("写入响应数据失败: " + std::string(ec.message()));
+                }
+                close();
             }
         });
 }
 
+void Connection::do_send_file() {
+    if (tls_) {
+        // 发送方向交给内核后文件仍然可以零拷贝发送，否则只能读出来加密
+        if (tls_->ktls_send()) {
+            send_file_ktls();
+        } else {
+            send_file_copy();
+        }
+        return;
+    }
+
+#ifdef __linux__
+    auto self(shared_from_this());
+    auto& body = *file_body_;
+
+    // 内核直接把文件页发送到socket，数据不经过用户态
+    boost::system::error_code ec;
+    socket_.native_non_blocking(true, ec);
+    while (!ec && body.length > 0) {
+        off_t offset = static_cast<off_t>(body.offset);
+        const auto chunk = static_cast<size_t>(std::min<std::uint64_t>(body.length, 1u << 30));
+        const auto sent = ::sendfile(socket_.native_handle(), body.fd, &offset, chunk);
+        if (sent > 0) {
+            utils::Metrics::add(utils::Counter::bytes_sent, static_cast<std::uint64_t>(sent));
+            body.offset += static_cast<std::uint64_t>(sent);
+            body.length -= static_cast<std::uint64_t>(sent);
+            set_deadline(context_->options.write_timeout);
+        } else if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            // socket发送缓冲区已满，等待可写后继续
+            socket_.async_wait(boost::asio::ip::tcp::socket::wait_write,
+                [this, self](boost::system::error_code wait_ec) {
+                    if (!wait_ec) {
+                        do_send_file();
+                    } else {
+                        close();
+                    }
+                });
+            return;
+        } else if (sent < 0 && errno == EINTR) {
+            continue;
+        } else {
+            // 文件在发送过程中被截断或发生IO错误，响应已无法完整发送
+            ec = boost::system::error_code(sent < 0 ? errno : EIO, boost::system::system_category());
+        }
+    }
+
+    if (ec) {
+        LOG_ERROR("发送文件失败: " + ec.message());
+        close();
+        return;
+    }
+    next_request();
+#else
+    send_file_copy();
+#endif
+}
+
+void Connection::send_file_copy() {
+    auto self(shared_from_this());
+    auto& body = *file_body_;
+
+    // 分块读取文件并发送，读缓冲区中可能还有下一个请求，不能借用
+    const auto buffer = chunk_buffer();
+    const auto chunk = static_cast<size_t>(std::min<std::uint64_t>(body.length, buffer.size()));
+    const auto n = ::pread(body.fd, buffer.data(), chunk, static_cast<off_t>(body.offset));
+    if (n <= 0) {
+        LOG_ERROR("读取文件失败");
+        close();
+        return;
+    }
+    body.offset += static_cast<std::uint64_t>(n);
+    body.length -= static_cast<std::uint64_t>(n);
+
+    write(
+        boost::asio::buffer(buffer.data(), static_cast<size_t>(n)),
+        [this, self](boost::system::error_code ec, std::size_t length) {
+            utils::Metrics::add(utils::Counter::bytes_sent, length);
+            if (ec) {
+                close();
+            } else if (file_body_->length > 0) {
+                set_deadline(context_->options.write_timeout);
+                send_file_copy();
+            } else {
+                next_request();
+            }
+        });
+}
+
+void Connection::send_file_ktls() {
+    auto self(shared_from_this());
+    auto& body = *file_body_;
+
+    const auto chunk = static_cast<size_t>(std::min<std::uint64_t>(body.length, 1u << 30));
+    tls_->async_sendfile(body.fd, body.offset, chunk,
+        [this, self](boost::system::error_code ec, std::size_t length) {
+            if (ec) {
+                LOG_ERROR("发送文件失败: " + ec.message());
+                close();
+                return;
+            }
+            utils::Metrics::add(utils::Counter::bytes_sent, length);
+            file_body_->offset += length;
+            file_body_->length -= length;
+            if (file_body_->length > 0) {
+                set_deadline(context_->options.write_timeout);
+                send_file_ktls();
+            } else {
+                next_request();
+            }
+        });
+}
+
+void Connection::do_write_chunk() {
+    auto self(shared_from_this());
+    const auto buffer = chunk_buffer();
+
+    std::size_t length = 0;
+    try {
+        length = std::min(response_->chunked_body()(buffer), buffer.size());
+    }
+    catch (const std::exception& e) {
+        // 响应头已经发出，只能断开连接
+        LOG_ERROR("生成分块响应失败: " + std::string(e.what()));
+        close();
+        return;
+    }
+
+    if (length == 0) {
+        static constexpr std::string_view last_chunk = "0\r\n\r\n";
+        write(
+            boost::asio::buffer(last_chunk.data(), last_chunk.size()),
+            [this, self](boost::system::error_code ec, std::size_t length) {
+                utils::Metrics::add(utils::Counter::bytes_sent, length);
+                if (ec) {
+                    close();
+                } else {
+                    next_request();
+                }
+            });
+        return;
+    }
+
+    // 分块头、数据和结尾的CRLF一次写出，数据不复制
+    auto* end = std::to_chars(chunk_header_.data(), chunk_header_.data() + chunk_header_.size() - 2, length, 16).ptr;
+    *end++ = '\r';
+    *end++ = '\n';
+    const std::array<boost::asio::const_buffer, 3> buffers{
+        boost::asio::buffer(chunk_header_.data(), static_cast<size_t>(end - chunk_header_.data())),
+        boost::asio::buffer(buffer.data(), length),
+        boost::asio::buffer("\r\n", 2)
+    };
+    write(
+        buffers,
+        [this, self](boost::system::error_code ec, std::size_t length) {
+            utils::Metrics::add(utils::Counter::bytes_sent, length);
+            if (ec) {
+                if (ec != boost::asio::error::operation_aborted) {
+                    LOG_ERROR("写入响应数据失败: " + std::string(ec.message()));
+                }
+                close();
+                return;
+            }
+            set_deadline(context_->options.write_timeout);
+            do_write_chunk();
+        });
+}
+
+std::span<char> Connection::chunk_buffer() {
+    if (chunk_buffer_.empty()) {
+        chunk_buffer_ = std::span<char>(static_cast<char*>(arena_.allocate(chunk_size)), chunk_size);
+    }
+    return chunk_buffer_;
+}
+
+void Connection::finish_request() noexcept {
+    // 先销毁引用内存池的对象，再整体重置内存池
+    write_head_ = {};
+    write_body_ = {};
+    payload_owner_.reset();
+    file_body_.reset();
+    output_.reset();
+    chunk_buffer_ = {};
+    body_reader_.reset();
+    body_.reset();
+    body_too_large_ = false;
+    body_remaining_ = 0;
+    header_copy_.reset();
+    route_ = nullptr;
+    ticket_.reset();
+    response_.reset();
+    request_.reset();
+    method_ = uri_ = version_ = {};
+    arena_.release();
+    input_.consume(request_size_);
+    request_size_ = 0;
+}
+
+void Connection::next_request() {
+    utils::Metrics::record(utils::Timer::write, utils::Metrics::now_ns() - write_start_ns_);
+    const bool close_connection = close_after_response_;
+    finish_request();
+    if (close_connection || context_->draining.load(std::memory_order_relaxed)) {
+        close();
+        return;
+    }
+
+    idle_ = true;
+    set_deadline(context_->options.idle_timeout);
+    if (!input_.empty()) {
+        // 客户端已经发来了下一个请求（pipelining）
+        read_header();
+    } else {
+        // 继续读取下一个请求
+        do_read();
+    }
+}
+
+std::unique_ptr<http2::Session> Connection::make_http2_session() {
+    // 会话持有连接的引用，连接关闭时reset()销毁会话，循环引用随之解除
+    return std::make_unique<http2::Session>(context_->router, context_->options,
+        [this, self = shared_from_this()](std::function<void()> resume) {
+            boost::asio::post(strand_, [this, self, resume = std::move(resume)] {
+                resume();
+                if (!socket_.is_open()) {
+                    // 连接已经关闭，只是在等待异步处理函数完成
+                    h2_close();
+                    return;
+                }
+                h2_flush();
+                if (h2_) {
+                    h2_read();
+                }
+            });
+        },
+        &context_->admission, client_);
+}
+
+void Connection::start_http2() {
+    h2_ = make_http2_session();
+    h2_->start();
+    h2_receive();
+}
+
+bool Connection::upgrade_http2(std::string_view settings) {
+    h2_ = make_http2_session();
+    if (!h2_->start_upgrade(*request_, settings)) {
+        h2_.reset();
+        return false;
+    }
+
+    // 101响应之后紧跟服务器的SETTINGS和流1的响应，一起写出
+    h2_output_.assign("HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: h2c\r\n\r\n");
+    utils::Metrics::count_response(101);
+    // 丢弃升级请求，之后的数据属于HTTP/2连接
+    finish_request();
+    h2_receive();
+    return true;
+}
+
+void Connection::h2_receive() {
+    // 会话会复制不完整的帧，交给会话的数据立即丢弃，读缓冲区始终复用同一个内存块
+    while (!input_.empty()) {
+        const std::span<const char> data = input_.front();
+        // 连接错误时GOAWAY已经在会话的输出中，发送完后关闭
+        h2_->receive(data);
+        input_.consume(data.size());
+    }
+    if (context_->draining.load(std::memory_order_relaxed)) {
+        h2_->shutdown();
+    }
+    h2_flush();
+    if (h2_) {
+        h2_read();
+    }
+}
+
+void Connection::h2_read() {
+    // 客户端不读取响应时生成的控制帧会不断累积，暂停读取直到写出
+    if (h2_reading_ || h2_->closed() ||
+        h2_->pending_output() > context_->options.http2.max_write_batch) {
+        return;
+    }
+
+    idle_ = h2_->idle() && !h2_writing_;
+    if (!h2_writing_) {
+        set_deadline(idle_ ? context_->options.idle_timeout : context_->options.body_timeout);
+    }
+
+    auto self(shared_from_this());
+    h2_reading_ = true;
+    read_some(
+        input_.prepare_buffers(utils::IoBuffer::slab_size),
+        [this, self](boost::system::error_code ec, std::size_t length) {
+            h2_reading_ = false;
+            if (ec) {
+                if (ec != boost::asio::error::operation_aborted && ec != boost::asio::error::eof) {
+                    LOG_ERROR("读取连接数据失败: " + std::string(ec.message()));
+                }
+                h2_close();
+                return;
+            }
+            utils::Metrics::add(utils::Counter::bytes_received, length);
+            input_.commit(length);
+            h2_receive();
+        });
+}
+
+void Connection::h2_flush() {
+    if (h2_writing_) {
+        return;
+    }
+    if (!h2_->take_output(h2_output_) && h2_output_.empty()) {
+        if (h2_->closed()) {
+            h2_close();
+        }
+        return;
+    }
+
+    auto self(shared_from_this());
+    h2_writing_ = true;
+    idle_ = false;
+    set_deadline(context_->options.write_timeout);
+    write(
+        boost::asio::buffer(h2_output_.data(), h2_output_.size()),
+        [this, self](boost::system::error_code ec, std::size_t length) {
+            h2_writing_ = false;
+            utils::Metrics::add(utils::Counter::bytes_sent, length);
+            if (ec) {
+                if (ec != boost::asio::error::operation_aborted) {
+                    LOG_ERROR("写入响应数据失败: " + std::string(ec.message()));
+                }
+                h2_close();
+                return;
+            }
+            h2_output_.clear();
+            if (context_->draining.load(std::memory_order_relaxed)) {
+                h2_->shutdown();
+            }
+            // 发送窗口允许时继续取出各个流的数据
+            h2_flush();
+            if (h2_ && !h2_writing_) {
+                idle_ = h2_->idle();
+                set_deadline(idle_ ? context_->options.idle_timeout : context_->options.body_timeout);
+            }
+            if (h2_) {
+                h2_read();
+            }
+        });
+}
+
+void Connection::h2_close() {
+    // 关闭socket使另一个挂起的操作结束，最后一个结束的操作（或异步处理函数）回收连接
+    boost::system::error_code ec;
+    socket_.close(ec);
+    if (!h2_reading_ && !h2_writing_ && !h2_->busy()) {
+        close();
+    }
+}
+
+void Connection::start_websocket() {
+    auto accept = websocket::handshake(*request_, *response_);
+    if (!accept) {
+        close_after_response_ = true;
+        send_response();
+        return;
+    }
+
+    ticket_.respond();
+    utils::Metrics::add(utils::Counter::requests);
+    utils::Metrics::count_response(101);
+    // 会话持有连接的引用，连接关闭时reset()销毁会话，Socket随之断开，循环引用解除
+    ws_ = std::make_unique<websocket::Session>(route_->websocket, std::string(request_->uri),
+        context_->options.websocket,
+        [this, self = shared_from_this(), generation = generation_.load(std::memory_order_relaxed)] {
+            boost::asio::post(strand_, [this, self, generation] {
+                if (generation == generation_.load(std::memory_order_relaxed) && ws_) {
+                    ws_flush();
+                }
+            });
+        });
+    finish_request();
+    // 101响应排在所有帧之前写出
+    ws_frames_.push_back(std::make_shared<const std::string>(std::move(*accept)));
+    set_deadline(context_->options.websocket.ping_interval);
+    ws_->open();
+
+    // 客户端可能紧跟着握手请求发来了帧
+    ws_receive();
+}
+
+void Connection::ws_receive() {
+    // 会话会复制不完整的帧，交给会话的数据立即丢弃
+    while (!input_.empty()) {
+        const auto data = input_.front();
+        ws_->receive(data);
+        input_.consume(data.size());
+    }
+    if (context_->draining.load(std::memory_order_relaxed)) {
+        ws_->shutdown();
+    }
+    ws_flush();
+    if (ws_) {
+        ws_read();
+    }
+}
+
+void Connection::ws_read() {
+    // 关闭握手完成或者发生协议错误后不再读取，发送完Close帧后关闭
+    if (ws_reading_ || ws_->done()) {
+        return;
+    }
+
+    auto self(shared_from_this());
+    ws_reading_ = true;
+    read_some(
+        input_.prepare_buffers(utils::IoBuffer::slab_size),
+        [this, self](boost::system::error_code ec, std::size_t length) {
+            ws_reading_ = false;
+            if (ec) {
+                if (ec != boost::asio::error::operation_aborted && ec != boost::asio::error::eof) {
+                    LOG_ERROR("读取连接数据失败: " + std::string(ec.message()));
+                }
+                ws_close();
+                return;
+            }
+            utils::Metrics::add(utils::Counter::bytes_received, length);
+            // 收到任何数据都说明对端仍然存活
+            ws_ping_sent_ = false;
+            if (!ws_writing_) {
+                set_deadline(context_->options.websocket.ping_interval);
+            }
+            input_.commit(length);
+            ws_receive();
+        });
+}
+
+void Connection::ws_flush() {
+    if (ws_->overflowed()) {
+        // 客户端不读取时写操作不会完成，关闭socket使其结束
+        LOG_DEBUG("WebSocket客户端读取太慢，关闭连接");
+        ws_close();
+        return;
+    }
+    if (ws_writing_) {
+        return;
+    }
+    ws_->take_output(ws_frames_, max_ws_batch - std::min(ws_frames_.size(), max_ws_batch));
+    if (ws_frames_.empty()) {
+        if (ws_->done()) {
+            ws_close();
+        }
+        return;
+    }
+
+    // 帧只是共享指针，多个连接写出同一份数据
+    ws_buffers_.clear();
+    for (const auto& frame : ws_frames_) {
+        ws_buffers_.emplace_back(frame->data(), frame->size());
+    }
+    auto self(shared_from_this());
+    ws_writing_ = true;
+    set_deadline(context_->options.write_timeout);
+    write(
+        ws_buffers_,
+        [this, self](boost::system::error_code ec, std::size_t length) {
+            ws_writing_ = false;
+            utils::Metrics::add(utils::Counter::bytes_sent, length);
+            ws_frames_.clear();
+            if (ec) {
+                if (ec != boost::asio::error::operation_aborted) {
+                    LOG_ERROR("写入响应数据失败: " + std::string(ec.message()));
+                }
+                ws_close();
+                return;
+            }
+            ws_flush();
+            if (ws_ && !ws_writing_) {
+                set_deadline(context_->options.websocket.ping_interval);
+            }
+        });
+}
+
+void Connection::ws_close() {
+    // 关闭socket使另一个挂起的操作结束，最后一个结束的操作回收连接
+    boost::system::error_code ec;
+    socket_.close(ec);
+    if (!ws_reading_ && !ws_writing_) {
+        close();
+    }
+}
+
+void Connection::ws_timeout(bool expired) {
+    const bool draining = context_->draining.load(std::memory_order_relaxed);
+    if (expired && (ws_writing_ || ws_ping_sent_ || ws_->closing())) {
+        // 写操作超时、ping没有回应或者对端没有完成关闭握手
+        LOG_DEBUG("WebSocket连接超时，关闭连接");
+        boost::system::error_code ec;
+        socket_.close(ec);
+        return;
+    }
+
+    if (draining) {
+        // 发送Close帧，等待对端回应，最多等待一个写超时
+        ws_->shutdown();
+        set_deadline(context_->options.write_timeout);
+    } else if (expired) {
+        ws_->ping();
+        ws_ping_sent_ = true;
+        set_deadline(context_->options.websocket.ping_interval);
+    }
+    // 到期或提前触发的条目已经从时间轮中摘下
+    context_->timers.reinsert(*this);
+    ws_flush();
+}
+
+void Connection::close() {
+    if (context_) {
+        context_->timers.remove(*this);
+        context_->active_connections.fetch_sub(1, std::memory_order_relaxed);
+        context_ = nullptr;
+    }
+    reset();
+    pool_.recycle(shared_from_this());
+}
+
 bool Connection::parse_request(std::span<const char> data) {
     // 使用HttpParser解析请求
-    auto request = http::HttpParser::parse(data);
+    auto request = http::HttpParser::parse(data, &arena_);
     if (!request) {
         return false;
     }
@@ -77,4 +1080,4 @@ bool Connection::parse_request(std::span<const char> data) {
 
     return true;
 }
-} 
\ No newline at end of file
+}
@@ -0,0 +1,57 @@
+#include "server/ConnectionPool.hpp"
+#include "server/Connection.hpp"
+#include <algorithm>
+#include <utility>
+
+namespace hsmm {
+
+ConnectionPool::ConnectionPool(boost::asio::io_context& io_context)
+    : io_context_(io_context) {
+    // 预留空闲列表容量，回收连接时不会触发扩容
+    idle_.reserve(max_idle_connections);
+}
+
+std::shared_ptr<Connection> ConnectionPool::acquire() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!idle_.empty()) {
+            auto connection = std::move(idle_.back());
+            idle_.pop_back();
+            return connection;
+        }
+    }
+    return std::make_shared<Connection>(*this);
+}
+
+void ConnectionPool::recycle(std::shared_ptr<Connection> connection) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (idle_.size() < max_idle_connections) {
+        idle_.push_back(std::move(connection));
+        return;
+    }
+    // 池已满：在锁外释放连接对象
+    lock.unlock();
+    connection.reset();
+}
+
+void ConnectionPool::preallocate(size_t count) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    while (idle_.size() < std::min(count, max_idle_connections)) {
+        idle_.push_back(std::make_shared<Connection>(*this));
+    }
+}
+
+void ConnectionPool::clear() noexcept {
+    std::vector<std::shared_ptr<Connection>> idle;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        idle.swap(idle_);
+    }
+}
+
+size_t ConnectionPool::idle_count() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return idle_.size();
+}
+
+} // namespace hsmm
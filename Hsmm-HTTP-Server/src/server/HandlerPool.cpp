@@ -0,0 +1,79 @@
+#include "server/HandlerPool.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Metrics.hpp"
+#include <algorithm>
+#include <string>
+
+namespace hsmm {
+
+HandlerPool::HandlerPool(size_t threads, size_t max_queue)
+    : max_queue_(std::max<size_t>(max_queue, 1)) {
+    threads = std::max<size_t>(threads, 1);
+    threads_.reserve(threads);
+    for (size_t i = 0; i < threads; ++i) {
+        threads_.emplace_back([this] { worker(); });
+    }
+}
+
+HandlerPool::~HandlerPool() {
+    stop();
+}
+
+bool HandlerPool::submit(Task task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_ || queue_.size() >= max_queue_) {
+            return false;
+        }
+        queue_.push_back({std::move(task), utils::Metrics::now_ns()});
+        queue_depth_.store(queue_.size(), std::memory_order_relaxed);
+    }
+    ready_.notify_one();
+    return true;
+}
+
+void HandlerPool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    ready_.notify_all();
+    for (auto& thread : threads_) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+}
+
+void HandlerPool::worker() {
+    for (;;) {
+        Item item;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            ready_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            if (queue_.empty()) {
+                // 停止时先执行完已排队的任务，它们的连接还在等待响应
+                return;
+            }
+            item = std::move(queue_.front());
+            queue_.pop_front();
+            queue_depth_.store(queue_.size(), std::memory_order_relaxed);
+        }
+
+        utils::Metrics::record(utils::Timer::handler_queue, utils::Metrics::now_ns() - item.queued_ns);
+        busy_threads_.fetch_add(1, std::memory_order_relaxed);
+        try {
+            item.task();
+        }
+        catch (const std::exception& e) {
+            // 任务应自行处理异常并完成请求，这里只保证线程不退出
+            LOG_ERROR("处理函数线程池的任务抛出异常: " + std::string(e.what()));
+        }
+        catch (...) {
+            LOG_ERROR("处理函数线程池的任务抛出未知异常");
+        }
+        busy_threads_.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+} // namespace hsmm
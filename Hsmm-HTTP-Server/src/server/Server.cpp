@@ -1,84 +1,300 @@
 #include "server/Server.hpp"
 #include "server/Connection.hpp"
+#include "http/StaticFileHandler.hpp"
+#include "server/UringBackend.hpp"
+#include "tls/Context.hpp"
+#include "utils/CpuAffinity.hpp"
+#include "utils/IoBuffer.hpp"
 #include "utils/Logger.hpp"
+#include "utils/Metrics.hpp"
 #include <boost/asio/signal_set.hpp>
+#include <algorithm>
+#include <csignal>
 #include <memory>
 #include <stdexcept>
+#ifdef __linux__
+#include <sys/socket.h>
+#endif
 
 namespace hsmm {
 
-Server::Server(const std::string& address, unsigned short port, size_t thread_count)
+namespace {
+// 时间轮的时钟间隔，即超时精度
+constexpr std::chrono::milliseconds timer_tick{500};
+// 优雅关闭期间检查连接是否全部关闭的间隔
+constexpr std::chrono::milliseconds drain_poll_interval{50};
+}
+
+Server::Listener::Listener(const boost::asio::any_io_executor& executor, boost::asio::io_context& io_context,
+                           std::chrono::milliseconds backoff)
+    : acceptor(executor)
+    , timer(executor)
+    , io_context(io_context)
+    , pool(io_context)
+    , backoff(backoff) {
+}
+
+Server::Shard::Shard(int cpu, std::chrono::milliseconds backoff)
+    : work_guard(boost::asio::make_work_guard(io_context))
+    , listener(io_context.get_executor(), io_context, backoff)
+    , cpu(cpu) {
+}
+
+Server::Server(const std::string& address, unsigned short port, size_t thread_count, ServerOptions options)
     : io_context_(thread_count)  // 设置并发线程数
     , work_guard_(boost::asio::make_work_guard(io_context_))  // 防止io_context过早退出
-    , acceptor_(io_context_)
-    , thread_count_(thread_count) {
+    , strand_(boost::asio::make_strand(io_context_))
+    , listener_(strand_, io_context_, options.accept_backoff)
+    , drain_timer_(strand_)
+    , signals_(strand_, SIGINT, SIGTERM)
+    , thread_count_(thread_count)
+    , options_(options)
+    , compression_pool_(std::max<size_t>(options_.compression.threads, 1))
+    , timers_(io_context_, timer_tick)
+    , admission_(options_.admission)
+    , tls_(options_.tls.certificate_file.empty() ? nullptr
+           : std::make_unique<tls::Context>(options_.tls, options_.http2.enabled))
+    , context_{router_, options_, timers_, compression_pool_, admission_, tls_.get()} {
+#ifdef SIGPIPE
+    if (tls_) {
+        // OpenSSL直接用write()写socket，对端已关闭时不能让SIGPIPE终止进程
+        std::signal(SIGPIPE, SIG_IGN);
+    }
+#endif
     
     boost::asio::ip::tcp::endpoint endpoint(
         boost::asio::ip::make_address(address), port);
-    
+
+#ifdef HSMM_HAS_IO_URING
+    if (tls_) {
+        LOG_WARNING("io_uring后端不支持TLS，使用Asio后端");
+    } else if (admission_.enabled()) {
+        LOG_WARNING("io_uring后端不支持准入控制（限速和过载保护），使用Asio后端");
+    } else if (UringBackend::available()) {
+        use_uring_ = true;
+    } else {
+        LOG_WARNING("当前内核不支持io_uring，回退到Asio后端");
+    }
+#endif
+
+    if (options_.cpu.affinity.empty() || use_uring_) {
+        open_acceptor(listener_.acceptor, endpoint, false);
+    } else {
+        // 每个IO线程一个监听socket，由内核按连接的四元组分配到各个线程
+        for (size_t i = 0; i < thread_count_; ++i) {
+            const int cpu = options_.cpu.affinity[i % options_.cpu.affinity.size()];
+            shards_.push_back(std::make_unique<Shard>(cpu, options_.accept_backoff));
+            open_acceptor(shards_.back()->listener.acceptor, endpoint, true);
+        }
+    }
+
+    if (options_.cache.max_bytes > 0) {
+        // 后台刷新缓存条目在工作线程上执行，不占用触发刷新的请求
+        cache_ = std::make_shared<http::ResponseCache>(options_.cache, options_.compression,
+            [this](std::function<void()> task) { boost::asio::post(io_context_, std::move(task)); });
+    }
+
+    // 没有匹配路由的请求返回默认欢迎信息
+    router_.set_default([](const http::HttpRequest&, http::HttpResponse& response) {
+        response.set_status(200, "OK");
+        response.add_header("Content-Type", "text/plain");
+        response.add_header("Server", "HSMM-HTTP-Server");
+        response.set_body("Hello from HSMM HTTP Server!");
+    });
+
+    if (!options_.metrics_path.empty()) {
+        router_.add_route(options_.metrics_path, [this](const http::HttpRequest&, http::HttpResponse& response) {
+            auto text = std::make_shared<std::string>();
+            utils::Metrics::instance().render(*text);
+            utils::Metrics::render_gauge(*text, "hsmm_connections_active", "当前打开的连接数",
+                                         static_cast<double>(active_connections()));
+            if (cache_) {
+                utils::Metrics::render_gauge(*text, "hsmm_cache_bytes", "响应缓存占用的字节数",
+                                             static_cast<double>(cache_->size_bytes()));
+            }
+            if (handler_pool_) {
+                utils::Metrics::render_gauge(*text, "hsmm_handler_queue_depth", "在处理函数线程池中排队的请求数",
+                                             static_cast<double>(handler_pool_->queue_depth()));
+                utils::Metrics::render_gauge(*text, "hsmm_handler_threads_busy", "正在执行处理函数的线程数",
+                                             static_cast<double>(handler_pool_->busy_threads()));
+            }
+            if (options_.admission.max_inflight_requests > 0 || options_.admission.latency_target.count() > 0) {
+                utils::Metrics::render_gauge(*text, "hsmm_requests_inflight", "已准入但还没有生成响应的请求数",
+                                             static_cast<double>(admission_.inflight()));
+            }
+            response.set_status(200, "OK");
+            response.add_header("Content-Type", "text/plain; version=0.0.4");
+            const std::string_view body(*text);
+            response.set_body(body, std::move(text));
+        });
+    }
+
+    LOG_INFO("服务器初始化完成，监听地址: " + address + ":" + std::to_string(port));
+}
+
+Server::~Server() = default;
+
+void Server::open_acceptor(boost::asio::ip::tcp::acceptor& acceptor, const boost::asio::ip::tcp::endpoint& endpoint,
+                           bool reuse_port) {
     // 配置接受器
     boost::system::error_code ec;
-    acceptor_.open(endpoint.protocol(), ec);
+    acceptor.open(endpoint.protocol(), ec);
     if (ec) {
         LOG_ERROR("打开接受器失败: " + ec.message());
         throw std::runtime_error("打开接受器失败: " + ec.message());
     }
 
-    acceptor_.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true), ec);
+    acceptor.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true), ec);
     if (ec) {
         LOG_ERROR("设置地址重用选项失败: " + ec.message());
         throw std::runtime_error("设置地址重用选项失败: " + ec.message());
     }
 
-    acceptor_.bind(endpoint, ec);
+#ifdef __linux__
+    if (reuse_port) {
+        acceptor.set_option(boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>(true), ec);
+        if (ec) {
+            LOG_ERROR("设置端口重用选项失败: " + ec.message());
+            throw std::runtime_error("设置端口重用选项失败: " + ec.message());
+        }
+    }
+
+    if (options_.cpu.busy_poll.count() > 0) {
+        // 由accept得到的连接继承监听socket的SO_BUSY_POLL；设置失败（通常是权限不足）不影响服务
+        const auto busy_poll = static_cast<int>(options_.cpu.busy_poll.count());
+        acceptor.set_option(boost::asio::detail::socket_option::integer<SOL_SOCKET, SO_BUSY_POLL>(busy_poll), ec);
+        if (ec) {
+            LOG_WARNING("设置SO_BUSY_POLL失败: " + ec.message());
+            ec.clear();
+        }
+    }
+#else
+    (void)reuse_port;
+#endif
+
+    acceptor.bind(endpoint, ec);
     if (ec) {
         LOG_ERROR("绑定地址失败: " + ec.message());
         throw std::runtime_error("绑定地址失败: " + ec.message());
     }
 
-    acceptor_.listen(boost::asio::socket_base::max_listen_connections, ec);
+    acceptor.listen(boost::asio::socket_base::max_listen_connections, ec);
     if (ec) {
         LOG_ERROR("开始监听失败: " + ec.message());
         throw std::runtime_error("开始监听失败: " + ec.message());
     }
+}
 
-    LOG_INFO("服务器初始化完成，监听地址: " + address + ":" + std::to_string(port));
+void Server::serve_static(const std::filesystem::path& root, const std::string& url_prefix) {
+    http::StaticFileHandler::Options static_options;
+    static_options.compression = options_.compression;
+    auto handler = std::make_shared<http::StaticFileHandler>(io_context_, root, url_prefix, static_options);
+    router_.add_prefix_route(url_prefix, [handler](const http::HttpRequest& request, http::HttpResponse& response) {
+        handler->handle(request, response);
+    });
+}
+
+void Server::reverse_proxy(const std::string& url_prefix, const std::vector<std::string>& upstreams,
+                           proxy::ReverseProxy::Options options) {
+    auto proxy = std::make_shared<proxy::ReverseProxy>(io_context_, upstreams, std::move(options));
+    proxy->start();
+    http::Router::AsyncHandler handler =
+        [proxy](const http::HttpRequest& request, http::HttpResponse& response, http::Router::Completion done) {
+            proxy->handle(request, response, std::move(done));
+        };
+    router_.add_async_prefix_route(url_prefix, cache_ ? cache_->wrap(std::move(handler)) : std::move(handler));
+}
+
+void Server::add_cached_route(std::string path, http::Router::Handler handler) {
+    if (cache_) {
+        router_.add_async_route(std::move(path), cache_->wrap(std::move(handler)));
+    } else {
+        router_.add_route(std::move(path), std::move(handler));
+    }
+}
+
+void Server::add_blocking_route(std::string path, http::Router::Handler handler) {
+    if (!handler_pool_) {
+        // 默认把IO线程用不到的核心都分给处理函数
+        const size_t cores = std::thread::hardware_concurrency();
+        const auto threads = options_.blocking.threads > 0 ? options_.blocking.threads
+            : (cores > thread_count_ ? cores - thread_count_ : 1);
+        handler_pool_ = std::make_unique<HandlerPool>(threads, options_.blocking.max_queue);
+        LOG_INFO("启动处理函数线程池，线程数: " + std::to_string(handler_pool_->thread_count()));
+    }
+
+    // 路由表运行期间只读，处理函数在线程池上通过共享指针访问
+    auto shared = std::make_shared<const http::Router::Handler>(std::move(handler));
+    router_.add_async_route(std::move(path),
+        [pool = handler_pool_.get(), shared](const http::HttpRequest& request, http::HttpResponse& response,
+                                             http::Router::Completion done) {
+            // 调用done之前请求和响应保持有效，连接也不会访问它们
+            auto task = [shared, &request, &response, done]() mutable {
+                try {
+                    (*shared)(request, response);
+                }
+                catch (const std::exception& e) {
+                    LOG_ERROR("处理请求时发生错误: " + std::string(e.what()));
+                    http::set_error_response(response, 500, "Internal Server Error");
+                }
+                catch (...) {
+                    LOG_ERROR("处理请求时发生未知错误");
+                    http::set_error_response(response, 500, "Internal Server Error");
+                }
+                done();
+            };
+            if (!pool->submit(std::move(task))) {
+                utils::Metrics::add(utils::Counter::handler_rejected);
+                http::set_error_response(response, 503, "Service Unavailable");
+                response.add_header("Retry-After", "1");
+                done();
+            }
+        });
 }
 
 void Server::run() {
     running_ = true;
+    wait_signal();
+    timers_.start();
 
-    // 启动工作线程
-    LOG_INFO("启动工作线程池，线程数: " + std::to_string(thread_count_));
-    for (size_t i = 0; i < thread_count_ - 1; ++i) {
-        worker_threads_.emplace_back([this] { worker_thread(); });
+#ifdef HSMM_HAS_IO_URING
+    if (use_uring_) {
+        run_uring();
     }
+#endif
+
+    if (!shards_.empty()) {
+        // 绑定核心的IO线程各自accept和处理连接，主线程只运行共享的io_context
+        LOG_INFO("启动绑定核心的IO线程，线程数: " + std::to_string(shards_.size()));
+        for (auto& shard : shards_) {
+            worker_threads_.emplace_back([this, &shard = *shard] { shard_thread(shard); });
+        }
+    } else if (!uring_backend_) {
+        // 启动工作线程
+        LOG_INFO("启动工作线程池，线程数: " + std::to_string(thread_count_));
+        for (size_t i = 0; i < thread_count_ - 1; ++i) {
+            worker_threads_.emplace_back([this] { worker_thread(); });
+        }
 
-    // 启动接受连接
-    do_accept();
+        // 启动接受连接
+        boost::asio::post(strand_, [this] { do_accept(listener_); });
+    }
 
     // 主线程也运行io_context
     try {
-        io_context_.run();
+        if (shards_.empty()) {
+            run_loop(io_context_);
+        } else {
+            io_context_.run();
+        }
         LOG_INFO("服务器主循环退出");
     }
     catch (const std::exception& e) {
         LOG_ERROR("主线程异常: " + std::string(e.what()));
-        stop();
+        running_ = false;
+        io_context_.stop();
     }
-}
-
-void Server::stop() {
-    if (!running_) return;
-
-    LOG_INFO("正在停止服务器...");
-    running_ = false;
-    
-    // 停止接受新的工作
-    work_guard_.reset();
-    
-    // 停止io_context
-    io_context_.stop();
+    stopped_ = true;
 
     // 等待所有工作线程结束
     for (auto& thread : worker_threads_) {
@@ -86,48 +302,233 @@ void Server::stop() {
             thread.join();
         }
     }
+    worker_threads_.clear();
+    // 正在执行的压缩任务和处理函数还会访问连接和服务器状态
+    compression_pool_.join();
+    if (handler_pool_) {
+        handler_pool_->stop();
+    }
+    // 释放空闲连接，其他连接随io_context中剩余的处理函数一起销毁
+    listener_.pool.clear();
+    for (auto& shard : shards_) {
+        shard->listener.pool.clear();
+    }
 
     LOG_INFO("服务器已停止");
 }
 
-void Server::do_accept() {
+#ifdef HSMM_HAS_IO_URING
+void Server::run_uring() {
+    // 每个线程一个io_uring事件循环，共享同一个监听socket；主线程运行io_context，处理静态文件监听等其余异步任务
+    LOG_INFO("使用io_uring后端，线程数: " + std::to_string(thread_count_));
+    uring_backend_ = std::make_unique<UringBackend>(listener_.acceptor.native_handle(), context_, stopped_);
+    for (size_t i = 0; i < thread_count_; ++i) {
+        worker_threads_.emplace_back([this, i] {
+            const auto& cpus = options_.cpu.affinity;
+            if (!cpus.empty() && !utils::pin_current_thread(cpus[i % cpus.size()])) {
+                LOG_WARNING("绑定CPU " + std::to_string(cpus[i % cpus.size()]) + " 失败");
+            }
+            try {
+                uring_backend_->run_worker();
+                LOG_INFO("io_uring工作线程退出");
+            }
+            catch (const std::exception& e) {
+                LOG_ERROR("io_uring工作线程异常: " + std::string(e.what()));
+            }
+        });
+    }
+}
+#endif
+
+void Server::stop() {
+    if (!running_.exchange(false)) return;
+
+    LOG_INFO("正在停止服务器...");
+    boost::asio::post(strand_, [this] { begin_drain(); });
+}
+
+void Server::wait_signal() {
+    signals_.async_wait([this](boost::system::error_code ec, int signal_number) {
+        if (ec) return;
+
+        if (running_) {
+            LOG_INFO("收到信号 " + std::to_string(signal_number) + "，开始优雅关闭");
+            stop();
+            wait_signal();
+        } else {
+            LOG_WARNING("再次收到信号，立即退出");
+            io_context_.stop();
+        }
+    });
+}
+
+void Server::begin_drain() {
+    // 停止接受新连接，已在内核监听队列中的连接随监听socket一起关闭
+    boost::system::error_code ec;
+    listener_.acceptor.close(ec);
+    listener_.timer.cancel();
+    for (auto& shard : shards_) {
+        boost::asio::post(shard->io_context, [&listener = shard->listener] {
+            boost::system::error_code ignored;
+            listener.acceptor.close(ignored);
+            listener.timer.cancel();
+        });
+    }
+
+    // 空闲连接立即关闭，处理中的连接发送完当前响应后关闭
+    context_.draining = true;
+    timers_.expire_all();
+
+    LOG_INFO("等待 " + std::to_string(active_connections()) + " 个连接完成");
+    drain_deadline_ = std::chrono::steady_clock::now() + options_.drain_timeout;
+    check_drained();
+}
+
+void Server::check_drained() {
+    const auto remaining = active_connections();
+    if (remaining > 0 && std::chrono::steady_clock::now() < drain_deadline_) {
+        drain_timer_.expires_after(drain_poll_interval);
+        drain_timer_.async_wait([this](boost::system::error_code ec) {
+            if (!ec) {
+                check_drained();
+            }
+        });
+        return;
+    }
+
+    if (remaining > 0) {
+        LOG_WARNING("等待超时，强制关闭剩余的 " + std::to_string(remaining) + " 个连接");
+    }
+
+    timers_.stop();
+    signals_.cancel();
+    work_guard_.reset();
+    io_context_.stop();
+    for (auto& shard : shards_) {
+        shard->work_guard.reset();
+        shard->io_context.stop();
+    }
+}
+
+void Server::do_accept(Listener& listener) {
     if (!running_) return;
 
-    acceptor_.async_accept(
-        [this](boost::system::error_code ec, boost::asio::ip::tcp::socket socket) {
+    if (active_connections() >= options_.max_connections) {
+        // 连接数达到上限：暂停accept，新连接留在内核的监听队列中等待
+        LOG_DEBUG("连接数达到上限 " + std::to_string(options_.max_connections) + "，暂停接受新连接");
+        pause_accept(listener);
+        return;
+    }
+
+    // 从监听socket所属io_context的连接池取出连接对象，直接在其socket上接受连接
+    auto connection = listener.pool.acquire();
+    auto& socket = connection->socket();
+
+    listener.acceptor.async_accept(
+        socket,
+        [this, &listener, connection = std::move(connection)](boost::system::error_code ec) mutable {
             if (!ec) {
+                utils::Metrics::add(utils::Counter::connections_accepted);
+                listener.backoff = options_.accept_backoff;
+                if (!admission_.allow_connection(connection->socket())) {
+                    // 超出该客户端的新建连接速率：不读取任何数据，直接关闭
+                    connection->reset();
+                    listener.pool.recycle(std::move(connection));
+                    do_accept(listener);
+                    return;
+                }
                 try {
-                    LOG_DEBUG("接受新连接: " + socket.remote_endpoint().address().to_string() + 
-                             ":" + std::to_string(socket.remote_endpoint().port()));
-
-                    // 使用PMR内存池创建连接对象
-                    auto connection = std::allocate_shared<Connection>(
-                        std::pmr::polymorphic_allocator<Connection>(&connection_pool_),
-                        std::move(socket));
-                    
-                    connection->start();
+                    LOG_DEBUG("接受新连接: " + connection->socket().remote_endpoint().address().to_string() + 
+                             ":" + std::to_string(connection->socket().remote_endpoint().port()));
+
+                    connection->start(context_);
                 }
                 catch (const std::exception& e) {
                     LOG_ERROR("处理新连接时发生错误: " + std::string(e.what()));
+                    connection->reset();
+                    listener.pool.recycle(std::move(connection));
                 }
             } else {
+                connection->reset();
+                listener.pool.recycle(std::move(connection));
+                if (ec == boost::asio::error::operation_aborted) {
+                    return;
+                }
+
                 LOG_ERROR("接受连接失败: " + ec.message());
+                if (ec == boost::asio::error::no_descriptors ||
+                    ec == boost::system::errc::too_many_files_open_in_system ||
+                    ec == boost::asio::error::no_buffer_space ||
+                    ec == boost::asio::error::no_memory) {
+                    // 资源耗尽时立即重试只会空转，等待已有连接释放资源
+                    pause_accept(listener);
+                    return;
+                }
             }
 
             // 继续接受下一个连接
-            if (running_) {
-                do_accept();
-            }
+            do_accept(listener);
         });
 }
 
+void Server::pause_accept(Listener& listener) {
+    listener.timer.expires_after(listener.backoff);
+    listener.backoff = std::min(listener.backoff * 2, options_.max_accept_backoff);
+    listener.timer.async_wait([this, &listener](boost::system::error_code ec) {
+        if (!ec) {
+            do_accept(listener);
+        }
+    });
+}
+
 void Server::worker_thread() {
     try {
-        io_context_.run();
+        run_loop(io_context_);
         LOG_INFO("工作线程退出");
     }
     catch (const std::exception& e) {
         LOG_ERROR("工作线程异常: " + std::string(e.what()));
     }
 }
+
+void Server::shard_thread(Shard& shard) {
+    if (!utils::pin_current_thread(shard.cpu)) {
+        LOG_WARNING("绑定CPU " + std::to_string(shard.cpu) + " 失败");
+    } else if (options_.cpu.numa_local) {
+        // 之后这个线程分配的连接对象、请求内存池和读缓冲区都在本地节点上
+        const int node = utils::numa_node_of_cpu(shard.cpu);
+        if (node >= 0 && !utils::prefer_numa_node(node)) {
+            LOG_WARNING("设置NUMA节点 " + std::to_string(node) + " 的内存策略失败");
+        }
+        shard.listener.pool.preallocate(options_.cpu.preallocate_connections);
+        utils::IoBuffer::preallocate(options_.cpu.preallocate_connections);
+    }
+
+    try {
+        do_accept(shard.listener);
+        run_loop(shard.io_context);
+        LOG_INFO("IO线程退出，CPU " + std::to_string(shard.cpu));
+    }
+    catch (const std::exception& e) {
+        LOG_ERROR("IO线程异常: " + std::string(e.what()));
+    }
+}
+
+void Server::run_loop(boost::asio::io_context& io_context) {
+    if (options_.cpu.spin.count() == 0) {
+        io_context.run();
+        return;
+    }
+
+    // 有就绪事件时一直非阻塞地处理；连续空闲超过spin后才阻塞等待下一个事件
+    auto idle_since = std::chrono::steady_clock::now();
+    while (!io_context.stopped()) {
+        if (io_context.poll() > 0) {
+            idle_since = std::chrono::steady_clock::now();
+        } else if (std::chrono::steady_clock::now() - idle_since >= options_.cpu.spin) {
+            io_context.run_one();
+            idle_since = std::chrono::steady_clock::now();
+        }
+    }
+}
 } 
\ No newline at end of file
@@ -0,0 +1,158 @@
+#include "server/TimerWheel.hpp"
+#include <algorithm>
+
+namespace hsmm {
+
+TimerWheel::TimerWheel(boost::asio::io_context& io_context, std::chrono::milliseconds tick, size_t slots)
+    // 时钟在独立的strand上运行，stop()可以从任意线程调用
+    : timer_(boost::asio::make_strand(io_context))
+    , tick_(std::chrono::duration_cast<std::chrono::nanoseconds>(tick).count())
+    , slots_(std::max<size_t>(slots, 1), nullptr) {
+}
+
+void TimerWheel::start() {
+    boost::asio::post(timer_.get_executor(), [this] {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            current_tick_ = to_ticks(clock::now()) / tick_;
+        }
+        running_ = true;
+        do_tick();
+    });
+}
+
+void TimerWheel::stop() {
+    boost::asio::post(timer_.get_executor(), [this] {
+        running_ = false;
+        timer_.cancel();
+    });
+}
+
+void TimerWheel::add(Entry& entry, clock::time_point deadline) {
+    const auto ticks = to_ticks(deadline);
+    entry.deadline_.store(ticks, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (entry.linked_) {
+        unlink(entry);
+    }
+    link(entry, ticks);
+}
+
+void TimerWheel::remove(Entry& entry) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (entry.linked_) {
+        unlink(entry);
+    }
+}
+
+void TimerWheel::update(Entry& entry, clock::time_point deadline) {
+    const auto ticks = to_ticks(deadline);
+    entry.deadline_.store(ticks, std::memory_order_relaxed);
+
+    // 截止时间晚于所在槽位时，由时钟在处理该槽位时顺延，不需要加锁
+    if (ticks >= entry.bucket_deadline_.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (entry.linked_) {
+        unlink(entry);
+        link(entry, ticks);
+    }
+}
+
+void TimerWheel::reinsert(Entry& entry) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!entry.linked_) {
+        link(entry, entry.deadline_.load(std::memory_order_relaxed));
+    }
+}
+
+void TimerWheel::expire_all() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& head : slots_) {
+        auto* entry = head;
+        head = nullptr;
+        while (entry) {
+            auto* next = entry->next_;
+            entry->prev_ = entry->next_ = nullptr;
+            entry->linked_ = false;
+            entry->on_expire();
+            entry = next;
+        }
+    }
+}
+
+size_t TimerWheel::slot_of(std::int64_t deadline) const noexcept {
+    return static_cast<size_t>(deadline / tick_) % slots_.size();
+}
+
+void TimerWheel::link(Entry& entry, std::int64_t deadline) {
+    // 向上取整到时钟周期，已经过期的条目放到下一个要处理的槽位
+    const auto tick = std::max((deadline + tick_ - 1) / tick_, current_tick_);
+    auto& head = slots_[static_cast<size_t>(tick) % slots_.size()];
+
+    entry.bucket_deadline_.store(tick * tick_, std::memory_order_relaxed);
+    entry.prev_ = nullptr;
+    entry.next_ = head;
+    if (head) {
+        head->prev_ = &entry;
+    }
+    head = &entry;
+    entry.linked_ = true;
+}
+
+void TimerWheel::unlink(Entry& entry) {
+    if (entry.prev_) {
+        entry.prev_->next_ = entry.next_;
+    } else {
+        slots_[slot_of(entry.bucket_deadline_.load(std::memory_order_relaxed))] = entry.next_;
+    }
+    if (entry.next_) {
+        entry.next_->prev_ = entry.prev_;
+    }
+    entry.prev_ = entry.next_ = nullptr;
+    entry.linked_ = false;
+}
+
+void TimerWheel::do_tick() {
+    if (!running_) return;
+
+    const auto now = to_ticks(clock::now());
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const auto now_tick = now / tick_;
+        // 处理从上次到现在经过的所有时钟周期，最多转一圈
+        const auto last = std::min(now_tick, current_tick_ + static_cast<std::int64_t>(slots_.size()) - 1);
+        for (; current_tick_ <= last; ++current_tick_) {
+            auto& head = slots_[static_cast<size_t>(current_tick_) % slots_.size()];
+            auto* entry = head;
+            head = nullptr;
+            // 先把整个槽位摘下来，再逐个到期或顺延到新的槽位
+            while (entry) {
+                auto* next = entry->next_;
+                entry->prev_ = entry->next_ = nullptr;
+                entry->linked_ = false;
+                const auto deadline = entry->deadline_.load(std::memory_order_relaxed);
+                if (deadline <= now) {
+                    entry->on_expire();
+                } else {
+                    link(*entry, deadline);
+                }
+                entry = next;
+            }
+        }
+        current_tick_ = std::max(current_tick_, now_tick + 1);
+    }
+
+    timer_.expires_at(clock::time_point(
+        std::chrono::duration_cast<clock::duration>(std::chrono::nanoseconds(current_tick_ * tick_))));
+    timer_.async_wait([this](boost::system::error_code ec) {
+        if (!ec) {
+            do_tick();
+        }
+    });
+}
+
+} // namespace hsmm
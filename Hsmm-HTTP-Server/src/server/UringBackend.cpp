@@ -0,0 +1,981 @@
+#include "server/UringBackend.hpp"
+#include "http/HttpParser.hpp"
+#include "http/Router.hpp"
+#include "server/ServerContext.hpp"
+#include "utils/IoBuffer.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Metrics.hpp"
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+namespace hsmm {
+
+namespace {
+
+    int io_uring_setup(unsigned entries, io_uring_params* params) {
+        return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+    }
+
+    int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+        return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+    }
+
+    int io_uring_register(int fd, unsigned opcode, void* arg, unsigned nr_args) {
+        return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+    }
+
+    [[noreturn]] void throw_errno(const char* what) {
+        throw std::system_error(errno, std::system_category(), what);
+    }
+
+    // 把分块响应体全部编码到输出缓冲区：这个后端按整块发送响应，不支持逐块发送
+    bool append_chunks(std::pmr::string& out, const http::HttpResponse::ChunkSource& source) {
+        std::array<char, 8192> chunk;
+        char size[20];
+        try {
+            while (const auto n = std::min(source(chunk), chunk.size())) {
+                out.append(size, std::to_chars(size, size + sizeof(size), n, 16).ptr);
+                out.append("\r\n");
+                out.append(chunk.data(), n);
+                out.append("\r\n");
+            }
+        }
+        catch (const std::exception& e) {
+            LOG_ERROR("生成分块响应失败: " + std::string(e.what()));
+            return false;
+        }
+        out.append("0\r\n\r\n");
+        return true;
+    }
+
+    /**
+     * @brief io_uring提交队列和完成队列的最小封装
+     *
+     * 只由创建它的线程使用。get_sqe()只在本地推进队尾，enter()时才一次性发布并提交。
+     */
+    class Ring {
+    public:
+        explicit Ring(unsigned entries) {
+            io_uring_params params{};
+            params.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_COOP_TASKRUN;
+            fd_ = io_uring_setup(entries, &params);
+            if (fd_ < 0 && errno == EINVAL) {
+                // 旧内核不支持上述标志
+                params = io_uring_params{};
+                fd_ = io_uring_setup(entries, &params);
+            }
+            if (fd_ < 0) throw_errno("io_uring_setup");
+
+            sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            if (params.features & IORING_FEAT_SINGLE_MMAP) {
+                sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+            }
+
+            sq_ring_ = ::mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                              fd_, IORING_OFF_SQ_RING);
+            if (sq_ring_ == MAP_FAILED) throw_errno("mmap sq ring");
+            if (params.features & IORING_FEAT_SINGLE_MMAP) {
+                cq_ring_ = sq_ring_;
+            } else {
+                cq_ring_ = ::mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                  fd_, IORING_OFF_CQ_RING);
+                if (cq_ring_ == MAP_FAILED) throw_errno("mmap cq ring");
+            }
+            sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+            sqes_ = static_cast<io_uring_sqe*>(::mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                                                      MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES));
+            if (sqes_ == MAP_FAILED) throw_errno("mmap sqes");
+
+            auto* sq = static_cast<char*>(sq_ring_);
+            sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+            sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+            sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+            sq_entries_ = params.sq_entries;
+            auto* sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+            for (unsigned i = 0; i < sq_entries_; ++i) {
+                sq_array[i] = i;
+            }
+            local_tail_ = *sq_tail_;
+
+            auto* cq = static_cast<char*>(cq_ring_);
+            cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+            cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+            cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+            cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        }
+
+        ~Ring() {
+            if (sqes_ && sqes_ != MAP_FAILED) ::munmap(sqes_, sqes_size_);
+            if (cq_ring_ && cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_) ::munmap(cq_ring_, cq_ring_size_);
+            if (sq_ring_ && sq_ring_ != MAP_FAILED) ::munmap(sq_ring_, sq_ring_size_);
+            if (fd_ >= 0) ::close(fd_);
+        }
+
+        Ring(const Ring&) = delete;
+        Ring& operator=(const Ring&) = delete;
+
+        int fd() const noexcept { return fd_; }
+
+        /**
+         * @brief 获取一个空闲的提交项，队列已满时先提交已有的项
+         */
+        io_uring_sqe* get_sqe() {
+            if (local_tail_ - std::atomic_ref<unsigned>(*sq_head_).load(std::memory_order_acquire) >= sq_entries_) {
+                enter(0);
+            }
+            auto* sqe = &sqes_[local_tail_ & sq_mask_];
+            ++local_tail_;
+            std::memset(sqe, 0, sizeof(*sqe));
+            return sqe;
+        }
+
+        /**
+         * @brief 确保接下来的count个提交项不会被get_sqe()拆到两次提交中，用于链接的提交项
+         */
+        void reserve(unsigned count) {
+            if (local_tail_ - std::atomic_ref<unsigned>(*sq_head_).load(std::memory_order_acquire) + count > sq_entries_) {
+                enter(0);
+            }
+        }
+
+        /**
+         * @brief 批量提交所有待提交项，并等待至少min_complete个完成事件
+         */
+        void enter(unsigned min_complete) {
+            const unsigned to_submit = local_tail_ - *sq_tail_;
+            std::atomic_ref<unsigned>(*sq_tail_).store(local_tail_, std::memory_order_release);
+            if (to_submit == 0 && min_complete == 0) return;
+
+            const unsigned flags = min_complete > 0 ? IORING_ENTER_GETEVENTS : 0;
+            while (io_uring_enter(fd_, to_submit, min_complete, flags) < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN || errno == EBUSY) break;
+                throw_errno("io_uring_enter");
+            }
+        }
+
+        /**
+         * @brief 处理所有已完成的事件
+         * @return 处理的事件数
+         */
+        template<typename F>
+        unsigned for_each_cqe(F&& handle) {
+            unsigned head = *cq_head_;
+            const unsigned tail = std::atomic_ref<unsigned>(*cq_tail_).load(std::memory_order_acquire);
+            const unsigned count = tail - head;
+            for (; head != tail; ++head) {
+                handle(cqes_[head & cq_mask_]);
+            }
+            std::atomic_ref<unsigned>(*cq_head_).store(head, std::memory_order_release);
+            return count;
+        }
+
+    private:
+        int fd_{-1};
+        void* sq_ring_{nullptr};
+        void* cq_ring_{nullptr};
+        io_uring_sqe* sqes_{nullptr};
+        size_t sq_ring_size_{0};
+        size_t cq_ring_size_{0};
+        size_t sqes_size_{0};
+
+        unsigned* sq_head_{nullptr};
+        unsigned* sq_tail_{nullptr};
+        unsigned sq_mask_{0};
+        unsigned sq_entries_{0};
+        unsigned local_tail_{0};
+
+        unsigned* cq_head_{nullptr};
+        unsigned* cq_tail_{nullptr};
+        unsigned cq_mask_{0};
+        io_uring_cqe* cqes_{nullptr};
+    };
+
+    /**
+     * @brief 注册给内核的读缓冲区环
+     *
+     * 内核在recv完成时从环中挑选缓冲区，处理完后由用户态归还
+     */
+    class BufferRing {
+    public:
+        static constexpr unsigned buffer_size = 8192;
+        static constexpr std::uint16_t group_id = 0;
+
+        /**
+         * @param ring 注册到的io_uring实例
+         * @param buffer_count 缓冲区数量，必须是2的幂
+         */
+        BufferRing(Ring& ring, unsigned buffer_count)
+            : buffer_count_(buffer_count) {
+            ring_size_ = buffer_count_ * sizeof(io_uring_buf);
+            ring_ = static_cast<io_uring_buf*>(::mmap(nullptr, ring_size_, PROT_READ | PROT_WRITE,
+                                                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+            if (ring_ == MAP_FAILED) throw_errno("mmap buffer ring");
+
+            io_uring_buf_reg reg{};
+            reg.ring_addr = reinterpret_cast<std::uint64_t>(ring_);
+            reg.ring_entries = buffer_count_;
+            reg.bgid = group_id;
+            if (io_uring_register(ring.fd(), IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+                ::munmap(ring_, ring_size_);
+                throw_errno("IORING_REGISTER_PBUF_RING");
+            }
+
+            storage_ = std::make_unique<char[]>(static_cast<size_t>(buffer_count_) * buffer_size);
+            for (unsigned i = 0; i < buffer_count_; ++i) {
+                add(static_cast<std::uint16_t>(i));
+            }
+            publish();
+        }
+
+        ~BufferRing() {
+            ::munmap(ring_, ring_size_);
+        }
+
+        char* data(std::uint16_t bid) noexcept {
+            return storage_.get() + static_cast<size_t>(bid) * buffer_size;
+        }
+
+        // 归还缓冲区，publish()之后内核才能再次使用
+        void add(std::uint16_t bid) noexcept {
+            auto& buf = ring_[local_tail_ & (buffer_count_ - 1)];
+            buf.addr = reinterpret_cast<std::uint64_t>(data(bid));
+            buf.len = buffer_size;
+            buf.bid = bid;
+            ++local_tail_;
+        }
+
+        void publish() noexcept {
+            // 队尾与第一个缓冲区的resv字段重叠
+            std::atomic_ref<std::uint16_t>(ring_[0].resv).store(local_tail_, std::memory_order_release);
+        }
+
+    private:
+        unsigned buffer_count_;
+        io_uring_buf* ring_{nullptr};
+        size_t ring_size_{0};
+        std::uint16_t local_tail_{0};
+        std::unique_ptr<char[]> storage_;
+    };
+
+    enum class Op : std::uint64_t {
+        accept = 1,
+        recv = 2,
+        send = 3,
+        read_file = 4,
+        tick = 5,
+        // 链接在recv/send之后的超时，完成事件不需要处理
+        timeout = 6,
+        cancel = 7,
+        resume_accept = 8,
+    };
+
+    std::uint64_t make_user_data(Op op, int fd) noexcept {
+        return (static_cast<std::uint64_t>(op) << 32) | static_cast<std::uint32_t>(fd);
+    }
+
+    /**
+     * @brief io_uring后端上的单个连接
+     *
+     * 同一时刻只有一个操作在进行（recv、send或读文件），因此关闭时无需取消操作。
+     * 每个recv和send都链接一个IORING_OP_LINK_TIMEOUT，超过截止时间时操作以-ECANCELED结束，连接随之关闭。
+     * 收到的数据从内核提供的缓冲区复制到input，请求按HttpParser::header_size和
+     * Content-Length/分块编码划分边界，多余的数据留给下一个请求（pipelining）。
+     */
+    struct UringConnection {
+        static constexpr size_t arena_size = 16 * 1024;
+        static constexpr size_t file_chunk_size = 64 * 1024;
+
+        UringConnection()
+            : arena(arena_buffer.data(), arena_buffer.size()) {}
+
+        void finish_request() noexcept {
+            // 先销毁引用内存池的对象，再整体重置内存池
+            pending = {};
+            payload_owner.reset();
+            body_reader.reset();
+            file_body.reset();
+            response.reset();
+            request.reset();
+            body.reset();
+            header_copy.reset();
+            arena.release();
+            input.consume(request_size);
+            request_size = 0;
+        }
+
+        int fd{-1};
+        // 当前阶段的截止时间，和Asio后端一样按请求头、请求体、发送和空闲分别设置
+        std::chrono::steady_clock::time_point deadline;
+        // 提交时传给内核的剩余时间
+        __kernel_timespec timeout{};
+        // 在两个请求之间等待数据，优雅关闭时直接关闭
+        bool idle{false};
+        alignas(std::max_align_t) std::array<std::byte, arena_size> arena_buffer;
+        std::pmr::monotonic_buffer_resource arena;
+
+        // 已收到还未处理完的数据，当前请求结束时才丢弃其中属于它的部分
+        utils::IoBuffer input;
+        // input开头属于当前请求的长度，请求头解析完后确定
+        size_t request_size{0};
+        std::optional<http::HttpRequest> request;
+        // 分块编码的请求体解码到这里，请求头先复制出来，input中的数据逐块丢弃；
+        // 跨越内存块的Content-Length请求整个复制到header_copy中解析
+        std::optional<std::pmr::string> header_copy;
+        std::optional<std::pmr::string> body;
+        http::ChunkedDecoder chunked_decoder;
+        // 正在发送的是100 Continue，之后继续读取请求体
+        bool interim{false};
+        bool close_after_response{false};
+
+        std::optional<std::pmr::string> response;
+
+        // 尚未发送的数据
+        std::string_view pending;
+        std::shared_ptr<const void> payload_owner;
+        // 流式路由的BodyReader，响应可能引用它的成员
+        std::unique_ptr<http::BodyReader> body_reader;
+        std::optional<http::HttpResponse::FileBody> file_body;
+        std::unique_ptr<char[]> file_chunk;
+    };
+
+    /**
+     * @brief 单个线程的io_uring事件循环
+     */
+    class Worker {
+    public:
+        Worker(int listen_fd, ServerContext& context, const std::atomic<bool>& stopped)
+            : listen_fd_(listen_fd)
+            , context_(context)
+            , stopped_(stopped)
+            , accept_backoff_(context.options.accept_backoff)
+            , ring_(std::make_unique<Ring>(queue_depth))
+            , buffers_(*ring_, buffer_count) {}
+
+        ~Worker() {
+            // 先销毁io_uring实例取消所有进行中的操作，之后才能释放缓冲区和连接
+            ring_.reset();
+            for (auto& connection : connections_) {
+                if (connection && connection->fd >= 0) {
+                    ::close(connection->fd);
+                    context_.active_connections.fetch_sub(1, std::memory_order_relaxed);
+                }
+            }
+        }
+
+        void run() {
+            submit_accept();
+            submit_tick();
+
+            while (!stopped_.load(std::memory_order_relaxed)) {
+                // 本轮处理中产生的所有提交在这里一次性提交
+                ring_->enter(1);
+                ring_->for_each_cqe([this](const io_uring_cqe& cqe) { handle(cqe); });
+                buffers_.publish();
+                if (!draining_ && context_.draining.load(std::memory_order_relaxed)) {
+                    begin_drain();
+                }
+            }
+        }
+
+    private:
+        static constexpr unsigned queue_depth = 4096;
+        static constexpr unsigned buffer_count = 1024;
+
+        void handle(const io_uring_cqe& cqe) {
+            const auto op = static_cast<Op>(cqe.user_data >> 32);
+            const int fd = static_cast<int>(cqe.user_data & 0xffffffffu);
+
+            switch (op) {
+                case Op::accept: on_accept(cqe); break;
+                case Op::recv: on_recv(fd, cqe); break;
+                case Op::send: on_send(fd, cqe); break;
+                case Op::read_file: on_read_file(fd, cqe); break;
+                case Op::tick: submit_tick(); break;
+                case Op::resume_accept: resume_accept(); break;
+                case Op::timeout:
+                case Op::cancel:
+                    break;
+            }
+        }
+
+        /**
+         * @brief 优雅关闭：停止accept，关闭空闲连接；处理中的连接发送完当前响应后关闭
+         */
+        void begin_drain() {
+            draining_ = true;
+            if (accept_state_ == AcceptState::armed) {
+                submit_cancel(make_user_data(Op::accept, listen_fd_));
+            }
+            accept_state_ = AcceptState::stopped;
+            for (auto& connection : connections_) {
+                if (connection && connection->fd >= 0 && connection->idle) {
+                    // 取消的recv以-ECANCELED结束，在完成事件中关闭连接
+                    submit_cancel(make_user_data(Op::recv, connection->fd));
+                }
+            }
+        }
+
+        void submit_cancel(std::uint64_t user_data) {
+            auto* sqe = ring_->get_sqe();
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->fd = -1;
+            sqe->addr = user_data;
+            sqe->user_data = make_user_data(Op::cancel, 0);
+        }
+
+        /**
+         * @brief 暂停accept一段时间后重试，间隔按指数退避增长
+         */
+        void pause_accept() {
+            if (accept_state_ == AcceptState::armed) {
+                submit_cancel(make_user_data(Op::accept, listen_fd_));
+            }
+            accept_state_ = AcceptState::paused;
+
+            const auto backoff = std::chrono::duration_cast<std::chrono::nanoseconds>(accept_backoff_);
+            accept_backoff_ = std::min(accept_backoff_ * 2, context_.options.max_accept_backoff);
+            accept_pause_.tv_sec = backoff.count() / 1000000000;
+            accept_pause_.tv_nsec = backoff.count() % 1000000000;
+            auto* sqe = ring_->get_sqe();
+            sqe->opcode = IORING_OP_TIMEOUT;
+            sqe->fd = -1;
+            sqe->addr = reinterpret_cast<std::uint64_t>(&accept_pause_);
+            sqe->len = 1;
+            sqe->user_data = make_user_data(Op::resume_accept, 0);
+        }
+
+        void resume_accept() {
+            if (accept_state_ != AcceptState::paused) return;
+            if (context_.active_connections.load(std::memory_order_relaxed) >= context_.options.max_connections) {
+                pause_accept();
+                return;
+            }
+            submit_accept();
+        }
+
+        void submit_accept() {
+            accept_state_ = AcceptState::armed;
+            auto* sqe = ring_->get_sqe();
+            sqe->opcode = IORING_OP_ACCEPT;
+            sqe->fd = listen_fd_;
+            sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+            sqe->accept_flags = SOCK_CLOEXEC;
+            sqe->user_data = make_user_data(Op::accept, listen_fd_);
+        }
+
+        // 定期唤醒事件循环检查运行标志
+        void submit_tick() {
+            static __kernel_timespec interval{0, 100 * 1000 * 1000};
+            auto* sqe = ring_->get_sqe();
+            sqe->opcode = IORING_OP_TIMEOUT;
+            sqe->fd = -1;
+            sqe->addr = reinterpret_cast<std::uint64_t>(&interval);
+            sqe->len = 1;
+            sqe->user_data = make_user_data(Op::tick, 0);
+        }
+
+        void set_deadline(UringConnection& connection, std::chrono::milliseconds timeout) {
+            connection.deadline = std::chrono::steady_clock::now() + timeout;
+        }
+
+        void submit_recv(UringConnection& connection) {
+            ring_->reserve(2);
+            auto* sqe = ring_->get_sqe();
+            sqe->opcode = IORING_OP_RECV;
+            sqe->fd = connection.fd;
+            sqe->flags = IOSQE_BUFFER_SELECT | IOSQE_IO_LINK;
+            sqe->buf_group = BufferRing::group_id;
+            sqe->user_data = make_user_data(Op::recv, connection.fd);
+            submit_link_timeout(connection);
+        }
+
+        void submit_send(UringConnection& connection) {
+            ring_->reserve(2);
+            auto* sqe = ring_->get_sqe();
+            sqe->opcode = IORING_OP_SEND;
+            sqe->fd = connection.fd;
+            sqe->flags = IOSQE_IO_LINK;
+            sqe->addr = reinterpret_cast<std::uint64_t>(connection.pending.data());
+            sqe->len = static_cast<std::uint32_t>(connection.pending.size());
+            sqe->msg_flags = MSG_NOSIGNAL;
+            sqe->user_data = make_user_data(Op::send, connection.fd);
+            submit_link_timeout(connection);
+        }
+
+        // 前一个操作在截止时间前没有完成时被内核取消
+        void submit_link_timeout(UringConnection& connection) {
+            const auto remaining = std::max<std::chrono::nanoseconds>(
+                connection.deadline - std::chrono::steady_clock::now(), std::chrono::milliseconds(1));
+            connection.timeout.tv_sec = remaining.count() / 1000000000;
+            connection.timeout.tv_nsec = remaining.count() % 1000000000;
+            auto* sqe = ring_->get_sqe();
+            sqe->opcode = IORING_OP_LINK_TIMEOUT;
+            sqe->fd = -1;
+            sqe->addr = reinterpret_cast<std::uint64_t>(&connection.timeout);
+            sqe->len = 1;
+            sqe->user_data = make_user_data(Op::timeout, connection.fd);
+        }
+
+        void submit_read_file(UringConnection& connection) {
+            if (!connection.file_chunk) {
+                connection.file_chunk = std::make_unique<char[]>(UringConnection::file_chunk_size);
+            }
+            auto& body = *connection.file_body;
+            auto* sqe = ring_->get_sqe();
+            sqe->opcode = IORING_OP_READ;
+            sqe->fd = body.fd;
+            sqe->off = body.offset;
+            sqe->addr = reinterpret_cast<std::uint64_t>(connection.file_chunk.get());
+            sqe->len = static_cast<std::uint32_t>(std::min<std::uint64_t>(body.length, UringConnection::file_chunk_size));
+            sqe->user_data = make_user_data(Op::read_file, connection.fd);
+        }
+
+        void on_accept(const io_uring_cqe& cqe) {
+            if (!draining_ && context_.draining.load(std::memory_order_relaxed)) {
+                // 监听socket可能已经关闭，不能再重新提交accept
+                begin_drain();
+            }
+            // multishot accept在没有IORING_CQE_F_MORE时已终止，暂停或停止accept时不再重新提交
+            if (!(cqe.flags & IORING_CQE_F_MORE) && accept_state_ == AcceptState::armed) {
+                accept_state_ = AcceptState::idle;
+            }
+            if (cqe.res < 0) {
+                if (cqe.res != -ECANCELED) {
+                    LOG_ERROR("接受连接失败: " + std::string(std::strerror(-cqe.res)));
+                }
+                if (cqe.res == -EMFILE || cqe.res == -ENFILE || cqe.res == -ENOBUFS || cqe.res == -ENOMEM) {
+                    // 资源耗尽时立即重试只会空转，等待已有连接释放资源
+                    pause_accept();
+                } else if (accept_state_ == AcceptState::idle) {
+                    submit_accept();
+                }
+                return;
+            }
+
+            const int fd = cqe.res;
+            if (draining_) {
+                // 开始优雅关闭之后才完成的accept
+                ::close(fd);
+                return;
+            }
+            if (context_.active_connections.fetch_add(1, std::memory_order_relaxed) >= context_.options.max_connections) {
+                // multishot accept无法把连接留在监听队列中，超出上限的连接直接关闭，之后暂停accept
+                context_.active_connections.fetch_sub(1, std::memory_order_relaxed);
+                ::close(fd);
+                LOG_DEBUG("连接数达到上限 " + std::to_string(context_.options.max_connections) + "，暂停接受新连接");
+                pause_accept();
+                return;
+            }
+            if (accept_state_ == AcceptState::idle) {
+                submit_accept();
+            }
+
+            utils::Metrics::add(utils::Counter::connections_accepted);
+            accept_backoff_ = context_.options.accept_backoff;
+            if (static_cast<size_t>(fd) >= connections_.size()) {
+                connections_.resize(static_cast<size_t>(fd) + 1);
+            }
+            auto& slot = connections_[static_cast<size_t>(fd)];
+            if (!slot) {
+                slot = std::make_unique<UringConnection>();
+            }
+            slot->fd = fd;
+            // 新连接必须在header_timeout内发来完整的请求头
+            slot->idle = false;
+            set_deadline(*slot, context_.options.header_timeout);
+            submit_recv(*slot);
+        }
+
+        void on_recv(int fd, const io_uring_cqe& cqe) {
+            auto& connection = *connections_[static_cast<size_t>(fd)];
+
+            if (cqe.res == -ENOBUFS) {
+                // 缓冲区暂时耗尽，本轮结束时归还的缓冲区发布后重试
+                submit_recv(connection);
+                return;
+            }
+            if (cqe.res <= 0) {
+                if (cqe.res == -ECANCELED) {
+                    LOG_DEBUG(draining_ ? "优雅关闭，关闭空闲连接" : "连接超时，关闭连接");
+                } else if (cqe.res < 0 && cqe.res != -ECONNRESET) {
+                    LOG_ERROR("读取连接数据失败: " + std::string(std::strerror(-cqe.res)));
+                }
+                close(connection);
+                return;
+            }
+
+            // 数据复制出来后缓冲区立即归还，请求可以跨越多次读取
+            const auto bid = static_cast<std::uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+            const auto length = static_cast<size_t>(cqe.res);
+            utils::Metrics::add(utils::Counter::bytes_received, length);
+            const auto space = connection.input.prepare(length);
+            std::memcpy(space.data(), buffers_.data(bid), length);
+            connection.input.commit(length);
+            buffers_.add(bid);
+
+            process(connection);
+        }
+
+        /**
+         * @brief 根据已收到的数据推进当前请求：数据不够时继续读取，请求完整时处理并发送响应
+         */
+        void process(UringConnection& connection) {
+            if (connection.body) {
+                read_chunked(connection);
+                return;
+            }
+            if (connection.request_size == 0) {
+                read_header(connection);
+                return;
+            }
+
+            // 等待Content-Length声明的请求体
+            auto& input = connection.input;
+            if (input.size() < connection.request_size) {
+                set_deadline(connection, context_.options.body_timeout);
+                submit_recv(connection);
+                return;
+            }
+            // 丢弃等待期间解析请求头的结果，重新解析完整的请求
+            connection.request.reset();
+            connection.arena.release();
+            std::span<const char> pending = input.front();
+            if (pending.size() < connection.request_size) {
+                // 请求跨越了内存块，从各个内存块聚集复制到请求内存池，读缓冲区不合并
+                connection.header_copy.emplace(connection.request_size, '\0', &connection.arena);
+                boost::asio::buffer_copy(
+                    boost::asio::buffer(connection.header_copy->data(), connection.request_size), input.data());
+                pending = *connection.header_copy;
+            }
+            auto request = http::HttpParser::parse(pending.first(connection.request_size), &connection.arena);
+            if (!request) {
+                reply_error(connection, 400, "Bad Request");
+                return;
+            }
+            connection.request.emplace(std::move(*request));
+            respond(connection);
+        }
+
+        void read_header(UringConnection& connection) {
+            auto& input = connection.input;
+            const auto& options = context_.options;
+            std::span<const char> pending = input.front();
+            auto header_size = http::HttpParser::header_size(pending);
+            if (header_size == 0 && pending.size() < input.size()) {
+                // 请求头跨越了内存块，合并后再查找结尾
+                pending = input.linearize();
+                header_size = http::HttpParser::header_size(pending);
+            }
+            if (header_size == 0) {
+                if (input.size() >= options.max_header_size) {
+                    reply_error(connection, 431, "Request Header Fields Too Large");
+                    return;
+                }
+                if (connection.idle && !input.empty()) {
+                    // 收到了请求的一部分，从空闲超时切换为请求头超时
+                    connection.idle = false;
+                    set_deadline(connection, options.header_timeout);
+                }
+                submit_recv(connection);
+                return;
+            }
+            connection.idle = false;
+
+            const auto parse_start = utils::Metrics::now_ns();
+            auto request = http::HttpParser::parse(pending, &connection.arena);
+            utils::Metrics::record(utils::Timer::parse, utils::Metrics::now_ns() - parse_start);
+            if (!request) {
+                reply_error(connection, 400, "Bad Request");
+                return;
+            }
+            connection.request_size = header_size;
+
+            if (!request->has_body()) {
+                connection.request.emplace(std::move(*request));
+                respond(connection);
+                return;
+            }
+
+            const auto buffered = input.size() - header_size;
+            if (request->chunked) {
+                // 请求头复制到内存池，请求体解码后input中的数据逐块丢弃
+                connection.header_copy.emplace(pending.data(), header_size, &connection.arena);
+                auto copied = http::HttpParser::parse(*connection.header_copy, &connection.arena);
+                if (!copied) {
+                    reply_error(connection, 400, "Bad Request");
+                    return;
+                }
+                connection.request.emplace(std::move(*copied));
+                input.consume(header_size);
+                connection.request_size = 0;
+                connection.body.emplace(&connection.arena);
+                connection.chunked_decoder.reset();
+                if (request->expect_continue && buffered == 0) {
+                    send_continue(connection);
+                } else {
+                    read_chunked(connection);
+                }
+                return;
+            }
+
+            if (*request->content_length > options.max_body_size) {
+                reply_error(connection, 413, "Payload Too Large");
+                return;
+            }
+            connection.request_size += static_cast<size_t>(*request->content_length);
+            if (connection.request_size <= pending.size()) {
+                // 请求体已经完整地和请求头在一起，直接使用解析结果
+                connection.request.emplace(std::move(*request));
+                respond(connection);
+            } else if (request->expect_continue && buffered == 0) {
+                send_continue(connection);
+            } else {
+                process(connection);
+            }
+        }
+
+        void read_chunked(UringConnection& connection) {
+            auto& input = connection.input;
+            const auto max_body_size = context_.options.max_body_size;
+            auto& body = *connection.body;
+            bool too_large = false;
+            auto status = http::ChunkedDecoder::Status::need_more;
+            while (status == http::ChunkedDecoder::Status::need_more && !input.empty()) {
+                size_t consumed = 0;
+                status = connection.chunked_decoder.decode(input.front(), consumed,
+                    [&](std::span<const char> data) {
+                        if (body.size() + data.size() > max_body_size) {
+                            too_large = true;
+                        } else if (!too_large) {
+                            body.append(data.data(), data.size());
+                        }
+                    });
+                input.consume(consumed);
+            }
+
+            if (status == http::ChunkedDecoder::Status::error) {
+                reply_error(connection, 400, "Bad Request");
+            } else if (too_large) {
+                reply_error(connection, 413, "Payload Too Large");
+            } else if (status == http::ChunkedDecoder::Status::done) {
+                connection.request->body = body;
+                respond(connection);
+            } else {
+                set_deadline(connection, context_.options.body_timeout);
+                submit_recv(connection);
+            }
+        }
+
+        void send_continue(UringConnection& connection) {
+            static constexpr std::string_view continue_response = "HTTP/1.1 100 Continue\r\n\r\n";
+            utils::Metrics::count_response(100);
+            connection.interim = true;
+            connection.pending = continue_response;
+            submit_send(connection);
+        }
+
+        /**
+         * @brief 调用路由的处理函数并发送响应
+         *
+         * 这个后端没有strand，异步路由返回501；流式路由在收到完整的请求体后才调用，请求体同样受max_body_size限制
+         */
+        void respond(UringConnection& connection) {
+            // 响应分配在请求内存池上
+            http::HttpResponse response(&connection.arena);
+            const auto& request = *connection.request;
+            // 客户端要求关闭连接（Connection: close或没有keep-alive的HTTP/1.0）时，响应中带上Connection: close
+            if (!request.keep_alive()) {
+                connection.close_after_response = true;
+            }
+            const auto handler_start = utils::Metrics::now_ns();
+            connection.body_reader = http::Router::handle(context_.router.find(request.uri), request, response);
+            utils::Metrics::record(utils::Timer::handler, utils::Metrics::now_ns() - handler_start);
+            send_response(connection, response);
+        }
+
+        void reply_error(UringConnection& connection, int code, std::string_view reason) {
+            // 请求的剩余部分没有读取，无法确定下一个请求从哪里开始
+            http::HttpResponse response(&connection.arena);
+            http::set_error_response(response, code, reason);
+            connection.close_after_response = true;
+            send_response(connection, response);
+        }
+
+        void send_response(UringConnection& connection, http::HttpResponse& response) {
+            utils::Metrics::add(utils::Counter::requests);
+            utils::Metrics::count_response(response.status_code());
+
+            const bool close_connection =
+                connection.close_after_response || context_.draining.load(std::memory_order_relaxed);
+            if (close_connection) {
+                // 通知客户端不要在这个连接上继续发送请求
+                response.add_header("Connection", "close");
+            }
+
+            // 预先生成的响应直接发送，其余响应序列化到请求内存池
+            connection.payload_owner = response.owner();
+            connection.file_body = response.file_body();
+            if (!response.prebuilt().empty() && close_connection) {
+                // 预先生成的响应不受add_header()影响，重新生成带Connection: close的头部，响应体接在后面一起发送
+                connection.response.emplace(&connection.arena);
+                connection.response->append(response.serialize_prebuilt_head(*connection.response, "Connection", "close"));
+                connection.pending = *connection.response;
+            } else if (!response.prebuilt().empty()) {
+                connection.pending = response.prebuilt();
+            } else {
+                connection.response.emplace(&connection.arena);
+                response.serialize(*connection.response);
+                if (response.chunked_body() && !append_chunks(*connection.response, response.chunked_body())) {
+                    close(connection);
+                    return;
+                }
+                connection.pending = *connection.response;
+            }
+            // 和Asio后端一样，write_timeout是两次写出数据之间的最长间隔，每次发送或读取文件有进展后重新计时
+            set_deadline(connection, context_.options.write_timeout);
+            submit_send(connection);
+        }
+
+        void on_send(int fd, const io_uring_cqe& cqe) {
+            auto& connection = *connections_[static_cast<size_t>(fd)];
+            if (cqe.res < 0) {
+                if (cqe.res == -ECANCELED) {
+                    LOG_DEBUG("发送响应超时，关闭连接");
+                } else if (cqe.res != -EPIPE && cqe.res != -ECONNRESET) {
+                    LOG_ERROR("写入响应数据失败: " + std::string(std::strerror(-cqe.res)));
+                }
+                close(connection);
+                return;
+            }
+
+            utils::Metrics::add(utils::Counter::bytes_sent, static_cast<std::uint64_t>(cqe.res));
+            connection.pending.remove_prefix(static_cast<size_t>(cqe.res));
+            if (!connection.pending.empty()) {
+                if (cqe.res > 0) {
+                    set_deadline(connection, context_.options.write_timeout);
+                }
+                submit_send(connection);
+            } else if (connection.file_body && connection.file_body->length > 0) {
+                submit_read_file(connection);
+            } else if (connection.interim) {
+                connection.interim = false;
+                connection.pending = {};
+                process(connection);
+            } else {
+                next_request(connection);
+            }
+        }
+
+        void next_request(UringConnection& connection) {
+            const bool close_connection = connection.close_after_response;
+            connection.finish_request();
+            if (close_connection || context_.draining.load(std::memory_order_relaxed)) {
+                close(connection);
+                return;
+            }
+
+            connection.idle = true;
+            set_deadline(connection, context_.options.idle_timeout);
+            if (!connection.input.empty()) {
+                // 客户端已经发来了下一个请求（pipelining）
+                process(connection);
+            } else {
+                submit_recv(connection);
+            }
+        }
+
+        void on_read_file(int fd, const io_uring_cqe& cqe) {
+            auto& connection = *connections_[static_cast<size_t>(fd)];
+            if (cqe.res <= 0) {
+                // 文件在发送过程中被截断或发生IO错误，响应已无法完整发送
+                LOG_ERROR("读取文件失败");
+                close(connection);
+                return;
+            }
+
+            auto& body = *connection.file_body;
+            body.offset += static_cast<std::uint64_t>(cqe.res);
+            body.length -= static_cast<std::uint64_t>(cqe.res);
+            connection.pending = std::string_view(connection.file_chunk.get(), static_cast<size_t>(cqe.res));
+            set_deadline(connection, context_.options.write_timeout);
+            submit_send(connection);
+        }
+
+        void close(UringConnection& connection) {
+            // 等待请求体时request_size超出已收到的数据
+            connection.request_size = 0;
+            connection.input.clear();
+            connection.finish_request();
+            connection.interim = false;
+            connection.close_after_response = false;
+            connection.idle = false;
+            ::close(connection.fd);
+            connection.fd = -1;
+            context_.active_connections.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+    private:
+        enum class AcceptState {
+            idle,    // multishot accept已终止，需要重新提交
+            armed,   // multishot accept进行中
+            paused,  // 等待退避时间结束
+            stopped  // 优雅关闭，不再accept
+        };
+
+        int listen_fd_;
+        ServerContext& context_;
+        const std::atomic<bool>& stopped_;
+        AcceptState accept_state_{AcceptState::idle};
+        std::chrono::milliseconds accept_backoff_;
+        __kernel_timespec accept_pause_{};
+        bool draining_{false};
+        std::unique_ptr<Ring> ring_;
+        BufferRing buffers_;
+        // 按文件描述符索引的连接表，连接对象随描述符复用
+        std::vector<std::unique_ptr<UringConnection>> connections_;
+    };
+
+} // namespace
+
+UringBackend::UringBackend(int listen_fd, ServerContext& context, const std::atomic<bool>& stopped)
+    : listen_fd_(listen_fd)
+    , context_(context)
+    , stopped_(stopped) {
+}
+
+bool UringBackend::available() noexcept {
+    try {
+        Ring ring(8);
+        BufferRing buffers(ring, 8);
+        return true;
+    }
+    catch (const std::exception&) {
+        return false;
+    }
+}
+
+void UringBackend::run_worker() {
+    Worker worker(listen_fd_, context_, stopped_);
+    worker.run();
+}
+
+} // namespace hsmm
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+
+namespace hsmm {
+namespace test {
+
+// 失败的检查数
+inline int failures = 0;
+
+/**
+ * @brief 记录一项检查并打印结果
+ * @param condition 是否通过
+ * @param what 检查内容
+ */
+inline void check(bool condition, const std::string& what) {
+    std::printf("%s %s\n", condition ? "ok  " : "FAIL", what.c_str());
+    if (!condition) ++failures;
+}
+
+/**
+ * @brief 打印汇总，作为main的返回值
+ * @return 全部通过时为0，否则为1
+ */
+inline int finish() {
+    if (failures > 0) {
+        std::printf("%d 项检查失败\n", failures);
+        return 1;
+    }
+    std::printf("全部通过\n");
+    return 0;
+}
+
+} // namespace test
+} // namespace hsmm
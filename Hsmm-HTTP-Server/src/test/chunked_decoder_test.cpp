@@ -0,0 +1,136 @@
+// 分块传输编码解码器的单元测试：每个用例的输入一次性、逐字节、在每个位置切成两段交给解码器，
+// 状态、解出的数据和消耗的字节数都必须与预期相同
+#include "check.hpp"
+#include "http/HttpParser.hpp"
+#include <cstddef>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using hsmm::http::ChunkedDecoder;
+using Status = ChunkedDecoder::Status;
+using hsmm::test::check;
+
+namespace {
+
+struct Case {
+    const char* name;
+    std::string_view input;
+    Status status;
+    // 解出的请求体
+    std::string_view body;
+    // 结束或出错时消耗的字节数；need_more时为输入长度
+    std::size_t consumed;
+};
+
+const Case cases[] = {
+    {"单个分块", "5\r\nhello\r\n0\r\n\r\n", Status::done, "hello", 15},
+    {"多个分块，大小写十六进制", "3\r\nabc\r\nA\r\n0123456789\r\na\r\nABCDEFGHIJ\r\n0\r\n\r\n",
+     Status::done, "abc0123456789ABCDEFGHIJ", 43},
+    {"空请求体", "0\r\n\r\n", Status::done, "", 5},
+    {"大小带前导0", "0005\r\nhello\r\n0\r\n\r\n", Status::done, "hello", 18},
+    {"16位十六进制的分块大小", "0000000000000003\r\nabc\r\n0\r\n\r\n", Status::done, "abc", 28},
+    {"分块扩展", "5;name=value\r\nhello\r\n0;last\r\n\r\n", Status::done, "hello", 31},
+    {"带空白和引号的分块扩展", "5 ;a=\"x;y\"\t;b\r\nhello\r\n0\r\n\r\n", Status::done, "hello", 27},
+    {"trailer", "5\r\nhello\r\n0\r\nExpires: never\r\nX-Trailer: 1\r\n\r\n", Status::done, "hello", 45},
+    {"结束后紧跟下一个请求", "2\r\nhi\r\n0\r\n\r\nGET / HTTP/1.1\r\n\r\n", Status::done, "hi", 12},
+    {"数据中的CRLF不影响解码", "4\r\n\r\n\r\n\r\n0\r\n\r\n", Status::done, "\r\n\r\n", 14},
+    {"数据不完整", "5\r\nhel", Status::need_more, "hel", 6},
+    {"trailer不完整", "0\r\nX-Trailer: 1\r\n", Status::need_more, "", 17},
+    {"最大的16位分块大小", "ffffffffffffffff\r\nab", Status::need_more, "ab", 20},
+
+    {"超过16位的分块大小", "00000000000000001\r\nx\r\n0\r\n\r\n", Status::error, "", 17},
+    {"溢出的分块大小", "10000000000000000\r\n", Status::error, "", 17},
+    {"缺少分块大小", "\r\n0\r\n\r\n", Status::error, "", 1},
+    {"分块大小前有空白", " 5\r\nhello\r\n0\r\n\r\n", Status::error, "", 1},
+    {"非十六进制字符", "5g\r\nhello\r\n0\r\n\r\n", Status::error, "", 2},
+    {"负的分块大小", "-1\r\nx\r\n0\r\n\r\n", Status::error, "", 1},
+    {"0x前缀", "0x5\r\nhello\r\n0\r\n\r\n", Status::error, "", 2},
+    {"只有LF的大小行", "5\nhello\r\n0\r\n\r\n", Status::error, "", 2},
+    {"扩展之后只有LF", "5;ext\nhello\r\n0\r\n\r\n", Status::error, "", 6},
+    {"数据比声明的长", "3\r\nhello\r\n0\r\n\r\n", Status::error, "hel", 7},
+    {"数据之后只有LF", "5\r\nhello\n0\r\n\r\n", Status::error, "hello", 9},
+    {"trailer行只有LF", "0\r\nX: 1\n\r\n", Status::error, "", 8},
+    {"trailer行的CR之后不是LF", "0\r\nX: 1\r\r\n\r\n", Status::error, "", 9},
+    {"结尾的空行只有CR", "0\r\n\r\r", Status::error, "", 5},
+};
+
+struct Result {
+    Status status{Status::need_more};
+    std::string body;
+    std::size_t consumed{0};
+};
+
+/**
+ * @brief 把输入按切分点分段交给一个新的解码器
+ * @param input 输入
+ * @param cuts 升序的切分点，不包括0和输入长度
+ */
+Result run(std::string_view input, const std::vector<std::size_t>& cuts) {
+    ChunkedDecoder decoder;
+    Result result;
+    std::size_t begin = 0;
+    for (std::size_t i = 0; i <= cuts.size(); ++i) {
+        const auto end = i < cuts.size() ? cuts[i] : input.size();
+        std::size_t consumed = 0;
+        result.status = decoder.decode(std::span<const char>(input.data() + begin, end - begin), consumed,
+            [&](std::span<const char> data) { result.body.append(data.data(), data.size()); });
+        result.consumed = begin + consumed;
+        if (result.status != Status::need_more) break;
+        begin = end;
+    }
+    return result;
+}
+
+bool matches(const Result& result, const Case& c) {
+    return result.status == c.status && result.body == c.body && result.consumed == c.consumed;
+}
+
+void test_cases() {
+    for (const auto& c : cases) {
+        check(matches(run(c.input, {}), c), std::string(c.name) + "：一次性输入");
+
+        std::vector<std::size_t> every_byte;
+        for (std::size_t i = 1; i < c.input.size(); ++i) every_byte.push_back(i);
+        check(matches(run(c.input, every_byte), c), std::string(c.name) + "：逐字节输入");
+
+        bool split = true;
+        for (std::size_t i = 1; i < c.input.size(); ++i) {
+            split = split && matches(run(c.input, {i}), c);
+        }
+        check(split, std::string(c.name) + "：在每个位置切成两段");
+    }
+}
+
+void test_reset() {
+    ChunkedDecoder decoder;
+    std::string body;
+    const auto on_data = [&](std::span<const char> data) { body.append(data.data(), data.size()); };
+
+    std::size_t consumed = 0;
+    const std::string_view first = "3\r\nabc\r\n0\r\n\r\n";
+    const bool first_done = decoder.decode(first, consumed, on_data) == Status::done;
+    decoder.reset();
+    const std::string_view second = "2\r\nde\r\n0\r\n\r\n";
+    check(first_done && decoder.decode(second, consumed, on_data) == Status::done &&
+          body == "abcde" && consumed == second.size(),
+          "reset之后解码下一个请求体");
+
+    decoder.reset();
+    body.clear();
+    check(decoder.decode(std::string_view("5\r\nhe"), consumed, on_data) == Status::need_more, "解码到一半");
+    decoder.reset();
+    body.clear();
+    check(decoder.decode(second, consumed, on_data) == Status::done && body == "de",
+          "解码到一半时reset，之前的状态不影响下一个请求体");
+}
+
+} // namespace
+
+int main() {
+    test_cases();
+    test_reset();
+
+    return hsmm::test::finish();
+}
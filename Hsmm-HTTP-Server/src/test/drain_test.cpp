@@ -0,0 +1,181 @@
+// 优雅关闭的集成测试：在进程内启动服务器，挂载一个临时的静态文件目录。
+// 几个keep-alive连接先完成一次请求，再各发出半个请求，然后调用Server::stop()，
+// 关闭期间补全的请求应得到带Connection: close的完整响应，空闲连接被直接关闭，run()在drain_timeout之前返回。
+// 使用Asio后端还是io_uring后端取决于构建选项，两种后端都应通过
+#include "check.hpp"
+#include "server/Server.hpp"
+#include <boost/asio.hpp>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+namespace net = boost::asio;
+using tcp = boost::asio::ip::tcp;
+
+using hsmm::test::check;
+
+namespace {
+
+struct Response {
+    std::string head;
+    std::string body;
+    // 读完响应后连接已被服务器关闭
+    bool closed{false};
+};
+
+bool has_connection_close(const Response& response) {
+    std::string head = response.head;
+    std::transform(head.begin(), head.end(), head.begin(), [](unsigned char c) { return std::tolower(c); });
+    return head.find("\r\nconnection: close\r\n") != std::string::npos;
+}
+
+std::optional<size_t> content_length(const Response& response) {
+    std::string head = response.head;
+    std::transform(head.begin(), head.end(), head.begin(), [](unsigned char c) { return std::tolower(c); });
+    const auto pos = head.find("\r\ncontent-length: ");
+    if (pos == std::string::npos) return std::nullopt;
+    return std::stoul(head.substr(pos + 18));
+}
+
+/**
+ * @brief 读取一个响应，之后再读一次检查连接是否已经关闭
+ * @param head_only HEAD请求的响应没有响应体
+ * @param expect_close 预期服务器在响应之后关闭连接，为false时不等待
+ */
+Response read_response(tcp::socket& socket, std::string& buffer, bool head_only, bool expect_close) {
+    Response response;
+    boost::system::error_code ec;
+    net::read_until(socket, net::dynamic_buffer(buffer), "\r\n\r\n", ec);
+    const auto header_end = buffer.find("\r\n\r\n");
+    if (header_end == std::string::npos) {
+        response.closed = true;
+        return response;
+    }
+    response.head = buffer.substr(0, header_end + 4);
+    buffer.erase(0, header_end + 4);
+
+    const size_t length = head_only ? 0 : content_length(response).value_or(0);
+    if (buffer.size() < length) {
+        net::read(socket, net::dynamic_buffer(buffer), net::transfer_exactly(length - buffer.size()), ec);
+    }
+    response.body = buffer.substr(0, std::min(length, buffer.size()));
+    buffer.erase(0, response.body.size());
+
+    if (expect_close) {
+        char byte;
+        socket.read_some(net::buffer(&byte, 1), ec);
+        response.closed = ec == net::error::eof || ec == net::error::connection_reset;
+    }
+    return response;
+}
+
+unsigned short free_port() {
+    net::io_context io_context;
+    tcp::acceptor acceptor(io_context, tcp::endpoint(net::ip::make_address("127.0.0.1"), 0));
+    return acceptor.local_endpoint().port();
+}
+
+tcp::socket connect(net::io_context& io_context, unsigned short port) {
+    const tcp::endpoint endpoint(net::ip::make_address("127.0.0.1"), port);
+    for (int attempt = 0;; ++attempt) {
+        tcp::socket socket(io_context);
+        boost::system::error_code ec;
+        socket.connect(endpoint, ec);
+        if (!ec || attempt == 100) return socket;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+}
+
+void write(tcp::socket& socket, std::string_view data) {
+    boost::system::error_code ec;
+    net::write(socket, net::buffer(data.data(), data.size()), ec);
+}
+
+} // namespace
+
+int main() {
+    // 小文件在内存中预先生成完整的响应，大文件只预先生成头部，内容用sendfile发送
+    const auto root = std::filesystem::temp_directory_path() / ("hsmm_drain_test_" + std::to_string(::getpid()));
+    std::filesystem::create_directories(root);
+    const std::string small(1000, 's');
+    std::string big(300 * 1024, '\0');
+    for (size_t i = 0; i < big.size(); ++i) {
+        big[i] = static_cast<char>('a' + i % 26);
+    }
+    std::ofstream(root / "small.txt", std::ios::binary) << small;
+    std::ofstream(root / "big.bin", std::ios::binary) << big;
+
+    const auto port = free_port();
+    hsmm::ServerOptions options;
+    options.drain_timeout = std::chrono::seconds(10);
+    hsmm::Server server("127.0.0.1", port, 2, options);
+    server.serve_static(root, "/static/");
+    std::thread server_thread([&server] { server.run(); });
+
+    net::io_context io_context;
+    const std::string_view requests[] = {
+        "GET /static/small.txt HTTP/1.1\r\nHost: localhost\r\n",
+        "GET /static/big.bin HTTP/1.1\r\nHost: localhost\r\n",
+        "HEAD /static/small.txt HTTP/1.1\r\nHost: localhost\r\n",
+    };
+    const std::string* expected_bodies[] = {&small, &big, nullptr};
+    constexpr size_t busy_count = 3;
+
+    // 0~2号连接在关闭开始时有半个请求，3号连接空闲
+    std::vector<tcp::socket> sockets;
+    std::vector<std::string> buffers(busy_count + 1);
+    for (size_t i = 0; i <= busy_count; ++i) {
+        sockets.push_back(connect(io_context, port));
+        write(sockets[i], "GET /static/small.txt HTTP/1.1\r\nHost: localhost\r\n\r\n");
+        const auto response = read_response(sockets[i], buffers[i], false, false);
+        check(response.head.starts_with("HTTP/1.1 200") && response.body == small && !has_connection_close(response),
+              "连接" + std::to_string(i) + "：关闭之前的keep-alive响应");
+    }
+    for (size_t i = 0; i < busy_count; ++i) {
+        write(sockets[i], requests[i]);
+    }
+    // 等服务器读到半个请求，连接从空闲变为处理中
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    const auto stop_start = std::chrono::steady_clock::now();
+    server.stop();
+    // io_uring后端的工作线程最多在一个时钟周期（100ms）后开始关闭
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+    for (size_t i = 0; i < busy_count; ++i) {
+        write(sockets[i], "\r\n");
+        const auto response = read_response(sockets[i], buffers[i], expected_bodies[i] == nullptr, true);
+        const std::string name = "连接" + std::to_string(i) + "（" + std::string(requests[i].substr(0, requests[i].find(" HTTP"))) + "）";
+        check(response.head.starts_with("HTTP/1.1 200"), name + "：关闭期间补全的请求得到响应");
+        check(has_connection_close(response), name + "：响应带有Connection: close");
+        if (expected_bodies[i]) {
+            check(response.body == *expected_bodies[i], name + "：响应体完整");
+        } else {
+            check(content_length(response) == small.size() && response.body.empty(), name + "：HEAD响应只有头部");
+        }
+        check(response.closed, name + "：响应之后连接被关闭");
+    }
+
+    {
+        char byte;
+        boost::system::error_code ec;
+        sockets[busy_count].read_some(net::buffer(&byte, 1), ec);
+        check(ec == net::error::eof || ec == net::error::connection_reset, "空闲连接被关闭");
+    }
+
+    server_thread.join();
+    const auto elapsed = std::chrono::steady_clock::now() - stop_start;
+    check(elapsed < options.drain_timeout, "所有连接关闭后run()在drain_timeout之前返回");
+    check(server.active_connections() == 0, "连接计数归零");
+
+    std::filesystem::remove_all(root);
+    return hsmm::test::finish();
+}
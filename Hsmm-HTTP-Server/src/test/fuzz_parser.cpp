@@ -0,0 +1,323 @@
+// HttpParser、ChunkedDecoder和HttpResponse序列化的模糊测试
+//
+// 用clang构建时是标准的libFuzzer目标；其他编译器使用文件末尾的独立驱动，
+// 回放语料文件，并可以在语料（或内置种子）上做随机变异。
+// 除了依靠ASan/UBSan发现内存错误，还检查以下性质：
+//   - header_size()返回第一个空行之后的位置
+//   - 解析结果的字段都引用输入中的数据（常用请求头的字段名除外），请求体不超过Content-Length
+//   - 常用请求头的查找不区分大小写，并且与遍历结果一致
+//   - 把解析结果重新格式化后再次解析，得到相同的结果
+//   - 分块解码的结果与输入的切分位置无关
+//   - serialize()、serialize_head()+body()与to_string()的输出一致
+#include "http/HttpParser.hpp"
+#include "utils/Logger.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+using hsmm::http::ChunkedDecoder;
+using hsmm::http::Header;
+using hsmm::http::HeaderMap;
+using hsmm::http::HttpParser;
+using hsmm::http::HttpRequest;
+using hsmm::http::HttpResponse;
+
+#define FUZZ_CHECK(condition)                                                           \
+    do {                                                                                \
+        if (!(condition)) {                                                             \
+            std::fprintf(stderr, "%s:%d: 检查失败: %s\n", __FILE__, __LINE__, #condition); \
+            std::abort();                                                               \
+        }                                                                               \
+    } while (0)
+
+bool within(std::string_view part, std::string_view whole) noexcept {
+    return part.empty() ||
+           (part.data() >= whole.data() && part.data() + part.size() <= whole.data() + whole.size());
+}
+
+void check_header_size(std::string_view input) {
+    const auto size = HttpParser::header_size(std::span<const char>(input.data(), input.size()));
+    const auto end = input.find("\r\n\r\n");
+    FUZZ_CHECK(size == (end == std::string_view::npos ? 0 : end + 4));
+}
+
+// 按解析结果重新生成请求头，Content-Length等头部原样保留
+std::string format_request(const HttpRequest& request) {
+    std::string out;
+    out.append(request.method).append(" ").append(request.uri).append(" ").append(request.version).append("\r\n");
+    for (const auto& [name, value] : request.headers) {
+        out.append(name).append(": ").append(value).append("\r\n");
+    }
+    out.append("\r\n");
+    return out;
+}
+
+void check_parse(std::string_view input) {
+    std::pmr::monotonic_buffer_resource arena;
+    const auto request = HttpParser::parse(std::span<const char>(input.data(), input.size()), &arena);
+    if (!request) {
+        return;
+    }
+
+    FUZZ_CHECK(!request->method.empty() && !request->uri.empty() && !request->version.empty());
+    FUZZ_CHECK(request->method.find(' ') == std::string_view::npos);
+    FUZZ_CHECK(request->uri.find(' ') == std::string_view::npos);
+    FUZZ_CHECK(within(request->method, input) && within(request->uri, input) && within(request->version, input));
+    // 常用请求头的字段名是规范写法，不引用输入
+    for (const auto& [name, value] : request->headers) {
+        FUZZ_CHECK((within(name, input) || HeaderMap::lookup(name)) && within(value, input));
+        FUZZ_CHECK(name.find(':') == std::string_view::npos);
+        FUZZ_CHECK(name.find('\n') == std::string_view::npos && value.find('\n') == std::string_view::npos);
+    }
+    FUZZ_CHECK(!(request->chunked && request->content_length));
+
+    // 请求体紧跟在请求头之后，不超过Content-Length
+    const auto header_end = HttpParser::header_size(std::span<const char>(input.data(), input.size()));
+    FUZZ_CHECK(header_end > 0);
+    if (request->content_length) {
+        const auto available = input.size() - header_end;
+        FUZZ_CHECK(request->body.size() == std::min<std::uint64_t>(*request->content_length, available));
+        FUZZ_CHECK(request->body.empty() || request->body.data() == input.data() + header_end);
+    } else {
+        FUZZ_CHECK(request->body.empty());
+    }
+
+    // 按字段名查找（不区分大小写）得到遍历顺序中第一个同名字段的值
+    for (const auto& [name, value] : request->headers) {
+        const auto first = std::find_if(request->headers.begin(), request->headers.end(),
+            [name = name](const HeaderMap::value_type& header) { return HeaderMap::iequals(header.first, name); });
+        FUZZ_CHECK(request->headers.find(name) == (*first).second);
+    }
+
+    // 重新格式化后解析结果不变；重复的常用请求头只保留了第一个，Expect的判断可能不同，不比较
+    const auto formatted = format_request(*request);
+    const auto again = HttpParser::parse(std::span<const char>(formatted.data(), formatted.size()), &arena);
+    FUZZ_CHECK(again);
+    FUZZ_CHECK(again->method == request->method && again->uri == request->uri && again->version == request->version);
+    FUZZ_CHECK(again->headers.size() == request->headers.size());
+    FUZZ_CHECK(std::equal(request->headers.begin(), request->headers.end(), again->headers.begin(), again->headers.end()));
+    FUZZ_CHECK(again->content_length == request->content_length && again->chunked == request->chunked);
+}
+
+// 完美哈希只是预筛选，命中的一定是同名（不区分大小写）的常用请求头
+void check_lookup(std::string_view input) {
+    const auto name = input.substr(0, std::min<size_t>(input.find('\0'), 32));
+    if (const auto header = HeaderMap::lookup(name)) {
+        FUZZ_CHECK(HeaderMap::iequals(HeaderMap::name(*header), name));
+    }
+    for (size_t i = 0; i < HeaderMap::known_count; ++i) {
+        const auto header = static_cast<Header>(i);
+        FUZZ_CHECK(HeaderMap::lookup(HeaderMap::name(header)) == header);
+    }
+}
+
+struct DecodeResult {
+    ChunkedDecoder::Status status;
+    size_t consumed;
+    std::string data;
+
+    bool operator==(const DecodeResult&) const = default;
+};
+
+// 把输入切成若干段依次解码，遇到结束或错误时停止
+DecodeResult decode_chunked(std::string_view input, std::initializer_list<size_t> cuts) {
+    ChunkedDecoder decoder;
+    DecodeResult result{ChunkedDecoder::Status::need_more, 0, {}};
+    size_t begin = 0;
+    std::vector<size_t> ends(cuts);
+    ends.push_back(input.size());
+    for (const auto end : ends) {
+        if (end < begin) {
+            continue;
+        }
+        size_t consumed = 0;
+        result.status = decoder.decode(std::span<const char>(input.data() + begin, end - begin), consumed,
+            [&result](std::span<const char> data) { result.data.append(data.data(), data.size()); });
+        FUZZ_CHECK(consumed <= end - begin);
+        result.consumed += consumed;
+        if (result.status != ChunkedDecoder::Status::need_more) {
+            break;
+        }
+        FUZZ_CHECK(consumed == end - begin);
+        begin = end;
+    }
+    return result;
+}
+
+void check_chunked(std::string_view input) {
+    const auto whole = decode_chunked(input, {});
+    // 解码出的数据不会比输入长
+    FUZZ_CHECK(whole.data.size() <= whole.consumed);
+
+    const auto first = input.empty() ? 0 : static_cast<unsigned char>(input[0]) % (input.size() + 1);
+    const auto second = input.size() < 2 ? input.size() : first + static_cast<unsigned char>(input[1]) % (input.size() - first + 1);
+    FUZZ_CHECK(decode_chunked(input, {first, second}) == whole);
+
+    // 逐字节输入是最极端的切分
+    if (input.size() <= 256) {
+        ChunkedDecoder decoder;
+        DecodeResult bytewise{ChunkedDecoder::Status::need_more, 0, {}};
+        for (size_t i = 0; i < input.size() && bytewise.status == ChunkedDecoder::Status::need_more; ++i) {
+            size_t consumed = 0;
+            bytewise.status = decoder.decode(std::span<const char>(input.data() + i, 1), consumed,
+                [&bytewise](std::span<const char> data) { bytewise.data.append(data.data(), data.size()); });
+            bytewise.consumed += consumed;
+        }
+        FUZZ_CHECK(bytewise == whole);
+    }
+}
+
+// 从输入中取出状态码、若干头部和响应体，检查几种序列化方式的输出一致
+void check_serialize(std::string_view input) {
+    if (input.size() < 2) {
+        return;
+    }
+    std::pmr::monotonic_buffer_resource arena;
+    HttpResponse response(&arena);
+    const int code = 100 + (static_cast<unsigned char>(input[0]) | static_cast<unsigned char>(input[1]) << 8) % 500;
+    input.remove_prefix(2);
+
+    // 字段之间用'\0'分隔：状态消息、若干对头部，最后一段是响应体
+    std::vector<std::string_view> fields;
+    while (!input.empty() && fields.size() < 32) {
+        const auto pos = input.find('\0');
+        fields.push_back(input.substr(0, pos));
+        input = pos == std::string_view::npos ? std::string_view() : input.substr(pos + 1);
+    }
+    response.set_status(code, fields.empty() ? std::string_view("OK") : fields[0]);
+    for (size_t i = 1; i + 2 < fields.size(); i += 2) {
+        response.add_header(fields[i], fields[i + 1]);
+    }
+    if (fields.size() > 1) {
+        response.set_body(fields.back());
+    }
+
+    std::pmr::string serialized(&arena);
+    response.serialize(serialized);
+    std::pmr::string head(&arena);
+    response.serialize_head(head);
+    const auto text = response.to_string();
+    FUZZ_CHECK(std::string_view(serialized) == text);
+    FUZZ_CHECK(std::string_view(head).size() + response.body().size() == text.size());
+    FUZZ_CHECK(std::string_view(text).starts_with(head) && std::string_view(text).ends_with(response.body()));
+    FUZZ_CHECK(text.starts_with("HTTP/1.1 " + std::to_string(code) + " "));
+    FUZZ_CHECK(text.find("\r\nContent-Length: " + std::to_string(response.body().size()) + "\r\n") != std::string::npos);
+}
+
+} // namespace
+
+extern "C" int LLVMFuzzerInitialize(int*, char***) {
+    // 畸形输入会产生大量解析警告
+    hsmm::utils::Logger::instance().init("/dev/null", hsmm::utils::LogLevel::ERROR);
+    return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data, size_t size) {
+    const std::string_view input(reinterpret_cast<const char*>(data), size);
+    check_header_size(input);
+    check_lookup(input);
+    check_parse(input);
+    check_chunked(input);
+    check_serialize(input);
+    return 0;
+}
+
+#ifdef HSMM_FUZZ_STANDALONE
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+
+namespace {
+
+// 没有语料时使用的种子
+const char* const seeds[] = {
+    "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n",
+    "POST /upload HTTP/1.1\r\nHost: x\r\nContent-Length: 5\r\nExpect: 100-continue\r\n\r\nhello",
+    "POST /upload HTTP/1.1\r\nTransfer-Encoding: gzip, chunked\r\n\r\n",
+    "5\r\nhello\r\n0;ext=1\r\nTrailer: x\r\n\r\n",
+    "a\r\n0123456789\r\nA\r\n0123456789\r\n0\r\n\r\n",
+};
+
+void run(const std::string& input) {
+    LLVMFuzzerTestOneInput(reinterpret_cast<const std::uint8_t*>(input.data()), input.size());
+}
+
+// 简单的变异：翻转、插入、删除字节，或者插入协议中的关键片段
+std::string mutate(std::string input, std::mt19937& rng) {
+    static const char* const tokens[] = {"\r\n", "\r\n\r\n", ":", " ", "Content-Length: ", "Transfer-Encoding: chunked",
+                                         "0\r\n", "ffffffffffffffff", "\n", "\t", ";"};
+    const auto rounds = 1 + rng() % 4;
+    for (unsigned i = 0; i < rounds; ++i) {
+        const auto pos = input.empty() ? 0 : rng() % (input.size() + 1);
+        switch (rng() % 4) {
+        case 0:
+            if (pos < input.size()) input[pos] = static_cast<char>(rng());
+            break;
+        case 1:
+            input.insert(pos, 1, static_cast<char>(rng()));
+            break;
+        case 2:
+            if (pos < input.size()) input.erase(pos, 1 + rng() % 8);
+            break;
+        default:
+            input.insert(pos, tokens[rng() % std::size(tokens)]);
+            break;
+        }
+    }
+    return input;
+}
+
+} // namespace
+
+// 用法: fuzz_parser [-runs=N] [文件或目录...]
+// 回放所有输入后，在它们（或内置种子）上做N次随机变异
+int main(int argc, char** argv) {
+    LLVMFuzzerInitialize(&argc, &argv);
+
+    unsigned long runs = 0;
+    std::vector<std::string> corpus;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg(argv[i]);
+        if (arg.starts_with("-runs=")) {
+            runs = std::strtoul(argv[i] + 6, nullptr, 10);
+            continue;
+        }
+        std::vector<std::filesystem::path> files;
+        if (std::filesystem::is_directory(arg)) {
+            for (const auto& entry : std::filesystem::directory_iterator(arg)) {
+                files.push_back(entry.path());
+            }
+        } else {
+            files.emplace_back(arg);
+        }
+        for (const auto& file : files) {
+            std::ifstream stream(file, std::ios::binary);
+            corpus.emplace_back(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+            run(corpus.back());
+        }
+    }
+    std::cout << "回放了 " << corpus.size() << " 个输入" << std::endl;
+
+    if (corpus.empty()) {
+        corpus.assign(std::begin(seeds), std::end(seeds));
+    }
+    std::mt19937 rng(std::random_device{}());
+    for (unsigned long i = 0; i < runs; ++i) {
+        run(mutate(corpus[rng() % corpus.size()], rng));
+    }
+    std::cout << "完成 " << runs << " 次变异" << std::endl;
+    return 0;
+}
+#endif
@@ -0,0 +1,309 @@
+// HPACK编解码的单元测试：RFC 7541 C.4的请求示例、Huffman编解码、动态表淘汰和容量更新
+// （包括会话收到SETTINGS_HEADER_TABLE_SIZE后的响应）以及敏感字段的never-indexed表示
+#include "check.hpp"
+#include "http/Router.hpp"
+#include "http2/Frame.hpp"
+#include "http2/Hpack.hpp"
+#include "http2/Session.hpp"
+#include "server/ServerOptions.hpp"
+#include <cstdint>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using namespace hsmm;
+using namespace hsmm::http2;
+using hsmm::test::check;
+
+namespace {
+
+using Headers = std::vector<std::pair<std::string, std::string>>;
+
+std::vector<std::uint8_t> from_hex(std::string_view hex) {
+    std::vector<std::uint8_t> bytes;
+    int high = -1;
+    for (const char c : hex) {
+        int nibble;
+        if (c >= '0' && c <= '9') nibble = c - '0';
+        else if (c >= 'a' && c <= 'f') nibble = c - 'a' + 10;
+        else continue;
+        if (high < 0) {
+            high = nibble;
+        } else {
+            bytes.push_back(static_cast<std::uint8_t>(high << 4 | nibble));
+            high = -1;
+        }
+    }
+    return bytes;
+}
+
+std::vector<std::uint8_t> to_bytes(std::string_view data) {
+    return std::vector<std::uint8_t>(data.begin(), data.end());
+}
+
+bool decode(HpackDecoder& decoder, const std::vector<std::uint8_t>& block, Headers& headers) {
+    headers.clear();
+    return decoder.decode(block, [&](std::string_view name, std::string_view value) {
+        headers.emplace_back(name, value);
+    });
+}
+
+// 动态表中第一个条目（索引62）是否存在，存在时输出其内容
+bool first_dynamic_entry(HpackDecoder& decoder, std::pair<std::string, std::string>& entry) {
+    Headers headers;
+    if (!decode(decoder, {0xbe}, headers) || headers.size() != 1) return false;
+    entry = headers[0];
+    return true;
+}
+
+void test_rfc_requests() {
+    struct Request {
+        const char* hex;
+        Headers headers;
+    };
+    const Request requests[] = {
+        {"8286 8441 8cf1 e3c2 e5f2 3a6b a0ab 90f4 ff",
+         {{":method", "GET"}, {":scheme", "http"}, {":path", "/"}, {":authority", "www.example.com"}}},
+        {"8286 84be 5886 a8eb 1064 9cbf",
+         {{":method", "GET"}, {":scheme", "http"}, {":path", "/"}, {":authority", "www.example.com"},
+          {"cache-control", "no-cache"}}},
+        {"8287 85bf 4088 25a8 49e9 5ba9 7d7f 8925 a849 e95b b8e8 b4bf",
+         {{":method", "GET"}, {":scheme", "https"}, {":path", "/index.html"}, {":authority", "www.example.com"},
+          {"custom-key", "custom-value"}}},
+    };
+
+    HpackDecoder decoder;
+    HpackEncoder encoder;
+    for (std::size_t i = 0; i < std::size(requests); ++i) {
+        const auto& request = requests[i];
+        const auto label = "C.4." + std::to_string(i + 1);
+        const auto block = from_hex(request.hex);
+
+        Headers headers;
+        check(decode(decoder, block, headers) && headers == request.headers, label + " 解码结果");
+
+        std::string encoded;
+        encoder.begin_block(encoded);
+        for (const auto& [name, value] : request.headers) {
+            encoder.encode(name, value, encoded);
+        }
+        check(to_bytes(encoded) == block, label + " 编码结果与RFC相同");
+    }
+
+    // 第三个请求之后动态表的顺序：custom-key、cache-control、:authority
+    Headers headers;
+    check(decode(decoder, {0xbe, 0xbf, 0xc0}, headers) &&
+          headers == Headers{{"custom-key", "custom-value"}, {"cache-control", "no-cache"},
+                             {":authority", "www.example.com"}},
+          "C.4.3 之后的动态表条目");
+    check(!decode(decoder, {0xc1}, headers), "超出动态表的索引被拒绝");
+}
+
+void test_huffman() {
+    const std::pair<std::string_view, std::string_view> examples[] = {
+        {"www.example.com", "f1e3 c2e5 f23a 6ba0 ab90 f4ff"},
+        {"no-cache", "a8eb 1064 9cbf"},
+        {"custom-key", "25a8 49e9 5ba9 7d7f"},
+        {"custom-value", "25a8 49e9 5bb8 e8b4 bf"},
+    };
+    for (const auto& [text, hex] : examples) {
+        std::string encoded;
+        huffman_encode(text, encoded);
+        const auto expected = from_hex(hex);
+        check(to_bytes(encoded) == expected && huffman_encoded_size(text) == expected.size(),
+              "Huffman编码 \"" + std::string(text) + "\"");
+    }
+
+    // 所有字节值，以及随机长度的随机字节串
+    std::string all_bytes;
+    for (int c = 0; c < 256; ++c) all_bytes.push_back(static_cast<char>(c));
+    std::vector<std::string> inputs{"", all_bytes};
+    std::mt19937 rng(7541);
+    for (int i = 0; i < 200; ++i) {
+        std::string input(rng() % 64, '\0');
+        for (auto& c : input) c = static_cast<char>(rng());
+        inputs.push_back(std::move(input));
+    }
+    bool round_trip = true;
+    for (const auto& input : inputs) {
+        std::string encoded;
+        huffman_encode(input, encoded);
+        std::string decoded;
+        round_trip = round_trip && encoded.size() == huffman_encoded_size(input) &&
+                     huffman_decode(to_bytes(encoded), decoded) && decoded == input;
+    }
+    check(round_trip, "Huffman编码后解码回原文（" + std::to_string(inputs.size()) + "个输入）");
+
+    // 'a'的编码是00011
+    std::string out;
+    check(huffman_decode(from_hex("1f"), out) && out == "a", "填充为全1时解码成功");
+    out.clear();
+    check(!huffman_decode(from_hex("18"), out), "填充不是EOS前缀时被拒绝");
+    out.clear();
+    check(!huffman_decode(from_hex("1f ff"), out), "超过7位的填充被拒绝");
+    out.clear();
+    check(!huffman_decode(from_hex("ffff ffff"), out), "出现EOS时被拒绝");
+}
+
+void test_eviction() {
+    // 每个条目 1 + 7 + 32 = 40字节
+    HpackTable table(100);
+    table.add("a", "0000000");
+    table.add("b", "1111111");
+    check(table.count() == 2 && table.size() == 80, "两个条目放得下");
+    table.add("c", "2222222");
+    check(table.count() == 2 && table.size() == 80 && table.at(0).first == "c" && table.at(1).first == "b",
+          "第三个条目淘汰最旧的条目");
+    table.set_max_size(50);
+    check(table.count() == 1 && table.at(0).first == "c", "缩小容量时从最旧的条目开始淘汰");
+    table.add("long-name", std::string(100, 'x'));
+    check(table.count() == 0 && table.size() == 0, "比整个表还大的条目使表清空");
+
+    // 解码器：容量256的表依次插入四个条目，第一个条目被淘汰
+    HpackDecoder decoder(256);
+    std::string block;
+    for (int i = 0; i < 4; ++i) {
+        const std::string value(40, static_cast<char>('0' + i));
+        block.push_back(0x40);
+        block.push_back(0x06);
+        block.append("name-" + std::to_string(i));
+        block.push_back(static_cast<char>(value.size()));
+        block.append(value);
+    }
+    Headers headers;
+    check(decode(decoder, to_bytes(block), headers) && headers.size() == 4, "解码器插入四个条目");
+    check(decode(decoder, {0xbe, 0xbf, 0xc0}, headers) && headers.size() == 3 &&
+          headers[0].first == "name-3" && headers[2].first == "name-1",
+          "解码器保留最新的三个条目");
+    check(!decode(decoder, {0xc1}, headers), "被淘汰的条目不能再引用");
+}
+
+void test_table_size_update() {
+    HpackDecoder decoder;
+    Headers headers;
+    check(decode(decoder, from_hex("8286 8441 8cf1 e3c2 e5f2 3a6b a0ab 90f4 ff"), headers), "填充动态表");
+
+    // 容量更新为4096（3f e1 1f）和4097（3f e2 1f）
+    check(decode(decoder, from_hex("3fe11f 82"), headers) && headers.size() == 1, "不超过SETTINGS的容量更新");
+    check(!decode(decoder, from_hex("3fe21f"), headers), "超过SETTINGS的容量更新被拒绝");
+    check(!decode(decoder, from_hex("82 20"), headers), "头部字段之后的容量更新被拒绝");
+
+    std::pair<std::string, std::string> entry;
+    check(first_dynamic_entry(decoder, entry) && entry.first == ":authority", "容量更新之前条目仍在");
+    check(decode(decoder, from_hex("20 3fe11f"), headers) && headers.empty(), "先缩小为0再恢复");
+    check(!first_dynamic_entry(decoder, entry), "缩小为0时清空动态表");
+
+    // 编码器：两个头部块之间容量先减小后增大时先输出最小值
+    HpackEncoder encoder;
+    std::string out;
+    encoder.encode("custom-key", "custom-value", out);
+    encoder.set_max_table_size(0);
+    encoder.set_max_table_size(8192);
+    out.clear();
+    encoder.begin_block(out);
+    check(to_bytes(out) == from_hex("20 3fe11f"), "编码器输出最小值和新容量（不超过4096）");
+    out.clear();
+    encoder.begin_block(out);
+    check(out.empty(), "容量更新只输出一次");
+    encoder.encode("custom-key", "custom-value", out);
+    check(static_cast<std::uint8_t>(out[0]) == 0x40, "容量缩小为0后原来的条目已被淘汰");
+    out.clear();
+    encoder.set_max_table_size(4096);
+    encoder.begin_block(out);
+    check(out.empty(), "容量不变时不输出更新");
+}
+
+void test_never_indexed() {
+    HpackEncoder encoder;
+    HpackDecoder decoder;
+    Headers headers;
+
+    for (int i = 0; i < 2; ++i) {
+        std::string out;
+        encoder.encode("authorization", "Basic c2VjcmV0", out);
+        encoder.encode("x-secret", "1", out);
+        // authorization是静态表第23项：0001 1111后接8
+        check(out.size() > 2 && static_cast<std::uint8_t>(out[0]) == 0x1f && out[1] == 0x08,
+              "第" + std::to_string(i + 1) + "次编码authorization使用never-indexed表示");
+        check(decode(decoder, to_bytes(out), headers) && headers.size() == 2 &&
+              headers[0] == std::pair<std::string, std::string>{"authorization", "Basic c2VjcmV0"},
+              "never-indexed字段解码正确");
+    }
+
+    std::string out;
+    encoder.encode("set-cookie", "id=1", out);
+    check((static_cast<std::uint8_t>(out[0]) & 0xf0) == 0x10, "set-cookie使用never-indexed表示");
+
+    // 动态表中只有x-secret
+    std::pair<std::string, std::string> entry;
+    check(first_dynamic_entry(decoder, entry) && entry.first == "x-secret", "never-indexed字段不加入解码器的动态表");
+    check(!decode(decoder, {0xbf}, headers), "动态表中只有一个条目");
+
+    // 字段名不在静态表中的never-indexed字面量
+    check(decode(decoder, from_hex("10 0178 0179"), headers) &&
+          headers == Headers{{"x", "y"}}, "字段名为字面量的never-indexed表示");
+    check(!decode(decoder, {0xbf}, headers), "解码后动态表不变");
+}
+
+// 会话：对端设置SETTINGS_HEADER_TABLE_SIZE为0后，响应头部块以容量更新开头
+void test_session_table_size() {
+    http::Router router;
+    router.add_route("/", [](const http::HttpRequest&, http::HttpResponse& response) {
+        response.set_status(200, "OK");
+        response.set_body("hello");
+    });
+    ServerOptions options;
+    Session session(router, options);
+    session.start();
+
+    std::string input(client_preface);
+    write_frame_header(input, 6, FrameType::settings, 0, 0);
+    input.push_back(0x00);
+    input.push_back(static_cast<char>(SettingId::header_table_size));
+    write_u32(input, 0);
+    const auto block = from_hex("8286 8441 8cf1 e3c2 e5f2 3a6b a0ab 90f4 ff");
+    write_frame_header(input, static_cast<std::uint32_t>(block.size()), FrameType::headers,
+                       flags::end_headers | flags::end_stream, 1);
+    input.append(block.begin(), block.end());
+    check(session.receive(input), "会话接受请求");
+
+    std::string output;
+    while (session.take_output(output)) {}
+
+    std::vector<std::uint8_t> response_block;
+    bool settings_ack = false;
+    for (std::size_t pos = 0; pos + frame_header_size <= output.size();) {
+        const auto header = parse_frame_header(reinterpret_cast<const std::uint8_t*>(output.data() + pos));
+        const auto* payload = reinterpret_cast<const std::uint8_t*>(output.data() + pos + frame_header_size);
+        if (header.type == FrameType::settings && (header.flags & flags::ack)) settings_ack = true;
+        if (header.type == FrameType::headers && header.stream_id == 1) {
+            response_block.assign(payload, payload + header.length);
+        }
+        pos += frame_header_size + header.length;
+    }
+    check(settings_ack, "会话确认SETTINGS");
+    check(!response_block.empty() && response_block[0] == 0x20, "响应头部块以容量更新（0）开头");
+
+    Headers headers;
+    HpackDecoder decoder;
+    check(decode(decoder, response_block, headers) && !headers.empty() &&
+          headers[0] == std::pair<std::string, std::string>{":status", "200"},
+          "响应头部块解码为:status 200");
+    std::pair<std::string, std::string> entry;
+    check(!first_dynamic_entry(decoder, entry), "容量为0时编码器不向动态表插入条目");
+}
+
+} // namespace
+
+int main() {
+    test_rfc_requests();
+    test_huffman();
+    test_eviction();
+    test_table_size_update();
+    test_never_indexed();
+    test_session_table_size();
+
+    return hsmm::test::finish();
+}
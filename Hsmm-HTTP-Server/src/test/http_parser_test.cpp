@@ -0,0 +1,97 @@
+// 请求头解析的单元测试：前端代理和本服务器可能理解不同的写法（单独的LF或CR、
+// 字段名与冒号之间的空白、续行、两种长度信息）都必须被拒绝
+#include "check.hpp"
+#include "http/HttpParser.hpp"
+#include <memory_resource>
+#include <span>
+#include <string>
+#include <string_view>
+
+using hsmm::http::HttpParser;
+using hsmm::test::check;
+
+namespace {
+
+struct Case {
+    const char* name;
+    std::string_view input;
+    bool accepted;
+    // 接受时按字段名查找的结果
+    std::string_view field;
+    std::string_view value;
+};
+
+const Case cases[] = {
+    {"最简单的请求", "GET / HTTP/1.1\r\n\r\n", true, "", ""},
+    {"普通字段", "GET / HTTP/1.1\r\nHost: example.com\r\n\r\n", true, "Host", "example.com"},
+    {"值两端的空白被去掉", "GET / HTTP/1.1\r\nX-Test: \t a b \t\r\n\r\n", true, "X-Test", "a b"},
+    {"冒号后没有空白", "GET / HTTP/1.1\r\nX-Test:value\r\n\r\n", true, "X-Test", "value"},
+    {"空值", "GET / HTTP/1.1\r\nX-Test:\r\n\r\n", true, "X-Test", ""},
+    {"Content-Length和请求体", "POST / HTTP/1.1\r\nContent-Length: 3\r\n\r\nabc", true, "Content-Length", "3"},
+
+    {"请求行只有LF", "GET / HTTP/1.1\nHost: a\r\n\r\n", false, "", ""},
+    {"字段行只有LF", "GET / HTTP/1.1\r\nHost: a\nX-Test: b\r\n\r\n", false, "", ""},
+    {"字段值中单独的CR", "GET / HTTP/1.1\r\nX-Test: a\rb\r\n\r\n", false, "", ""},
+    {"隐藏在LF之后的Content-Length",
+     "POST / HTTP/1.1\r\nX-Test: a\nContent-Length: 5\r\n\r\nhello", false, "", ""},
+    {"请求行末尾有空白", "GET / HTTP/1.1 \r\n\r\n", false, "", ""},
+    {"请求行开头有空白", " GET / HTTP/1.1\r\n\r\n", false, "", ""},
+    {"字段名与冒号之间有空格", "GET / HTTP/1.1\r\nHost : a\r\n\r\n", false, "", ""},
+    {"字段名与冒号之间有制表符", "POST / HTTP/1.1\r\nTransfer-Encoding\t: chunked\r\n\r\n", false, "", ""},
+    {"字段名中有空格", "GET / HTTP/1.1\r\nX Test: a\r\n\r\n", false, "", ""},
+    {"空字段名", "GET / HTTP/1.1\r\n: a\r\n\r\n", false, "", ""},
+    {"没有冒号", "GET / HTTP/1.1\r\nHost\r\n\r\n", false, "", ""},
+    {"空格开头的续行", "GET / HTTP/1.1\r\nX-Test: a\r\n b\r\n\r\n", false, "", ""},
+    {"制表符开头的续行", "GET / HTTP/1.1\r\nX-Test: a\r\n\tb\r\n\r\n", false, "", ""},
+    {"第一个字段前的续行", "GET / HTTP/1.1\r\n Host: a\r\n\r\n", false, "", ""},
+    {"同时有Content-Length和chunked",
+     "POST / HTTP/1.1\r\nContent-Length: 3\r\nTransfer-Encoding: chunked\r\n\r\n", false, "", ""},
+    {"不同的Content-Length", "POST / HTTP/1.1\r\nContent-Length: 3\r\nContent-Length: 4\r\n\r\n", false, "", ""},
+    {"Content-Length不是数字", "POST / HTTP/1.1\r\nContent-Length: 3a\r\n\r\n", false, "", ""},
+    {"chunked不是最后一层编码", "POST / HTTP/1.1\r\nTransfer-Encoding: chunked, gzip\r\n\r\n", false, "", ""},
+};
+
+void test_cases() {
+    for (const auto& c : cases) {
+        std::pmr::monotonic_buffer_resource arena;
+        const auto request = HttpParser::parse(std::span<const char>(c.input.data(), c.input.size()), &arena);
+        bool passed = request.has_value() == c.accepted;
+        if (passed && request && !c.field.empty()) {
+            passed = request->headers.find(c.field) == c.value;
+        }
+        check(passed, std::string(c.accepted ? "接受" : "拒绝") + c.name);
+    }
+}
+
+void test_keep_alive() {
+    struct KeepAliveCase {
+        const char* name;
+        std::string_view input;
+        bool keep_alive;
+    };
+    const KeepAliveCase cases[] = {
+        {"HTTP/1.1默认长连接", "GET / HTTP/1.1\r\n\r\n", true},
+        {"HTTP/1.1 Connection: close", "GET / HTTP/1.1\r\nConnection: close\r\n\r\n", false},
+        {"close出现在选项列表中，不区分大小写", "GET / HTTP/1.1\r\nConnection: Keep-Alive, CLOSE\r\n\r\n", false},
+        {"close在第二个Connection头部中",
+         "GET / HTTP/1.1\r\nConnection: keep-alive\r\nConnection: close\r\n\r\n", false},
+        {"只是以close开头的选项", "GET / HTTP/1.1\r\nConnection: closed\r\n\r\n", true},
+        {"HTTP/1.0默认关闭", "GET / HTTP/1.0\r\n\r\n", false},
+        {"HTTP/1.0 Connection: keep-alive", "GET / HTTP/1.0\r\nConnection: keep-alive\r\n\r\n", true},
+        {"HTTP/1.0 close优先于keep-alive", "GET / HTTP/1.0\r\nConnection: keep-alive, close\r\n\r\n", false},
+    };
+    for (const auto& c : cases) {
+        std::pmr::monotonic_buffer_resource arena;
+        const auto request = HttpParser::parse(std::span<const char>(c.input.data(), c.input.size()), &arena);
+        check(request && request->keep_alive() == c.keep_alive, c.name);
+    }
+}
+
+} // namespace
+
+int main() {
+    test_cases();
+    test_keep_alive();
+
+    return hsmm::test::finish();
+}
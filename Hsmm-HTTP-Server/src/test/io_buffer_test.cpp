@@ -0,0 +1,122 @@
+// 链式IO缓冲区的单元测试：分散读入的数据跨越内存块时front()/data()/linearize()得到同样的内容，
+// consume之后预留的内存块继续使用，splice只转移内存块
+#include "check.hpp"
+#include "utils/IoBuffer.hpp"
+#include <boost/asio/buffer.hpp>
+#include <cstddef>
+#include <string>
+
+using hsmm::utils::IoBuffer;
+using hsmm::test::check;
+
+namespace {
+
+constexpr std::size_t slab = IoBuffer::slab_size;
+
+std::string pattern(std::size_t size, char first) {
+    std::string out(size, '\0');
+    for (std::size_t i = 0; i < size; ++i) out[i] = static_cast<char>(first + i % 23);
+    return out;
+}
+
+// 模拟一次分散读取：把data依次写入prepare_buffers得到的缓冲区
+void scatter_read(IoBuffer& buffer, const std::string& data, std::size_t reserve) {
+    const auto n = boost::asio::buffer_copy(buffer.prepare_buffers(reserve), boost::asio::buffer(data));
+    buffer.commit(n);
+}
+
+std::string contents(const IoBuffer& buffer) {
+    std::string out(buffer.size(), '\0');
+    boost::asio::buffer_copy(boost::asio::buffer(out), buffer.data());
+    return out;
+}
+
+std::size_t buffer_count(const IoBuffer::const_buffers_type& buffers) {
+    std::size_t count = 0;
+    for (auto it = buffers.begin(); it != buffers.end(); ++it) ++count;
+    return count;
+}
+
+void test_scatter_read() {
+    IoBuffer buffer;
+    const auto first = pattern(slab - 100, 'a');
+    scatter_read(buffer, first, slab);
+    check(buffer.size() == first.size() && buffer.front().size() == first.size(), "第一次读入一个内存块");
+
+    // 当前内存块只剩100字节，分散读取接着写入预留的下一个内存块
+    const auto second = pattern(1000, 'A');
+    scatter_read(buffer, second, slab);
+    check(buffer.size() == first.size() + second.size() && buffer.front().size() == slab, "剩余空间写满后写入下一个内存块");
+    check(buffer_count(buffer.data()) == 2 && contents(buffer) == first + second, "data()按顺序返回两个内存块的数据");
+
+    // 再用prepare()写入时使用同一个内存块的剩余空间
+    const auto space = buffer.prepare(10);
+    check(space.size() == slab - 900, "prepare()继续使用正在写入的内存块");
+    space[0] = '#';
+    buffer.commit(1);
+    check(contents(buffer) == first + second + "#", "prepare()写入的数据接在后面");
+
+    // 正好写满当前内存块后，下一次分散读取的第一个缓冲区不为空（TLS连接只读入第一个缓冲区）
+    scatter_read(buffer, pattern(slab - 901, 'z'), slab - 901);
+    check(buffer.size() == first.size() + second.size() + 1 + slab - 901 &&
+          (*buffer.prepare_buffers(1).begin()).size() == slab,
+          "当前内存块写满时分散读取从下一个内存块开始");
+    const auto all = contents(buffer);
+
+    const auto merged = buffer.linearize();
+    check(std::string(merged.data(), merged.size()) == all && buffer_count(buffer.data()) == 1,
+          "linearize()合并为一个内存块");
+}
+
+void test_consume_reuses_reserved() {
+    IoBuffer buffer;
+    scatter_read(buffer, pattern(slab, 'a'), 3 * slab);
+    // 预留了三个内存块，只写满了第一个
+    check(buffer_count(buffer.data()) == 1, "预留的空内存块不属于data()");
+
+    buffer.consume(slab);
+    check(buffer.empty() && buffer_count(buffer.data()) == 1 && boost::asio::buffer_size(buffer.data()) == 0,
+          "consume用完第一个内存块后归还，写入位置移到预留的内存块");
+
+    const auto data = pattern(2 * slab + 5, 'k');
+    scatter_read(buffer, data, data.size());
+    check(contents(buffer) == data, "用完内存块后的分散读取");
+
+    buffer.consume(slab + 5);
+    check(contents(buffer) == data.substr(slab + 5) && buffer.front().size() == slab - 5,
+          "consume跨过内存块边界");
+}
+
+void test_splice() {
+    IoBuffer target;
+    IoBuffer source;
+    scatter_read(target, "head", slab);
+    const auto data = pattern(slab + 7, 'x');
+    scatter_read(source, data, 2 * slab);
+    source.consume(3);
+
+    target.splice(source);
+    check(source.empty() && buffer_count(source.data()) == 0, "splice之后源缓冲区为空");
+    check(contents(target) == "head" + data.substr(3) && target.size() == 4 + data.size() - 3,
+          "splice把数据接在后面");
+    check(buffer_count(target.data()) == 3, "只转移内存块，不合并");
+
+    // 目标缓冲区之后的读取写入转移过来的最后一个内存块
+    scatter_read(target, "tail", 4);
+    check(contents(target) == "head" + data.substr(3) + "tail" && buffer_count(target.data()) == 3,
+          "splice之后继续写入最后一个内存块");
+
+    IoBuffer empty;
+    target.splice(empty);
+    check(contents(target) == "head" + data.substr(3) + "tail", "splice空缓冲区不改变数据");
+}
+
+} // namespace
+
+int main() {
+    test_scatter_read();
+    test_consume_reuses_reserved();
+    test_splice();
+
+    return hsmm::test::finish();
+}
@@ -0,0 +1,150 @@
+// 响应缓存的单元测试：同一个键的并发未命中合并为一次调用；结果不能缓存时，等待的请求
+// 投递回各自的连接重新调用处理函数，之后hit_for_pass期间的请求不再等待
+#include "check.hpp"
+#include "http/ResponseCache.hpp"
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace hsmm::http;
+using hsmm::test::check;
+
+namespace {
+
+// 一个请求及其所在"连接"的投递队列
+struct Client {
+    Client() {
+        request.method = "GET";
+        request.uri = "/resource";
+        request.version = "HTTP/1.1";
+        request.post = &post;
+    }
+
+    HttpRequest request;
+    HttpResponse response;
+    std::function<void(std::function<void()>)> post = [this](std::function<void()> task) {
+        queued.push_back(std::move(task));
+    };
+    std::vector<std::function<void()>> queued;
+    bool done{false};
+
+    void run_queued() {
+        auto tasks = std::move(queued);
+        queued.clear();
+        for (auto& task : tasks) task();
+    }
+};
+
+// 异步处理函数：记录调用，由测试决定何时完成
+struct Backend {
+    const char* cache_control = "max-age=60";
+    int calls = 0;
+    std::vector<std::function<void()>> pending;
+
+    Router::AsyncHandler handler() {
+        return [this](const HttpRequest&, HttpResponse& response, Router::Completion done) {
+            ++calls;
+            response.set_status(200, "OK");
+            response.add_header("Cache-Control", cache_control);
+            response.set_body("body");
+            pending.push_back(std::move(done));
+        };
+    }
+
+    void complete_all() {
+        auto completions = std::move(pending);
+        pending.clear();
+        for (auto& done : completions) done();
+    }
+};
+
+void call(const Router::AsyncHandler& wrapped, Client& client) {
+    wrapped(client.request, client.response, [&client] { client.done = true; });
+}
+
+std::shared_ptr<ResponseCache> make_cache() {
+    CacheOptions options;
+    options.hit_for_pass = std::chrono::seconds(60);
+    return std::make_shared<ResponseCache>(options, CompressionOptions{});
+}
+
+void test_coalesced_hit() {
+    Backend backend;
+    auto cache = make_cache();
+    const auto wrapped = cache->wrap(backend.handler());
+
+    Client leader, waiter;
+    call(wrapped, leader);
+    call(wrapped, waiter);
+    check(backend.calls == 1 && !waiter.done, "并发未命中只调用一次处理函数，第二个请求等待");
+
+    backend.complete_all();
+    check(leader.done && waiter.done && !waiter.response.prebuilt().empty() && waiter.queued.empty(),
+          "可以缓存的结果直接交给等待的请求");
+
+    Client later;
+    call(wrapped, later);
+    check(later.done && backend.calls == 1, "之后的请求命中缓存");
+}
+
+void test_uncacheable_dispatch() {
+    Backend backend;
+    backend.cache_control = "private";
+    auto cache = make_cache();
+    const auto wrapped = cache->wrap(backend.handler());
+
+    Client leader, first, second;
+    call(wrapped, leader);
+    call(wrapped, first);
+    call(wrapped, second);
+    backend.complete_all();
+    check(leader.done && backend.calls == 1 && first.queued.size() == 1 && second.queued.size() == 1,
+          "不能缓存时等待的请求投递回各自的连接，不在完成调用的线程上执行");
+
+    first.run_queued();
+    second.run_queued();
+    check(backend.calls == 3, "等待的请求在自己的连接上各自调用处理函数");
+    backend.complete_all();
+    check(first.done && second.done, "等待的请求各自完成");
+
+    Client passed, concurrent;
+    call(wrapped, passed);
+    call(wrapped, concurrent);
+    check(backend.calls == 5 && passed.queued.empty() && concurrent.queued.empty(),
+          "hit-for-pass期间的并发请求不再等待，直接调用处理函数");
+    backend.complete_all();
+    check(passed.done && concurrent.done, "hit-for-pass的请求完成");
+}
+
+void test_pass_disabled() {
+    Backend backend;
+    backend.cache_control = "private";
+    CacheOptions options;
+    options.hit_for_pass = std::chrono::seconds(0);
+    auto cache = std::make_shared<ResponseCache>(options, CompressionOptions{});
+    const auto wrapped = cache->wrap(backend.handler());
+
+    Client first;
+    call(wrapped, first);
+    backend.complete_all();
+
+    // hit_for_pass为0时不记录，之后的并发未命中仍然合并
+    backend.cache_control = "max-age=60";
+    Client leader, waiter;
+    call(wrapped, leader);
+    call(wrapped, waiter);
+    check(backend.calls == 2 && !waiter.done, "hit_for_pass为0时不记录，并发未命中仍然合并");
+    backend.complete_all();
+    check(waiter.done && !waiter.response.prebuilt().empty(), "合并的请求得到缓存的结果");
+}
+
+} // namespace
+
+int main() {
+    test_coalesced_hit();
+    test_uncacheable_dispatch();
+    test_pass_disabled();
+
+    return hsmm::test::finish();
+}
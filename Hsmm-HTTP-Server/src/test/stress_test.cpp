@@ -1,156 +1,658 @@
+// Boost 1.74的awaitable.hpp使用了std::exchange但没有包含<utility>
+#include <utility>
 #include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
 #include <boost/beast.hpp>
+#include "utils/Metrics.hpp"
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <sstream>
 #include <string>
 #include <thread>
 #include <vector>
-#include <atomic>
-#include <iomanip>
-#include <mutex>
 
 namespace beast = boost::beast;
 namespace http = beast::http;
 namespace net = boost::asio;
+namespace ssl = boost::asio::ssl;
 using tcp = boost::asio::ip::tcp;
+using clock_type = std::chrono::steady_clock;
+
+namespace {
+
+// 测试配置
+struct Options {
+    std::string host = "127.0.0.1";
+    std::string port = "8080";
+    std::string path = "/";
+    size_t connections = 50;
+    size_t threads = 1;
+    // 测试时长（秒），指定了total_requests且没有指定时长时不限时
+    double duration = 10;
+    bool duration_set = false;
+    // 总请求数，0表示不限
+    std::uint64_t total_requests = 0;
+    // 开环模式下的总请求速率（请求/秒），0表示闭环模式
+    double rate = 0;
+    // 每个连接上未收到响应的最大请求数
+    size_t pipeline = 1;
+    // JSON报告输出路径，"-"表示标准输出
+    std::string json;
+    // 使用TLS连接（不验证证书）
+    bool tls = false;
+    // 每个请求使用新连接（Connection: close），用于测量握手开销
+    bool close = false;
+    // 新连接是否恢复上一个连接的TLS会话
+    bool resume = true;
+};
+
+void print_usage(const char* program) {
+    std::cerr << "用法: " << program << " [选项] <host> <port>\n"
+              << "      " << program << " <host> <port> <total_requests> <concurrent_connections>\n\n"
+              << "选项:\n"
+              << "  -c <n>        连接数（默认50）\n"
+              << "  -t <n>        线程数（默认1）\n"
+              << "  -d <秒>       测试时长（默认10）\n"
+              << "  -n <n>        总请求数，达到后结束\n"
+              << "  -r <rps>      开环模式：按固定速率发送，延迟从计划发送时间算起\n"
+              << "  -p <n>        每个连接的流水线深度（默认1）\n"
+              << "  --path <uri>  请求路径（默认/）\n"
+              << "  --json <file> 输出JSON报告，\"-\"表示标准输出\n"
+              << "  --tls         使用TLS连接，不验证服务器证书\n"
+              << "  --close       每个请求使用新连接，配合--tls测量握手开销\n"
+              << "  --no-resume   新连接不恢复上一个TLS会话，每次都是完整握手\n";
+}
+
+bool parse_options(int argc, char* argv[], Options& options) {
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const auto value = [&]() -> const char* {
+            if (i + 1 >= argc) throw std::invalid_argument("缺少参数值: " + arg);
+            return argv[++i];
+        };
+
+        if (arg == "-c") options.connections = std::stoul(value());
+        else if (arg == "-t") options.threads = std::stoul(value());
+        else if (arg == "-d") { options.duration = std::stod(value()); options.duration_set = true; }
+        else if (arg == "-n") options.total_requests = std::stoull(value());
+        else if (arg == "-r") options.rate = std::stod(value());
+        else if (arg == "-p") options.pipeline = std::stoul(value());
+        else if (arg == "--path") options.path = value();
+        else if (arg == "--json") options.json = value();
+        else if (arg == "--tls") options.tls = true;
+        else if (arg == "--close") options.close = true;
+        else if (arg == "--no-resume") options.resume = false;
+        else if (arg == "-h" || arg == "--help") return false;
+        else if (!arg.empty() && arg[0] == '-') throw std::invalid_argument("未知选项: " + arg);
+        else positional.push_back(arg);
+    }
 
-// 统计信息
-struct Statistics {
-    std::atomic<size_t> success_count{0};
-    std::atomic<size_t> error_count{0};
-    std::atomic<size_t> total_latency{0};  // 单位：毫秒
-    std::mutex cout_mutex;
-
-    void print_progress(size_t total_requests) {
-        std::lock_guard<std::mutex> lock(cout_mutex);
-        size_t completed = success_count + error_count;
-        double progress = (completed * 100.0) / total_requests;
-        double avg_latency = completed > 0 ? total_latency.load() / (double)completed : 0;
-        
-        std::cout << "\r进度: " << std::fixed << std::setprecision(2) << progress << "% "
-                  << "成功: " << success_count << " "
-                  << "失败: " << error_count << " "
-                  << "平均延迟: " << avg_latency << "ms" << std::flush;
-    }
-
-    void print_final_results(size_t total_requests, std::chrono::milliseconds duration) {
-        std::lock_guard<std::mutex> lock(cout_mutex);
-        double total_time = duration.count() / 1000.0;
-        double qps = total_requests / total_time;
-        double avg_latency = (success_count + error_count) > 0 ? 
-            total_latency.load() / (double)(success_count + error_count) : 0;
-
-        std::cout << "\n\n最终测试结果:" << std::endl;
-        std::cout << "总请求数: " << total_requests << std::endl;
-        std::cout << "成功请求: " << success_count << std::endl;
-        std::cout << "失败请求: " << error_count << std::endl;
-        std::cout << "总耗时: " << total_time << "秒" << std::endl;
-        std::cout << "QPS: " << std::fixed << std::setprecision(2) << qps << std::endl;
-        std::cout << "平均延迟: " << avg_latency << "ms" << std::endl;
+    if (positional.size() == 4) {
+        // 兼容旧的参数格式：<host> <port> <total_requests> <concurrent_connections>
+        options.total_requests = std::stoull(positional[2]);
+        options.connections = std::stoul(positional[3]);
+    } else if (positional.size() != 2) {
+        return false;
+    }
+    options.host = positional[0];
+    options.port = positional[1];
+
+    options.connections = std::max<size_t>(options.connections, 1);
+    options.threads = std::clamp<size_t>(options.threads, 1, options.connections);
+    // 短连接上只发送一个请求
+    options.pipeline = options.close ? 1 : std::max<size_t>(options.pipeline, 1);
+    return true;
+}
+
+// 单个线程的统计，只由该线程写入，测试结束后汇总
+struct ThreadStats {
+    hsmm::utils::LatencyHistogram latency;
+    std::uint64_t completed = 0;
+    std::uint64_t latency_sum = 0;
+    std::uint64_t latency_min = std::numeric_limits<std::uint64_t>::max();
+    std::uint64_t latency_max = 0;
+    std::uint64_t bytes_received = 0;
+    std::uint64_t connect_errors = 0;
+    std::uint64_t read_errors = 0;
+    std::uint64_t write_errors = 0;
+    // 连接断开时未收到响应的请求
+    std::uint64_t dropped = 0;
+    std::array<std::uint64_t, 6> status{};
+    // TLS握手，从TCP连接建立到握手完成
+    hsmm::utils::LatencyHistogram handshake_latency;
+    std::uint64_t handshakes = 0;
+    std::uint64_t resumed = 0;
+    std::uint64_t handshake_sum = 0;
+    std::uint64_t handshake_max = 0;
+    std::uint64_t handshake_errors = 0;
+
+    void record(std::uint64_t nanoseconds) {
+        latency.record(nanoseconds);
+        latency_sum += nanoseconds;
+        latency_min = std::min(latency_min, nanoseconds);
+        latency_max = std::max(latency_max, nanoseconds);
+        ++completed;
     }
 };
 
-// 发送单个请求
-void send_request(net::io_context& ioc, const std::string& host, unsigned short port, Statistics& stats) {
-    try {
-        tcp::resolver resolver(ioc);
-        beast::tcp_stream stream(ioc);
+// 所有线程共享的测试状态
+struct Shared {
+    Options options;
+    tcp::resolver::results_type endpoints;
+    std::string request;
+    clock_type::time_point start;
+    clock_type::time_point deadline;
+    // 开环模式下每个连接的发送间隔
+    clock_type::duration interval{};
 
-        auto start_time = std::chrono::steady_clock::now();
+    std::atomic<bool> stopping{false};
+    // -n模式下剩余可发送的请求数
+    std::atomic<std::int64_t> budget{std::numeric_limits<std::int64_t>::max()};
+    std::atomic<std::uint64_t> finished{0};
+    // --tls时所有连接共享的客户端配置
+    std::unique_ptr<ssl::context> ssl_context;
 
-        // 设置超时
-        stream.expires_after(std::chrono::seconds(5));
+    bool open_loop() const noexcept { return options.rate > 0; }
+
+    bool take_request() noexcept {
+        return budget.fetch_sub(1, std::memory_order_relaxed) > 0;
+    }
+};
+
+/**
+ * @brief 单个keep-alive连接
+ *
+ * 发送协程按计划时间（开环）或流水线窗口（闭环）写出请求，接收协程按顺序解析响应。
+ * 两个协程运行在同一个线程上，通过wakeup_定时器互相唤醒。
+ * --tls时每次建立连接后先完成握手，收到响应后保存会话，下一次连接时恢复。
+ */
+class Client : public std::enable_shared_from_this<Client> {
+public:
+    Client(net::io_context& io_context, Shared& shared, ThreadStats& stats)
+        : socket_(io_context), wakeup_(io_context), shared_(shared), stats_(stats) {
+        wakeup_.expires_at(clock_type::time_point::max());
+    }
 
-        // 解析地址
-        auto const results = resolver.resolve(host, std::to_string(port));
-        
-        // 连接
-        stream.connect(results);
+    net::awaitable<void> run(clock_type::time_point first_send) {
+        next_send_ = first_send;
+        while (!shared_.stopping.load(std::memory_order_relaxed)) {
+            boost::system::error_code ec;
+            co_await net::async_connect(socket_, shared_.endpoints, net::redirect_error(net::use_awaitable, ec));
+            if (ec) {
+                ++stats_.connect_errors;
+                net::steady_timer backoff(socket_.get_executor(), std::chrono::milliseconds(100));
+                co_await backoff.async_wait(net::redirect_error(net::use_awaitable, ec));
+                continue;
+            }
+            socket_.set_option(tcp::no_delay(true), ec);
+            if (shared_.ssl_context && !co_await handshake()) {
+                socket_.close(ec);
+                continue;
+            }
 
-        // 准备请求
-        http::request<http::string_body> req{http::verb::get, "/", 11};
-        req.set(http::field::host, host);
-        req.set(http::field::user_agent, "StressTest");
+            closed_ = false;
+            sender_done_ = false;
+            receiver_done_ = false;
+            net::co_spawn(socket_.get_executor(), receive(),
+                [self = shared_from_this()](std::exception_ptr) {
+                    self->receiver_done_ = true;
+                    self->notify();
+                });
+            co_await send();
 
-        // 发送请求
-        http::write(stream, req);
+            while (!receiver_done_) {
+                co_await wait();
+            }
+            tls_.reset();
+            socket_.close(ec);
+        }
+    }
+
+    void stop() {
+        boost::system::error_code ec;
+        socket_.close(ec);
+        notify();
+    }
+
+private:
+    net::awaitable<bool> handshake() {
+        tls_.emplace(socket_, *shared_.ssl_context);
+        SSL_set_tlsext_host_name(tls_->native_handle(), shared_.options.host.c_str());
+        if (!session_.empty()) {
+            const auto* data = session_.data();
+            if (auto* session = d2i_SSL_SESSION(nullptr, &data, static_cast<long>(session_.size()))) {
+                SSL_set_session(tls_->native_handle(), session);
+                SSL_SESSION_free(session);
+            }
+        }
+
+        const auto start = clock_type::now();
+        boost::system::error_code ec;
+        co_await tls_->async_handshake(ssl::stream_base::client, net::redirect_error(net::use_awaitable, ec));
+        if (ec) {
+            ++stats_.handshake_errors;
+            tls_.reset();
+            co_return false;
+        }
+
+        const auto nanoseconds = static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - start).count());
+        if (clock_type::now() <= shared_.deadline) {
+            stats_.handshake_latency.record(nanoseconds);
+            stats_.handshake_sum += nanoseconds;
+            stats_.handshake_max = std::max(stats_.handshake_max, nanoseconds);
+            ++stats_.handshakes;
+            if (SSL_session_reused(tls_->native_handle())) {
+                ++stats_.resumed;
+            }
+        }
+        co_return true;
+    }
+
+    // TLS 1.3的会话票据在握手之后才到达，收到第一个响应后再保存
+    void save_session() {
+        if (!tls_ || !shared_.options.resume) {
+            return;
+        }
+        auto* session = SSL_get0_session(tls_->native_handle());
+        if (!session || !SSL_SESSION_is_resumable(session)) {
+            return;
+        }
+        session_.resize(static_cast<size_t>(i2d_SSL_SESSION(session, nullptr)));
+        auto* data = session_.data();
+        i2d_SSL_SESSION(session, &data);
+    }
+
+    net::awaitable<void> send() {
+        const auto depth = shared_.options.pipeline;
+        while (!closed_ && !shared_.stopping.load(std::memory_order_relaxed)) {
+            clock_type::time_point intended;
+            if (shared_.open_loop()) {
+                // 按固定节奏发送，即使落后也不跳过，延迟从计划时间算起（避免协调遗漏）
+                intended = next_send_;
+                next_send_ += shared_.interval;
+                if (intended > clock_type::now()) {
+                    net::steady_timer timer(socket_.get_executor(), intended);
+                    boost::system::error_code ec;
+                    co_await timer.async_wait(net::redirect_error(net::use_awaitable, ec));
+                }
+            }
+
+            while (in_flight_.size() >= depth && !closed_) {
+                co_await wait();
+            }
+            if (closed_ || shared_.stopping.load(std::memory_order_relaxed) || !shared_.take_request()) {
+                break;
+            }
+
+            if (!shared_.open_loop()) {
+                intended = clock_type::now();
+            }
+            in_flight_.push_back(intended);
+            notify();
+
+            boost::system::error_code ec;
+            // GCC 12在co_await条件表达式时会重复销毁临时的awaitable，分开写
+            if (tls_) {
+                co_await net::async_write(*tls_, net::buffer(shared_.request), net::redirect_error(net::use_awaitable, ec));
+            } else {
+                co_await net::async_write(socket_, net::buffer(shared_.request), net::redirect_error(net::use_awaitable, ec));
+            }
+            if (ec) {
+                ++stats_.write_errors;
+                close();
+            }
+            if (shared_.options.close) {
+                break;
+            }
+        }
+        sender_done_ = true;
+        notify();
+    }
 
-        // 接收响应
+    net::awaitable<void> receive() {
         beast::flat_buffer buffer;
-        http::response<http::string_body> res;
-        http::read(stream, buffer, res);
+        while (true) {
+            if (in_flight_.empty()) {
+                if (sender_done_ || closed_) break;
+                co_await wait();
+                continue;
+            }
 
-        // 计算延迟
-        auto end_time = std::chrono::steady_clock::now();
-        auto latency = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
+            http::response<http::string_body> response;
+            boost::system::error_code ec;
+            std::size_t bytes = 0;
+            if (tls_) {
+                bytes = co_await http::async_read(*tls_, buffer, response, net::redirect_error(net::use_awaitable, ec));
+            } else {
+                bytes = co_await http::async_read(socket_, buffer, response, net::redirect_error(net::use_awaitable, ec));
+            }
+            if (ec) {
+                if (!shared_.stopping.load(std::memory_order_relaxed)) {
+                    ++stats_.read_errors;
+                }
+                break;
+            }
+
+            const auto now = clock_type::now();
+            const auto intended = in_flight_.front();
+            in_flight_.pop_front();
+            stats_.bytes_received += bytes;
+            if (now <= shared_.deadline) {
+                stats_.record(static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - intended).count()));
+                const auto status_class = std::min<unsigned>(response.result_int() / 100, 5);
+                ++stats_.status[status_class];
+            }
+            shared_.finished.fetch_add(1, std::memory_order_relaxed);
+            save_session();
+            notify();
+
+            if (!response.keep_alive()) {
+                break;
+            }
+        }
+
+        // 连接断开时还没收到响应的请求计为丢失
+        if (!shared_.stopping.load(std::memory_order_relaxed)) {
+            stats_.dropped += in_flight_.size();
+        }
+        in_flight_.clear();
+        close();
+    }
+
+    net::awaitable<void> wait() {
+        boost::system::error_code ec;
+        co_await wakeup_.async_wait(net::redirect_error(net::use_awaitable, ec));
+    }
+
+    void notify() {
+        wakeup_.cancel();
+    }
 
-        // 更新统计信息
-        stats.total_latency += latency.count();
-        stats.success_count++;
+    void close() {
+        closed_ = true;
+        boost::system::error_code ec;
+        socket_.shutdown(tcp::socket::shutdown_both, ec);
+        notify();
+    }
+
+    tcp::socket socket_;
+    std::optional<ssl::stream<tcp::socket&>> tls_;
+    // 上一个连接的TLS会话（DER编码），每次连接时解码出新的会话对象。
+    // OpenSSL 3.0的客户端直接复用另一个连接的会话对象时，TLS 1.3的ClientHello不会带上PSK
+    std::vector<unsigned char> session_;
+    net::steady_timer wakeup_;
+    Shared& shared_;
+    ThreadStats& stats_;
+
+    // 已发送请求的计划发送时间，按发送顺序排列
+    std::deque<clock_type::time_point> in_flight_;
+    clock_type::time_point next_send_;
+    bool closed_ = false;
+    bool sender_done_ = false;
+    bool receiver_done_ = false;
+};
 
-        // 关闭连接
-        beast::error_code ec;
-        stream.socket().shutdown(tcp::socket::shutdown_both, ec);
+// 从汇总的直方图中取分位数
+std::uint64_t percentile(const std::array<std::uint64_t, hsmm::utils::LatencyHistogram::bucket_count>& buckets,
+                         std::uint64_t total, double quantile, std::uint64_t max) {
+    if (total == 0) return 0;
+    const auto rank = static_cast<std::uint64_t>(quantile * static_cast<double>(total - 1)) + 1;
+    std::uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return std::min(hsmm::utils::LatencyHistogram::bucket_upper(i), max);
+        }
     }
-    catch(std::exception const&) {
-        stats.error_count++;
+    return max;
+}
+
+std::string json_escape(const std::string& value) {
+    std::string out;
+    for (const char c : value) {
+        if (c == '"' || c == '\\') out.push_back('\\');
+        out.push_back(c);
     }
+    return out;
 }
 
+} // namespace
+
 int main(int argc, char* argv[]) {
     try {
-        if (argc != 5) {
-            std::cerr << "用法: " << argv[0] << " <host> <port> <total_requests> <concurrent_connections>\n";
+        Shared shared;
+        try {
+            if (!parse_options(argc, argv, shared.options)) {
+                print_usage(argv[0]);
+                return 1;
+            }
+        }
+        catch (const std::exception& e) {
+            std::cerr << "错误: " << e.what() << "\n";
+            print_usage(argv[0]);
             return 1;
         }
+        const auto& options = shared.options;
 
-        auto const host = argv[1];
-        auto const port = static_cast<unsigned short>(std::atoi(argv[2]));
-        auto const total_requests = std::atoi(argv[3]);
-        auto const concurrent_connections = std::atoi(argv[4]);
+        {
+            net::io_context resolver_context;
+            tcp::resolver resolver(resolver_context);
+            shared.endpoints = resolver.resolve(options.host, options.port);
+        }
+        shared.request = "GET " + options.path + " HTTP/1.1\r\nHost: " + options.host +
+                         "\r\nUser-Agent: hsmm-stress-test\r\n" +
+                         (options.close ? "Connection: close\r\n" : "") + "\r\n";
+        if (options.tls) {
+            shared.ssl_context = std::make_unique<ssl::context>(ssl::context::tls_client);
+            shared.ssl_context->set_verify_mode(ssl::verify_none);
+            // 客户端缓存会话由Client自己管理
+            SSL_CTX_set_session_cache_mode(shared.ssl_context->native_handle(), SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL);
+        }
+        if (options.total_requests > 0) {
+            shared.budget = static_cast<std::int64_t>(options.total_requests);
+        }
+        const bool timed = options.duration_set || options.total_requests == 0;
+        if (shared.open_loop()) {
+            shared.interval = std::chrono::duration_cast<clock_type::duration>(
+                std::chrono::duration<double>(static_cast<double>(options.connections) / options.rate));
+        }
 
         std::cout << "开始压力测试:\n"
-                  << "目标服务器: " << host << ":" << port << "\n"
-                  << "总请求数: " << total_requests << "\n"
-                  << "并发连接数: " << concurrent_connections << "\n\n";
+                  << "目标服务器: " << options.host << ":" << options.port << options.path << "\n"
+                  << "模式: " << (shared.open_loop() ? "开环，目标速率 " + std::to_string(options.rate) + " 请求/秒" : std::string("闭环")) << "\n"
+                  << "连接数: " << options.connections << "，线程数: " << options.threads
+                  << "，流水线深度: " << options.pipeline << "\n";
+        if (options.tls) {
+            std::cout << "TLS: " << (options.resume ? "恢复会话" : "完整握手")
+                      << (options.close ? "，每个请求一个连接" : "") << "\n";
+        }
+        if (options.total_requests > 0) std::cout << "总请求数: " << options.total_requests << "\n";
+        if (timed) std::cout << "测试时长: " << options.duration << "秒\n";
+        std::cout << std::endl;
 
-        Statistics stats;
-        auto start_time = std::chrono::steady_clock::now();
+        shared.start = clock_type::now();
+        shared.deadline = timed
+            ? shared.start + std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(options.duration))
+            : clock_type::time_point::max();
+
+        // 每个线程一个io_context，连接平均分配到各线程
+        std::vector<std::unique_ptr<net::io_context>> contexts;
+        std::vector<std::unique_ptr<ThreadStats>> stats;
+        std::vector<std::vector<std::shared_ptr<Client>>> clients(options.threads);
+        for (size_t t = 0; t < options.threads; ++t) {
+            contexts.push_back(std::make_unique<net::io_context>(1));
+            stats.push_back(std::make_unique<ThreadStats>());
+        }
+        for (size_t i = 0; i < options.connections; ++i) {
+            const auto t = i % options.threads;
+            auto client = std::make_shared<Client>(*contexts[t], shared, *stats[t]);
+            // 开环模式下各连接的发送时间错开，整体速率均匀
+            const auto offset = shared.interval * static_cast<long>(i) / static_cast<long>(options.connections);
+            net::co_spawn(*contexts[t], client->run(shared.start + offset), net::detached);
+            clients[t].push_back(std::move(client));
+        }
 
-        // 创建线程池
         std::vector<std::thread> threads;
-        size_t requests_per_thread = total_requests / concurrent_connections;
-        size_t remaining_requests = total_requests % concurrent_connections;
-
-        // 启动工作线程
-        for (int i = 0; i < concurrent_connections; ++i) {
-            size_t thread_requests = requests_per_thread + (i < remaining_requests ? 1 : 0);
-            threads.emplace_back([&host, port, thread_requests, &stats, total_requests]() {
-                net::io_context ioc;
-                for (size_t j = 0; j < thread_requests; ++j) {
-                    send_request(ioc, host, port, stats);
-                    if (j % 10 == 0) {  // 每10个请求更新一次进度
-                        stats.print_progress(total_requests);
-                    }
-                }
-            });
+        for (auto& context : contexts) {
+            threads.emplace_back([&context] { context->run(); });
         }
 
-        // 等待所有线程完成
+        // 主线程每秒输出一次进度，达到时长或请求数后结束
+        std::uint64_t last_finished = 0;
+        auto last_report = shared.start;
+        while (true) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            const auto now = clock_type::now();
+            const auto finished = shared.finished.load(std::memory_order_relaxed);
+            if (now >= shared.deadline ||
+                (options.total_requests > 0 && finished >= options.total_requests)) {
+                break;
+            }
+            if (now - last_report >= std::chrono::seconds(1)) {
+                const auto seconds = std::chrono::duration<double>(now - last_report).count();
+                std::cout << "\r已完成: " << finished << "  当前速率: " << std::fixed << std::setprecision(0)
+                          << static_cast<double>(finished - last_finished) / seconds << " 请求/秒   " << std::flush;
+                last_finished = finished;
+                last_report = now;
+            }
+        }
+        const auto end = clock_type::now();
+        shared.stopping = true;
+        if (!timed) {
+            shared.deadline = end;
+        }
+        for (size_t t = 0; t < options.threads; ++t) {
+            net::post(*contexts[t], [&clients, t] {
+                for (auto& client : clients[t]) client->stop();
+            });
+        }
+        for (auto& context : contexts) {
+            context->stop();
+        }
         for (auto& thread : threads) {
             thread.join();
         }
 
-        auto end_time = std::chrono::steady_clock::now();
-        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
+        // 汇总各线程的统计
+        ThreadStats total;
+        std::array<std::uint64_t, hsmm::utils::LatencyHistogram::bucket_count> buckets{};
+        std::array<std::uint64_t, hsmm::utils::LatencyHistogram::bucket_count> handshake_buckets{};
+        std::uint64_t unused_sum = 0;
+        for (const auto& s : stats) {
+            s->latency.merge_into(buckets, unused_sum);
+            s->handshake_latency.merge_into(handshake_buckets, unused_sum);
+            total.handshakes += s->handshakes;
+            total.resumed += s->resumed;
+            total.handshake_sum += s->handshake_sum;
+            total.handshake_max = std::max(total.handshake_max, s->handshake_max);
+            total.handshake_errors += s->handshake_errors;
+            total.completed += s->completed;
+            total.latency_sum += s->latency_sum;
+            total.latency_min = std::min(total.latency_min, s->latency_min);
+            total.latency_max = std::max(total.latency_max, s->latency_max);
+            total.bytes_received += s->bytes_received;
+            total.connect_errors += s->connect_errors;
+            total.read_errors += s->read_errors;
+            total.write_errors += s->write_errors;
+            total.dropped += s->dropped;
+            for (size_t i = 0; i < total.status.size(); ++i) total.status[i] += s->status[i];
+        }
+
+        const auto elapsed = std::chrono::duration<double>(std::min(end, shared.deadline) - shared.start).count();
+        const auto throughput = elapsed > 0 ? static_cast<double>(total.completed) / elapsed : 0.0;
+        const auto us = [](std::uint64_t ns) { return static_cast<double>(ns) / 1000.0; };
+        const auto min = total.completed ? total.latency_min : 0;
+        const auto mean = total.completed ? total.latency_sum / total.completed : 0;
+        const std::array<std::pair<const char*, double>, 4> quantiles{{
+            {"p50", 0.5}, {"p90", 0.9}, {"p99", 0.99}, {"p999", 0.999}
+        }};
 
-        // 打印最终结果
-        stats.print_final_results(total_requests, duration);
+        std::cout << "\n\n最终测试结果:\n" << std::fixed << std::setprecision(2)
+                  << "完成请求: " << total.completed << "\n"
+                  << "状态码: 2xx=" << total.status[2] << " 3xx=" << total.status[3]
+                  << " 4xx=" << total.status[4] << " 5xx=" << total.status[5] << "\n"
+                  << "错误: 连接=" << total.connect_errors << " 读取=" << total.read_errors
+                  << " 写入=" << total.write_errors << " 丢失=" << total.dropped << "\n"
+                  << "总耗时: " << elapsed << "秒\n"
+                  << "吞吐量: " << throughput << " 请求/秒\n"
+                  << "接收: " << static_cast<double>(total.bytes_received) / elapsed / (1024 * 1024) << " MB/秒\n"
+                  << "延迟(微秒): min=" << us(min) << " mean=" << us(mean);
+        for (const auto& [name, q] : quantiles) {
+            std::cout << " " << name << "=" << us(percentile(buckets, total.completed, q, total.latency_max));
+        }
+        std::cout << " max=" << us(total.latency_max) << std::endl;
+        const auto handshake_mean = total.handshakes ? total.handshake_sum / total.handshakes : 0;
+        if (options.tls) {
+            std::cout << "TLS握手: " << total.handshakes << " 次，恢复 " << total.resumed
+                      << " 次，失败 " << total.handshake_errors << " 次，"
+                      << static_cast<double>(total.handshakes) / elapsed << " 次/秒\n"
+                      << "握手耗时(微秒): mean=" << us(handshake_mean);
+            for (const auto& [name, q] : quantiles) {
+                std::cout << " " << name << "=" << us(percentile(handshake_buckets, total.handshakes, q, total.handshake_max));
+            }
+            std::cout << " max=" << us(total.handshake_max) << std::endl;
+        }
+
+        if (!options.json.empty()) {
+            std::ostringstream json;
+            json << std::fixed << std::setprecision(3)
+                 << "{\n"
+                 << "  \"target\": \"" << json_escape(options.host + ":" + options.port + options.path) << "\",\n"
+                 << "  \"mode\": \"" << (shared.open_loop() ? "open-loop" : "closed-loop") << "\",\n"
+                 << "  \"connections\": " << options.connections << ",\n"
+                 << "  \"threads\": " << options.threads << ",\n"
+                 << "  \"pipeline\": " << options.pipeline << ",\n"
+                 << "  \"target_rate\": " << options.rate << ",\n"
+                 << "  \"duration_s\": " << elapsed << ",\n"
+                 << "  \"requests\": " << total.completed << ",\n"
+                 << "  \"throughput_rps\": " << throughput << ",\n"
+                 << "  \"bytes_received\": " << total.bytes_received << ",\n"
+                 << "  \"status\": {\"1xx\": " << total.status[1] << ", \"2xx\": " << total.status[2]
+                 << ", \"3xx\": " << total.status[3] << ", \"4xx\": " << total.status[4]
+                 << ", \"5xx\": " << total.status[5] << "},\n"
+                 << "  \"errors\": {\"connect\": " << total.connect_errors << ", \"read\": " << total.read_errors
+                 << ", \"write\": " << total.write_errors << ", \"dropped\": " << total.dropped << "},\n"
+                 << "  \"latency_us\": {\"min\": " << us(min) << ", \"mean\": " << us(mean);
+            for (const auto& [name, q] : quantiles) {
+                json << ", \"" << name << "\": " << us(percentile(buckets, total.completed, q, total.latency_max));
+            }
+            json << ", \"max\": " << us(total.latency_max) << "}";
+            if (options.tls) {
+                json << ",\n  \"tls\": {\"handshakes\": " << total.handshakes << ", \"resumed\": " << total.resumed
+                     << ", \"errors\": " << total.handshake_errors
+                     << ", \"handshake_us\": {\"mean\": " << us(handshake_mean);
+                for (const auto& [name, q] : quantiles) {
+                    json << ", \"" << name << "\": " << us(percentile(handshake_buckets, total.handshakes, q, total.handshake_max));
+                }
+                json << ", \"max\": " << us(total.handshake_max) << "}}";
+            }
+            json << "\n}\n";
+
+            if (options.json == "-") {
+                std::cout << json.str();
+            } else {
+                std::ofstream(options.json) << json.str();
+                std::cout << "JSON报告已写入: " << options.json << std::endl;
+            }
+        }
 
         return 0;
     }
-    catch(std::exception const& e) {
+    catch (const std::exception& e) {
         std::cerr << "错误: " << e.what() << std::endl;
         return 1;
     }
-} 
\ No newline at end of file
+}
@@ -0,0 +1,171 @@
+// WebSocket帧处理的单元测试：握手的Sec-WebSocket-Accept、帧头解析、
+// 跨过AVX2/SSE2/标量循环边界的去掩码以及UTF-8校验
+#include "check.hpp"
+#include "websocket/Frame.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <initializer_list>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using namespace hsmm::websocket;
+using hsmm::test::check;
+
+namespace {
+
+std::string bytes(std::initializer_list<int> values) {
+    std::string out;
+    for (const int value : values) out.push_back(static_cast<char>(value));
+    return out;
+}
+
+void test_accept_key() {
+    check(accept_key("dGhlIHNhbXBsZSBub25jZQ==") == "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=", "RFC 6455的Sec-WebSocket-Accept示例");
+}
+
+void test_frame_header() {
+    struct Case {
+        const char* name;
+        std::string data;
+        std::uint64_t length;
+        bool masked;
+        std::size_t size;
+    };
+    const Case cases[] = {
+        // RFC 6455 5.7：带掩码的"Hello"
+        {"7位长度，带掩码", bytes({0x81, 0x85, 0x37, 0xfa, 0x21, 0x3d}), 5, true, 6},
+        {"7位长度最大值125", bytes({0x82, 0x7d}), 125, false, 2},
+        {"16位长度", bytes({0x82, 0x7e, 0x01, 0x00}), 256, false, 4},
+        {"16位长度最大值，带掩码", bytes({0x82, 0xfe, 0xff, 0xff, 1, 2, 3, 4}), 0xffff, true, 8},
+        {"64位长度", bytes({0x82, 0x7f, 0, 0, 0, 0, 0, 1, 0, 0}), 0x10000, false, 10},
+        {"64位长度高位，带掩码", bytes({0x02, 0xff, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 1, 2, 3, 4}),
+         0x0102030405060708ull, true, 14},
+    };
+    for (const auto& c : cases) {
+        FrameHeader header{};
+        const bool complete = parse_frame_header(c.data, header);
+        check(complete && header.length == c.length && header.masked == c.masked && header.size == c.size,
+              std::string(c.name) + "：长度" + std::to_string(c.length));
+
+        bool partial_rejected = true;
+        for (std::size_t n = 0; n < c.data.size(); ++n) {
+            FrameHeader partial{};
+            partial_rejected = partial_rejected && !parse_frame_header(std::string_view(c.data).substr(0, n), partial);
+        }
+        check(partial_rejected, std::string(c.name) + "：帧头不完整时返回false");
+    }
+
+    FrameHeader header{};
+    parse_frame_header(bytes({0x81, 0x85, 0x37, 0xfa, 0x21, 0x3d}), header);
+    check(header.fin && header.opcode == Opcode::text && header.reserved == 0 &&
+          header.mask == std::array<std::uint8_t, 4>{0x37, 0xfa, 0x21, 0x3d},
+          "FIN、opcode和掩码");
+    parse_frame_header(bytes({0x72, 0x00}), header);
+    check(!header.fin && header.reserved == 0x7 && header.opcode == Opcode::binary, "RSV位");
+
+    bool round_trip = true;
+    for (const std::uint64_t length : {0ull, 125ull, 126ull, 0xffffull, 0x10000ull, 0x100000005ull}) {
+        std::string out;
+        write_frame_header(out, Opcode::binary, true, length);
+        round_trip = round_trip && parse_frame_header(out, header) && header.length == length &&
+                     header.size == out.size() && !header.masked;
+    }
+    check(round_trip, "write_frame_header写出的帧头解析回同样的长度");
+}
+
+void test_unmask() {
+    std::string payload = bytes({0x7f, 0x9f, 0x4d, 0x51, 0x58});
+    unmask(payload, {0x37, 0xfa, 0x21, 0x3d}, 0);
+    check(payload == "Hello", "RFC 6455 5.7的掩码示例");
+
+    const std::array<std::uint8_t, 4> mask{0xa1, 0x5b, 0x3c, 0xe7};
+    std::mt19937 rng(6455);
+    std::vector<char> original(200);
+    for (auto& c : original) c = static_cast<char>(rng());
+
+    // 每种长度和偏移，数据起点也不对齐
+    bool matches = true;
+    for (std::size_t size = 0; size <= 100; ++size) {
+        for (std::uint64_t offset = 0; offset < 8; ++offset) {
+            const auto start = static_cast<std::size_t>(offset % 3);
+            std::vector<char> data(original.begin(), original.end());
+            unmask(std::span<char>(data.data() + start, size), mask, offset);
+            for (std::size_t i = 0; i < data.size(); ++i) {
+                const bool inside = i >= start && i < start + size;
+                const char expected = inside ? static_cast<char>(original[i] ^ mask[(offset + i - start) & 3])
+                                             : original[i];
+                matches = matches && data[i] == expected;
+            }
+        }
+    }
+    check(matches, "长度0到100、偏移0到7时与逐字节异或相同，不改动范围外的数据");
+
+    // 负载分段处理：每段的offset是它在负载中的位置
+    bool chunked = true;
+    for (const std::size_t step : {1, 3, 7, 9, 17, 33, 65}) {
+        std::vector<char> whole(original.begin(), original.end());
+        unmask(whole, mask, 0);
+        std::vector<char> pieces(original.begin(), original.end());
+        for (std::size_t pos = 0; pos < pieces.size(); pos += step) {
+            const auto n = std::min(step, pieces.size() - pos);
+            unmask(std::span<char>(pieces.data() + pos, n), mask, pos);
+        }
+        chunked = chunked && pieces == whole;
+    }
+    check(chunked, "分段处理与一次处理结果相同");
+}
+
+void test_utf8() {
+    const std::string ascii = "plain ascii text";
+    const std::pair<const char*, std::string> valid[] = {
+        {"空字符串", ""},
+        {"ASCII", ascii},
+        {"两字节 U+00E9", bytes({0xc3, 0xa9})},
+        {"三字节 U+20AC", bytes({0xe2, 0x82, 0xac})},
+        {"代理项之前 U+D7FF", bytes({0xed, 0x9f, 0xbf})},
+        {"代理项之后 U+E000", bytes({0xee, 0x80, 0x80})},
+        {"四字节 U+10348", bytes({0xf0, 0x90, 0x8d, 0x88})},
+        {"最大码点 U+10FFFF", bytes({0xf4, 0x8f, 0xbf, 0xbf})},
+        {"ASCII和多字节混合", ascii + bytes({0xe2, 0x82, 0xac}) + ascii + bytes({0xf0, 0x90, 0x8d, 0x88})},
+    };
+    for (const auto& [name, text] : valid) {
+        check(valid_utf8(text), std::string("接受") + name);
+    }
+
+    const std::pair<const char*, std::string> invalid[] = {
+        {"过长编码 C0 80", bytes({0xc0, 0x80})},
+        {"过长编码 C1 BF", bytes({0xc1, 0xbf})},
+        {"过长编码 E0 80 80", bytes({0xe0, 0x80, 0x80})},
+        {"过长编码 E0 9F BF", bytes({0xe0, 0x9f, 0xbf})},
+        {"过长编码 F0 8F BF BF", bytes({0xf0, 0x8f, 0xbf, 0xbf})},
+        {"代理项 U+D800", bytes({0xed, 0xa0, 0x80})},
+        {"代理项 U+DFFF", bytes({0xed, 0xbf, 0xbf})},
+        {"超出范围 U+110000", bytes({0xf4, 0x90, 0x80, 0x80})},
+        {"超出范围的首字节 F5", bytes({0xf5, 0x80, 0x80, 0x80})},
+        {"非法字节 FF", bytes({0xff})},
+        {"单独的后续字节", bytes({0x80})},
+        {"后续字节不是10xxxxxx", bytes({0xe2, 0x28, 0xa1})},
+        {"截断的两字节序列", bytes({0xc3})},
+        {"截断的三字节序列", bytes({0xe2, 0x82})},
+        {"截断的四字节序列", bytes({0xf0, 0x90, 0x8d})},
+    };
+    for (const auto& [name, text] : invalid) {
+        // 单独出现以及跟在一段ASCII之后（经过按8字节跳过ASCII的循环）
+        check(!valid_utf8(text) && !valid_utf8(ascii + text), std::string("拒绝") + name);
+    }
+}
+
+} // namespace
+
+int main() {
+    test_accept_key();
+    test_frame_header();
+    test_unmask();
+    test_utf8();
+
+    return hsmm::test::finish();
+}
@@ -0,0 +1,173 @@
+#include "tls/Context.hpp"
+#include "utils/Logger.hpp"
+#include <openssl/core_names.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+namespace hsmm {
+namespace tls {
+
+namespace {
+    // ALPN协议列表（长度前缀格式），按服务器的偏好排列
+    constexpr unsigned char alpn_h2[] = {2, 'h', '2', 8, 'h', 't', 't', 'p', '/', '1', '.', '1'};
+    constexpr unsigned char alpn_http11[] = {8, 'h', 't', 't', 'p', '/', '1', '.', '1'};
+
+    // 会话缓存的作用域，同一个SSL_CTX内的会话才能恢复
+    constexpr unsigned char session_id_context[] = {'h', 's', 'm', 'm'};
+
+    std::string last_error() {
+        char buffer[256];
+        ERR_error_string_n(ERR_get_error(), buffer, sizeof(buffer));
+        return buffer;
+    }
+}
+
+Context::Context(const TlsOptions& options, bool http2)
+    : ctx_(SSL_CTX_new(TLS_server_method()))
+    , http2_(http2)
+    , ticket_key_lifetime_(options.ticket_key_lifetime)
+    , ticket_keys_{make_ticket_key(), make_ticket_key()}
+    , ticket_key_created_(std::chrono::steady_clock::now()) {
+    if (!ctx_) {
+        throw std::runtime_error("创建TLS上下文失败: " + last_error());
+    }
+
+    SSL_CTX_set_min_proto_version(ctx_, TLS1_2_VERSION);
+    // 连接关闭时不要求对端先发送close_notify，按普通的EOF处理
+    SSL_CTX_set_options(ctx_, SSL_OP_NO_RENEGOTIATION | SSL_OP_CIPHER_SERVER_PREFERENCE |
+                              SSL_OP_IGNORE_UNEXPECTED_EOF);
+    // 空闲连接不占用读写缓冲区
+    SSL_CTX_set_mode(ctx_, SSL_MODE_RELEASE_BUFFERS);
+#ifdef SSL_OP_ENABLE_KTLS
+    if (options.ktls) {
+        SSL_CTX_set_options(ctx_, SSL_OP_ENABLE_KTLS);
+    }
+#endif
+
+    if (SSL_CTX_use_certificate_chain_file(ctx_, options.certificate_file.c_str()) != 1 ||
+        SSL_CTX_use_PrivateKey_file(ctx_, options.private_key_file.c_str(), SSL_FILETYPE_PEM) != 1 ||
+        SSL_CTX_check_private_key(ctx_) != 1) {
+        const auto error = last_error();
+        SSL_CTX_free(ctx_);
+        throw std::runtime_error("加载TLS证书失败: " + error);
+    }
+
+    // 有状态恢复：会话缓存在所有IO线程之间共享，过期的会话由OpenSSL定期清理
+    SSL_CTX_set_session_cache_mode(ctx_, SSL_SESS_CACHE_SERVER);
+    SSL_CTX_sess_set_cache_size(ctx_, static_cast<long>(options.session_cache_size));
+    SSL_CTX_set_timeout(ctx_, static_cast<long>(options.session_timeout.count()));
+    SSL_CTX_set_session_id_context(ctx_, session_id_context, sizeof(session_id_context));
+
+    if (options.session_tickets) {
+        // TLS 1.3默认每次握手发送两张票据，一张就足以恢复下一次连接
+        SSL_CTX_set_num_tickets(ctx_, 1);
+        SSL_CTX_set_app_data(ctx_, this);
+        SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx_, &Context::ticket_key_callback);
+    } else {
+        SSL_CTX_set_options(ctx_, SSL_OP_NO_TICKET);
+    }
+
+    SSL_CTX_set_alpn_select_cb(ctx_, &Context::select_alpn, this);
+}
+
+Context::~Context() {
+    SSL_CTX_free(ctx_);
+}
+
+int Context::select_alpn(SSL*, const unsigned char** out, unsigned char* out_length,
+                         const unsigned char* in, unsigned int in_length, void* arg) {
+    const auto* self = static_cast<const Context*>(arg);
+    const auto* protocols = self->http2_ ? alpn_h2 : alpn_http11;
+    const auto size = self->http2_ ? sizeof(alpn_h2) : sizeof(alpn_http11);
+    unsigned char* selected = nullptr;
+    if (SSL_select_next_proto(&selected, out_length, protocols, static_cast<unsigned int>(size),
+                              in, in_length) != OPENSSL_NPN_NEGOTIATED) {
+        // 客户端只支持其他协议时不选择，连接按HTTP/1.1处理
+        return SSL_TLSEXT_ERR_NOACK;
+    }
+    *out = selected;
+    return SSL_TLSEXT_ERR_OK;
+}
+
+int Context::ticket_key_callback(SSL* ssl, unsigned char* name, unsigned char* iv,
+                                 EVP_CIPHER_CTX* cipher, EVP_MAC_CTX* mac, int encrypt) {
+    auto* self = static_cast<Context*>(SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)));
+
+    TicketKey key;
+    int result = 1;
+    if (encrypt) {
+        key = self->current_ticket_key();
+        if (RAND_bytes(iv, EVP_CIPHER_get_iv_length(EVP_aes_256_cbc())) != 1) {
+            return -1;
+        }
+        std::memcpy(name, key.name.data(), key.name.size());
+    } else {
+        const auto found = self->find_ticket_key(name);
+        if (!found) {
+            // 密钥已经淘汰，进行完整握手
+            return 0;
+        }
+        key = found->first;
+        result = found->second ? 1 : 2;
+    }
+
+    OSSL_PARAM params[] = {
+        OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, key.hmac_key.data(), key.hmac_key.size()),
+        OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, const_cast<char*>("SHA256"), 0),
+        OSSL_PARAM_construct_end()
+    };
+    if (EVP_MAC_CTX_set_params(mac, params) != 1) {
+        return -1;
+    }
+    const int ok = encrypt
+        ? EVP_EncryptInit_ex(cipher, EVP_aes_256_cbc(), nullptr, key.aes_key.data(), iv)
+        : EVP_DecryptInit_ex(cipher, EVP_aes_256_cbc(), nullptr, key.aes_key.data(), iv);
+    return ok == 1 ? result : -1;
+}
+
+Context::TicketKey Context::current_ticket_key() {
+    const auto now = std::chrono::steady_clock::now();
+    {
+        std::shared_lock<std::shared_mutex> lock(ticket_mutex_);
+        if (now - ticket_key_created_ < ticket_key_lifetime_) {
+            return ticket_keys_[0];
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(ticket_mutex_);
+    if (now - ticket_key_created_ >= ticket_key_lifetime_) {
+        ticket_keys_[1] = ticket_keys_[0];
+        ticket_keys_[0] = make_ticket_key();
+        ticket_key_created_ = now;
+        LOG_DEBUG("更换TLS会话票据密钥");
+    }
+    return ticket_keys_[0];
+}
+
+std::optional<std::pair<Context::TicketKey, bool>> Context::find_ticket_key(const unsigned char* name) {
+    std::shared_lock<std::shared_mutex> lock(ticket_mutex_);
+    for (size_t i = 0; i < ticket_keys_.size(); ++i) {
+        if (std::memcmp(ticket_keys_[i].name.data(), name, ticket_keys_[i].name.size()) == 0) {
+            return std::make_pair(ticket_keys_[i], i == 0);
+        }
+    }
+    return std::nullopt;
+}
+
+Context::TicketKey Context::make_ticket_key() {
+    TicketKey key;
+    if (RAND_bytes(key.name.data(), static_cast<int>(key.name.size())) != 1 ||
+        RAND_bytes(key.aes_key.data(), static_cast<int>(key.aes_key.size())) != 1 ||
+        RAND_bytes(key.hmac_key.data(), static_cast<int>(key.hmac_key.size())) != 1) {
+        throw std::runtime_error("生成TLS会话票据密钥失败");
+    }
+    return key;
+}
+
+} // namespace tls
+} // namespace hsmm
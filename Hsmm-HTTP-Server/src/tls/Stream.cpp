@@ -0,0 +1,88 @@
+#include "tls/Stream.hpp"
+#include "utils/Metrics.hpp"
+#include <boost/asio/ssl/error.hpp>
+#include <cerrno>
+
+namespace hsmm {
+namespace tls {
+
+Stream::Stream(const Context& context, socket_type& socket)
+    : ssl_(SSL_new(context.native_handle()))
+    , socket_(socket) {
+    if (!ssl_) {
+        throw std::bad_alloc();
+    }
+    // OpenSSL直接读写socket，必须是非阻塞的；Asio只用来等待就绪
+    boost::system::error_code ec;
+    socket_.native_non_blocking(true, ec);
+    SSL_set_fd(ssl_, socket_.native_handle());
+    SSL_set_accept_state(ssl_);
+}
+
+Stream::~Stream() {
+    SSL_free(ssl_);
+}
+
+std::string_view Stream::alpn() const noexcept {
+    const unsigned char* protocol = nullptr;
+    unsigned int length = 0;
+    SSL_get0_alpn_selected(ssl_, &protocol, &length);
+    return protocol ? std::string_view(reinterpret_cast<const char*>(protocol), length) : std::string_view();
+}
+
+void Stream::shutdown() noexcept {
+    // 致命错误之后不能再发送close_notify；发送失败（缓冲区满）也不等待
+    if (failed_ || !SSL_is_init_finished(ssl_)) {
+        return;
+    }
+    ERR_clear_error();
+    SSL_shutdown(ssl_);
+}
+
+int Stream::handshake_step() noexcept {
+    const auto start = utils::Metrics::now_ns();
+    ERR_clear_error();
+    const int ret = SSL_do_handshake(ssl_);
+    handshake_ns_ += utils::Metrics::now_ns() - start;
+    return ret == 1 ? SSL_ERROR_NONE : SSL_get_error(ssl_, ret);
+}
+
+void Stream::handshake_done() noexcept {
+#ifndef OPENSSL_NO_KTLS
+    ktls_send_ = BIO_get_ktls_send(SSL_get_wbio(ssl_));
+#endif
+    utils::Metrics::add(utils::Counter::tls_handshakes);
+    if (SSL_session_reused(ssl_)) {
+        utils::Metrics::add(utils::Counter::tls_resumed);
+    }
+    if (ktls_send_) {
+        utils::Metrics::add(utils::Counter::tls_ktls);
+    }
+    utils::Metrics::record(utils::Timer::tls_handshake, handshake_ns_);
+}
+
+boost::system::error_code Stream::error(int status) noexcept {
+    switch (status) {
+    case SSL_ERROR_ZERO_RETURN:
+        // 对端发送了close_notify，或者在没有close_notify的情况下关闭了连接
+        return boost::asio::error::eof;
+    case SSL_ERROR_SYSCALL: {
+        failed_ = true;
+        const int code = errno;
+        if (const auto error = ERR_get_error(); error != 0) {
+            return boost::system::error_code(static_cast<int>(error), boost::asio::error::get_ssl_category());
+        }
+        return code != 0 ? boost::system::error_code(code, boost::system::system_category())
+                         : boost::system::error_code(boost::asio::error::eof);
+    }
+    default:
+        failed_ = true;
+        if (!SSL_is_init_finished(ssl_)) {
+            utils::Metrics::add(utils::Counter::tls_handshake_errors);
+        }
+        return boost::system::error_code(static_cast<int>(ERR_get_error()), boost::asio::error::get_ssl_category());
+    }
+}
+
+} // namespace tls
+} // namespace hsmm
@@ -0,0 +1,98 @@
+#include "utils/CpuAffinity.hpp"
+#include <charconv>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace hsmm {
+namespace utils {
+
+namespace {
+    int parse_cpu(std::string_view text, std::string_view list) {
+        int cpu = -1;
+        const auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), cpu);
+        if (ec != std::errc() || end != text.data() + text.size() || cpu < 0) {
+            throw std::invalid_argument("CPU列表格式错误: " + std::string(list));
+        }
+        return cpu;
+    }
+}
+
+std::vector<int> parse_cpu_list(std::string_view list) {
+    std::vector<int> cpus;
+    while (!list.empty()) {
+        const auto comma = list.find(',');
+        const auto item = list.substr(0, comma);
+        const auto dash = item.find('-');
+        const int first = parse_cpu(item.substr(0, dash), list);
+        const int last = dash == std::string_view::npos ? first : parse_cpu(item.substr(dash + 1), list);
+        if (last < first) {
+            throw std::invalid_argument("CPU列表格式错误: " + std::string(list));
+        }
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+        list = comma == std::string_view::npos ? std::string_view() : list.substr(comma + 1);
+    }
+    return cpus;
+}
+
+bool pin_current_thread(int cpu) noexcept {
+#ifdef __linux__
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+int numa_node_of_cpu(int cpu) noexcept {
+#ifdef __linux__
+    // sysfs中每个CPU的目录下有一个指向所在节点的nodeN链接
+    std::error_code ec;
+    const std::filesystem::path dir("/sys/devices/system/cpu/cpu" + std::to_string(cpu));
+    for (std::filesystem::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) {
+        const auto name = it->path().filename().string();
+        int node = -1;
+        if (name.size() > 4 && name.compare(0, 4, "node") == 0 &&
+            std::from_chars(name.data() + 4, name.data() + name.size(), node).ec == std::errc()) {
+            return node;
+        }
+    }
+#else
+    (void)cpu;
+#endif
+    return -1;
+}
+
+bool prefer_numa_node(int node) noexcept {
+#ifdef __linux__
+    constexpr int bits = 8 * sizeof(unsigned long);
+    unsigned long mask[4] = {};
+    if (node < 0 || node >= bits * 4) {
+        return false;
+    }
+    mask[node / bits] = 1UL << (node % bits);
+    // 内核只使用maxnode - 1位
+    return syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, static_cast<unsigned long>(bits * 4 + 1)) == 0;
+#else
+    (void)node;
+    return false;
+#endif
+}
+
+} // namespace utils
+} // namespace hsmm
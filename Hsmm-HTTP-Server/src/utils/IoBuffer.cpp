@@ -0,0 +1,249 @@
+#include "utils/IoBuffer.hpp"
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <utility>
+
+namespace hsmm {
+namespace utils {
+
+namespace {
+    // 每个线程最多缓存的空闲内存块（共16MB），超出部分直接释放
+    constexpr size_t max_cached_slabs = 1024;
+
+    /**
+     * @brief 线程本地的内存块池
+     *
+     * 连接在哪个线程上释放内存块，就归还到哪个线程的池中，不需要任何锁
+     */
+    class SlabPool {
+    public:
+        static SlabPool& local() {
+            thread_local SlabPool pool;
+            return pool;
+        }
+
+        char* acquire() {
+            if (free_.empty()) {
+                return static_cast<char*>(::operator new(IoBuffer::slab_size));
+            }
+            auto* slab = free_.back();
+            free_.pop_back();
+            return slab;
+        }
+
+        void recycle(char* slab) noexcept {
+            if (free_.size() < max_cached_slabs) {
+                free_.push_back(slab);
+            } else {
+                ::operator delete(slab);
+            }
+        }
+
+        void preallocate(size_t count) {
+            while (free_.size() < std::min(count, max_cached_slabs)) {
+                auto* slab = static_cast<char*>(::operator new(IoBuffer::slab_size));
+                std::memset(slab, 0, IoBuffer::slab_size);
+                free_.push_back(slab);
+            }
+        }
+
+        ~SlabPool() {
+            for (auto* slab : free_) {
+                ::operator delete(slab);
+            }
+        }
+
+    private:
+        SlabPool() {
+            // 预留空闲列表容量，归还内存块时不会触发扩容
+            free_.reserve(max_cached_slabs);
+        }
+
+        std::vector<char*> free_;
+    };
+}
+
+IoBuffer::~IoBuffer() {
+    clear();
+}
+
+IoBuffer::IoBuffer(IoBuffer&& other) noexcept
+    : blocks_(std::move(other.blocks_))
+    , write_(std::exchange(other.write_, 0))
+    , size_(std::exchange(other.size_, 0)) {
+    other.blocks_.clear();
+}
+
+IoBuffer& IoBuffer::operator=(IoBuffer&& other) noexcept {
+    if (this != &other) {
+        clear();
+        blocks_ = std::move(other.blocks_);
+        write_ = std::exchange(other.write_, 0);
+        size_ = std::exchange(other.size_, 0);
+        other.blocks_.clear();
+    }
+    return *this;
+}
+
+void IoBuffer::preallocate(size_t count) {
+    SlabPool::local().preallocate(count);
+}
+
+IoBuffer::Block IoBuffer::allocate(size_t capacity) {
+    if (capacity <= slab_size) {
+        return Block{SlabPool::local().acquire(), slab_size, 0, 0};
+    }
+    return Block{static_cast<char*>(::operator new(capacity)), capacity, 0, 0};
+}
+
+void IoBuffer::release(const Block& block) noexcept {
+    if (block.capacity == slab_size) {
+        SlabPool::local().recycle(block.data);
+    } else {
+        ::operator delete(block.data);
+    }
+}
+
+std::span<char> IoBuffer::prepare(size_t min_size) {
+    if (!blocks_.empty()) {
+        auto& block = blocks_[write_];
+        if (block.capacity - block.end >= min_size) {
+            return {block.data + block.end, block.capacity - block.end};
+        }
+        if (block.begin == block.end) {
+            // 正在写入的内存块还没有数据，直接换成足够大的
+            release(block);
+            block = allocate(std::max(min_size, slab_size));
+            return {block.data, block.capacity};
+        }
+        if (write_ + 1 < blocks_.size() && blocks_[write_ + 1].capacity >= min_size) {
+            // 使用prepare_buffers预留的内存块
+            auto& next = blocks_[++write_];
+            return {next.data, next.capacity};
+        }
+    }
+
+    // 插入到预留的内存块之前，保持write_之后都是空内存块
+    const auto position = blocks_.empty() ? 0 : write_ + 1;
+    blocks_.insert(blocks_.begin() + static_cast<std::ptrdiff_t>(position), allocate(std::max(min_size, slab_size)));
+    write_ = position;
+    return {blocks_[write_].data, blocks_[write_].capacity};
+}
+
+IoBuffer::mutable_buffers_type IoBuffer::prepare_buffers(size_t length) {
+    size_t available = 0;
+    for (size_t i = write_; i < blocks_.size(); ++i) {
+        available += blocks_[i].capacity - blocks_[i].end;
+    }
+    while (available < length || blocks_.empty()) {
+        blocks_.push_back(allocate(slab_size));
+        available += slab_size;
+    }
+    if (blocks_[write_].end == blocks_[write_].capacity && write_ + 1 < blocks_.size()) {
+        // 正在写入的内存块已经写满，序列从下一个内存块开始，第一个缓冲区不为空
+        ++write_;
+    }
+    return mutable_buffers_type(blocks_.data() + write_, blocks_.data() + blocks_.size());
+}
+
+void IoBuffer::commit(size_t length) noexcept {
+    size_ += length;
+    while (length > 0) {
+        auto& block = blocks_[write_];
+        const auto n = std::min(length, block.capacity - block.end);
+        block.end += n;
+        length -= n;
+        if (length > 0) {
+            ++write_;
+        }
+    }
+}
+
+std::span<char> IoBuffer::front() noexcept {
+    if (blocks_.empty()) {
+        return {};
+    }
+    auto& block = blocks_.front();
+    return {block.data + block.begin, block.end - block.begin};
+}
+
+std::span<const char> IoBuffer::front() const noexcept {
+    if (blocks_.empty()) {
+        return {};
+    }
+    const auto& block = blocks_.front();
+    return {block.data + block.begin, block.end - block.begin};
+}
+
+std::span<char> IoBuffer::linearize() {
+    if (front().size() == size_) {
+        return front();
+    }
+
+    auto merged = allocate(2 * size_);
+    for (size_t i = 0; i <= write_; ++i) {
+        const auto& block = blocks_[i];
+        std::memcpy(merged.data + merged.end, block.data + block.begin, block.end - block.begin);
+        merged.end += block.end - block.begin;
+    }
+    for (const auto& block : blocks_) {
+        release(block);
+    }
+    blocks_.assign(1, merged);
+    write_ = 0;
+    return front();
+}
+
+void IoBuffer::consume(size_t length) noexcept {
+    size_ -= length;
+    while (length > 0) {
+        auto& block = blocks_.front();
+        const auto n = std::min(length, block.end - block.begin);
+        block.begin += n;
+        length -= n;
+        if (block.begin < block.end) {
+            break;
+        }
+
+        if (write_ > 0 || block.capacity != slab_size) {
+            // 用完的内存块立即归还，大内存块也不长期保留
+            release(block);
+            blocks_.erase(blocks_.begin());
+            write_ = write_ > 0 ? write_ - 1 : 0;
+        } else {
+            // 正在写入的普通内存块留下来，下一次读取从头开始
+            block.begin = block.end = 0;
+        }
+    }
+}
+
+void IoBuffer::splice(IoBuffer& other) {
+    if (other.empty()) {
+        return;
+    }
+
+    // 丢弃预留的空内存块，正在写入的内存块没有数据时也丢弃
+    while (blocks_.size() > write_ + 1 || (!blocks_.empty() && blocks_.back().begin == blocks_.back().end)) {
+        release(blocks_.back());
+        blocks_.pop_back();
+    }
+    const auto moved = static_cast<std::ptrdiff_t>(other.write_ + 1);
+    blocks_.insert(blocks_.end(), other.blocks_.begin(), other.blocks_.begin() + moved);
+    other.blocks_.erase(other.blocks_.begin(), other.blocks_.begin() + moved);
+    write_ = blocks_.size() - 1;
+    size_ += std::exchange(other.size_, 0);
+    other.write_ = 0;
+}
+
+void IoBuffer::clear() noexcept {
+    for (const auto& block : blocks_) {
+        release(block);
+    }
+    blocks_.clear();
+    write_ = 0;
+    size_ = 0;
+}
+
+} // namespace utils
+} // namespace hsmm
@@ -0,0 +1,173 @@
+#include "utils/Metrics.hpp"
+#include <cstdio>
+
+namespace hsmm {
+namespace utils {
+
+namespace {
+    struct MetricInfo {
+        std::string_view name;
+        std::string_view help;
+    };
+
+    constexpr std::array<MetricInfo, static_cast<size_t>(Counter::count)> counter_info{{
+        {"hsmm_connections_accepted_total", "已接受的连接数"},
+        {"hsmm_requests_total", "已处理的请求数"},
+        {"hsmm_received_bytes_total", "从客户端读取的字节数"},
+        {"hsmm_sent_bytes_total", "发送给客户端的字节数"},
+        {"hsmm_responses_1xx_total", "1xx响应数"},
+        {"hsmm_responses_2xx_total", "2xx响应数"},
+        {"hsmm_responses_3xx_total", "3xx响应数"},
+        {"hsmm_responses_4xx_total", "4xx响应数"},
+        {"hsmm_responses_5xx_total", "5xx响应数"},
+        {"hsmm_cache_hits_total", "响应缓存命中数"},
+        {"hsmm_cache_stale_total", "返回过期缓存条目并在后台刷新的次数"},
+        {"hsmm_cache_misses_total", "响应缓存未命中数"},
+        {"hsmm_cache_coalesced_total", "合并到进行中的处理函数调用的未命中数"},
+        {"hsmm_cache_passes_total", "因最近的响应不能缓存而直接调用处理函数的请求数"},
+        {"hsmm_connections_rejected_total", "因超出客户端连接速率被关闭的连接数"},
+        {"hsmm_requests_rate_limited_total", "因超出客户端请求速率返回429的请求数"},
+        {"hsmm_requests_shed_total", "因服务器过载返回503的请求数"},
+        {"hsmm_handler_rejected_total", "因处理函数线程池队列已满返回503的请求数"},
+        {"hsmm_tls_handshakes_total", "完成的TLS握手数"},
+        {"hsmm_tls_resumed_total", "恢复了会话的TLS握手数"},
+        {"hsmm_tls_handshake_errors_total", "因协议错误失败的TLS握手数"},
+        {"hsmm_tls_ktls_total", "使用内核TLS发送的连接数"},
+    }};
+
+    constexpr std::array<MetricInfo, static_cast<size_t>(Timer::count)> timer_info{{
+        {"hsmm_request_parse_seconds", "解析请求头的耗时"},
+        {"hsmm_request_handler_seconds", "执行处理函数的耗时"},
+        {"hsmm_response_write_seconds", "发送响应的耗时"},
+        {"hsmm_handler_queue_seconds", "在处理函数线程池中排队的耗时"},
+        {"hsmm_tls_handshake_seconds", "TLS握手的CPU耗时（不含等待网络）"},
+    }};
+
+    // 导出的直方图边界（秒），直方图内部的精度更高，导出时按边界合并
+    constexpr std::array<double, 20> bucket_bounds{
+        1e-6, 2.5e-6, 5e-6, 1e-5, 2.5e-5, 5e-5, 1e-4, 2.5e-4, 5e-4, 1e-3,
+        2.5e-3, 5e-3, 1e-2, 2.5e-2, 5e-2, 0.1, 0.25, 0.5, 1.0, 2.5
+    };
+
+    constexpr std::array<std::string_view, 4> quantile_labels{"0.5", "0.9", "0.99", "0.999"};
+    constexpr std::array<double, 4> quantiles{0.5, 0.9, 0.99, 0.999};
+
+    // 辅助函数：按Prometheus文本格式写出数值
+    void append_number(std::string& out, double value) {
+        char buffer[32];
+        const auto length = std::snprintf(buffer, sizeof(buffer), "%.9g", value);
+        out.append(buffer, static_cast<size_t>(length));
+    }
+
+    void append_number(std::string& out, std::uint64_t value) {
+        out.append(std::to_string(value));
+    }
+
+    void append_header(std::string& out, std::string_view name, std::string_view help, std::string_view type) {
+        out.append("# HELP ").append(name).append(" ").append(help).append("\n");
+        out.append("# TYPE ").append(name).append(" ").append(type).append("\n");
+    }
+}
+
+Metrics& Metrics::instance() {
+    static Metrics instance;
+    return instance;
+}
+
+Metrics::Shard* Metrics::register_shard() {
+    auto shard = std::make_unique<Shard>();
+    auto* result = shard.get();
+    std::lock_guard<std::mutex> lock(mutex_);
+    shards_.push_back(std::move(shard));
+    return result;
+}
+
+void Metrics::render_gauge(std::string& out, std::string_view name, std::string_view help, double value) {
+    append_header(out, name, help, "gauge");
+    out.append(name).append(" ");
+    append_number(out, value);
+    out.append("\n");
+}
+
+void Metrics::render(std::string& out) const {
+    std::array<std::uint64_t, static_cast<size_t>(Counter::count)> counters{};
+    std::vector<std::array<std::uint64_t, LatencyHistogram::bucket_count>> buckets(static_cast<size_t>(Timer::count));
+    std::array<std::uint64_t, static_cast<size_t>(Timer::count)> sums{};
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& shard : shards_) {
+            for (size_t i = 0; i < counters.size(); ++i) {
+                counters[i] += shard->counters[i].load(std::memory_order_relaxed);
+            }
+            for (size_t i = 0; i < sums.size(); ++i) {
+                shard->timers[i].merge_into(buckets[i], sums[i]);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < counters.size(); ++i) {
+        append_header(out, counter_info[i].name, counter_info[i].help, "counter");
+        out.append(counter_info[i].name).append(" ");
+        append_number(out, counters[i]);
+        out.append("\n");
+    }
+
+    for (size_t i = 0; i < sums.size(); ++i) {
+        const auto name = timer_info[i].name;
+        const auto& histogram = buckets[i];
+
+        std::uint64_t total = 0;
+        for (const auto count : histogram) total += count;
+
+        // 累积分布：每个内部桶计入上界不小于其最大值的第一个导出边界
+        append_header(out, name, timer_info[i].help, "histogram");
+        std::uint64_t cumulative = 0;
+        size_t bucket = 0;
+        for (const auto bound : bucket_bounds) {
+            const auto bound_ns = static_cast<std::uint64_t>(bound * 1e9);
+            while (bucket < histogram.size() && LatencyHistogram::bucket_upper(bucket) <= bound_ns) {
+                cumulative += histogram[bucket++];
+            }
+            out.append(name).append("_bucket{le=\"");
+            append_number(out, bound);
+            out.append("\"} ");
+            append_number(out, cumulative);
+            out.append("\n");
+        }
+        out.append(name).append("_bucket{le=\"+Inf\"} ");
+        append_number(out, total);
+        out.append("\n");
+        out.append(name).append("_sum ");
+        append_number(out, static_cast<double>(sums[i]) / 1e9);
+        out.append("\n");
+        out.append(name).append("_count ");
+        append_number(out, total);
+        out.append("\n");
+
+        // 直接由内部直方图计算的分位数，精度高于按导出边界估算
+        std::string quantile_name(name);
+        quantile_name.insert(quantile_name.size() - std::string_view("_seconds").size(), "_quantile");
+        append_header(out, quantile_name, std::string(timer_info[i].help) + "的分位数", "gauge");
+        for (size_t q = 0; q < quantiles.size(); ++q) {
+            std::uint64_t value = 0;
+            if (total > 0) {
+                const auto rank = static_cast<std::uint64_t>(quantiles[q] * static_cast<double>(total - 1)) + 1;
+                std::uint64_t seen = 0;
+                for (size_t b = 0; b < histogram.size(); ++b) {
+                    seen += histogram[b];
+                    if (seen >= rank) {
+                        value = LatencyHistogram::bucket_upper(b);
+                        break;
+                    }
+                }
+            }
+            out.append(quantile_name).append("{quantile=\"").append(quantile_labels[q]).append("\"} ");
+            append_number(out, static_cast<double>(value) / 1e9);
+            out.append("\n");
+        }
+    }
+}
+
+} // namespace utils
+} // namespace hsmm
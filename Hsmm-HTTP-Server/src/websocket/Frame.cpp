@@ -0,0 +1,278 @@
+#include "websocket/Frame.hpp"
+#include <cstring>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// 没有用-mavx2编译时，在x86-64上单独为AVX2编译去掩码的循环，运行时按CPU选择
+#if !defined(__AVX2__) && defined(__x86_64__) && defined(__GNUC__)
+#define HSMM_WS_AVX2_DISPATCH 1
+#endif
+
+namespace hsmm {
+namespace websocket {
+
+namespace {
+    // 握手时附加在Sec-WebSocket-Key之后的GUID（RFC 6455 1.3）
+    constexpr std::string_view handshake_guid = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+    std::uint32_t rotl(std::uint32_t value, int bits) noexcept {
+        return (value << bits) | (value >> (32 - bits));
+    }
+
+    // 只用于计算握手响应，输入很短，不需要流式接口
+    std::array<std::uint8_t, 20> sha1(std::string_view input) {
+        std::uint32_t h[5] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0};
+
+        std::string message(input);
+        const std::uint64_t bit_length = static_cast<std::uint64_t>(input.size()) * 8;
+        message.push_back(static_cast<char>(0x80));
+        while (message.size() % 64 != 56) {
+            message.push_back('\0');
+        }
+        for (int i = 7; i >= 0; --i) {
+            message.push_back(static_cast<char>(bit_length >> (i * 8)));
+        }
+
+        const auto* bytes = reinterpret_cast<const std::uint8_t*>(message.data());
+        for (std::size_t chunk = 0; chunk < message.size(); chunk += 64) {
+            std::uint32_t w[80];
+            for (int i = 0; i < 16; ++i) {
+                const auto* p = bytes + chunk + i * 4;
+                w[i] = (std::uint32_t{p[0]} << 24) | (std::uint32_t{p[1]} << 16) | (std::uint32_t{p[2]} << 8) | p[3];
+            }
+            for (int i = 16; i < 80; ++i) {
+                w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+            }
+
+            auto a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+            for (int i = 0; i < 80; ++i) {
+                std::uint32_t f, k;
+                if (i < 20) {
+                    f = (b & c) | (~b & d);
+                    k = 0x5a827999;
+                } else if (i < 40) {
+                    f = b ^ c ^ d;
+                    k = 0x6ed9eba1;
+                } else if (i < 60) {
+                    f = (b & c) | (b & d) | (c & d);
+                    k = 0x8f1bbcdc;
+                } else {
+                    f = b ^ c ^ d;
+                    k = 0xca62c1d6;
+                }
+                const auto temp = rotl(a, 5) + f + e + k + w[i];
+                e = d;
+                d = c;
+                c = rotl(b, 30);
+                b = a;
+                a = temp;
+            }
+            h[0] += a;
+            h[1] += b;
+            h[2] += c;
+            h[3] += d;
+            h[4] += e;
+        }
+
+        std::array<std::uint8_t, 20> digest;
+        for (int i = 0; i < 5; ++i) {
+            digest[i * 4] = static_cast<std::uint8_t>(h[i] >> 24);
+            digest[i * 4 + 1] = static_cast<std::uint8_t>(h[i] >> 16);
+            digest[i * 4 + 2] = static_cast<std::uint8_t>(h[i] >> 8);
+            digest[i * 4 + 3] = static_cast<std::uint8_t>(h[i]);
+        }
+        return digest;
+    }
+
+    std::string base64(std::span<const std::uint8_t> data) {
+        constexpr std::string_view alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        std::string out;
+        out.reserve((data.size() + 2) / 3 * 4);
+        std::size_t i = 0;
+        for (; i + 3 <= data.size(); i += 3) {
+            const std::uint32_t v = (std::uint32_t{data[i]} << 16) | (std::uint32_t{data[i + 1]} << 8) | data[i + 2];
+            out.push_back(alphabet[v >> 18]);
+            out.push_back(alphabet[(v >> 12) & 0x3f]);
+            out.push_back(alphabet[(v >> 6) & 0x3f]);
+            out.push_back(alphabet[v & 0x3f]);
+        }
+        if (i < data.size()) {
+            std::uint32_t v = std::uint32_t{data[i]} << 16;
+            if (i + 1 < data.size()) v |= std::uint32_t{data[i + 1]} << 8;
+            out.push_back(alphabet[v >> 18]);
+            out.push_back(alphabet[(v >> 12) & 0x3f]);
+            out.push_back(i + 1 < data.size() ? alphabet[(v >> 6) & 0x3f] : '=');
+            out.push_back('=');
+        }
+        return out;
+    }
+
+#if defined(__AVX2__) || defined(HSMM_WS_AVX2_DISPATCH)
+    // 每次处理32字节，返回处理过的字节数
+#if defined(HSMM_WS_AVX2_DISPATCH)
+    __attribute__((target("avx2")))
+#endif
+    std::size_t unmask_avx2(char* p, std::size_t size, std::uint64_t key64) noexcept {
+        const __m256i key256 = _mm256_set1_epi64x(static_cast<long long>(key64));
+        std::size_t i = 0;
+        for (; i + 32 <= size; i += 32) {
+            const auto value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(p + i), _mm256_xor_si256(value, key256));
+        }
+        return i;
+    }
+#endif
+}
+
+bool parse_frame_header(std::span<const char> data, FrameHeader& header) noexcept {
+    if (data.size() < 2) {
+        return false;
+    }
+    const auto* bytes = reinterpret_cast<const std::uint8_t*>(data.data());
+    header.fin = (bytes[0] & 0x80) != 0;
+    header.reserved = static_cast<std::uint8_t>((bytes[0] >> 4) & 0x7);
+    header.opcode = static_cast<Opcode>(bytes[0] & 0x0f);
+    header.masked = (bytes[1] & 0x80) != 0;
+
+    std::size_t size = 2;
+    std::uint64_t length = bytes[1] & 0x7f;
+    if (length == 126) {
+        size += 2;
+        if (data.size() < size) return false;
+        length = (std::uint64_t{bytes[2]} << 8) | bytes[3];
+    } else if (length == 127) {
+        size += 8;
+        if (data.size() < size) return false;
+        length = 0;
+        for (std::size_t i = 2; i < 10; ++i) {
+            length = (length << 8) | bytes[i];
+        }
+    }
+    if (header.masked) {
+        if (data.size() < size + 4) return false;
+        std::memcpy(header.mask.data(), bytes + size, 4);
+        size += 4;
+    } else {
+        header.mask = {};
+    }
+    header.length = length;
+    header.size = size;
+    return true;
+}
+
+void write_frame_header(std::string& out, Opcode opcode, bool fin, std::uint64_t length) {
+    out.push_back(static_cast<char>((fin ? 0x80 : 0) | static_cast<std::uint8_t>(opcode)));
+    if (length < 126) {
+        out.push_back(static_cast<char>(length));
+    } else if (length <= 0xffff) {
+        out.push_back(static_cast<char>(126));
+        out.push_back(static_cast<char>(length >> 8));
+        out.push_back(static_cast<char>(length));
+    } else {
+        out.push_back(static_cast<char>(127));
+        for (int i = 7; i >= 0; --i) {
+            out.push_back(static_cast<char>(length >> (i * 8)));
+        }
+    }
+}
+
+void unmask(std::span<char> data, const std::array<std::uint8_t, 4>& mask, std::uint64_t offset) noexcept {
+    // 按偏移旋转掩码，使key的第0个字节对应data[0]；下面每一步都前进4的倍数，相位保持不变
+    std::array<std::uint8_t, 8> key;
+    for (std::size_t i = 0; i < key.size(); ++i) {
+        key[i] = mask[(offset + i) & 3];
+    }
+    std::uint64_t key64;
+    std::memcpy(&key64, key.data(), sizeof(key64));
+
+    auto* p = data.data();
+    const auto size = data.size();
+    std::size_t i = 0;
+#if defined(__AVX2__)
+    i = unmask_avx2(p, size, key64);
+#elif defined(HSMM_WS_AVX2_DISPATCH)
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    if (has_avx2 && size >= 32) {
+        i = unmask_avx2(p, size, key64);
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i key128 = _mm_set1_epi64x(static_cast<long long>(key64));
+    for (; i + 16 <= size; i += 16) {
+        const auto value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p + i), _mm_xor_si128(value, key128));
+    }
+#endif
+    for (; i + 8 <= size; i += 8) {
+        std::uint64_t value;
+        std::memcpy(&value, p + i, sizeof(value));
+        value ^= key64;
+        std::memcpy(p + i, &value, sizeof(value));
+    }
+    for (; i < size; ++i) {
+        p[i] = static_cast<char>(p[i] ^ key[i & 3]);
+    }
+}
+
+bool valid_utf8(std::string_view data) noexcept {
+    const auto* p = reinterpret_cast<const std::uint8_t*>(data.data());
+    const auto* end = p + data.size();
+    while (p < end) {
+        // 连续的ASCII字符按8字节一组跳过
+        if (end - p >= 8) {
+            std::uint64_t word;
+            std::memcpy(&word, p, sizeof(word));
+            if ((word & 0x8080808080808080ull) == 0) {
+                p += 8;
+                continue;
+            }
+        }
+        const auto lead = *p;
+        if (lead < 0x80) {
+            ++p;
+            continue;
+        }
+
+        std::size_t count;
+        std::uint32_t code_point;
+        if (lead >= 0xc2 && lead <= 0xdf) {
+            count = 1;
+            code_point = lead & 0x1f;
+        } else if ((lead & 0xf0) == 0xe0) {
+            count = 2;
+            code_point = lead & 0x0f;
+        } else if (lead >= 0xf0 && lead <= 0xf4) {
+            count = 3;
+            code_point = lead & 0x07;
+        } else {
+            return false;
+        }
+        if (static_cast<std::size_t>(end - p) <= count) {
+            return false;
+        }
+        for (std::size_t i = 1; i <= count; ++i) {
+            if ((p[i] & 0xc0) != 0x80) {
+                return false;
+            }
+            code_point = (code_point << 6) | (p[i] & 0x3f);
+        }
+        // 拒绝过长编码、代理项和超出范围的码点
+        if ((count == 2 && (code_point < 0x800 || (code_point >= 0xd800 && code_point <= 0xdfff))) ||
+            (count == 3 && (code_point < 0x10000 || code_point > 0x10ffff))) {
+            return false;
+        }
+        p += count + 1;
+    }
+    return true;
+}
+
+std::string accept_key(std::string_view key) {
+    std::string input(key);
+    input.append(handshake_guid);
+    const auto digest = sha1(input);
+    return base64(digest);
+}
+
+} // namespace websocket
+} // namespace hsmm
@@ -0,0 +1,299 @@
+#include "websocket/Session.hpp"
+#include "http/Router.hpp"
+#include "utils/Logger.hpp"
+#include <algorithm>
+
+namespace hsmm {
+namespace websocket {
+
+namespace {
+    bool iequals(std::string_view a, std::string_view b) noexcept {
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+            return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+        });
+    }
+
+    std::string_view trim(std::string_view str) noexcept {
+        while (!str.empty() && (str.front() == ' ' || str.front() == '\t')) str.remove_prefix(1);
+        while (!str.empty() && (str.back() == ' ' || str.back() == '\t')) str.remove_suffix(1);
+        return str;
+    }
+
+    // 逗号分隔的列表中是否包含token
+    bool has_token(std::string_view list, std::string_view token) noexcept {
+        while (!list.empty()) {
+            const auto comma = std::min(list.find(','), list.size());
+            if (iequals(trim(list.substr(0, comma)), token)) {
+                return true;
+            }
+            list.remove_prefix(std::min(comma + 1, list.size()));
+        }
+        return false;
+    }
+
+    // Close帧中允许出现的状态码（RFC 6455 7.4）
+    bool valid_close_code(std::uint16_t code) noexcept {
+        return (code >= 1000 && code <= 1003) || (code >= 1007 && code <= 1011) || (code >= 3000 && code <= 4999);
+    }
+}
+
+std::optional<std::string> handshake(const http::HttpRequest& request, http::HttpResponse& response) {
+    const auto upgrade = request.headers.get(http::Header::upgrade);
+    const auto connection = request.headers.get(http::Header::connection);
+    const auto key = request.headers.get(http::Header::sec_websocket_key);
+    if (!upgrade || !has_token(*upgrade, "websocket")) {
+        // 普通的HTTP请求，告诉客户端需要升级
+        http::set_error_response(response, 426, "Upgrade Required");
+        response.add_header("Upgrade", "websocket");
+        return std::nullopt;
+    }
+    if (request.method != "GET" || request.has_body() || !connection || !has_token(*connection, "upgrade") ||
+        !key || trim(*key).size() != 24) {
+        http::set_error_response(response, 400, "Bad Request");
+        return std::nullopt;
+    }
+    if (const auto version = request.headers.get(http::Header::sec_websocket_version); !version || trim(*version) != "13") {
+        http::set_error_response(response, 426, "Upgrade Required");
+        response.add_header("Sec-WebSocket-Version", "13");
+        return std::nullopt;
+    }
+
+    std::string head("HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: ");
+    head.append(accept_key(trim(*key)));
+    head.append("\r\n\r\n");
+    return head;
+}
+
+Session::Session(std::shared_ptr<const Handler> handler, std::string uri, const WebSocketOptions& options, Socket::Wake wake)
+    : handler_(std::move(handler))
+    , options_(options)
+    , socket_(std::make_shared<Socket>(std::move(uri), options.max_queued_bytes, std::move(wake))) {
+}
+
+Session::~Session() {
+    finish();
+}
+
+void Session::open() {
+    if (!handler_->on_open) {
+        return;
+    }
+    try {
+        handler_->on_open(socket_);
+    }
+    catch (const std::exception& e) {
+        LOG_ERROR("WebSocket处理函数发生错误: " + std::string(e.what()));
+        fail(close_code::internal_error);
+    }
+}
+
+void Session::receive(std::span<char> data) {
+    while (!data.empty() && !done_) {
+        if (!in_frame_) {
+            // 帧头可能被拆在两次读取中，最长14字节，不完整时先保存下来
+            const auto buffered = header_buffer_.size();
+            std::span<const char> view(data.data(), data.size());
+            if (buffered > 0) {
+                header_buffer_.append(data.data(), std::min(max_frame_header_size - buffered, data.size()));
+                view = std::span<const char>(header_buffer_.data(), header_buffer_.size());
+            }
+            if (!parse_frame_header(view, frame_)) {
+                if (buffered == 0) {
+                    header_buffer_.assign(data.data(), data.size());
+                }
+                return;
+            }
+            data = data.subspan(frame_.size - buffered);
+            header_buffer_.clear();
+
+            if (!begin_frame()) {
+                return;
+            }
+            frame_offset_ = 0;
+            if (frame_.length == 0) {
+                // 空的最后一个分片仍然要使用message_中已经收到的数据
+                end_frame(in_message_ ? std::nullopt : std::optional<std::string_view>(std::string_view()));
+                continue;
+            }
+            in_frame_ = true;
+        }
+
+        const auto length = static_cast<size_t>(std::min<std::uint64_t>(frame_.length - frame_offset_, data.size()));
+        const auto chunk = data.first(length);
+        unmask(chunk, frame_.mask, frame_offset_);
+        // 不分片、完整在本次读取中的消息直接使用读缓冲区中的负载
+        const bool whole = frame_offset_ == 0 && length == frame_.length;
+        std::optional<std::string_view> direct;
+        if (is_control(frame_.opcode)) {
+            control_.append(chunk.data(), chunk.size());
+        } else if (whole && frame_.fin && !in_message_) {
+            direct = std::string_view(chunk.data(), chunk.size());
+        } else {
+            message_.append(chunk.data(), chunk.size());
+        }
+        frame_offset_ += length;
+        data = data.subspan(length);
+
+        if (frame_offset_ == frame_.length) {
+            in_frame_ = false;
+            end_frame(direct);
+        }
+    }
+}
+
+bool Session::begin_frame() {
+    // 没有协商扩展，RSV位必须为0；客户端发送的帧必须带掩码
+    if (frame_.reserved != 0 || !frame_.masked) {
+        fail(close_code::protocol_error);
+        return false;
+    }
+
+    switch (frame_.opcode) {
+    case Opcode::close:
+    case Opcode::ping:
+    case Opcode::pong:
+        if (!frame_.fin || frame_.length > max_control_payload) {
+            fail(close_code::protocol_error);
+            return false;
+        }
+        control_.clear();
+        return true;
+    case Opcode::continuation:
+        if (!in_message_) {
+            fail(close_code::protocol_error);
+            return false;
+        }
+        break;
+    case Opcode::text:
+    case Opcode::binary:
+        if (in_message_) {
+            fail(close_code::protocol_error);
+            return false;
+        }
+        message_binary_ = frame_.opcode == Opcode::binary;
+        break;
+    default:
+        fail(close_code::protocol_error);
+        return false;
+    }
+
+    if (frame_.length > options_.max_message_size - std::min(message_.size(), options_.max_message_size)) {
+        fail(close_code::message_too_big);
+        return false;
+    }
+    // 第一个分片开始一条消息，之后的数据都进入message_
+    if (!frame_.fin || frame_.opcode == Opcode::continuation) {
+        in_message_ = true;
+    }
+    return true;
+}
+
+void Session::end_frame(std::optional<std::string_view> direct) {
+    if (is_control(frame_.opcode)) {
+        handle_control();
+        return;
+    }
+    if (!frame_.fin) {
+        return;
+    }
+
+    const std::string_view message = direct ? *direct : std::string_view(message_);
+    if (!message_binary_ && !valid_utf8(message)) {
+        fail(close_code::invalid_payload);
+        return;
+    }
+    if (handler_->on_message) {
+        try {
+            handler_->on_message(socket_, message, message_binary_);
+        }
+        catch (const std::exception& e) {
+            LOG_ERROR("WebSocket处理函数发生错误: " + std::string(e.what()));
+            fail(close_code::internal_error);
+        }
+    }
+    in_message_ = false;
+    message_.clear();
+    if (message_.capacity() > 64 * 1024) {
+        // 连接可能长时间存在，不长期保留大消息的缓冲区
+        std::string().swap(message_);
+    }
+}
+
+void Session::handle_control() {
+    switch (frame_.opcode) {
+    case Opcode::ping:
+        send_control(Opcode::pong, control_);
+        break;
+    case Opcode::close: {
+        std::uint16_t code = close_code::no_status;
+        if (control_.size() == 1) {
+            fail(close_code::protocol_error);
+            return;
+        }
+        if (control_.size() >= 2) {
+            code = static_cast<std::uint16_t>((static_cast<std::uint8_t>(control_[0]) << 8) | static_cast<std::uint8_t>(control_[1]));
+            if (!valid_close_code(code) || !valid_utf8(std::string_view(control_).substr(2))) {
+                fail(close_code::protocol_error);
+                return;
+            }
+        }
+        close_code_ = code;
+        // 对端先发起关闭时回应同样的状态码；我们先发起时关闭握手到此完成
+        if (!socket_->close_sent()) {
+            if (code == close_code::no_status) {
+                auto frame = std::make_shared<std::string>();
+                write_frame_header(*frame, Opcode::close, true, 0);
+                socket_->enqueue(std::move(frame), true);
+            } else {
+                socket_->close(code);
+            }
+        }
+        done_ = true;
+        break;
+    }
+    default:
+        // 不需要回应pong，收到任何数据都会重置连接的空闲计时
+        break;
+    }
+}
+
+void Session::fail(std::uint16_t code) {
+    close_code_ = code;
+    socket_->close(code);
+    done_ = true;
+}
+
+void Session::send_control(Opcode opcode, std::string_view payload) {
+    auto frame = std::make_shared<std::string>();
+    write_frame_header(*frame, opcode, true, payload.size());
+    frame->append(payload);
+    socket_->enqueue(std::move(frame), false);
+}
+
+void Session::ping() {
+    send_control(Opcode::ping, {});
+}
+
+void Session::shutdown() {
+    socket_->close(close_code::going_away);
+}
+
+void Session::finish() noexcept {
+    if (finished_) {
+        return;
+    }
+    finished_ = true;
+    // 断开通知函数，解除连接和Socket之间的循环引用
+    socket_->detach();
+    if (handler_->on_close) {
+        try {
+            handler_->on_close(socket_, close_code_);
+        }
+        catch (const std::exception& e) {
+            LOG_ERROR("WebSocket处理函数发生错误: " + std::string(e.what()));
+        }
+    }
+}
+
+} // namespace websocket
+} // namespace hsmm
@@ -0,0 +1,147 @@
+#include "websocket/WebSocket.hpp"
+#include <algorithm>
+
+namespace hsmm {
+namespace websocket {
+
+SharedFrame make_frame(std::string_view payload, bool binary) {
+    auto frame = std::make_shared<std::string>();
+    frame->reserve(max_frame_header_size + payload.size());
+    write_frame_header(*frame, binary ? Opcode::binary : Opcode::text, true, payload.size());
+    frame->append(payload);
+    return frame;
+}
+
+Socket::Socket(std::string uri, size_t max_queued_bytes, Wake wake)
+    : uri_(std::move(uri))
+    , max_queued_bytes_(max_queued_bytes)
+    , wake_(std::move(wake)) {
+}
+
+bool Socket::send(SharedFrame frame) {
+    return enqueue(std::move(frame), false);
+}
+
+void Socket::close(std::uint16_t code, std::string_view reason) {
+    auto frame = std::make_shared<std::string>();
+    reason = reason.substr(0, max_control_payload - 2);
+    write_frame_header(*frame, Opcode::close, true, 2 + reason.size());
+    frame->push_back(static_cast<char>(code >> 8));
+    frame->push_back(static_cast<char>(code));
+    frame->append(reason);
+    enqueue(std::move(frame), true);
+}
+
+bool Socket::is_open() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return open_;
+}
+
+bool Socket::enqueue(SharedFrame frame, bool last) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!open_) {
+        return false;
+    }
+    if (last) {
+        open_ = false;
+        close_sent_ = true;
+    } else if (queued_bytes_ + frame->size() > max_queued_bytes_) {
+        // 客户端读取太慢：不再排队，由连接断开
+        open_ = false;
+        overflowed_ = true;
+        queue_.clear();
+        queued_bytes_ = 0;
+    }
+    if (!overflowed_) {
+        queued_bytes_ += frame->size();
+        queue_.push_back(std::move(frame));
+    }
+    if ((!wake_pending_ || overflowed_) && wake_) {
+        // wake_只投递，不会在这里回调take()，可以持有锁调用；
+        // 溢出时连接可能正阻塞在写操作上，也要通知它立即断开
+        wake_pending_ = true;
+        wake_();
+    }
+    return !overflowed_;
+}
+
+size_t Socket::take(std::vector<SharedFrame>& out, size_t max_frames) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto count = std::min(queue_.size(), max_frames);
+    for (size_t i = 0; i < count; ++i) {
+        queued_bytes_ -= queue_.front()->size();
+        out.push_back(std::move(queue_.front()));
+        queue_.pop_front();
+    }
+    if (count == 0) {
+        wake_pending_ = false;
+    }
+    return count;
+}
+
+void Socket::detach() noexcept {
+    std::lock_guard<std::mutex> lock(mutex_);
+    open_ = false;
+    wake_ = nullptr;
+    queue_.clear();
+    queued_bytes_ = 0;
+}
+
+bool Socket::overflowed() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return overflowed_;
+}
+
+bool Socket::close_sent() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return close_sent_;
+}
+
+void Channel::subscribe(std::shared_ptr<Socket> socket) {
+    auto& shard = shards_[shard_of(*socket)];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.sockets.push_back(std::move(socket));
+}
+
+void Channel::unsubscribe(const Socket& socket) {
+    auto& shard = shards_[shard_of(socket)];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto& sockets = shard.sockets;
+    const auto it = std::find_if(sockets.begin(), sockets.end(),
+        [&socket](const auto& candidate) { return candidate.get() == &socket; });
+    if (it != sockets.end()) {
+        *it = std::move(sockets.back());
+        sockets.pop_back();
+    }
+}
+
+size_t Channel::publish(const SharedFrame& frame) {
+    size_t delivered = 0;
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto& sockets = shard.sockets;
+        for (size_t i = 0; i < sockets.size();) {
+            if (sockets[i]->send(frame)) {
+                ++delivered;
+                ++i;
+            } else {
+                // 连接已经关闭或者太慢被断开
+                sockets[i] = std::move(sockets.back());
+                sockets.pop_back();
+            }
+        }
+    }
+    return delivered;
+}
+
+size_t Channel::size() const {
+    size_t total = 0;
+    for (const auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        total += shard.sockets.size();
+    }
+    return total;
+}
+
+} // namespace websocket
+} // namespace hsmm
@@ -0,0 +1,120 @@
+/*
+   碎片基准测试：分几个阶段分配和释放大小不同的内存块，
+   在每个阶段结束时比较进程的常驻内存（RSS）与程序实际持有的字节数。
+   - 阶段1：分配大量64~4096字节的内存块
+   - 阶段2：释放其中每隔一个的内存块，留下大量不相邻的空洞
+   - 阶段3：分配比空洞更大的内存块（4~16KB），只有合并后的空间才能复用
+   - 阶段4：随机释放一半，再分配随机大小的内存块
+   - 阶段5：释放所有内存块
+   输出各阶段的存活字节数、RSS和二者之比，以及整个过程的峰值。
+
+   与glibc对比：
+     gcc -O2 -o bench_fragmentation bench_fragmentation.c
+     ./bench_fragmentation
+     LD_PRELOAD=./memalloc.so ./bench_fragmentation
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#define NUM_BLOCKS 100000
+
+static char *blocks[NUM_BLOCKS];
+static size_t sizes[NUM_BLOCKS];
+static size_t live_bytes, peak_live_bytes;
+static uint32_t state = 12345;
+
+static uint32_t next_random(void)
+{
+    state = state * 1103515245u + 12345u;
+    return state >> 8;
+}
+
+static void alloc_block(size_t i, size_t size)
+{
+    blocks[i] = malloc(size);
+    if (!blocks[i]) {
+        fprintf(stderr, "分配%zu字节失败\n", size);
+        exit(1);
+    }
+    // 写满整个内存块，使所有页面都计入RSS
+    memset(blocks[i], (int)i, size);
+    sizes[i] = size;
+    live_bytes += size;
+    if (live_bytes > peak_live_bytes)
+        peak_live_bytes = live_bytes;
+}
+
+static void free_block(size_t i)
+{
+    free(blocks[i]);
+    blocks[i] = NULL;
+    live_bytes -= sizes[i];
+    sizes[i] = 0;
+}
+
+// 当前的RSS，单位字节
+static size_t current_rss(void)
+{
+    unsigned long pages = 0, resident = 0;
+    FILE *file = fopen("/proc/self/statm", "r");
+    if (file) {
+        if (fscanf(file, "%lu %lu", &pages, &resident) != 2)
+            resident = 0;
+        fclose(file);
+    }
+    return resident * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+static void report(const char *phase)
+{
+    size_t rss = current_rss();
+    printf("%-28s %12.1f %12.1f %10.2f\n", phase, live_bytes / 1048576.0, rss / 1048576.0,
+           live_bytes ? (double)rss / live_bytes : 0.0);
+}
+
+int main(void)
+{
+    const char *preload = getenv("LD_PRELOAD");
+    struct rusage usage;
+    size_t i;
+
+    printf("allocator: %s\n", preload && *preload ? preload : "glibc");
+    printf("%-28s %12s %12s %10s\n", "phase", "live MB", "RSS MB", "RSS/live");
+    report("start");
+
+    for (i = 0; i < NUM_BLOCKS; i++)
+        alloc_block(i, 64 + next_random() % (4096 - 64));
+    report("1 alloc 64B-4KB");
+
+    for (i = 0; i < NUM_BLOCKS; i += 2)
+        free_block(i);
+    report("2 free every other block");
+
+    for (i = 0; i < NUM_BLOCKS; i += 2)
+        if (next_random() % 2)
+            alloc_block(i, 4096 + next_random() % (16384 - 4096));
+    report("3 alloc 4KB-16KB");
+
+    for (i = 0; i < NUM_BLOCKS; i++)
+        if (blocks[i] && next_random() % 2)
+            free_block(i);
+    for (i = 0; i < NUM_BLOCKS; i++)
+        if (!blocks[i] && next_random() % 2)
+            alloc_block(i, 16 + next_random() % 8192);
+    report("4 random free/alloc");
+
+    for (i = 0; i < NUM_BLOCKS; i++)
+        if (blocks[i])
+            free_block(i);
+    report("5 free all");
+
+    getrusage(RUSAGE_SELF, &usage);
+    printf("peak live: %.1f MB, peak RSS: %.1f MB, peak RSS/peak live: %.2f\n",
+           peak_live_bytes / 1048576.0, usage.ru_maxrss / 1024.0,
+           (double)usage.ru_maxrss * 1024 / peak_live_bytes);
+    return 0;
+}
@@ -0,0 +1,92 @@
+/*
+   多线程分配基准测试：每个线程维护一组存活的内存块，随机释放其中一个再分配一个新的，
+   大小以16~512字节为主，偶尔有几KB的，与典型服务程序的分配分布相近。
+   输出各线程数下的总吞吐量（百万次malloc+free每秒）。
+
+   与glibc对比：
+     gcc -O2 -o bench_threads bench_threads.c -lpthread
+     ./bench_threads 1 2 4 8 16 32 64
+     LD_PRELOAD=./memalloc.so ./bench_threads 1 2 4 8 16 32 64
+ */
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// 每个线程存活的内存块数
+#define LIVE_BLOCKS 1024
+// 每个线程执行的malloc+free次数
+#define OPS_PER_THREAD 2000000
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static size_t random_size(uint32_t *state)
+{
+    uint32_t r;
+    *state = *state * 1103515245u + 12345u;
+    r = *state >> 8;
+    // 95%是16~512字节，其余为512字节~8KB
+    if (r % 100 < 95)
+        return 16 + (r >> 7) % 497;
+    return 512 + (r >> 7) % (8192 - 512);
+}
+
+static void *worker(void *arg)
+{
+    uint32_t state = (uint32_t)(uintptr_t)arg * 2654435761u + 1;
+    char *live[LIVE_BLOCKS];
+    size_t i, slot;
+    for (i = 0; i < LIVE_BLOCKS; i++) {
+        live[i] = malloc(random_size(&state));
+        live[i][0] = (char)i;
+    }
+    for (i = 0; i < OPS_PER_THREAD; i++) {
+        state = state * 1103515245u + 12345u;
+        slot = (state >> 8) % LIVE_BLOCKS;
+        free(live[slot]);
+        live[slot] = malloc(random_size(&state));
+        // 写一个字节，避免分配器的行为完全不触及内存
+        live[slot][0] = (char)i;
+    }
+    for (i = 0; i < LIVE_BLOCKS; i++)
+        free(live[i]);
+    return NULL;
+}
+
+static double run(int threads)
+{
+    pthread_t tids[256];
+    double start;
+    int i;
+    start = now();
+    for (i = 0; i < threads; i++)
+        pthread_create(&tids[i], NULL, worker, (void*)(uintptr_t)(i + 1));
+    for (i = 0; i < threads; i++)
+        pthread_join(tids[i], NULL);
+    return (double)threads * OPS_PER_THREAD / (now() - start) / 1e6;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *preload = getenv("LD_PRELOAD");
+    int i, threads;
+    printf("allocator: %s\n", preload && *preload ? preload : "glibc");
+    printf("%8s %14s\n", "threads", "Mops/s");
+    for (i = 1; i < argc; i++) {
+        threads = atoi(argv[i]);
+        if (threads < 1 || threads > 256) {
+            fprintf(stderr, "线程数必须在1~256之间: %s\n", argv[i]);
+            return 1;
+        }
+        printf("%8d %14.2f\n", threads, run(threads));
+        fflush(stdout);
+    }
+    return 0;
+}
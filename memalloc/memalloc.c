@@ -1,18 +1,31 @@
+// mremap()需要
+#define _GNU_SOURCE
 #include <unistd.h>
+#include <sys/mman.h>
+#include <stdlib.h>
+#include <errno.h>
 #include <string.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <pthread.h>
 /* 仅用于调试输出 */
 #include <stdio.h>
 
-// 定义一个长度为16的字符数组，用于强制头部按16字节对齐
-typedef char ALIGN[16];
+// 用max_align_t强制头部按16字节对齐，返回给用户的地址也因此按16字节对齐
+typedef max_align_t ALIGN;
 
-// 定义一个联合体，用于表示内存块的头部信息
+/*
+   内存块的头部。堆中的内存块在地址上首尾相接，头部之后就是返回给用户的内存。
+   prev_size是前一个内存块的大小，即前一块末尾的边界标记（footer），
+   释放时据此找到前一块，两边空闲的邻居都立即合并，堆中不会有相邻的两个空闲内存块。
+   size的低4位用作标志；next/prev只在内存块空闲时使用。
+ */
 union header {
     struct {
-        size_t size;         // 内存块的大小
-        unsigned is_free;    // 标记该内存块是否空闲
-        union header *next;  // 指向下一个内存块头部的指针
+        size_t prev_size;    // 前一个内存块的大小（边界标记）
+        size_t size;         // 内存块的大小，低4位是标志
+        union header *next;  // 空闲链表中的下一个内存块
+        union header *prev;  // 空闲链表中的上一个内存块
     } s;
     // 强制头部按16字节对齐
     ALIGN stub;
@@ -20,78 +33,478 @@ union header {
 // 为联合体类型定义别名
 typedef union header header_t;
 
-// 定义链表的头指针和尾指针，初始化为NULL
-header_t *head = NULL, *tail = NULL;
-// 定义全局互斥锁，用于保证线程安全
-pthread_mutex_t global_malloc_lock;
+/*
+   大小类：
+   - 1024字节以内按16字节递增，每个大小一个类（64个）
+   - 1024字节以上每个2的幂区间等分为4个类，直到64MB（64个）
+   线程缓存范围内的申请向上取整到所属类的大小，更大的申请只按16字节对齐。
+   空闲内存块按大小放入对应的空闲链表（bin）：第i个链表中的内存块不小于第i个类的大小，
+   分配时从申请大小所属的类开始，借助位图找到第一个非空的链表，取出头部的内存块，
+   多余的部分切分出来放回空闲链表。超过最大类的内存块放在最后一个链表中，按首次适配查找。
+ */
+#define ALIGNMENT 16
+#define SMALL_MAX 1024
+#define NUM_SMALL_CLASSES (SMALL_MAX / ALIGNMENT)
+#define LARGE_STEPS_LOG2 2
+#define NUM_LARGE_CLASSES 64
+#define NUM_CLASSES (NUM_SMALL_CLASSES + NUM_LARGE_CLASSES)
+#define HUGE_BIN NUM_CLASSES
+#define NUM_BINS (NUM_CLASSES + 1)
 
-// 查找空闲且能容纳指定大小的内存块
-header_t *get_free_block(size_t size)
+// 内存块大小的标志位
+#define BLOCK_FREE 1u     // 空闲，位于中心堆的空闲链表中
+#define BLOCK_ALIGNED 2u  // 对齐分配留下的偏移头部，大小是到真正内存块起始地址的偏移
+#define BLOCK_MMAPPED 4u  // 单独用mmap()分配的大内存块，大小是映射的长度减去头部
+#define BLOCK_CLEAN 8u    // 空闲内存块中完整的页已经归还操作系统
+#define FLAG_MASK ((size_t)ALIGNMENT - 1)
+
+// 切分后剩余的部分至少能放下一个头部和32字节时才切分，更小的余量留在内存块中
+#define SPLIT_THRESHOLD (sizeof(header_t) + 2 * ALIGNMENT)
+/*
+   中心堆由若干个用mmap()分配、按2MB对齐的内存区（chunk）组成，每个内存区以一个大小为0的头哨兵开始，
+   以一个大小为0的尾哨兵结束，合并时不会越过哨兵。设置环境变量MEMALLOC_HUGEPAGES=1时，
+   内存区用madvise(MADV_HUGEPAGE)请求透明大页。
+ */
+#define CHUNK_SIZE ((size_t)2 * 1024 * 1024)
+/*
+   不小于mmap_threshold的申请直接用mmap()分配，释放时munmap()。阈值从MMAP_THRESHOLD开始，
+   释放一个mmap()分配的内存块时提高到它的大小（最多MMAP_THRESHOLD_MAX），
+   反复分配和释放同样大小的内存块时改由内存区提供，避免每次映射新页面的缺页开销
+ */
+#define MMAP_THRESHOLD (128 * 1024)
+#define MMAP_THRESHOLD_MAX ((size_t)32 * 1024 * 1024)
+/*
+   不小于RELEASE_THRESHOLD的空闲内存块中完整的页可以用madvise(MADV_DONTNEED)归还操作系统。
+   这样的内存块总共超过内存区总大小的1/8（至少DIRTY_MAX字节）时，从最大的开始归还，直到剩下一半。
+   马上会被重新使用的内存不立即归还，避免反复缺页
+ */
+#define RELEASE_THRESHOLD (64 * 1024)
+#define DIRTY_MAX ((size_t)4 * 1024 * 1024)
+
+/*
+   线程缓存（tcache）：32KB以内的大小类，每个线程保存一些最近释放的内存块，
+   malloc/free先在本线程的缓存中取出或放入，不加锁。
+   缓存为空时一次从中心堆取一批，超过上限时一次归还一批，每批只加一次锁。
+   线程退出时缓存中的内存块全部归还中心堆。
+ */
+#define TCACHE_MAX_SIZE_LOG2 15
+#define NUM_TCACHE_CLASSES (NUM_SMALL_CLASSES + ((TCACHE_MAX_SIZE_LOG2 - 10) << LARGE_STEPS_LOG2))
+// 每个类缓存的字节数大约不超过这个值，同时数量限制在[TCACHE_MIN_COUNT, TCACHE_MAX_COUNT]
+#define TCACHE_CLASS_BYTES 65536
+#define TCACHE_MIN_COUNT 4
+#define TCACHE_MAX_COUNT 64
+
+enum { TCACHE_UNUSED, TCACHE_ACTIVE, TCACHE_DISABLED };
+
+struct tcache {
+    header_t *lists[NUM_TCACHE_CLASSES];
+    unsigned counts[NUM_TCACHE_CLASSES];
+    // 线程退出时归还缓存后变为TCACHE_DISABLED，之后的分配和释放直接使用中心堆
+    int state;
+};
+
+// 每个大小类一个空闲链表（双向），最后一个是超大内存块的链表
+header_t *bins[NUM_BINS];
+// 非空空闲链表的位图
+uint64_t bin_map[(NUM_BINS + 63) / 64];
+// 当前的mmap()阈值，不受锁保护，用原子操作读写
+size_t mmap_threshold = MMAP_THRESHOLD;
+// 所有内存区的总字节数
+size_t chunk_bytes;
+// 空闲链表中不小于RELEASE_THRESHOLD、页面还没有归还的内存块的总字节数
+size_t dirty_bytes;
+// 定义全局互斥锁，保护中心堆：空闲链表及其位图、各内存区中内存块的头部，以及chunk_bytes和dirty_bytes
+pthread_mutex_t global_malloc_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// initial-exec模型的TLS直接用线程指针寻址，第一次访问时不会调用malloc
+static __thread struct tcache tcache __attribute__((tls_model("initial-exec")));
+// 用于在线程退出时归还线程缓存
+static pthread_key_t tcache_key;
+static pthread_once_t tcache_key_once = PTHREAD_ONCE_INIT;
+
+// 计算容纳size字节所需的大小类，超过最大类时返回HUGE_BIN
+static size_t size_class(size_t size)
+{
+    unsigned msb;
+    if (size <= SMALL_MAX)
+        return (size + ALIGNMENT - 1) / ALIGNMENT - 1;
+    // size位于(2^msb, 2^(msb+1)]，该区间等分为2^LARGE_STEPS_LOG2个类
+    msb = 63 - __builtin_clzl(size - 1);
+    if (msb - 10 >= NUM_LARGE_CLASSES >> LARGE_STEPS_LOG2)
+        return HUGE_BIN;
+    return NUM_SMALL_CLASSES + ((msb - 10) << LARGE_STEPS_LOG2)
+        + (((size - 1) >> (msb - LARGE_STEPS_LOG2)) & ((1u << LARGE_STEPS_LOG2) - 1));
+}
+
+// 大小类对应的内存块大小
+static size_t class_size(size_t cls)
+{
+    unsigned msb, step;
+    if (cls < NUM_SMALL_CLASSES)
+        return (cls + 1) * ALIGNMENT;
+    msb = 10 + ((cls - NUM_SMALL_CLASSES) >> LARGE_STEPS_LOG2);
+    step = (cls - NUM_SMALL_CLASSES) & ((1u << LARGE_STEPS_LOG2) - 1);
+    return ((size_t)1 << msb) + ((size_t)(step + 1) << (msb - LARGE_STEPS_LOG2));
+}
+
+// 线程缓存中一个大小类最多保存的内存块数，一批转移其中的一半
+static unsigned tcache_limit(size_t cls)
+{
+    size_t count = TCACHE_CLASS_BYTES / class_size(cls);
+    if (count < TCACHE_MIN_COUNT)
+        return TCACHE_MIN_COUNT;
+    return count > TCACHE_MAX_COUNT ? TCACHE_MAX_COUNT : (unsigned)count;
+}
+
+// 空闲内存块所在的链表：不大于size的最大的类，超过最大类时是HUGE_BIN
+static size_t bin_index(size_t size)
+{
+    size_t cls = size_class(size);
+    if (cls != HUGE_BIN && class_size(cls) > size)
+        cls--;
+    return cls;
+}
+
+static size_t block_size(const header_t *header)
+{
+    return header->s.size & ~FLAG_MASK;
+}
+
+// 地址上的后一个内存块
+static header_t *next_block(header_t *header)
+{
+    return (header_t*)((char*)(header + 1) + block_size(header));
+}
+
+// 地址上的前一个内存块，由边界标记得到
+static header_t *prev_block(header_t *header)
+{
+    return (header_t*)((char*)header - header->s.prev_size) - 1;
+}
+
+// 设置内存块的大小和标志，同时更新后一个内存块中的边界标记
+static void set_block(header_t *header, size_t size, unsigned flags)
+{
+    header->s.size = size | flags;
+    next_block(header)->s.prev_size = size;
+}
+
+// 对齐分配返回的地址先换回真正的内存块起始地址
+static void *block_start(void *block)
+{
+    header_t *header = (header_t*)block - 1;
+    if (header->s.size & BLOCK_ALIGNED)
+        return (char*)block - block_size(header);
+    return block;
+}
+
+// 把空闲内存块插入所属空闲链表的头部
+static void insert_free(header_t *header)
+{
+    size_t size = block_size(header), bin = bin_index(size);
+    set_block(header, size, BLOCK_FREE);
+    if (size >= RELEASE_THRESHOLD)
+        dirty_bytes += size;
+    header->s.prev = NULL;
+    header->s.next = bins[bin];
+    if (bins[bin])
+        bins[bin]->s.prev = header;
+    bins[bin] = header;
+    bin_map[bin / 64] |= (uint64_t)1 << (bin % 64);
+}
+
+// 把空闲内存块从所在的空闲链表中摘下，O(1)
+static void remove_free(header_t *header)
+{
+    size_t size = block_size(header), bin = bin_index(size);
+    if (header->s.prev)
+        header->s.prev->s.next = header->s.next;
+    else
+        bins[bin] = header->s.next;
+    if (header->s.next)
+        header->s.next->s.prev = header->s.prev;
+    if (!bins[bin])
+        bin_map[bin / 64] &= ~((uint64_t)1 << (bin % 64));
+    if (size >= RELEASE_THRESHOLD && !(header->s.size & BLOCK_CLEAN))
+        dirty_bytes -= size;
+    header->s.size = size;
+}
+
+// 从第bin个链表开始找第一个非空的空闲链表，没有时返回NUM_BINS
+static size_t next_nonempty_bin(size_t bin)
+{
+    size_t word = bin / 64;
+    uint64_t bits = bin_map[word] & (~(uint64_t)0 << (bin % 64));
+    while (!bits) {
+        if (++word == sizeof(bin_map) / sizeof(bin_map[0]))
+            return NUM_BINS;
+        bits = bin_map[word];
+    }
+    return word * 64 + (size_t)__builtin_ctzll(bits);
+}
+
+// 从空闲链表中取出能容纳size字节的内存块
+static header_t *get_free_block(size_t size)
 {
-    header_t *curr = head;
-    // 遍历链表
-    while(curr) {
-        // 查看是否有空闲且能容纳请求大小的内存块
-        if (curr->s.is_free && curr->s.size >= size)
+    header_t *curr;
+    size_t bin = next_nonempty_bin(size_class(size));
+    if (bin == NUM_BINS)
+        return NULL;
+    if (bin != HUGE_BIN) {
+        // 这个链表中的内存块都不小于size，直接取头部
+        curr = bins[bin];
+        remove_free(curr);
+        return curr;
+    }
+    // 超大内存块按首次适配查找
+    for (curr = bins[HUGE_BIN]; curr; curr = curr->s.next) {
+        if (block_size(curr) >= size) {
+            remove_free(curr);
             return curr;
-        curr = curr->s.next;
+        }
     }
     return NULL;
 }
 
+// 内存块比size大出SPLIT_THRESHOLD以上时，把多余的部分切分成新的空闲内存块
+static void split_block(header_t *header, size_t size)
+{
+    size_t total = block_size(header);
+    header_t *rest;
+    if (total - size < SPLIT_THRESHOLD)
+        return;
+    set_block(header, size, 0);
+    rest = next_block(header);
+    // 原内存块的后一块不是空闲的（否则已经合并），剩余部分不需要再合并
+    set_block(rest, total - size - sizeof(header_t), 0);
+    insert_free(rest);
+}
+
+// 与地址上相邻的空闲内存块合并，返回合并后的内存块（不在空闲链表中）
+static header_t *coalesce(header_t *header)
+{
+    size_t size = block_size(header);
+    header_t *neighbor = next_block(header);
+    if (neighbor->s.size & BLOCK_FREE) {
+        remove_free(neighbor);
+        size += sizeof(header_t) + block_size(neighbor);
+    }
+    neighbor = prev_block(header);
+    if (neighbor->s.size & BLOCK_FREE) {
+        remove_free(neighbor);
+        size += sizeof(header_t) + block_size(neighbor);
+        header = neighbor;
+    }
+    set_block(header, size, 0);
+    return header;
+}
+
+// 把内存块中完整的页归还操作系统，头部所在的页保留，内存块仍可正常使用
+static void release_pages(header_t *header)
+{
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t begin = ((uintptr_t)(header + 1) + page - 1) & ~(page - 1);
+    uintptr_t end = (uintptr_t)next_block(header) & ~(page - 1);
+    if (begin < end)
+        madvise((void*)begin, end - begin, MADV_DONTNEED);
+}
+
+// 映射len字节、按align对齐的内存，align必须是页大小的整数倍
+static void *map_aligned(size_t len, size_t align)
+{
+    char *map = mmap(NULL, len + align, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    size_t head;
+    if (map == MAP_FAILED)
+        return NULL;
+    // 多映射align字节，再去掉前后不对齐的部分
+    head = (size_t)(-(uintptr_t)map & (align - 1));
+    if (head)
+        munmap(map, head);
+    munmap(map + head + len, align - head);
+    return map + head;
+}
+
+/*
+   新映射一个能容纳size字节的内存区，长度是CHUNK_SIZE的整数倍，返回其中唯一的空闲内存块（不在空闲链表中）。
+   调用者必须持有global_malloc_lock
+ */
+static header_t *chunk_alloc(size_t size)
+{
+    static int hugepages = -1;
+    const char *env;
+    size_t len = (size + 3 * sizeof(header_t) + CHUNK_SIZE - 1) & ~(CHUNK_SIZE - 1);
+    header_t *header = map_aligned(len, CHUNK_SIZE);
+    if (!header)
+        return NULL;
+    chunk_bytes += len;
+    if (hugepages < 0) {
+        env = getenv("MEMALLOC_HUGEPAGES");
+        hugepages = env && *env == '1';
+    }
+    if (hugepages)
+        madvise(header, len, MADV_HUGEPAGE);
+    // 头哨兵，mmap()得到的内存已经清零
+    header++;
+    set_block(header, len - 3 * sizeof(header_t), 0);
+    // 尾哨兵
+    next_block(header)->s.size = 0;
+    return header;
+}
+
+// 用mmap()单独分配一个大内存块
+static header_t *mmap_alloc(size_t size)
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t len = (size + sizeof(header_t) + page - 1) & ~(page - 1);
+    header_t *header = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (header == MAP_FAILED)
+        return NULL;
+    header->s.size = (len - sizeof(header_t)) | BLOCK_MMAPPED;
+    return header;
+}
+
+// 未归还的空闲页面最多保留的字节数
+static size_t dirty_limit(void)
+{
+    return chunk_bytes / 8 > DIRTY_MAX ? chunk_bytes / 8 : DIRTY_MAX;
+}
+
+// 从最大的空闲内存块开始归还页面，直到dirty_bytes降到上限的一半
+static void release_dirty(void)
+{
+    size_t bin, last = bin_index(RELEASE_THRESHOLD), target = dirty_limit() / 2;
+    header_t *curr, *next;
+    for (bin = HUGE_BIN; bin >= last && dirty_bytes > target; bin--) {
+        for (curr = bins[bin]; curr && dirty_bytes > target; curr = next) {
+            next = curr->s.next;
+            if (!prev_block(curr)->s.size && !next_block(curr)->s.size) {
+                // 整个内存区都空闲，直接解除映射
+                remove_free(curr);
+                chunk_bytes -= block_size(curr) + 3 * sizeof(header_t);
+                munmap(curr - 1, block_size(curr) + 3 * sizeof(header_t));
+                continue;
+            }
+            if (curr->s.size & BLOCK_CLEAN)
+                continue;
+            release_pages(curr);
+            curr->s.size |= BLOCK_CLEAN;
+            dirty_bytes -= block_size(curr);
+        }
+    }
+}
+
+/*
+   把内存块归还中心堆：先与相邻的空闲内存块合并，再放入空闲链表，未归还的空闲页面过多时归还一部分。
+   调用者必须持有global_malloc_lock
+ */
+static void heap_free(header_t *header)
+{
+    header = coalesce(header);
+    insert_free(header);
+    if (dirty_bytes > dirty_limit())
+        release_dirty();
+}
+
+// 在中心堆上分配至少size字节的内存块，多余的部分切分出来。调用者必须持有global_malloc_lock
+static header_t *heap_alloc(size_t size)
+{
+    header_t *header = get_free_block(size);
+    if (!header && !(header = chunk_alloc(size)))
+        return NULL;
+    split_block(header, size);
+    return header;
+}
+
+// 把线程缓存中一个大小类的前count个内存块归还中心堆，只加一次锁
+static void tcache_flush(size_t cls, unsigned count)
+{
+    header_t *header;
+    pthread_mutex_lock(&global_malloc_lock);
+    while (count-- && (header = tcache.lists[cls])) {
+        tcache.lists[cls] = header->s.next;
+        tcache.counts[cls]--;
+        heap_free(header);
+    }
+    pthread_mutex_unlock(&global_malloc_lock);
+}
+
+// 线程退出时归还线程缓存中的所有内存块
+static void tcache_release(void *arg)
+{
+    size_t cls;
+    (void)arg;
+    for (cls = 0; cls < NUM_TCACHE_CLASSES; cls++)
+        tcache_flush(cls, tcache.counts[cls]);
+    tcache.state = TCACHE_DISABLED;
+}
+
+static void tcache_create_key(void)
+{
+    pthread_key_create(&tcache_key, tcache_release);
+}
+
+// 线程第一次使用缓存时注册退出时的归还函数
+static void tcache_init(void)
+{
+    // 先改状态：pthread_setspecific()可能分配内存，再次进入这里时不能重复注册
+    tcache.state = TCACHE_ACTIVE;
+    pthread_once(&tcache_key_once, tcache_create_key);
+    pthread_setspecific(tcache_key, &tcache);
+}
+
+/*
+   从中心堆取一批内存块放入线程缓存，只加一次锁。
+   缓存中的内存块在中心堆看来仍在使用，不参与合并，归还中心堆时才合并（延迟合并）
+ */
+static void tcache_refill(size_t cls)
+{
+    unsigned count = tcache_limit(cls) / 2;
+    header_t *header;
+    if (tcache.state == TCACHE_UNUSED)
+        tcache_init();
+    pthread_mutex_lock(&global_malloc_lock);
+    while (tcache.counts[cls] < count && (header = heap_alloc(class_size(cls)))) {
+        header->s.next = tcache.lists[cls];
+        tcache.lists[cls] = header;
+        tcache.counts[cls]++;
+    }
+    pthread_mutex_unlock(&global_malloc_lock);
+}
+
 // 释放指定的内存块
 void free(void *block)
 {
-    header_t *header, *tmp;
-    // 程序断点是进程数据段的末尾
-    void *programbreak;
+    header_t *header;
+    size_t cls, size;
 
     // 如果传入的指针为空，直接返回
     if (!block)
         return;
-    // 加锁，保证线程安全
-    pthread_mutex_lock(&global_malloc_lock);
     // 获取内存块的头部信息
-    header = (header_t*)block - 1;
-    // sbrk(0) 获取当前程序断点的地址
-    programbreak = sbrk(0);
-
-    /*
-       检查要释放的内存块是否是链表中的最后一个。
-       如果是，则缩小堆的大小并将内存释放给操作系统。
-       否则，将该内存块标记为空闲。
-     */
-    if ((char*)block + header->s.size == programbreak) {
-        if (head == tail) {
-            // 如果链表中只有一个节点，将头指针和尾指针置为NULL
-            head = tail = NULL;
-        } else {
-            tmp = head;
-            // 遍历链表找到倒数第二个节点
-            while (tmp) {
-                if(tmp->s.next == tail) {
-                    tmp->s.next = NULL;
-                    tail = tmp;
-                }
-                tmp = tmp->s.next;
-            }
-        }
-        /*
-           sbrk() 传入负数参数会减小程序断点，
-           从而将内存释放给操作系统。
-        */
-        sbrk(0 - header->s.size - sizeof(header_t));
-        /* 注意：这个锁并不能真正保证线程安全，
-           因为 sbrk() 本身不是线程安全的。
-           假设在我们获取程序断点之后、减小断点之前，
-           发生了一个外部的 sbrk(N) 调用，
-           那么我们最终会释放外部 sbrk() 获取的内存。
-        */
-        pthread_mutex_unlock(&global_malloc_lock);
+    header = (header_t*)block_start(block) - 1;
+    if (header->s.size & BLOCK_MMAPPED) {
+        // 提高mmap()的阈值，之后同样大小的申请由内存区提供
+        size = block_size(header);
+        if (size > __atomic_load_n(&mmap_threshold, __ATOMIC_RELAXED) && size <= MMAP_THRESHOLD_MAX)
+            __atomic_store_n(&mmap_threshold, size, __ATOMIC_RELAXED);
+        munmap(header, size + sizeof(header_t));
+        return;
+    }
+    // 切分留下的余量可能使内存块比所属类稍大，按不大于它的类缓存
+    cls = bin_index(block_size(header));
+    if (cls < NUM_TCACHE_CLASSES && tcache.state != TCACHE_DISABLED) {
+        // 放入线程缓存，超过上限时归还一半
+        if (tcache.state == TCACHE_UNUSED)
+            tcache_init();
+        header->s.next = tcache.lists[cls];
+        tcache.lists[cls] = header;
+        if (++tcache.counts[cls] > tcache_limit(cls))
+            tcache_flush(cls, tcache.counts[cls] / 2);
         return;
     }
-    // 将该内存块标记为空闲
-    header->s.is_free = 1;
+    // 加锁，保证线程安全
+    pthread_mutex_lock(&global_malloc_lock);
+    heap_free(header);
     // 解锁
     pthread_mutex_unlock(&global_malloc_lock);
 }
@@ -99,50 +512,41 @@ void free(void *block)
 // 分配指定大小的内存
 void *malloc(size_t size)
 {
-    size_t total_size;
-    void *block;
+    size_t cls;
     header_t *header;
     // 如果请求的大小为0，直接返回NULL
     if (!size)
         return NULL;
-    // 加锁，保证线程安全
-    pthread_mutex_lock(&global_malloc_lock);
-    // 查找空闲且能容纳指定大小的内存块
-    header = get_free_block(size);
-    if (header) {
-        // 找到合适的空闲块，将其标记为已使用
-        header->s.is_free = 0;
-        // 解锁
-        pthread_mutex_unlock(&global_malloc_lock);
-        // 返回内存块的起始地址
+    // 大小加上头部和对齐后不能溢出
+    if (size > PTRDIFF_MAX - sizeof(header_t) - ALIGNMENT)
+        return NULL;
+    // 线程缓存范围内向上取整到所属大小类的大小，更大的只按16字节对齐，由切分去掉多余的部分
+    cls = size_class(size);
+    size = cls < NUM_TCACHE_CLASSES ? class_size(cls) : (size + ALIGNMENT - 1) & ~(size_t)(ALIGNMENT - 1);
+    if (cls < NUM_TCACHE_CLASSES && tcache.state != TCACHE_DISABLED) {
+        // 先从线程缓存中取，不加锁
+        if (!tcache.lists[cls])
+            tcache_refill(cls);
+        header = tcache.lists[cls];
+        if (!header)
+            return NULL;
+        tcache.lists[cls] = header->s.next;
+        tcache.counts[cls]--;
         return (void*)(header + 1);
     }
-    // 需要从操作系统获取内存，以容纳请求的内存块和头部信息
-    total_size = sizeof(header_t) + size;
-    // 调用 sbrk() 分配内存
-    block = sbrk(total_size);
-    if (block == (void*) -1) {
-        // 分配失败，解锁并返回NULL
-        pthread_mutex_unlock(&global_malloc_lock);
-        return NULL;
+    if (size >= __atomic_load_n(&mmap_threshold, __ATOMIC_RELAXED)) {
+        // 大内存块直接映射，不加锁，释放时立即归还操作系统
+        header = mmap_alloc(size);
+        return header ? (void*)(header + 1) : NULL;
     }
-    header = block;
-    // 设置内存块的大小
-    header->s.size = size;
-    // 标记该内存块为已使用
-    header->s.is_free = 0;
-    // 下一个节点指针置为NULL
-    header->s.next = NULL;
-    if (!head)
-        // 如果链表为空，将头指针指向该节点
-        head = header;
-    if (tail)
-        // 如果链表不为空，将尾节点的下一个指针指向该节点
-        tail->s.next = header;
-    // 更新尾指针
-    tail = header;
+    // 加锁，保证线程安全
+    pthread_mutex_lock(&global_malloc_lock);
+    // 查找空闲且能容纳指定大小的内存块，没有时映射一个新的内存区
+    header = heap_alloc(size);
     // 解锁
     pthread_mutex_unlock(&global_malloc_lock);
+    if (!header)
+        return NULL;
     // 返回内存块的起始地址
     return (void*)(header + 1);
 }
@@ -169,38 +573,152 @@ void *calloc(size_t num, size_t nsize)
     return block;
 }
 
+// 内存块中从block开始可以使用的字节数
+size_t malloc_usable_size(void *block)
+{
+    void *start;
+    if (!block)
+        return 0;
+    start = block_start(block);
+    return block_size((header_t*)start - 1) - (size_t)((char*)block - (char*)start);
+}
+
+// 吞并地址上紧接着的空闲内存块，把中心堆上的内存块原地扩大到size字节，成功时返回1
+static int heap_grow(header_t *header, size_t size)
+{
+    header_t *next;
+    int grown = 0;
+    pthread_mutex_lock(&global_malloc_lock);
+    next = next_block(header);
+    if ((next->s.size & BLOCK_FREE) && block_size(header) + sizeof(header_t) + block_size(next) >= size) {
+        remove_free(next);
+        set_block(header, block_size(header) + sizeof(header_t) + block_size(next), 0);
+        // 多出的部分切分回空闲链表
+        split_block(header, size);
+        grown = 1;
+    }
+    pthread_mutex_unlock(&global_malloc_lock);
+    return grown;
+}
+
+// 用mremap()改变mmap()分配的内存块的大小，内核只移动页表而不复制内容
+static header_t *mmap_resize(header_t *header, size_t size)
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t len = (size + sizeof(header_t) + page - 1) & ~(page - 1);
+    header = mremap(header, block_size(header) + sizeof(header_t), len, MREMAP_MAYMOVE);
+    if (header == MAP_FAILED)
+        return NULL;
+    header->s.size = (len - sizeof(header_t)) | BLOCK_MMAPPED;
+    return header;
+}
+
 // 重新分配指定内存块的大小
 void *realloc(void *block, size_t size)
 {
+    size_t usable;
     header_t *header;
     void *ret;
-    // 如果传入的指针为空或请求的大小为0，调用 malloc() 分配内存
-    if (!block || !size)
+    // 如果传入的指针为空，调用 malloc() 分配内存
+    if (!block)
         return malloc(size);
-    // 获取内存块的头部信息
-    header = (header_t*)block - 1;
-    // 如果当前内存块的大小足够，直接返回该内存块
-    if (header->s.size >= size)
+    // 如果请求的大小为0，释放内存块
+    if (!size) {
+        free(block);
+        return NULL;
+    }
+    usable = malloc_usable_size(block);
+    // 如果当前内存块的大小足够（大小类取整和切分留下的余量），直接返回该内存块
+    if (usable >= size)
         return block;
+    if (size > PTRDIFF_MAX - sizeof(header_t) - ALIGNMENT)
+        return NULL;
+    header = (header_t*)block - 1;
+    // 对齐分配的内存块（有偏移头部）仍然复制到新的内存块
+    if (block_start(block) == block) {
+        if (header->s.size & BLOCK_MMAPPED) {
+            header = mmap_resize(header, size);
+            return header ? (void*)(header + 1) : NULL;
+        }
+        // 后面紧接着足够大的空闲内存块时原地扩大，不复制内容
+        if (heap_grow(header, (size + ALIGNMENT - 1) & ~(size_t)(ALIGNMENT - 1)))
+            return block;
+    }
     // 调用 malloc() 分配新的内存块
     ret = malloc(size);
     if (ret) {
         // 将原内存块的内容复制到新的内存块
-        memcpy(ret, block, header->s.size);
+        memcpy(ret, block, usable);
         // 释放原内存块
         free(block);
     }
     return ret;
 }
 
-// 调试函数，用于打印整个链表信息
+// 分配起始地址按alignment对齐的内存，alignment必须是2的幂
+int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+    char *block, *aligned;
+    header_t *header;
+    if (!alignment || (alignment & (alignment - 1)) || alignment % sizeof(void*))
+        return EINVAL;
+    if (alignment <= ALIGNMENT) {
+        *memptr = malloc(size ? size : 1);
+        return *memptr ? 0 : ENOMEM;
+    }
+    if (size > PTRDIFF_MAX - alignment - sizeof(header_t))
+        return ENOMEM;
+    // 多申请alignment加一个头部的空间，保证对齐后的地址之前放得下偏移头部
+    block = malloc(size + alignment + sizeof(header_t));
+    if (!block)
+        return ENOMEM;
+    aligned = (char*)(((uintptr_t)block + sizeof(header_t) + alignment - 1) & ~(uintptr_t)(alignment - 1));
+    header = (header_t*)aligned - 1;
+    header->s.size = (size_t)(aligned - block) | BLOCK_ALIGNED;
+    *memptr = aligned;
+    return 0;
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+    void *block;
+    if (alignment < sizeof(void*))
+        alignment = sizeof(void*);
+    if (posix_memalign(&block, alignment, size))
+        return NULL;
+    return block;
+}
+
+void *memalign(size_t alignment, size_t size)
+{
+    return aligned_alloc(alignment, size);
+}
+
+void *valloc(size_t size)
+{
+    return aligned_alloc((size_t)sysconf(_SC_PAGESIZE), size);
+}
+
+void *pvalloc(size_t size)
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    return aligned_alloc(page, (size + page - 1) & ~(page - 1));
+}
+
+// 调试函数，用于打印各个空闲链表的信息
 void print_mem_list()
 {
-    header_t *curr = head;
-    printf("head = %p, tail = %p \n", (void*)head, (void*)tail);
-    while(curr) {
-        printf("addr = %p, size = %zu, is_free=%u, next=%p\n",
-               (void*)curr, curr->s.size, curr->s.is_free, (void*)curr->s.next);
-        curr = curr->s.next;
+    size_t cls, count;
+    header_t *curr;
+    for (cls = 0; cls < NUM_BINS; cls++) {
+        if (!bins[cls])
+            continue;
+        count = 0;
+        for (curr = bins[cls]; curr; curr = curr->s.next)
+            count++;
+        if (cls == HUGE_BIN)
+            printf("huge: %zu free blocks\n", count);
+        else
+            printf("class %zu (size >= %zu): %zu free blocks\n", cls, class_size(cls), count);
     }
-}    
\ No newline at end of file
+}